@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <deque>
+#include <algorithm>
+
+#include "BipartiteMatching.hh"
+
+BipartiteMatching::BipartiteMatching(int nleft_arg, int nright_arg, vector<int> row_begin_arg, vector<int> adj_arg) :
+  nleft{nleft_arg}, nright{nright_arg}, row_begin{move(row_begin_arg)}, adj{move(adj_arg)},
+  active_end(row_begin.begin() + 1, row_begin.end()), left_mate(nleft, -1), right_mate(nright, -1),
+  layer(nleft)
+{
+  assert((int) row_begin.size() == nleft + 1);
+}
+
+void
+BipartiteMatching::setActiveDegree(int i, int degree)
+{
+  assert(degree >= 0 && degree <= row_begin[i+1] - row_begin[i]);
+  active_end[i] = row_begin[i] + degree;
+  int j = left_mate[i];
+  if (j >= 0 && find(adj.begin() + row_begin[i], adj.begin() + active_end[i], j) == adj.begin() + active_end[i])
+    {
+      left_mate[i] = -1;
+      right_mate[j] = -1;
+    }
+}
+
+bool
+BipartiteMatching::buildLayers()
+{
+  deque<int> queue;
+  for (int i = 0; i < nleft; i++)
+    if (left_mate[i] < 0)
+      {
+        layer[i] = 0;
+        queue.push_back(i);
+      }
+    else
+      layer[i] = -1;
+
+  bool found = false;
+  while (!queue.empty())
+    {
+      int i = queue.front();
+      queue.pop_front();
+      for (int k = row_begin[i]; k < active_end[i]; k++)
+        {
+          int mate = right_mate[adj[k]];
+          if (mate < 0)
+            found = true;
+          else if (layer[mate] < 0)
+            {
+              layer[mate] = layer[i] + 1;
+              queue.push_back(mate);
+            }
+        }
+    }
+  return found;
+}
+
+bool
+BipartiteMatching::augmentFrom(int root, vector<int> &next_edge)
+{
+  // Depth-first search with an explicit stack of left vertices, since paths can be as long as the graph
+  vector<int> path{root};
+  while (!path.empty())
+    {
+      int i = path.back();
+      if (next_edge[i] == active_end[i])
+        {
+          // Dead end: no augmenting path goes through i in this phase
+          layer[i] = -1;
+          path.pop_back();
+          continue;
+        }
+      int j = adj[next_edge[i]];
+      int mate = right_mate[j];
+      if (mate < 0)
+        {
+          // Flips the edges along the path
+          for (auto it = path.rbegin(); it != path.rend(); ++it)
+            {
+              int left = *it, right = adj[next_edge[left]];
+              left_mate[left] = right;
+              right_mate[right] = left;
+            }
+          return true;
+        }
+      if (layer[mate] == layer[i] + 1)
+        path.push_back(mate);
+      else
+        next_edge[i]++;
+    }
+  return false;
+}
+
+int
+BipartiteMatching::augment()
+{
+  vector<int> next_edge(nleft);
+  while (buildLayers())
+    {
+      copy(row_begin.begin(), row_begin.end() - 1, next_edge.begin());
+      bool augmented = false;
+      for (int i = 0; i < nleft; i++)
+        if (left_mate[i] < 0 && augmentFrom(i, next_edge))
+          augmented = true;
+      if (!augmented)
+        break;
+    }
+  return nleft - count(left_mate.begin(), left_mate.end(), -1);
+}
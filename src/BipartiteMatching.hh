@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BIPARTITEMATCHING_HH
+#define _BIPARTITEMATCHING_HH
+
+#include <vector>
+
+using namespace std;
+
+//! Maximum cardinality matching in a bipartite graph (Hopcroft-Karp algorithm)
+/*! The graph is given in compressed sparse row form: the neighbours (right
+  vertices) of left vertex i are adj[row_begin[i]] to adj[row_begin[i+1]-1].
+
+  Only a prefix of the neighbours of each left vertex is active (see
+  setActiveDegree()). When the rows are sorted by decreasing weight, this
+  allows computing matchings for a sequence of thresholds on the weights
+  without rebuilding the graph. The matching is kept from one call of
+  augment() to the next: the edges that became inactive are removed from it,
+  and the remaining ones are a warm start for the next search. */
+class BipartiteMatching
+{
+private:
+  const int nleft, nright;
+  const vector<int> row_begin, adj;
+  //! End (in adj) of the active neighbours of each left vertex
+  vector<int> active_end;
+  //! Mate of each left (resp. right) vertex, or -1
+  vector<int> left_mate, right_mate;
+  //! Layer of each left vertex in the breadth-first search of the current phase (-1 if not reached)
+  vector<int> layer;
+  //! Builds the layers of the alternating paths starting from the free left vertices; returns true if a free right vertex is reachable
+  bool buildLayers();
+  //! Looks for an augmenting path from a free left vertex along the layers, and applies it if found
+  bool augmentFrom(int root, vector<int> &next_edge);
+public:
+  BipartiteMatching(int nleft_arg, int nright_arg, vector<int> row_begin_arg, vector<int> adj_arg);
+  //! Makes active the first degree neighbours of left vertex i (all are active initially)
+  void setActiveDegree(int i, int degree);
+  //! Augments the matching until it is maximum over the active edges, and returns its cardinality
+  int augment();
+  //! Mate of each left vertex (-1 if unmatched)
+  const vector<int> &
+  getLeftMates() const
+  {
+    return left_mate;
+  };
+};
+
+#endif
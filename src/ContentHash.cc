@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "ContentHash.hh"
+
+// See FIPS 180-4 for the definition of SHA-256
+static const uint32_t round_constants[64] =
+  {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+  };
+
+static inline uint32_t
+rotateRight(uint32_t x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+ContentHash::ContentHash() :
+  state{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
+{
+}
+
+void
+ContentHash::compress()
+{
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++)
+    w[i] = (uint32_t) block[4*i] << 24 | (uint32_t) block[4*i+1] << 16
+      | (uint32_t) block[4*i+2] << 8 | (uint32_t) block[4*i+3];
+  for (int i = 16; i < 64; i++)
+    {
+      uint32_t s0 = rotateRight(w[i-15], 7) ^ rotateRight(w[i-15], 18) ^ (w[i-15] >> 3);
+      uint32_t s1 = rotateRight(w[i-2], 17) ^ rotateRight(w[i-2], 19) ^ (w[i-2] >> 10);
+      w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+    e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int i = 0; i < 64; i++)
+    {
+      uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25))
+        + ((e & f) ^ (~e & g)) + round_constants[i] + w[i];
+      uint32_t t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22))
+        + ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+void
+ContentHash::update(const void *data, size_t size)
+{
+  auto bytes = static_cast<const uint8_t *>(data);
+  length += size;
+  while (size > 0)
+    {
+      size_t n = min(size, sizeof(block) - block_size);
+      memcpy(block + block_size, bytes, n);
+      block_size += n;
+      bytes += n;
+      size -= n;
+      if (block_size == sizeof(block))
+        {
+          compress();
+          block_size = 0;
+        }
+    }
+}
+
+void
+ContentHash::update(const string &data)
+{
+  update(data.data(), data.size());
+}
+
+void
+ContentHash::update(uint64_t value)
+{
+  uint8_t bytes[8];
+  for (int i = 0; i < 8; i++)
+    bytes[i] = value >> (8*i);
+  update(bytes, sizeof(bytes));
+}
+
+string
+ContentHash::hexDigest()
+{
+  // Padding: a one bit, zeros, and the length in bits on 64 bits (big endian)
+  uint64_t bit_length = length * 8;
+  uint8_t padding[72] = { 0x80 };
+  size_t padding_size = (block_size < 56 ? 56 : 120) - block_size;
+  for (int i = 0; i < 8; i++)
+    padding[padding_size + i] = bit_length >> (56 - 8*i);
+  update(padding, padding_size + 8);
+
+  const char digits[] = "0123456789abcdef";
+  string digest;
+  for (auto word : state)
+    for (int shift = 28; shift >= 0; shift -= 4)
+      digest += digits[(word >> shift) & 0xf];
+  return digest;
+}
+
+OutputManifest::OutputManifest(string filename_arg) : filename{move(filename_arg)}
+{
+  ifstream input(filename, ios::in | ios::binary);
+  string entry, digest;
+  while (input >> entry >> digest)
+    old_digests[entry] = digest;
+}
+
+bool
+OutputManifest::update(const string &entry, const string &digest)
+{
+  digests[entry] = digest;
+  auto it = old_digests.find(entry);
+  return it == old_digests.end() || it->second != digest;
+}
+
+void
+OutputManifest::save() const
+{
+  ofstream output(filename, ios::out | ios::binary);
+  if (!output.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  for (const auto &it : digests)
+    output << it.first << " " << it.second << endl;
+  output.close();
+}
+
+DigestCache::DigestCache(string directory_arg) : directory{move(directory_arg)}
+{
+}
+
+bool
+DigestCache::load(const string &digest, vector<vector<int>> &records) const
+{
+  ifstream input(directory + "/" + digest, ios::in | ios::binary);
+  if (!input.is_open())
+    return false;
+  records.clear();
+  string line;
+  while (getline(input, line))
+    {
+      // Each line holds the size of a record, followed by its elements
+      istringstream fields(line);
+      size_t size;
+      if (!(fields >> size))
+        return false;
+      // Each element takes at least two characters, which bounds the allocation
+      if (size > line.size() / 2)
+        return false;
+      vector<int> record(size);
+      for (auto &element : record)
+        if (!(fields >> element))
+          return false;
+      records.push_back(move(record));
+    }
+  return !input.bad();
+}
+
+void
+DigestCache::reportWriteFailure(const string &message) const
+{
+  if (write_failure_reported.exchange(true))
+    return;
+  // Written at once, since other threads may be writing to cerr
+  ostringstream warning;
+  warning << "WARNING: " << message << "; continuing without storing results in the cache" << endl;
+  cerr << warning.str();
+}
+
+void
+DigestCache::store(const string &digest, const vector<vector<int>> &records) const
+{
+  boost::filesystem::path tmp;
+  try
+    {
+      boost::filesystem::create_directories(directory);
+      tmp = boost::filesystem::path(directory) / (digest + "." + boost::filesystem::unique_path().string());
+    }
+  catch (const boost::filesystem::filesystem_error &e)
+    {
+      reportWriteFailure("can't create directory " + directory + ": " + e.what());
+      return;
+    }
+  ofstream output(tmp.string(), ios::out | ios::binary);
+  if (!output.is_open())
+    {
+      reportWriteFailure("can't open file " + tmp.string() + " for writing");
+      return;
+    }
+  for (const auto &record : records)
+    {
+      output << record.size();
+      for (int element : record)
+        output << " " << element;
+      output << endl;
+    }
+  output.close();
+  boost::system::error_code ec;
+  if (output.fail())
+    {
+      reportWriteFailure("can't write file " + tmp.string());
+      boost::filesystem::remove(tmp, ec);
+      return;
+    }
+  boost::filesystem::rename(tmp, boost::filesystem::path(directory) / digest, ec);
+  if (ec)
+    {
+      reportWriteFailure("can't rename " + tmp.string() + " in " + directory + ": " + ec.message());
+      boost::filesystem::remove(tmp, ec);
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CONTENTHASH_HH
+#define _CONTENTHASH_HH
+
+#include <cstdint>
+#include <string>
+#include <map>
+#include <vector>
+#include <atomic>
+
+using namespace std;
+
+//! Computes the SHA-256 digest of a stream of bytes
+/*! Used wherever generated contents must be identified reliably, e.g. as the
+  key of the compilation cache. Data is fed with update(), in as many pieces
+  as needed, and the digest is obtained with hexDigest(). */
+class ContentHash
+{
+private:
+  uint32_t state[8];
+  uint8_t block[64];
+  //! Number of bytes in block
+  size_t block_size{0};
+  //! Total number of bytes fed so far
+  uint64_t length{0};
+  //! Applies the compression function to block
+  void compress();
+public:
+  ContentHash();
+  void update(const void *data, size_t size);
+  void update(const string &data);
+  //! Feeds an integer, in a representation that does not depend on the machine
+  void update(uint64_t value);
+  //! Returns the digest, as 64 hexadecimal digits
+  /*! No more data can be fed afterwards */
+  string hexDigest();
+};
+
+//! Digests of the outputs generated from a .mod file, as stored by the previous run in a manifest file
+/*! Allows rewriting only the outputs that changed since the previous run.
+  Entries are named after an output (e.g. "dynamic") or a part of it (e.g.
+  "dynamic/second_derivatives"); the file has one "<entry> <digest>" line per
+  entry. */
+class OutputManifest
+{
+private:
+  const string filename;
+  //! Digests read from the manifest file
+  map<string, string> old_digests;
+  //! Digests given to update()
+  map<string, string> digests;
+public:
+  //! Reads the manifest file, if it exists
+  explicit OutputManifest(string filename_arg);
+  //! Records the digest of an entry, and returns true if it differs from that of the previous run (or if the entry is new)
+  bool update(const string &entry, const string &digest);
+  //! Writes the manifest file
+  /*! Only the entries given to update() are written */
+  void save() const;
+};
+
+//! Directory of results shared between runs of the preprocessor, keyed by the digests of their inputs
+/*! Each entry is a file named after its digest, holding a list of records
+  (vectors of integers). Entries are written under a temporary name and then
+  renamed, so that concurrent runs never see them half written; an entry that
+  cannot be read is treated as missing. The cache is only an optimization:
+  the callers must validate the records they load, and a failure to write an
+  entry is only reported with a warning. load() and store() may be called
+  from several threads. */
+class DigestCache
+{
+private:
+  const string directory;
+  //! Whether a failure to write an entry has already been reported
+  mutable atomic<bool> write_failure_reported{false};
+  //! Reports a failure to write an entry (only the first one)
+  void reportWriteFailure(const string &message) const;
+public:
+  explicit DigestCache(string directory_arg);
+  //! Reads an entry, and returns false if it does not exist or is malformed
+  bool load(const string &digest, vector<vector<int>> &records) const;
+  //! Writes an entry (creating the directory if needed)
+  void store(const string &digest, const vector<vector<int>> &records) const;
+};
+
+#endif
@@ -19,6 +19,7 @@
 
 #include <cstdlib>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <regex>
 
@@ -46,7 +47,43 @@ DataTree::DataTree(SymbolTable &symbol_table_arg,
   Pi = AddNonNegativeConstant("3.141592653589793");
 }
 
-DataTree::~DataTree() = default;
+DataTree::~DataTree()
+{
+  // The memory itself is released afterwards, in one go, by node_arena
+  for (auto it = node_list.rbegin(); it != node_list.rend(); ++it)
+    (*it)->~ExprNode();
+}
+
+void *
+DataTree::NodeArena::allocate(size_t size, size_t alignment)
+{
+  size_t padding = reinterpret_cast<uintptr_t>(free_begin) % alignment;
+  if (padding > 0)
+    padding = alignment - padding;
+
+  if (padding + size > free_size)
+    {
+      // Oversized requests get a block of their own, so that the current block is not wasted
+      if (size + alignment > block_size / 4)
+        {
+          blocks.emplace_back(new char[size + alignment]);
+          void *p = blocks.back().get();
+          size_t space = size + alignment;
+          return align(alignment, size, p, space);
+        }
+      blocks.emplace_back(new char[block_size]);
+      free_begin = blocks.back().get();
+      free_size = block_size;
+      padding = reinterpret_cast<uintptr_t>(free_begin) % alignment;
+      if (padding > 0)
+        padding = alignment - padding;
+    }
+
+  void *p = free_begin + padding;
+  free_begin += padding + size;
+  free_size -= padding + size;
+  return p;
+}
 
 expr_t
 DataTree::AddNonNegativeConstant(const string &value)
@@ -57,9 +94,7 @@ DataTree::AddNonNegativeConstant(const string &value)
   if (it != num_const_node_map.end())
     return it->second;
 
-  auto sp = make_unique<NumConstNode>(*this, node_list.size(), id);
-  auto p = sp.get();
-  node_list.push_back(move(sp));
+  auto p = newNode<NumConstNode>(id);
   num_const_node_map[id] = p;
   return p;
 }
@@ -71,9 +106,7 @@ DataTree::AddVariableInternal(int symb_id, int lag)
   if (it != variable_node_map.end())
     return it->second;
 
-  auto sp = make_unique<VariableNode>(*this, node_list.size(), symb_id, lag);
-  auto p = sp.get();
-  node_list.push_back(move(sp));
+  auto p = newNode<VariableNode>(symb_id, lag);
   variable_node_map[{ symb_id, lag }] = p;
   return p;
 }
@@ -514,9 +547,7 @@ DataTree::AddVarExpectation(const string &model_name)
   if (it != var_expectation_node_map.end())
     return it->second;
 
-  auto sp = make_unique<VarExpectationNode>(*this, node_list.size(), model_name);
-  auto p = sp.get();
-  node_list.push_back(move(sp));
+  auto p = newNode<VarExpectationNode>(model_name);
   var_expectation_node_map[model_name] = p;
   return p;
 }
@@ -528,9 +559,7 @@ DataTree::AddPacExpectation(const string &model_name)
   if (it != pac_expectation_node_map.end())
     return it->second;
 
-  auto sp = make_unique<PacExpectationNode>(*this, node_list.size(), model_name);
-  auto p = sp.get();
-  node_list.push_back(move(sp));
+  auto p = newNode<PacExpectationNode>(model_name);
   pac_expectation_node_map[model_name] = p;
   return p;
 }
@@ -560,14 +589,13 @@ DataTree::AddExternalFunction(int symb_id, const vector<expr_t> &arguments)
 {
   assert(symbol_table.getType(symb_id) == SymbolType::externalFunction);
 
-  auto it = external_function_node_map.find({ arguments, symb_id });
-  if (it != external_function_node_map.end())
-    return it->second;
+  external_function_node_map_t::key_type key{ arguments, symb_id };
+  size_t hash = external_function_node_map.hash(key);
+  if (auto p = external_function_node_map.find(key, hash))
+    return p;
 
-  auto sp = make_unique<ExternalFunctionNode>(*this, node_list.size(), symb_id, arguments);
-  auto p = sp.get();
-  node_list.push_back(move(sp));
-  external_function_node_map[{ arguments, symb_id }] = p;
+  auto p = newNode<ExternalFunctionNode>(symb_id, arguments);
+  external_function_node_map.insert(move(key), p, hash);
   return p;
 }
 
@@ -576,15 +604,13 @@ DataTree::AddFirstDerivExternalFunction(int top_level_symb_id, const vector<expr
 {
   assert(symbol_table.getType(top_level_symb_id) == SymbolType::externalFunction);
 
-  auto it
-    = first_deriv_external_function_node_map.find({ arguments, input_index, top_level_symb_id });
-  if (it != first_deriv_external_function_node_map.end())
-    return it->second;
+  first_deriv_external_function_node_map_t::key_type key{ arguments, input_index, top_level_symb_id };
+  size_t hash = first_deriv_external_function_node_map.hash(key);
+  if (auto p = first_deriv_external_function_node_map.find(key, hash))
+    return p;
 
-  auto sp = make_unique<FirstDerivExternalFunctionNode>(*this, node_list.size(), top_level_symb_id, arguments, input_index);
-  auto p = sp.get();
-  node_list.push_back(move(sp));
-  first_deriv_external_function_node_map[{ arguments, input_index, top_level_symb_id }] = p;
+  auto p = newNode<FirstDerivExternalFunctionNode>(top_level_symb_id, arguments, input_index);
+  first_deriv_external_function_node_map.insert(move(key), p, hash);
   return p;
 }
 
@@ -593,16 +619,13 @@ DataTree::AddSecondDerivExternalFunction(int top_level_symb_id, const vector<exp
 {
   assert(symbol_table.getType(top_level_symb_id) == SymbolType::externalFunction);
 
-  auto it
-    = second_deriv_external_function_node_map.find({ arguments, input_index1, input_index2,
-          top_level_symb_id });
-  if (it != second_deriv_external_function_node_map.end())
-    return it->second;
+  second_deriv_external_function_node_map_t::key_type key{ arguments, input_index1, input_index2, top_level_symb_id };
+  size_t hash = second_deriv_external_function_node_map.hash(key);
+  if (auto p = second_deriv_external_function_node_map.find(key, hash))
+    return p;
 
-  auto sp = make_unique<SecondDerivExternalFunctionNode>(*this, node_list.size(), top_level_symb_id, arguments, input_index1, input_index2);
-  auto p = sp.get();
-  node_list.push_back(move(sp));
-  second_deriv_external_function_node_map[{ arguments, input_index1, input_index2, top_level_symb_id }] = p;
+  auto p = newNode<SecondDerivExternalFunctionNode>(top_level_symb_id, arguments, input_index1, input_index2);
+  second_deriv_external_function_node_map.insert(move(key), p, hash);
   return p;
 }
 
@@ -29,12 +29,16 @@ using namespace std;
 #include <iomanip>
 #include <cmath>
 #include <utility>
+#include <memory>
+
+#include <boost/functional/hash.hpp>
 
 #include "SymbolTable.hh"
 #include "NumericalConstants.hh"
 #include "ExternalFunctionsTable.hh"
 #include "ExprNode.hh"
 #include "SubModel.hh"
+#include "NodeTable.hh"
 
 class DataTree
 {
@@ -45,8 +49,75 @@ public:
   NumericalConstants &num_constants;
   //! A reference to the external functions table
   ExternalFunctionsTable &external_functions_table;
+  //! Costs of operators, used for selecting temporary terms
+  OperatorCosts operator_costs;
 
 protected:
+  //! Hash function for the keys of the node-sharing tables
+  /*! Since identical subexpressions are always shared, a node is uniquely
+      identified by its index: hashing the indices of the children is
+      therefore a structural hash of the node being looked up. Indices are
+      used rather than addresses so that the tables behave identically from
+      one run to another. */
+  struct NodeKeyHash
+  {
+    static void
+    combine(size_t &seed, expr_t e)
+    {
+      boost::hash_combine(seed, e->idx);
+    }
+    static void
+    combine(size_t &seed, const vector<expr_t> &v)
+    {
+      for (auto e : v)
+        combine(seed, e);
+    }
+    static void
+    combine(size_t &seed, UnaryOpcode op_code)
+    {
+      boost::hash_combine(seed, static_cast<int>(op_code));
+    }
+    static void
+    combine(size_t &seed, BinaryOpcode op_code)
+    {
+      boost::hash_combine(seed, static_cast<int>(op_code));
+    }
+    static void
+    combine(size_t &seed, TrinaryOpcode op_code)
+    {
+      boost::hash_combine(seed, static_cast<int>(op_code));
+    }
+    template<typename T>
+    static void
+    combine(size_t &seed, const T &v)
+    {
+      boost::hash_combine(seed, v);
+    }
+    template<typename Tuple, size_t... I>
+    static size_t
+    hashTuple(const Tuple &key, index_sequence<I...>)
+    {
+      size_t seed = 0;
+      (void) initializer_list<int>{ (combine(seed, get<I>(key)), 0)... };
+      return seed;
+    }
+    template<typename... Args>
+    size_t
+    operator()(const tuple<Args...> &key) const
+    {
+      return hashTuple(key, index_sequence_for<Args...>{});
+    }
+    template<typename T1, typename T2>
+    size_t
+    operator()(const pair<T1, T2> &key) const
+    {
+      size_t seed = 0;
+      combine(seed, key.first);
+      combine(seed, key.second);
+      return seed;
+    }
+  };
+
   //! num_constant_id -> NumConstNode
   using num_const_node_map_t = map<int, NumConstNode *>;
   num_const_node_map_t num_const_node_map;
@@ -56,19 +127,19 @@ protected:
   variable_node_map_t variable_node_map;
 
   //! (arg, op_code, arg_exp_info_set, param1_symb_id, param2_symb_id, adl_param_name, adl_lags) -> UnaryOpNode
-  using unary_op_node_map_t = map<tuple<expr_t, UnaryOpcode, int, int, int, string, vector<int>>, UnaryOpNode *>;
+  using unary_op_node_map_t = NodeTable<tuple<expr_t, UnaryOpcode, int, int, int, string, vector<int>>, UnaryOpNode, NodeKeyHash>;
   unary_op_node_map_t unary_op_node_map;
 
   //! ( arg1, arg2, opCode, order of Power Derivative) -> BinaryOpNode
-  using binary_op_node_map_t = map<tuple<expr_t, expr_t, BinaryOpcode, int>, BinaryOpNode *>;
+  using binary_op_node_map_t = NodeTable<tuple<expr_t, expr_t, BinaryOpcode, int>, BinaryOpNode, NodeKeyHash>;
   binary_op_node_map_t binary_op_node_map;
 
   //! ( arg1, arg2, arg3, opCode) -> TrinaryOpNode
-  using trinary_op_node_map_t = map<tuple<expr_t, expr_t, expr_t, TrinaryOpcode>, TrinaryOpNode *>;
+  using trinary_op_node_map_t = NodeTable<tuple<expr_t, expr_t, expr_t, TrinaryOpcode>, TrinaryOpNode, NodeKeyHash>;
   trinary_op_node_map_t trinary_op_node_map;
 
   // (arguments, symb_id) -> ExternalFunctionNode
-  using external_function_node_map_t = map<pair<vector<expr_t>, int>, ExternalFunctionNode *>;
+  using external_function_node_map_t = NodeTable<pair<vector<expr_t>, int>, ExternalFunctionNode, NodeKeyHash>;
   external_function_node_map_t external_function_node_map;
 
   // (model_name, symb_id, forecast_horizon) -> VarExpectationNode
@@ -80,11 +151,11 @@ protected:
   pac_expectation_node_map_t pac_expectation_node_map;
 
   // (arguments, deriv_idx, symb_id) -> FirstDerivExternalFunctionNode
-  using first_deriv_external_function_node_map_t = map<tuple<vector<expr_t>, int, int>, FirstDerivExternalFunctionNode *>;
+  using first_deriv_external_function_node_map_t = NodeTable<tuple<vector<expr_t>, int, int>, FirstDerivExternalFunctionNode, NodeKeyHash>;
   first_deriv_external_function_node_map_t first_deriv_external_function_node_map;
 
   // (arguments, deriv_idx1, deriv_idx2, symb_id) -> SecondDerivExternalFunctionNode
-  using second_deriv_external_function_node_map_t = map<tuple<vector<expr_t>, int, int, int>, SecondDerivExternalFunctionNode *>;
+  using second_deriv_external_function_node_map_t = NodeTable<tuple<vector<expr_t>, int, int, int>, SecondDerivExternalFunctionNode, NodeKeyHash>;
   second_deriv_external_function_node_map_t second_deriv_external_function_node_map;
 
   //! Stores local variables value (maps symbol ID to corresponding node)
@@ -108,8 +179,39 @@ protected:
 private:
   const static int constants_precision{16};
 
-  //! The list of nodes
-  vector<unique_ptr<ExprNode>> node_list;
+  //! Bump allocator in which the nodes are stored
+  /*! Memory is only released when the allocator is destroyed, i.e. at the
+    same time as the DataTree. This avoids a separate heap allocation for
+    each node, which matters for large derivative trees. */
+  class NodeArena
+  {
+  private:
+    //! Size of the memory blocks requested from the system
+    const static size_t block_size{1 << 16};
+    vector<unique_ptr<char[]>> blocks;
+    //! Free space at the end of the current block
+    char *free_begin{nullptr};
+    size_t free_size{0};
+  public:
+    //! Returns a block of memory with the given size and alignment
+    void *allocate(size_t size, size_t alignment);
+  };
+  NodeArena node_arena;
+
+  //! The list of nodes, in creation order (the index of a node is its position in this list)
+  /*! The memory of the nodes is owned by node_arena, but their destructors
+    are called by the destructor of DataTree */
+  vector<ExprNode *> node_list;
+
+  //! Creates a node in the arena, and adds it to node_list
+  template<typename T, typename... Args>
+  T *
+  newNode(Args &&... args)
+  {
+    auto p = new (node_arena.allocate(sizeof(T), alignof(T))) T(*this, node_list.size(), forward<Args>(args)...);
+    node_list.push_back(p);
+    return p;
+  }
 
   inline expr_t AddUnaryOp(UnaryOpcode op_code, expr_t arg, int arg_exp_info_set = 0, int param1_symb_id = 0, int param2_symb_id = 0, const string &adl_param_name = "", const vector<int> &adl_lags = vector<int>());
   inline expr_t AddBinaryOp(expr_t arg1, BinaryOpcode op_code, expr_t arg2, int powerDerivOrder = 0);
@@ -123,6 +225,10 @@ public:
   virtual
   ~DataTree();
 
+  //! Nodes point back to their DataTree, so the latter cannot be copied
+  DataTree(const DataTree &) = delete;
+  DataTree &operator=(const DataTree &) = delete;
+
   //! Some predefined constants
   expr_t Zero, One, Two, MinusOne, NaN, Infinity, MinusInfinity, Pi;
 
@@ -352,9 +458,10 @@ inline expr_t
 DataTree::AddUnaryOp(UnaryOpcode op_code, expr_t arg, int arg_exp_info_set, int param1_symb_id, int param2_symb_id, const string &adl_param_name, const vector<int> &adl_lags)
 {
   // If the node already exists in tree, share it
-  auto it = unary_op_node_map.find({ arg, op_code, arg_exp_info_set, param1_symb_id, param2_symb_id, adl_param_name, adl_lags });
-  if (it != unary_op_node_map.end())
-    return it->second;
+  unary_op_node_map_t::key_type key{ arg, op_code, arg_exp_info_set, param1_symb_id, param2_symb_id, adl_param_name, adl_lags };
+  size_t hash = unary_op_node_map.hash(key);
+  if (auto p = unary_op_node_map.find(key, hash))
+    return p;
 
   // Try to reduce to a constant
   // Case where arg is a constant and op_code == UnaryOpcode::uminus (i.e. we're adding a negative constant) is skipped
@@ -372,19 +479,18 @@ DataTree::AddUnaryOp(UnaryOpcode op_code, expr_t arg, int arg_exp_info_set, int
         }
     }
 
-  auto sp = make_unique<UnaryOpNode>(*this, node_list.size(), op_code, arg, arg_exp_info_set, param1_symb_id, param2_symb_id, adl_param_name, adl_lags);
-  auto p = sp.get();
-  node_list.push_back(move(sp));
-  unary_op_node_map[{ arg, op_code, arg_exp_info_set, param1_symb_id, param2_symb_id, adl_param_name, adl_lags }] = p;
+  auto p = newNode<UnaryOpNode>(op_code, arg, arg_exp_info_set, param1_symb_id, param2_symb_id, adl_param_name, adl_lags);
+  unary_op_node_map.insert(move(key), p, hash);
   return p;
 }
 
 inline expr_t
 DataTree::AddBinaryOp(expr_t arg1, BinaryOpcode op_code, expr_t arg2, int powerDerivOrder)
 {
-  auto it = binary_op_node_map.find({ arg1, arg2, op_code, powerDerivOrder });
-  if (it != binary_op_node_map.end())
-    return it->second;
+  binary_op_node_map_t::key_type key{ arg1, arg2, op_code, powerDerivOrder };
+  size_t hash = binary_op_node_map.hash(key);
+  if (auto p = binary_op_node_map.find(key, hash))
+    return p;
 
   // Try to reduce to a constant
   try
@@ -398,19 +504,18 @@ DataTree::AddBinaryOp(expr_t arg1, BinaryOpcode op_code, expr_t arg2, int powerD
     {
     }
 
-  auto sp = make_unique<BinaryOpNode>(*this, node_list.size(), arg1, op_code, arg2, powerDerivOrder);
-  auto p = sp.get();
-  node_list.push_back(move(sp));
-  binary_op_node_map[{ arg1, arg2, op_code, powerDerivOrder }] = p;
+  auto p = newNode<BinaryOpNode>(arg1, op_code, arg2, powerDerivOrder);
+  binary_op_node_map.insert(move(key), p, hash);
   return p;
 }
 
 inline expr_t
 DataTree::AddTrinaryOp(expr_t arg1, TrinaryOpcode op_code, expr_t arg2, expr_t arg3)
 {
-  auto it = trinary_op_node_map.find({ arg1, arg2, arg3, op_code });
-  if (it != trinary_op_node_map.end())
-    return it->second;
+  trinary_op_node_map_t::key_type key{ arg1, arg2, arg3, op_code };
+  size_t hash = trinary_op_node_map.hash(key);
+  if (auto p = trinary_op_node_map.find(key, hash))
+    return p;
 
   // Try to reduce to a constant
   try
@@ -425,10 +530,8 @@ DataTree::AddTrinaryOp(expr_t arg1, TrinaryOpcode op_code, expr_t arg2, expr_t a
     {
     }
 
-  auto sp = make_unique<TrinaryOpNode>(*this, node_list.size(), arg1, op_code, arg2, arg3);
-  auto p = sp.get();
-  node_list.push_back(move(sp));
-  trinary_op_node_map[{ arg1, arg2, arg3, op_code }] = p;
+  auto p = newNode<TrinaryOpNode>(arg1, op_code, arg2, arg3);
+  trinary_op_node_map.insert(move(key), p, hash);
   return p;
 }
 
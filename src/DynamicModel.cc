@@ -59,7 +59,7 @@ DynamicModel::AddVariable(int symb_id, int lag)
 }
 
 void
-DynamicModel::compileDerivative(ofstream &code_file, unsigned int &instruction_number, int eq, int symb_id, int lag, const map_idx_t &map_idx) const
+DynamicModel::compileDerivative(ostream &code_file, unsigned int &instruction_number, int eq, int symb_id, int lag, const map_idx_t &map_idx) const
 {
   auto it = first_derivatives.find({ eq, getDerivID(symbol_table.getID(SymbolType::endogenous, symb_id), lag) });
   if (it != first_derivatives.end())
@@ -72,7 +72,7 @@ DynamicModel::compileDerivative(ofstream &code_file, unsigned int &instruction_n
 }
 
 void
-DynamicModel::compileChainRuleDerivative(ofstream &code_file, unsigned int &instruction_number, int eqr, int varr, int lag, const map_idx_t &map_idx) const
+DynamicModel::compileChainRuleDerivative(ostream &code_file, unsigned int &instruction_number, int eqr, int varr, int lag, const map_idx_t &map_idx) const
 {
   auto it = first_chain_rule_derivatives.find({ eqr, { varr, lag } });
   if (it != first_chain_rule_derivatives.end())
@@ -164,38 +164,36 @@ DynamicModel::computeTemporaryTermsOrdered()
           for (derivative_t::const_iterator it = derivative_other_endo[block].begin(); it != derivative_other_endo[block].end(); it++)
             it->second->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms, block_size-1);
         }
-      for (unsigned int block = 0; block < nb_blocks; block++)
-        {
-          // Collect the temporary terms reordered
-          unsigned int block_size = getBlockSize(block);
-          unsigned int block_nb_mfs = getBlockMfs(block);
-          unsigned int block_nb_recursives = block_size - block_nb_mfs;
-          set<int> temporary_terms_in_use;
-          for (unsigned int i = 0; i < block_size; i++)
-            {
-              if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
-                getBlockEquationRenormalizedExpr(block, i)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-              else
-                {
-                  eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-                  eq_node->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-                }
-            }
-          for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
-            {
-              expr_t id = it->second.second;
-              id->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-            }
-          for (derivative_t::const_iterator it = derivative_endo[block].begin(); it != derivative_endo[block].end(); it++)
-            it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-          for (derivative_t::const_iterator it = derivative_other_endo[block].begin(); it != derivative_other_endo[block].end(); it++)
-            it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-          for (derivative_t::const_iterator it = derivative_exo[block].begin(); it != derivative_exo[block].end(); it++)
-            it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-          for (derivative_t::const_iterator it = derivative_exo_det[block].begin(); it != derivative_exo_det[block].end(); it++)
-            it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-          v_temporary_terms_inuse[block] = temporary_terms_in_use;
-        }
+      // The temporary terms used by each block only depend on the block
+      forEachBlock(nb_blocks, [&](unsigned int block, int thread)
+                   {
+                     // Collect the temporary terms reordered
+                     unsigned int block_size = getBlockSize(block);
+                     unsigned int block_nb_mfs = getBlockMfs(block);
+                     unsigned int block_nb_recursives = block_size - block_nb_mfs;
+                     set<int> temporary_terms_in_use;
+                     for (unsigned int i = 0; i < block_size; i++)
+                       {
+                         if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
+                           getBlockEquationRenormalizedExpr(block, i)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                         else
+                           getBlockEquationExpr(block, i)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                       }
+                     for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
+                       {
+                         expr_t id = it->second.second;
+                         id->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                       }
+                     for (derivative_t::const_iterator it = derivative_endo[block].begin(); it != derivative_endo[block].end(); it++)
+                       it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                     for (derivative_t::const_iterator it = derivative_other_endo[block].begin(); it != derivative_other_endo[block].end(); it++)
+                       it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                     for (derivative_t::const_iterator it = derivative_exo[block].begin(); it != derivative_exo[block].end(); it++)
+                       it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                     for (derivative_t::const_iterator it = derivative_exo_det[block].begin(); it != derivative_exo_det[block].end(); it++)
+                       it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                     v_temporary_terms_inuse[block] = temporary_terms_in_use;
+                   });
       computeTemporaryTermsMapping();
     }
 }
@@ -1040,6 +1038,9 @@ DynamicModel::writeModelEquationsCode(const string &basename, const map_idx_t &m
   FEND_ fend;
   fend.write(code_file, instruction_number);
   code_file.close();
+
+  if (flat_bytecode)
+    writeFlatBytecode(basename, "dynamic", true, max_lag, max_lead);
 }
 
 void
@@ -1056,17 +1057,8 @@ DynamicModel::writeModelEquationsCode_Block(const string &basename, const map_id
     Uff_l *Ufl, *Ufl_First;
   };
 
-  int i, v;
-  string tmp_s;
-  ostringstream tmp_output;
   ofstream code_file;
   unsigned int instruction_number = 0;
-  expr_t lhs = nullptr, rhs = nullptr;
-  BinaryOpNode *eq_node;
-  Uff Uf[symbol_table.endo_nbr()];
-  map<expr_t, int> reference_count;
-  deriv_node_temp_terms_t tef_terms;
-  vector<int> feedback_variables;
   bool file_open = false;
 
   boost::filesystem::create_directories(basename + "/model/bytecode");
@@ -1083,16 +1075,34 @@ DynamicModel::writeModelEquationsCode_Block(const string &basename, const map_id
   FDIMT_ fdimt(temporary_terms.size());
   fdimt.write(code_file, instruction_number);
 
+  // Write_Inf_To_Bin_File_Block() appends to a single file, so it is called for all the blocks beforehand
+  vector<int> blocks_u_count_int(getNbBlocks(), 0);
   for (unsigned int block = 0; block < getNbBlocks(); block++)
     {
-      feedback_variables.clear();
-      if (block > 0)
+      BlockSimulationType simulation_type = getBlockSimulationType(block);
+      if (simulation_type == SOLVE_TWO_BOUNDARIES_SIMPLE || simulation_type == SOLVE_TWO_BOUNDARIES_COMPLETE
+          || simulation_type == SOLVE_BACKWARD_COMPLETE || simulation_type == SOLVE_FORWARD_COMPLETE)
         {
-          FENDBLOCK_ fendblock;
-          fendblock.write(code_file, instruction_number);
+          Write_Inf_To_Bin_File_Block(basename, block, blocks_u_count_int[block], file_open,
+                                      simulation_type == SOLVE_TWO_BOUNDARIES_COMPLETE || simulation_type == SOLVE_TWO_BOUNDARIES_SIMPLE);
+          file_open = true;
         }
+    }
+
+  /* The code of each block is written in its own buffer (the jumps being
+     relative to the current instruction), and the buffers are concatenated
+     in the order of the blocks */
+  vector<string> blocks_code(getNbBlocks());
+  auto writeBlock = [&](unsigned int block, Uff *Uf, deriv_node_temp_terms_t &tef_terms)
+    {
+      ostringstream code_file;
+      unsigned int instruction_number = 0;
+      int i, v;
+      expr_t lhs = nullptr, rhs = nullptr;
+      BinaryOpNode *eq_node;
+      vector<int> feedback_variables;
       int count_u;
-      int u_count_int = 0;
+      int u_count_int = blocks_u_count_int[block];
       BlockSimulationType simulation_type = getBlockSimulationType(block);
       unsigned int block_size = getBlockSize(block);
       unsigned int block_mfs = getBlockMfs(block);
@@ -1100,13 +1110,6 @@ DynamicModel::writeModelEquationsCode_Block(const string &basename, const map_id
       int block_max_lag = max_leadlag_block[block].first;
       int block_max_lead = max_leadlag_block[block].second;
 
-      if (simulation_type == SOLVE_TWO_BOUNDARIES_SIMPLE || simulation_type == SOLVE_TWO_BOUNDARIES_COMPLETE
-          || simulation_type == SOLVE_BACKWARD_COMPLETE || simulation_type == SOLVE_FORWARD_COMPLETE)
-        {
-          Write_Inf_To_Bin_File_Block(basename, block, u_count_int, file_open,
-                                      simulation_type == SOLVE_TWO_BOUNDARIES_COMPLETE || simulation_type == SOLVE_TWO_BOUNDARIES_SIMPLE);
-          file_open = true;
-        }
       map<pair<int, pair<int, int>>, expr_t> tmp_block_endo_derivative;
       for (auto it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
         tmp_block_endo_derivative[{ it->second.first, { it->first.second, it->first.first } }] = it->second.second;
@@ -1505,12 +1508,46 @@ DynamicModel::writeModelEquationsCode_Block(const string &basename, const map_id
       FJMP_ fjmp1(instruction_number - prev_instruction_number);
       fjmp1.write(code_file, instruction_number);
       code_file.seekp(pos1);
+      blocks_code[block] = code_file.str();
+    };
+
+  /* External functions computed in a block are not computed again in the
+     following ones, so in their presence the blocks are written serially;
+     otherwise they are written using nthreads threads */
+  if (external_functions_table.get_total_number_of_unique_model_block_external_functions() > 0)
+    {
+      vector<Uff> Uf(symbol_table.endo_nbr());
+      deriv_node_temp_terms_t tef_terms;
+      for (unsigned int block = 0; block < getNbBlocks(); block++)
+        writeBlock(block, Uf.data(), tef_terms);
+    }
+  else
+    {
+      vector<vector<Uff>> Uf(max(nthreads, 1), vector<Uff>(symbol_table.endo_nbr()));
+      forEachBlock(getNbBlocks(), [&](unsigned int block, int thread)
+                   {
+                     deriv_node_temp_terms_t tef_terms;
+                     writeBlock(block, Uf[thread].data(), tef_terms);
+                   });
+    }
+
+  for (unsigned int block = 0; block < getNbBlocks(); block++)
+    {
+      if (block > 0)
+        {
+          FENDBLOCK_ fendblock;
+          fendblock.write(code_file, instruction_number);
+        }
+      code_file.write(blocks_code[block].data(), blocks_code[block].size());
     }
   FENDBLOCK_ fendblock;
   fendblock.write(code_file, instruction_number);
   FEND_ fend;
   fend.write(code_file, instruction_number);
   code_file.close();
+
+  if (flat_bytecode)
+    writeFlatBytecode(basename, "dynamic", true, max_lag, max_lead);
 }
 
 void
@@ -1526,13 +1563,25 @@ DynamicModel::writeDynamicJuliaFile(const string &basename) const
 }
 
 void
-DynamicModel::writeDynamicCFile(const string &basename, const int order) const
+DynamicModel::writeDynamicCFile(const string &basename, const int order, int split_c_files, const string &library_prefix) const
 {
+  bool library = !library_prefix.empty();
   boost::filesystem::create_directories(basename + "/model/src");
   string filename = basename + "/model/src/dynamic.c";
   string filename_mex = basename + "/model/src/dynamic_mex.c";
   ofstream mDynamicModelFile, mDynamicMexFile;
 
+  if (split_c_files > 0 && external_functions_table.get_total_number_of_unique_model_block_external_functions())
+    {
+      cerr << "ERROR: the split_c_files option cannot be used with external functions in the model block" << endl;
+      exit(EXIT_FAILURE);
+    }
+  if (library && external_functions_table.get_total_number_of_unique_model_block_external_functions())
+    {
+      cerr << "ERROR: the C library output (language=c) cannot be used with external functions in the model block" << endl;
+      exit(EXIT_FAILURE);
+    }
+
   mDynamicModelFile.open(filename, ios::out | ios::binary);
   if (!mDynamicModelFile.is_open())
     {
@@ -1544,34 +1593,105 @@ DynamicModel::writeDynamicCFile(const string &basename, const int order) const
                     << " *" << endl
                     << " * Warning : this file is generated automatically by Dynare" << endl
                     << " *           from model file (.mod)" << endl
-                    << " */" << endl
+                    << " */" << endl;
+
+  ostringstream prologue;
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
-                    << "#ifdef _MSC_VER" << endl
-                    << "#define _USE_MATH_DEFINES" << endl
-                    << "#endif" << endl
+  prologue << "#ifdef _MSC_VER" << endl
+           << "#define _USE_MATH_DEFINES" << endl
+           << "#endif" << endl;
 #endif
-                    << "#include <math.h>" << endl;
+  prologue << "#include <math.h>" << endl
+           << "#include <string.h>" << endl
+           << "#include <stdlib.h>" << endl;
 
   if (external_functions_table.get_total_number_of_unique_model_block_external_functions())
     // External Matlab function, implies Dynamic function will call mex
-    mDynamicModelFile << "#include \"mex.h\"" << endl;
-  else
-    mDynamicModelFile << "#include <stdlib.h>" << endl;
+    prologue << "#include \"mex.h\"" << endl;
+
+  prologue << "#define max(a, b) (((a) > (b)) ? (a) : (b))" << endl
+           << "#define min(a, b) (((a) > (b)) ? (b) : (a))" << endl;
 
-  mDynamicModelFile << "#define max(a, b) (((a) > (b)) ? (a) : (b))" << endl
-                    << "#define min(a, b) (((a) > (b)) ? (b) : (a))" << endl;
+  if (library)
+    writeCLibraryRenames(prologue, library_prefix, "dynamic",
+                         { "Dynamic", "dynamic_max_lag", "dynamic_max_lead", "dynamic_lead_lag_incidence",
+                             "dynamic_resid_tt_batch", "dynamic_resid_batch", "dynamic_g1_tt_batch", "dynamic_g1_batch" });
 
   // Write function definition if BinaryOpcode::powerDeriv is used
-  writePowerDerivCHeader(mDynamicModelFile);
-  writeNormcdfCHeader(mDynamicModelFile);
+  writePowerDerivCHeader(prologue);
+  writeNormcdfCHeader(prologue);
+
+  if (split_c_files > 0)
+    {
+      // The prologue is shared with the other translation units
+      string filename_h = basename + "/model/src/dynamic.h";
+      ofstream mDynamicHeaderFile;
+      mDynamicHeaderFile.open(filename_h, ios::out | ios::binary);
+      if (!mDynamicHeaderFile.is_open())
+        {
+          cerr << "Error: Can't open file " << filename_h << " for writing" << endl;
+          exit(EXIT_FAILURE);
+        }
+      mDynamicHeaderFile << "/*" << endl
+                         << " * " << filename_h << " : Declarations shared by the translation units of the dynamic model" << endl
+                         << " *" << endl
+                         << " * Warning : this file is generated automatically by Dynare" << endl
+                         << " *           from model file (.mod)" << endl
+                         << " */" << endl
+                         << "#ifndef _DYNAMIC_H" << endl
+                         << "#define _DYNAMIC_H" << endl
+                         << prologue.str()
+                         << "#endif" << endl;
+      mDynamicHeaderFile.close();
+      mDynamicModelFile << "#include \"dynamic.h\"" << endl;
+    }
+  else
+    mDynamicModelFile << prologue.str();
+
+  // Checks that the definitions match the interface of the library
+  if (library)
+    mDynamicModelFile << "#include \"model.h\"" << endl;
 
   // Writing the function body
-  writeDynamicModel(mDynamicModelFile, true, false);
+  writeDynamicModel(basename, mDynamicModelFile, true, false, split_c_files);
+
+  if (library)
+    {
+      vector<pair<int, int>> g1_indices;
+      for (const auto &first_derivative : first_derivatives)
+        g1_indices.emplace_back(first_derivative.first.first, getDynJacobianCol(first_derivative.first.second));
+      writeCLibraryMetadata(mDynamicModelFile, "dynamic", dynJacobianColsNbr, g1_indices);
+
+      mDynamicModelFile << "const int dynamic_max_lag = " << max_endo_lag << ";" << endl
+                        << "const int dynamic_max_lead = " << max_endo_lead << ";" << endl
+                        << "const int dynamic_lead_lag_incidence[" << (max_endo_lag+max_endo_lead+1)*symbol_table.endo_nbr() << "] = {";
+      for (int lag = -max_endo_lag; lag <= max_endo_lead; lag++)
+        {
+          mDynamicModelFile << endl << " ";
+          for (int endoID = 0; endoID < symbol_table.endo_nbr(); endoID++)
+            try
+              {
+                int varID = getDerivID(symbol_table.getID(SymbolType::endogenous, endoID), lag);
+                mDynamicModelFile << " " << getDynJacobianCol(varID) << ",";
+              }
+            catch (UnknownDerivIDException &e)
+              {
+                mDynamicModelFile << " -1,";
+              }
+        }
+      mDynamicModelFile << endl << "};" << endl << endl;
+
+      writeDynamicCBatchKernels(mDynamicModelFile);
+    }
 
   writePowerDeriv(mDynamicModelFile);
   writeNormcdf(mDynamicModelFile);
   mDynamicModelFile.close();
 
+  // The library has no MEX gateway
+  if (library)
+    return;
+
   mDynamicMexFile.open(filename_mex, ios::out | ios::binary);
   if (!mDynamicMexFile.is_open())
     {
@@ -2164,7 +2284,7 @@ DynamicModel::writeDynamicModelHelper(const string &basename,
                                       const string &previous_tt_name,
                                       const ostringstream &init_s,
                                       const ostringstream &end_s,
-                                      const ostringstream &s, const ostringstream &s_tt) const
+                                      OutputSection &s, OutputSection &s_tt) const
 {
   string filename = packageDir(basename) + "/" + name_tt + ".m";
   ofstream output;
@@ -2200,7 +2320,7 @@ DynamicModel::writeDynamicModelHelper(const string &basename,
   if (!previous_tt_name.empty())
     output << "T = " << basename << "." << previous_tt_name << "(T, y, x, params, steady_state, it_);" << endl << endl;
 
-  output << s_tt.str() << endl
+  output << s_tt << endl
          << "end" << endl;
   output.close();
 
@@ -2239,7 +2359,7 @@ DynamicModel::writeDynamicModelHelper(const string &basename,
            << "end" << endl;
 
   output << init_s.str() << endl
-         << s.str()
+         << s
          << end_s.str() << endl
          << "end" << endl;
   output.close();
@@ -2277,27 +2397,32 @@ DynamicModel::writeDynamicMatlabCompatLayer(const string &basename) const
 void
 DynamicModel::writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia) const
 {
-  writeDynamicModel("", DynamicOutput, use_dll, julia);
+  writeDynamicModel("", DynamicOutput, use_dll, julia, 0);
 }
 
 void
 DynamicModel::writeDynamicModel(const string &basename, bool use_dll, bool julia) const
 {
   ofstream DynamicOutput;
-  writeDynamicModel(basename, DynamicOutput, use_dll, julia);
+  writeDynamicModel(basename, DynamicOutput, use_dll, julia, 0);
 }
 
 void
-DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput, bool use_dll, bool julia) const
+DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput, bool use_dll, bool julia, int split_c_files) const
 {
-  ostringstream model_tt_output;             // Used for storing model temp vars
-  ostringstream model_output;                // Used for storing model equations
-  ostringstream jacobian_tt_output;          // Used for storing jacobian temp vars
-  ostringstream jacobian_output;             // Used for storing jacobian equations
-  ostringstream hessian_tt_output;           // Used for storing Hessian temp vars
-  ostringstream hessian_output;              // Used for storing Hessian equations
-  ostringstream third_derivatives_tt_output; // Used for storing third order derivatives temp terms
-  ostringstream third_derivatives_output;    // Used for storing third order derivatives equations
+  OutputSection model_tt_output;             // Used for storing model temp vars
+  OutputSection model_output;                // Used for storing model equations
+  OutputSection jacobian_tt_output;          // Used for storing jacobian temp vars
+  OutputSection jacobian_output;             // Used for storing jacobian equations
+  OutputSection hessian_tt_output;           // Used for storing Hessian temp vars
+  OutputSection hessian_output;              // Used for storing Hessian equations
+  OutputSection third_derivatives_tt_output; // Used for storing third order derivatives temp terms
+  OutputSection third_derivatives_output;    // Used for storing third order derivatives equations
+  OutputSection hessian_copies_output;       // Used for storing the copies of symmetric elements of v2 (C only)
+  OutputSection third_derivatives_copies_output; // Used for storing the copies of symmetric elements of v3 (C only)
+  ostringstream sparse_idx_output;           // Used for storing the sparsity patterns of v2 and v3 (C only)
+  ostringstream hessian_idx_output;          // Used for storing the sparsity pattern of v2 (MATLAB only)
+  ostringstream third_derivatives_idx_output; // Used for storing the sparsity pattern of v3 (MATLAB only)
 
   ExprNodeOutputType output_type = (use_dll ? ExprNodeOutputType::CDynamicModel :
                                     julia ? ExprNodeOutputType::juliaDynamicModel : ExprNodeOutputType::matlabDynamicModel);
@@ -2354,6 +2479,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
       temp_term_union.insert(temporary_terms_g2.begin(), temporary_terms_g2.end());
 
       int k = 0; // Keep the line of a 2nd derivative in v2
+      vector<pair<int, int>> hessian_indices, hessian_copies;
       for (const auto & second_derivative : second_derivatives)
         {
           int eq, var1, var2;
@@ -2376,12 +2502,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
             }
           else
             {
-              sparseHelper(2, hessian_output, k, 0, output_type);
-              hessian_output << "=" << eq + 1 << ";" << endl;
-
-              sparseHelper(2, hessian_output, k, 1, output_type);
-              hessian_output << "=" << col_nb + 1 << ";" << endl;
-
+              hessian_indices.emplace_back(eq + 1, col_nb + 1);
               sparseHelper(2, hessian_output, k, 2, output_type);
               hessian_output << "=";
               d2->writeOutput(hessian_output, output_type, temp_term_union, temporary_terms_idxs, tef_terms);
@@ -2397,20 +2518,16 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
                              << for_sym.str() << endl;
             else
               {
-                sparseHelper(2, hessian_output, k, 0, output_type);
-                hessian_output << "=" << eq + 1 << ";" << endl;
-
-                sparseHelper(2, hessian_output, k, 1, output_type);
-                hessian_output << "=" << col_nb_sym + 1 << ";" << endl;
-
-                sparseHelper(2, hessian_output, k, 2, output_type);
-                hessian_output << "=";
-                sparseHelper(2, hessian_output, k-1, 2, output_type);
-                hessian_output << ";" << endl;
-
+                hessian_indices.emplace_back(eq + 1, col_nb_sym + 1);
+                hessian_copies.emplace_back(k, k-1);
                 k++;
               }
         }
+
+      writeSparseIndexTable(isCOutput(output_type) ? sparse_idx_output : hessian_idx_output,
+                            2, hessian_indices, output_type);
+      writeSparseSymmetricCopies(sparse_idx_output, isCOutput(output_type) ? hessian_copies_output : hessian_output,
+                                 2, hessian_copies, output_type);
     }
 
   // Writing third derivatives
@@ -2423,6 +2540,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
       temp_term_union.insert(temporary_terms_g3.begin(), temporary_terms_g3.end());
 
       int k = 0; // Keep the line of a 3rd derivative in v3
+      vector<pair<int, int>> third_derivatives_indices, third_derivatives_copies;
       for (const auto & third_derivative : third_derivatives)
         {
           int eq, var1, var2, var3;
@@ -2446,12 +2564,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
             }
           else
             {
-              sparseHelper(3, third_derivatives_output, k, 0, output_type);
-              third_derivatives_output << "=" << eq + 1 << ";" << endl;
-
-              sparseHelper(3, third_derivatives_output, k, 1, output_type);
-              third_derivatives_output << "=" << ref_col + 1 << ";" << endl;
-
+              third_derivatives_indices.emplace_back(eq + 1, ref_col + 1);
               sparseHelper(3, third_derivatives_output, k, 2, output_type);
               third_derivatives_output << "=";
               d3->writeOutput(third_derivatives_output, output_type, temp_term_union, temporary_terms_idxs, tef_terms);
@@ -2475,21 +2588,17 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
                                          << for_sym.str() << endl;
               else
                 {
-                  sparseHelper(3, third_derivatives_output, k+k2, 0, output_type);
-                  third_derivatives_output << "=" << eq + 1 << ";" << endl;
-
-                  sparseHelper(3, third_derivatives_output, k+k2, 1, output_type);
-                  third_derivatives_output << "=" << col + 1 << ";" << endl;
-
-                  sparseHelper(3, third_derivatives_output, k+k2, 2, output_type);
-                  third_derivatives_output << "=";
-                  sparseHelper(3, third_derivatives_output, k, 2, output_type);
-                  third_derivatives_output << ";" << endl;
-
+                  third_derivatives_indices.emplace_back(eq + 1, col + 1);
+                  third_derivatives_copies.emplace_back(k+k2, k);
                   k2++;
                 }
           k += k2;
         }
+
+      writeSparseIndexTable(isCOutput(output_type) ? sparse_idx_output : third_derivatives_idx_output,
+                            3, third_derivatives_indices, output_type);
+      writeSparseSymmetricCopies(sparse_idx_output, isCOutput(output_type) ? third_derivatives_copies_output : third_derivatives_output,
+                                 3, third_derivatives_copies, output_type);
     }
 
   if (output_type == ExprNodeOutputType::matlabDynamicModel)
@@ -2529,7 +2638,8 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
       init_output.clear();
       if (second_derivatives.size())
         {
-          init_output << "v2 = zeros(" << NNZDerivatives[1] << ",3);";
+          init_output << "v2 = zeros(" << NNZDerivatives[1] << ",3);" << endl
+                      << hessian_idx_output.str();
           end_output << "g2 = sparse(v2(:,1),v2(:,2),v2(:,3)," << nrows << "," << hessianColsNbr << ");";
         }
       else
@@ -2550,7 +2660,8 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
       int ncols = hessianColsNbr * dynJacobianColsNbr;
       if (third_derivatives.size())
         {
-          init_output << "v3 = zeros(" << NNZDerivatives[2] << ",3);";
+          init_output << "v3 = zeros(" << NNZDerivatives[2] << ",3);" << endl
+                      << third_derivatives_idx_output.str();
           end_output << "g3 = sparse(v3(:,1),v3(:,2),v3(:,3)," << nrows << "," << ncols << ");";
         }
       else
@@ -2568,40 +2679,92 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
     }
   else if (output_type == ExprNodeOutputType::CDynamicModel)
     {
-      DynamicOutput << "void Dynamic(double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *residual, double *g1, double *v2, double *v3)" << endl
-                    << "{" << endl
-                    << "  double lhs, rhs;" << endl
-                    << endl
-                    << "  /* Residual equations */" << endl
-                    << model_tt_output.str()
-                    << model_output.str()
-                    << "  /* Jacobian  */" << endl
-                    << "  if (g1 == NULL)" << endl
-                    << "    return;" << endl
-                    << endl
-                    << jacobian_tt_output.str()
-                    << jacobian_output.str()
-                    << endl;
-
+      /* As in the MATLAB output, each order has its own pair of functions:
+         dynamic_<order>_tt() fills the T buffer with the temporary terms needed
+         up to that order, and dynamic_<order>() computes the derivatives from
+         it. With split_c_files, the body of these functions is written to
+         separate translation units. */
+      int ntt = temporary_terms_mlv.size() + temporary_terms_res.size() + temporary_terms_g1.size()
+        + temporary_terms_g2.size() + temporary_terms_g3.size();
+      string params = "double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *T";
+      string args = "y, x, nb_row_x, params, steady_state, it_, T";
+      vector<string> sources = { "dynamic.c", "dynamic_mex.c" };
+      ostringstream prototypes;
+      OutputSection functions;
+      auto writeFunction = [&](OutputSection &code, const string &name, const string &out,
+                               const string &previous_name, const string &init, OutputSection *end)
+        {
+          functions << "void " << name << "(" << (out.empty() ? params : params + ", double *" + out) << ")" << endl
+                    << "{" << endl;
+          if (!previous_name.empty())
+            functions << "  " << previous_name << "(" << args << ");" << endl;
+          functions << init;
+          if (split_c_files > 0)
+            writeCSplitSection(basename, "dynamic.h", name,
+                               out.empty() ? params : params + ", double *" + out,
+                               out.empty() ? args : args + ", " + out,
+                               name == "dynamic_resid", code, split_c_files, prototypes, functions, "  ", sources);
+          else
+            {
+              if (name == "dynamic_resid")
+                functions << "  double lhs, rhs;" << endl;
+              functions << code;
+            }
+          if (end)
+            functions << *end;
+          functions << "}" << endl << endl;
+        };
+
+      writeFunction(model_tt_output, "dynamic_resid_tt", "", "", "", nullptr);
+      writeFunction(model_output, "dynamic_resid", "residual", "", "", nullptr);
+      writeFunction(jacobian_tt_output, "dynamic_g1_tt", "", "dynamic_resid_tt", "", nullptr);
+      writeFunction(jacobian_output, "dynamic_g1", "g1", "", "", nullptr);
+      vector<pair<string, string>> orders = { { "resid", "residual" }, { "g1", "g1" } };
       if (second_derivatives.size())
-        DynamicOutput << "  /* Hessian for endogenous and exogenous variables */" << endl
-                      << "  if (v2 == NULL)" << endl
-                      << "    return;" << endl
-                      << endl
-                      << hessian_tt_output.str()
-                      << hessian_output.str()
-                      << endl;
-
+        {
+          writeFunction(hessian_tt_output, "dynamic_g2_tt", "", "dynamic_g1_tt", "", nullptr);
+          writeFunction(hessian_output, "dynamic_g2", "v2", "", "  memcpy(v2, v2_idx, sizeof(v2_idx));\n",
+                        &hessian_copies_output);
+          orders.emplace_back("g2", "v2");
+        }
       if (third_derivatives.size())
-        DynamicOutput << "  /* Third derivatives for endogenous and exogenous variables */" << endl
-                      << "  if (v3 == NULL)" << endl
-                      << "    return;" << endl
-                      << endl
-                      << third_derivatives_tt_output.str()
-                      << third_derivatives_output.str()
-                      << endl;
+        {
+          writeFunction(third_derivatives_tt_output, "dynamic_g3_tt", "", "dynamic_g2_tt", "", nullptr);
+          writeFunction(third_derivatives_output, "dynamic_g3", "v3", "", "  memcpy(v3, v3_idx, sizeof(v3_idx));\n",
+                        &third_derivatives_copies_output);
+          orders.emplace_back("g3", "v3");
+        }
 
+      DynamicOutput << sparse_idx_output.str()
+                    << prototypes.str();
+      if (split_c_files > 0)
+        DynamicOutput << endl;
+      DynamicOutput << functions
+                    << "void Dynamic(double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *residual, double *g1, double *v2, double *v3)" << endl
+                    << "{" << endl
+                    << "  double T[" << max(ntt, 1) << "];" << endl
+                    << endl;
+      // Only compute the temporary terms of the highest order requested
+      for (size_t k = 0; k < orders.size(); k++)
+        {
+          DynamicOutput << "  ";
+          if (k > 0)
+            DynamicOutput << "else";
+          if (k > 0 && k < orders.size() - 1)
+            DynamicOutput << " ";
+          if (k < orders.size() - 1)
+            DynamicOutput << "if (" << orders[k+1].second << " == NULL)";
+          DynamicOutput << endl
+                        << "    {" << endl
+                        << "      dynamic_" << orders[k].first << "_tt(" << args << ");" << endl;
+          for (size_t l = 0; l <= k; l++)
+            DynamicOutput << "      dynamic_" << orders[l].first << "(" << args << ", " << orders[l].second << ");" << endl;
+          DynamicOutput << "    }" << endl;
+        }
       DynamicOutput << "}" << endl << endl;
+
+      if (split_c_files > 0)
+        writeCSplitMakefile(basename, "dynamic", "dynamic.h", sources);
     }
   else
     {
@@ -2677,7 +2840,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
       output << "function dynamicResidTT!(T::Vector{Float64}," << endl
              << "                         y::Vector{Float64}, x::Matrix{Float64}, "
              << "params::Vector{Float64}, steady_state::Vector{Float64}, it_::Int)" << endl
-             << model_tt_output.str()
+             << model_tt_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -2692,7 +2855,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
              << "    if T_flag" << endl
              << "        dynamicResidTT!(T, y, x, params, steady_state, it_)" << endl
              << "    end" << endl
-             << model_output.str()
+             << model_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -2701,7 +2864,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
              << "                      y::Vector{Float64}, x::Matrix{Float64}, "
              << "params::Vector{Float64}, steady_state::Vector{Float64}, it_::Int)" << endl
              << "    dynamicResidTT!(T, y, x, params, steady_state, it_)" << endl
-             << jacobian_tt_output.str()
+             << jacobian_tt_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -2718,7 +2881,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
              << "        dynamicG1TT!(T, y, x, params, steady_state, it_)" << endl
              << "    end" << endl
              << "    fill!(g1, 0.0)" << endl
-             << jacobian_output.str()
+             << jacobian_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -2727,7 +2890,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
              << "                      y::Vector{Float64}, x::Matrix{Float64}, "
              << "params::Vector{Float64}, steady_state::Vector{Float64}, it_::Int)" << endl
              << "    dynamicG1TT!(T, y, x, params, steady_state, it_)" << endl
-             << hessian_tt_output.str()
+             << hessian_tt_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -2743,7 +2906,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
              << "        dynamicG2TT!(T, y, x, params, steady_state, it_)" << endl
              << "    end" << endl
              << "    fill!(g2, 0.0)" << endl
-             << hessian_output.str()
+             << hessian_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -2752,7 +2915,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
              << "                      y::Vector{Float64}, x::Matrix{Float64}, "
              << "params::Vector{Float64}, steady_state::Vector{Float64}, it_::Int)" << endl
              << "    dynamicG2TT!(T, y, x, params, steady_state, it_)" << endl
-             << third_derivatives_tt_output.str()
+             << third_derivatives_tt_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -2770,7 +2933,7 @@ DynamicModel::writeDynamicModel(const string &basename, ostream &DynamicOutput,
              << "      dynamicG3TT!(T, y, x, params, steady_state, it_)" << endl
              << "    end" << endl
              << "    fill!(g3, 0.0)" << endl
-             << third_derivatives_output.str()
+             << third_derivatives_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -4224,6 +4387,13 @@ DynamicModel::computingPass(bool jacobianExo, bool hessian, bool thirdDerivative
         computeParamsDerivativesTemporaryTerms();
     }
 
+  if (params_derivs_adjoint)
+    {
+      if (!nopreprocessoroutput)
+        cout << " - reverse-mode derivatives of residuals/Jacobian w.r. to parameters" << endl;
+      computeParamsAdjoint(no_tmp_terms);
+    }
+
   if (thirdDerivatives)
     {
       if (!nopreprocessoroutput)
@@ -4234,16 +4404,20 @@ DynamicModel::computingPass(bool jacobianExo, bool hessian, bool thirdDerivative
   if (block)
     {
       vector<unsigned int> n_static, n_forward, n_backward, n_mixed;
-      jacob_map_t contemporaneous_jacobian, static_jacobian;
+      IncidenceMatrix incidence;
 
       // for each block contains pair<Size, Feddback_variable>
       vector<pair<int, int>> blocks;
 
-      evaluateAndReduceJacobian(eval_context, contemporaneous_jacobian, static_jacobian, dynamic_jacobian, cutoff, false);
+      evaluateAndReduceJacobian(eval_context, incidence, dynamic_jacobian, cutoff, false);
 
-      computeNonSingularNormalization(contemporaneous_jacobian, cutoff, static_jacobian, dynamic_jacobian);
+      computeNonSingularNormalization(incidence, cutoff, dynamic_jacobian);
 
-      computePrologueAndEpilogue(static_jacobian, equation_reordered, variable_reordered);
+      // With a zero cutoff, the model is reordered according to its symbolic incidence
+      if (cutoff == 0)
+        incidence = computeSymbolicIncidence();
+
+      computePrologueAndEpilogue(incidence, equation_reordered, variable_reordered);
 
       map<pair<int, pair<int, int>>, expr_t> first_order_endo_derivatives = collect_first_order_derivatives_endogenous();
 
@@ -4254,7 +4428,7 @@ DynamicModel::computingPass(bool jacobianExo, bool hessian, bool thirdDerivative
 
       lag_lead_vector_t equation_lag_lead, variable_lag_lead;
 
-      computeBlockDecompositionAndFeedbackVariablesForEachBlock(static_jacobian, dynamic_jacobian, equation_reordered, variable_reordered, blocks, equation_type_and_normalized_equation, false, true, mfs, inv_equation_reordered, inv_variable_reordered, equation_lag_lead, variable_lag_lead, n_static, n_forward, n_backward, n_mixed);
+      computeBlockDecompositionAndFeedbackVariablesForEachBlock(incidence, dynamic_jacobian, equation_reordered, variable_reordered, blocks, equation_type_and_normalized_equation, false, true, mfs, inv_equation_reordered, inv_variable_reordered, equation_lag_lead, variable_lag_lead, n_static, n_forward, n_backward, n_mixed);
 
       block_type_firstequation_size_mfs = reduceBlocksAndTypeDetermination(dynamic_jacobian, blocks, equation_type_and_normalized_equation, variable_reordered, equation_reordered, n_static, n_forward, n_backward, n_mixed, block_col_type);
 
@@ -4462,47 +4636,66 @@ DynamicModel::get_Derivatives(int block)
 void
 DynamicModel::computeChainRuleJacobian(blocks_derivatives_t &blocks_endo_derivatives)
 {
-  map<int, expr_t> recursive_variables;
   unsigned int nb_blocks = getNbBlocks();
   blocks_endo_derivatives = blocks_derivatives_t(nb_blocks);
+  /* The derivatives to be computed by the chain rule are first listed for
+     all the blocks, since they are independent from one block to another,
+     and computed using nthreads threads */
+  vector<map<int, expr_t>> recursive_variables(nb_blocks);
+  vector<map<pair<pair<int, pair<int, int>>, pair<int, int>>, int>> blocks_Derivatives(nb_blocks);
+  vector<vector<pair<expr_t, int>>> chain_rule_derivatives(nb_blocks);
   for (unsigned int block = 0; block < nb_blocks; block++)
     {
-      block_derivatives_equation_variable_laglead_nodeid_t tmp_derivatives;
-      recursive_variables.clear();
       int block_size = getBlockSize(block);
       int block_nb_mfs = getBlockMfs(block);
       int block_nb_recursives = block_size - block_nb_mfs;
-      blocks_endo_derivatives.push_back(block_derivatives_equation_variable_laglead_nodeid_t(0));
       for (int i = 0; i < block_nb_recursives; i++)
         {
           if (getBlockEquationType(block, i) == E_EVALUATE_S)
-            recursive_variables[getDerivID(symbol_table.getID(SymbolType::endogenous, getBlockVariableID(block, i)), 0)] = getBlockEquationRenormalizedExpr(block, i);
+            recursive_variables[block][getDerivID(symbol_table.getID(SymbolType::endogenous, getBlockVariableID(block, i)), 0)] = getBlockEquationRenormalizedExpr(block, i);
           else
-            recursive_variables[getDerivID(symbol_table.getID(SymbolType::endogenous, getBlockVariableID(block, i)), 0)] = getBlockEquationExpr(block, i);
+            recursive_variables[block][getDerivID(symbol_table.getID(SymbolType::endogenous, getBlockVariableID(block, i)), 0)] = getBlockEquationExpr(block, i);
         }
-      map<pair<pair<int, pair<int, int>>, pair<int, int>>, int> Derivatives = get_Derivatives(block);
-      map<pair<pair<int, pair<int, int>>, pair<int, int>>, int>::const_iterator it = Derivatives.begin();
-      for (int i = 0; i < (int) Derivatives.size(); i++)
+      blocks_Derivatives[block] = get_Derivatives(block);
+      for (const auto &it : blocks_Derivatives[block])
         {
-          int Deriv_type = it->second;
-          pair<pair<int, pair<int, int>>, pair<int, int>> it_l(it->first);
-          it++;
-          int lag = it_l.first.first;
-          int eq = it_l.first.second.first;
-          int var = it_l.first.second.second;
-          int eqr = it_l.second.first;
-          int varr = it_l.second.second;
-          if (Deriv_type == 0)
-            first_chain_rule_derivatives[{ eqr, { varr, lag } }] = first_derivatives[{ eqr, getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag) }];
-          else if (Deriv_type == 1)
-            first_chain_rule_derivatives[{ eqr, { varr, lag } }] = (equation_type_and_normalized_equation[eqr].second)->getChainRuleDerivative(getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag), recursive_variables);
+          int Deriv_type = it.second;
+          int lag = it.first.first.first;
+          int eq = it.first.first.second.first;
+          int eqr = it.first.second.first;
+          int varr = it.first.second.second;
+          int deriv_id = getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag);
+          if (Deriv_type == 1)
+            chain_rule_derivatives[block].emplace_back(equation_type_and_normalized_equation[eqr].second, deriv_id);
           else if (Deriv_type == 2)
             {
               if (getBlockEquationType(block, eq) == E_EVALUATE_S && eq < block_nb_recursives)
-                first_chain_rule_derivatives[{ eqr, { varr, lag } }] = (equation_type_and_normalized_equation[eqr].second)->getChainRuleDerivative(getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag), recursive_variables);
+                chain_rule_derivatives[block].emplace_back(equation_type_and_normalized_equation[eqr].second, deriv_id);
               else
-                first_chain_rule_derivatives[{ eqr, { varr, lag } }] = equations[eqr]->getChainRuleDerivative(getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag), recursive_variables);
+                chain_rule_derivatives[block].emplace_back(equations[eqr], deriv_id);
             }
+        }
+    }
+
+  computeChainRuleDerivativesParallel(recursive_variables, chain_rule_derivatives);
+
+  for (unsigned int block = 0; block < nb_blocks; block++)
+    {
+      block_derivatives_equation_variable_laglead_nodeid_t tmp_derivatives;
+      blocks_endo_derivatives.push_back(block_derivatives_equation_variable_laglead_nodeid_t(0));
+      auto it_chr = chain_rule_derivatives[block].begin();
+      for (const auto &it : blocks_Derivatives[block])
+        {
+          int Deriv_type = it.second;
+          int lag = it.first.first.first;
+          int eq = it.first.first.second.first;
+          int var = it.first.first.second.second;
+          int eqr = it.first.second.first;
+          int varr = it.first.second.second;
+          if (Deriv_type == 0)
+            first_chain_rule_derivatives[{ eqr, { varr, lag } }] = first_derivatives[{ eqr, getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag) }];
+          else if (Deriv_type == 1 || Deriv_type == 2)
+            first_chain_rule_derivatives[{ eqr, { varr, lag } }] = (it_chr++)->first;
           tmp_derivatives.emplace_back(make_pair(eq, var), make_pair(lag, first_chain_rule_derivatives[{ eqr, { varr, lag } }]));
         }
       blocks_endo_derivatives[block] = tmp_derivatives;
@@ -4685,8 +4878,96 @@ DynamicModel::collectBlockVariables()
     }
 }
 
+string
+DynamicModel::batchKernelParams()
+{
+  return "double *DYNARE_RESTRICT y, double *DYNARE_RESTRICT x, int nb_row_x, double *DYNARE_RESTRICT params, "
+    "double *DYNARE_RESTRICT steady_state, int it_, double *DYNARE_RESTRICT T";
+}
+
+void
+DynamicModel::writeDynamicCBatchKernels(ostream &output) const
+{
+  ExprNodeOutputType output_type = ExprNodeOutputType::CDynamicModelBatch;
+  OutputSection model_tt_output, model_output, jacobian_tt_output, jacobian_output;
+  deriv_node_temp_terms_t tef_terms;
+  temporary_terms_t temp_term_union;
+
+  for (auto it : temporary_terms_mlv)
+    temp_term_union.insert(it.first);
+  writeModelLocalVariableTemporaryTerms(temp_term_union, temporary_terms_mlv,
+                                        model_tt_output, output_type, tef_terms);
+  writeTemporaryTerms(temporary_terms_res, temp_term_union, temporary_terms_idxs,
+                      model_tt_output, output_type, tef_terms);
+  temp_term_union.insert(temporary_terms_res.begin(), temporary_terms_res.end());
+
+  writeModelEquations(model_output, output_type, temp_term_union);
+
+  writeTemporaryTerms(temporary_terms_g1, temp_term_union, temporary_terms_idxs,
+                      jacobian_tt_output, output_type, tef_terms);
+  temp_term_union.insert(temporary_terms_g1.begin(), temporary_terms_g1.end());
+
+  // The nonzero elements are stored in the order of dynamic_g1_idx
+  int k = 0;
+  for (const auto &first_derivative : first_derivatives)
+    {
+      jacobian_output << "g1[" << k++ << "*n+i]=";
+      first_derivative.second->writeOutput(jacobian_output, output_type,
+                                           temp_term_union, temporary_terms_idxs, tef_terms);
+      jacobian_output << ";" << endl;
+    }
+
+  /* Every statement of the loops only depends on the current point, so that
+     the loops can be vectorized. The arrays do not overlap (DYNARE_RESTRICT is
+     defined in model.h), so that the compiler does not have to assume that
+     the stores into T and the outputs change the inputs */
+  string params = "int n, " + batchKernelParams();
+  auto writeKernel = [&](const string &name, const string &out, const string &previous_name, OutputSection &code)
+    {
+      output << "void " << name << "(" << (out.empty() ? params : params + ", double *DYNARE_RESTRICT " + out) << ")" << endl
+             << "{" << endl;
+      if (!previous_name.empty())
+        output << "  " << previous_name << "(n, y, x, nb_row_x, params, steady_state, it_, T);" << endl;
+      output << "#pragma omp simd" << endl
+             << "  for (int i = 0; i < n; i++)" << endl
+             << "    {" << endl;
+      if (out == "residual")
+        output << "      double lhs, rhs;" << endl;
+      output << code
+             << "    }" << endl
+             << "}" << endl << endl;
+    };
+  writeKernel("dynamic_resid_tt_batch", "", "", model_tt_output);
+  writeKernel("dynamic_resid_batch", "residual", "", model_output);
+  writeKernel("dynamic_g1_tt_batch", "", "dynamic_resid_tt_batch", jacobian_tt_output);
+  writeKernel("dynamic_g1_batch", "g1", "", jacobian_output);
+}
+
 void
-DynamicModel::writeDynamicFile(const string &basename, bool block, bool bytecode, bool use_dll, int order, bool julia) const
+DynamicModel::writeDynamicCLibraryFile(const string &basename, const string &prefix, int order, ostream &header) const
+{
+  writeDynamicCFile(basename, order, 0, prefix);
+
+  writeCLibraryDeclarations(header, prefix, "dynamic",
+                            "double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *T",
+                            "void " + prefix + "Dynamic(double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *residual, double *g1, double *v2, double *v3)");
+  header << "extern const int " << prefix << "dynamic_max_lag;" << endl
+         << "extern const int " << prefix << "dynamic_max_lead;" << endl
+         << "extern const int " << prefix << "dynamic_lead_lag_incidence[];" << endl
+         << endl
+         << "/* Dynamic model at n points at once. Element k of point i of y, x, T, residual" << endl
+         << "   and g1 is stored at index k*n+i. T has dynamic_ntt*n elements, and g1 holds" << endl
+         << "   the dynamic_nnz[0] nonzero elements of the Jacobian, in the order of" << endl
+         << "   dynamic_g1_idx. */" << endl
+         << "void " << prefix << "dynamic_resid_tt_batch(int n, " << batchKernelParams() << ");" << endl
+         << "void " << prefix << "dynamic_resid_batch(int n, " << batchKernelParams() << ", double *DYNARE_RESTRICT residual);" << endl
+         << "void " << prefix << "dynamic_g1_tt_batch(int n, " << batchKernelParams() << ");" << endl
+         << "void " << prefix << "dynamic_g1_batch(int n, " << batchKernelParams() << ", double *DYNARE_RESTRICT g1);" << endl
+         << endl;
+}
+
+void
+DynamicModel::writeDynamicFile(const string &basename, bool block, bool bytecode, bool use_dll, int order, bool julia, int split_c_files) const
 {
   if (block && bytecode)
     writeModelEquationsCode_Block(basename, map_idx);
@@ -4695,7 +4976,7 @@ DynamicModel::writeDynamicFile(const string &basename, bool block, bool bytecode
   else if (block && !bytecode)
     writeSparseDynamicMFile(basename);
   else if (use_dll)
-    writeDynamicCFile(basename, order);
+    writeDynamicCFile(basename, order, split_c_files, "");
   else if (julia)
     writeDynamicJuliaFile(basename);
   else
@@ -5476,6 +5757,70 @@ DynamicModel::writeParamsDerivativesFile(const string &basename, bool julia) con
   paramsDerivsFile.close();
 }
 
+void
+DynamicModel::writeParamsAdjointFile(const string &basename) const
+{
+  if (!params_derivs_adjoint)
+    return;
+
+  vector<pair<expr_t, string>> residuals_seeds, jacobian_seeds;
+  for (int eq = 0; eq < (int) equations.size(); eq++)
+    residuals_seeds.emplace_back(equations[eq], "r_bar(" + to_string(eq+1) + ")");
+  for (const auto &first_derivative : first_derivatives)
+    {
+      int eq, var;
+      tie(eq, var) = first_derivative.first;
+      jacobian_seeds.emplace_back(first_derivative.second, "g1_bar(" + to_string(eq+1) + ", "
+                                  + to_string(getDynJacobianCol(var)+1) + ")");
+    }
+
+  ostringstream body_output;
+  writeParamsAdjoint(body_output, ExprNodeOutputType::matlabDynamicModel, residuals_seeds, jacobian_seeds);
+
+  // Check that we don't have more than 32 nested parenthesis because Matlab does not suppor this. See Issue #1201
+  map<string, string> tmp_paren_vars;
+  bool message_printed = false;
+  fixNestedParenthesis(body_output, tmp_paren_vars, message_printed);
+
+  string filename = packageDir(basename) + "/dynamic_params_adjoint.m";
+  ofstream paramsAdjointFile;
+  paramsAdjointFile.open(filename, ios::out | ios::binary);
+  if (!paramsAdjointFile.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  paramsAdjointFile << "function [rp_bar, gp_bar] = dynamic_params_adjoint(y, x, params, steady_state, it_, ss_param_deriv, r_bar, g1_bar)" << endl
+                    << "%" << endl
+                    << "% Compute in reverse mode the derivatives of weighted sums of the dynamic model residuals" << endl
+                    << "% and Jacobian with respect to the parameters" << endl
+                    << "% Inputs :" << endl
+                    << "%   y         [#dynamic variables by 1] double    vector of endogenous variables in the order stored" << endl
+                    << "%                                                 in M_.lead_lag_incidence; see the Manual" << endl
+                    << "%   x         [nperiods by M_.exo_nbr] double     matrix of exogenous variables (in declaration order)" << endl
+                    << "%                                                 for all simulation periods" << endl
+                    << "%   params    [M_.param_nbr by 1] double          vector of parameter values in declaration order" << endl
+                    << "%   steady_state  [M_.endo_nbr by 1] double       vector of steady state values" << endl
+                    << "%   it_       scalar double                       time period for exogenous variables for which to evaluate the model" << endl
+                    << "%   ss_param_deriv     [M_.eq_nbr by #params]     Jacobian matrix of the steady states values with respect to the parameters" << endl
+                    << "%   r_bar     [M_.eq_nbr by 1] double             weights of the residuals" << endl
+                    << "%   g1_bar    [M_.eq_nbr by #dynamic variables] double   weights of the Jacobian entries" << endl
+                    << "%" << endl
+                    << "% Outputs:" << endl
+                    << "%   rp_bar    [1 by #params] double   r_bar'*rp, where rp is the Jacobian matrix of dynamic model equations" << endl
+                    << "%                                     with respect to parameters (see dynamic_params_derivs.m)" << endl
+                    << "%   gp_bar    [1 by #params] double   sum of g1_bar.*gp over equations and variables, where gp is the derivative" << endl
+                    << "%                                     of the Jacobian matrix with respect to the parameters (see dynamic_params_derivs.m)" << endl
+                    << "%" << endl
+                    << "%" << endl
+                    << "% Warning : this file is generated automatically by Dynare" << endl
+                    << "%           from model file (.mod)" << endl << endl
+                    << body_output.str()
+                    << "end" << endl;
+  paramsAdjointFile.close();
+}
+
 void
 DynamicModel::writeLatexFile(const string &basename, const bool write_equation_tags) const
 {
@@ -5952,103 +6297,11 @@ DynamicModel::dynamicOnlyEquationsNbr() const
   return eqs.size();
 }
 
-bool
-DynamicModel::isChecksumMatching(const string &basename) const
+void
+DynamicModel::addBlockDecompositionToStructuralHash(StructuralHash &hash) const
 {
-  boost::crc_32_type result;
-
-  std::stringstream buffer;
-
-  // Write equation tags
-  for (const auto & equation_tag : equation_tags)
-    buffer << "  " << equation_tag.first + 1
-           << equation_tag.second.first
-           << equation_tag.second.second;
-
-  ExprNodeOutputType buffer_type = ExprNodeOutputType::CDynamicModel;
-
-  for (int eq = 0; eq < (int) equations.size(); eq++)
-    {
-      BinaryOpNode *eq_node = equations[eq];
-      expr_t lhs = eq_node->get_arg1();
-      expr_t rhs = eq_node->get_arg2();
-
-      // Test if the right hand side of the equation is empty.
-      double vrhs = 1.0;
-      try
-        {
-          vrhs = rhs->eval(eval_context_t());
-        }
-      catch (ExprNode::EvalException &e)
-        {
-        }
-
-      if (vrhs != 0) // The right hand side of the equation is not empty ==> residual=lhs-rhs;
-        {
-          buffer << "lhs =";
-          lhs->writeOutput(buffer, buffer_type, temporary_terms, temporary_terms_idxs);
-          buffer << ";" << endl;
-
-          buffer << "rhs =";
-          rhs->writeOutput(buffer, buffer_type, temporary_terms, temporary_terms_idxs);
-          buffer << ";" << endl;
-
-          buffer << "residual" << LEFT_ARRAY_SUBSCRIPT(buffer_type)
-                 << eq + ARRAY_SUBSCRIPT_OFFSET(buffer_type)
-                 << RIGHT_ARRAY_SUBSCRIPT(buffer_type)
-                 << "= lhs-rhs;" << endl;
-        }
-      else // The right hand side of the equation is empty ==> residual=lhs;
-        {
-          buffer << "residual" << LEFT_ARRAY_SUBSCRIPT(buffer_type)
-                 << eq + ARRAY_SUBSCRIPT_OFFSET(buffer_type)
-                 << RIGHT_ARRAY_SUBSCRIPT(buffer_type)
-                 << " = ";
-          lhs->writeOutput(buffer, buffer_type, temporary_terms, temporary_terms_idxs);
-          buffer << ";" << endl;
-        }
-    }
-
-  const size_t private_buffer_size{1024};
-  char private_buffer[private_buffer_size];
-  while (buffer)
-    {
-      buffer.get(private_buffer, private_buffer_size);
-      result.process_bytes(private_buffer, strlen(private_buffer));
-    }
-
-  bool basename_dir_exists = !boost::filesystem::create_directory(basename);
-
-  // check whether basename directory exist. If not, create it.
-  // If it does, read old checksum if it exist
-  fstream checksum_file;
-  string filename = basename + "/checksum";
-  unsigned int old_checksum = 0;
-  // read old checksum if it exists
-  if (basename_dir_exists)
-    {
-      checksum_file.open(filename, ios::in | ios::binary);
-      if (checksum_file.is_open())
-        {
-          checksum_file >> old_checksum;
-          checksum_file.close();
-        }
-    }
-  // write new checksum file if none or different from old checksum
-  if (old_checksum != result.checksum())
-    {
-      checksum_file.open(filename, ios::out | ios::binary);
-      if (!checksum_file.is_open())
-        {
-          cerr << "ERROR: Can't open file " << filename << endl;
-          exit(EXIT_FAILURE);
-        }
-      checksum_file << result.checksum();
-      checksum_file.close();
-      return false;
-    }
-
-  return true;
+  addBlocksToStructuralHash(hash, equation_type_and_normalized_equation, block_type_firstequation_size_mfs,
+                            blocks_linear);
 }
 
 void
@@ -6220,11 +6473,11 @@ DynamicModel::writeJsonDynamicModelInfo(ostream &output) const
 void
 DynamicModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) const
 {
-  ostringstream model_local_vars_output;  // Used for storing model local vars
-  ostringstream model_output;             // Used for storing model temp vars and equations
-  ostringstream jacobian_output;          // Used for storing jacobian equations
-  ostringstream hessian_output;           // Used for storing Hessian equations
-  ostringstream third_derivatives_output; // Used for storing third order derivatives equations
+  OutputSection model_local_vars_output;  // Used for storing model local vars
+  OutputSection model_output;             // Used for storing model temp vars and equations
+  OutputSection jacobian_output;          // Used for storing jacobian equations
+  OutputSection hessian_output;           // Used for storing Hessian equations
+  OutputSection third_derivatives_output; // Used for storing third order derivatives equations
 
   deriv_node_temp_terms_t tef_terms;
   temporary_terms_t temp_term_empty;
@@ -6384,11 +6637,11 @@ DynamicModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) c
     output << "\"dynamic_model\": {";
   else
     output << "\"dynamic_model_simple\": {";
-  output << model_local_vars_output.str()
-         << ", " << model_output.str()
-         << ", " << jacobian_output.str()
-         << ", " << hessian_output.str()
-         << ", " << third_derivatives_output.str()
+  output << model_local_vars_output
+         << ", " << model_output
+         << ", " << jacobian_output
+         << ", " << hessian_output
+         << ", " << third_derivatives_output
          << "}";
 }
 
@@ -6402,13 +6655,13 @@ DynamicModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       && !hessian_params_derivatives.size())
     return;
 
-  ostringstream model_local_vars_output;   // Used for storing model local vars
-  ostringstream model_output;              // Used for storing model temp vars and equations
-  ostringstream jacobian_output;           // Used for storing jacobian equations
-  ostringstream hessian_output;            // Used for storing Hessian equations
-  ostringstream hessian1_output;           // Used for storing Hessian equations
-  ostringstream third_derivs_output;       // Used for storing third order derivatives equations
-  ostringstream third_derivs1_output;      // Used for storing third order derivatives equations
+  OutputSection model_local_vars_output;   // Used for storing model local vars
+  OutputSection model_output;              // Used for storing model temp vars and equations
+  OutputSection jacobian_output;           // Used for storing jacobian equations
+  OutputSection hessian_output;            // Used for storing Hessian equations
+  OutputSection hessian1_output;           // Used for storing Hessian equations
+  OutputSection third_derivs_output;       // Used for storing third order derivatives equations
+  OutputSection third_derivs1_output;      // Used for storing third order derivatives equations
 
   deriv_node_temp_terms_t tef_terms;
   writeJsonModelLocalVariables(model_local_vars_output, tef_terms);
@@ -6605,13 +6858,13 @@ DynamicModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
     output << "\"dynamic_model_params_derivative\": {";
   else
     output << "\"dynamic_model_params_derivatives_simple\": {";
-  output << model_local_vars_output.str()
-         << ", " << model_output.str()
-         << ", " << jacobian_output.str()
-         << ", " << hessian_output.str()
-         << ", " << hessian1_output.str()
-         << ", " << third_derivs_output.str()
-         << ", " << third_derivs1_output.str()
+  output << model_local_vars_output
+         << ", " << model_output
+         << ", " << jacobian_output
+         << ", " << hessian_output
+         << ", " << hessian1_output
+         << ", " << third_derivs_output
+         << ", " << third_derivs1_output
          << "}";
 }
 
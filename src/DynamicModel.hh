@@ -23,7 +23,6 @@
 using namespace std;
 
 #include <fstream>
-#include <boost/crc.hpp>
 
 #include "StaticModel.hh"
 
@@ -107,14 +106,22 @@ private:
   void writeDynamicJuliaFile(const string &dynamic_basename) const;
   //! Writes dynamic model file (C version)
   /*! \todo add third derivatives handling */
-  void writeDynamicCFile(const string &basename, const int order) const;
+  /*! If split_c_files > 0, the code is split into several translation units of at most split_c_files statements each */
+  /*! If library_prefix is not empty, writes the standalone C library version
+    (without MEX gateway), whose symbols are prefixed with library_prefix */
+  void writeDynamicCFile(const string &basename, const int order, int split_c_files, const string &library_prefix) const;
+  //! Writes the C functions computing the residuals and the Jacobian at several points at once
+  /*! The loops over the points are written so that they can be vectorized by the compiler */
+  void writeDynamicCBatchKernels(ostream &output) const;
+  //! Parameters common to the batch functions (after the number of points), with their arrays marked as not overlapping
+  static string batchKernelParams();
   //! Writes dynamic model file when SparseDLL option is on
   void writeSparseDynamicMFile(const string &basename) const;
   //! Writes the dynamic model equations and its derivatives
   /*! \todo add third derivatives handling in C output */
   void writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia) const;
   void writeDynamicModel(const string &basename, bool use_dll, bool julia) const;
-  void writeDynamicModel(const string &basename, ostream &DynamicOutput, bool use_dll, bool julia) const;
+  void writeDynamicModel(const string &basename, ostream &DynamicOutput, bool use_dll, bool julia, int split_c_files) const;
   //! Writes the Block reordred structure of the model in M output
   void writeModelEquationsOrdered_M(const string &basename) const;
   //! Writes the code of the Block reordred structure of the model in virtual machine bytecode
@@ -146,9 +153,9 @@ private:
   //! creates a mapping from the index of temporary terms to a natural index
   void computeTemporaryTermsMapping();
   //! Write derivative code of an equation w.r. to a variable
-  void compileDerivative(ofstream &code_file, unsigned int &instruction_number, int eq, int symb_id, int lag, const map_idx_t &map_idx) const;
+  void compileDerivative(ostream &code_file, unsigned int &instruction_number, int eq, int symb_id, int lag, const map_idx_t &map_idx) const;
   //! Write chain rule derivative code of an equation w.r. to a variable
-  void compileChainRuleDerivative(ofstream &code_file, unsigned int &instruction_number, int eq, int var, int lag, const map_idx_t &map_idx) const;
+  void compileChainRuleDerivative(ostream &code_file, unsigned int &instruction_number, int eq, int var, int lag, const map_idx_t &map_idx) const;
 
   //! Get the type corresponding to a derivation ID
   SymbolType getTypeByDerivID(int deriv_id) const noexcept(false) override;
@@ -199,6 +206,8 @@ private:
   //! Vector indicating if the block is linear in endogenous variable (true) or not (false)
   vector<bool> blocks_linear;
 
+  void addBlockDecompositionToStructuralHash(StructuralHash &hash) const override;
+
   //! Map the derivatives for a block pair<lag, make_pair(make_pair(eq, var)), expr_t>
   using derivative_t = map<pair< int, pair<int, int>>, expr_t>;
   //! Vector of derivative for each blocks
@@ -245,7 +254,7 @@ private:
                                const string &previous_tt_name,
                                const ostringstream &init_s,
                                const ostringstream &end_s,
-                               const ostringstream &s, const ostringstream &s_tt) const;
+                               OutputSection &s, OutputSection &s_tt) const;
 
   //! Create a legacy *_dynamic.m file for Matlab/Octave not yet using the temporary terms array interface
   void writeDynamicMatlabCompatLayer(const string &basename) const;
@@ -353,9 +362,15 @@ public:
   void Write_Inf_To_Bin_File_Block(const string &basename,
                                    const int &num, int &u_count_int, bool &file_open, bool is_two_boundaries) const;
   //! Writes dynamic model file
-  void writeDynamicFile(const string &basename, bool block, bool bytecode, bool use_dll, int order, bool julia) const;
+  /*! \param split_c_files maximum number of statements per translation unit in C output (0 means a single file) */
+  void writeDynamicFile(const string &basename, bool block, bool bytecode, bool use_dll, int order, bool julia, int split_c_files) const;
+  //! Writes the dynamic model of the standalone C library (see language=c), and its declarations to the header of the library
+  /*! The symbols of the library are prefixed with prefix */
+  void writeDynamicCLibraryFile(const string &basename, const string &prefix, int order, ostream &header) const;
   //! Writes file containing parameters derivatives
   void writeParamsDerivativesFile(const string &basename, bool julia) const;
+  //! Writes file containing the reverse-mode parameters derivatives (MATLAB only)
+  void writeParamsAdjointFile(const string &basename) const;
 
   //! Converts to static model (only the equations)
   /*! It assumes that the static model given in argument has just been allocated */
@@ -636,8 +651,6 @@ public:
 
   //! Returns true if a parameter was used in the model block with a lead or lag
   bool ParamUsedWithLeadLag() const;
-
-  bool isChecksumMatching(const string &basename) const;
 };
 
 //! Classes to re-order derivatives for various sparse storage formats
@@ -41,7 +41,10 @@ void main2(stringstream &in, string &basename, bool debug, bool clear_all, bool
            bool nograph, bool nointeractive, bool parallel, ConfigFile &config_file,
            WarningConsolidation &warnings_arg, bool nostrict, bool stochastic, bool check_model_changes,
            bool minimal_workspace, bool compute_xrefs, FileOutputType output_mode,
-           LanguageOutputType lang, int params_derivs_order, bool transform_unary_ops
+           LanguageOutputType lang, int params_derivs_order, int nthreads, bool transform_unary_ops,
+           bool cse_tmpterms, const string &tmpterms_costs_file, bool tmpterms_report,
+           bool params_derivs_adjoint, int split_c_files, const string &compilation_cache,
+           const string &block_cache, bool flat_bytecode
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
            , bool cygwin, bool msvc, bool mingw
 #endif
@@ -57,8 +60,9 @@ usage()
 {
   cerr << "Dynare usage: dynare mod_file [debug] [noclearall] [onlyclearglobals] [savemacro[=macro_file]] [onlymacro] [nolinemacro] [noemptylinemacro] [notmpterms] [nolog] [warn_uninit]"
        << " [console] [nograph] [nointeractive] [parallel[=cluster_name]] [conffile=parallel_config_path_and_filename] [parallel_slave_open_mode] [parallel_test]"
-       << " [-D<variable>[=<value>]] [-I/path] [nostrict] [stochastic] [fast] [minimal_workspace] [compute_xrefs] [output=dynamic|first|second|third] [language=julia]"
-       << " [params_derivs_order=0|1|2] [transform_unary_ops]"
+       << " [-D<variable>[=<value>]] [-I/path] [nostrict] [stochastic] [fast] [minimal_workspace] [compute_xrefs] [output=dynamic|first|second|third] [language=c|julia]"
+       << " [params_derivs_order=0|1|2] [transform_unary_ops] [nthreads=N]"
+       << " [cse_tmpterms] [tmpterms_costs=FILE] [tmpterms_report] [params_derivs_adjoint] [split_c_files=N] [compilation_cache=DIR] [block_cache=DIR] [flat_bytecode]"
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
        << " [cygwin] [msvc] [mingw]"
 #endif
@@ -95,6 +99,15 @@ main(int argc, char **argv)
   bool no_log = false;
   bool no_warn = false;
   int params_derivs_order = 2;
+  int nthreads = 1;
+  bool cse_tmpterms = false;
+  string tmpterms_costs_file;
+  bool tmpterms_report = false;
+  bool params_derivs_adjoint = false;
+  int split_c_files = 0;
+  string compilation_cache;
+  string block_cache;
+  bool flat_bytecode = false;
   bool warn_uninit = false;
   bool console = false;
   bool nograph = false;
@@ -142,6 +155,63 @@ main(int argc, char **argv)
             }
           params_derivs_order = atoi(argv[arg] + 20);
         }
+      else if (strlen(argv[arg]) >= 8 && !strncmp(argv[arg], "nthreads", 8))
+        {
+          if (strlen(argv[arg]) <= 9 || argv[arg][8] != '='
+              || strspn(argv[arg] + 9, "0123456789") != strlen(argv[arg] + 9)
+              || atoi(argv[arg] + 9) < 1)
+            {
+              cerr << "Incorrect syntax for nthreads option" << endl;
+              usage();
+            }
+          nthreads = atoi(argv[arg] + 9);
+        }
+      else if (!strcmp(argv[arg], "cse_tmpterms"))
+        cse_tmpterms = true;
+      else if (strlen(argv[arg]) >= 14 && !strncmp(argv[arg], "tmpterms_costs", 14))
+        {
+          if (strlen(argv[arg]) <= 15 || argv[arg][14] != '=')
+            {
+              cerr << "Incorrect syntax for tmpterms_costs option" << endl;
+              usage();
+            }
+          tmpterms_costs_file = string(argv[arg] + 15);
+        }
+      else if (!strcmp(argv[arg], "tmpterms_report"))
+        tmpterms_report = true;
+      else if (!strcmp(argv[arg], "params_derivs_adjoint"))
+        params_derivs_adjoint = true;
+      else if (strlen(argv[arg]) >= 13 && !strncmp(argv[arg], "split_c_files", 13))
+        {
+          if (strlen(argv[arg]) <= 14 || argv[arg][13] != '='
+              || strspn(argv[arg] + 14, "0123456789") != strlen(argv[arg] + 14)
+              || atoi(argv[arg] + 14) < 1)
+            {
+              cerr << "Incorrect syntax for split_c_files option" << endl;
+              usage();
+            }
+          split_c_files = atoi(argv[arg] + 14);
+        }
+      else if (strlen(argv[arg]) >= 17 && !strncmp(argv[arg], "compilation_cache", 17))
+        {
+          if (strlen(argv[arg]) <= 18 || argv[arg][17] != '=')
+            {
+              cerr << "Incorrect syntax for compilation_cache option" << endl;
+              usage();
+            }
+          compilation_cache = string(argv[arg] + 18);
+        }
+      else if (strlen(argv[arg]) >= 11 && !strncmp(argv[arg], "block_cache", 11))
+        {
+          if (strlen(argv[arg]) <= 12 || argv[arg][11] != '=')
+            {
+              cerr << "Incorrect syntax for block_cache option" << endl;
+              usage();
+            }
+          block_cache = string(argv[arg] + 12);
+        }
+      else if (!strcmp(argv[arg], "flat_bytecode"))
+        flat_bytecode = true;
       else if (!strcmp(argv[arg], "onlyclearglobals"))
         {
           clear_all = false;
@@ -288,6 +358,8 @@ main(int argc, char **argv)
 
           if (strlen(argv[arg]) == 14 && !strncmp(argv[arg] + 9, "julia", 5))
             language = LanguageOutputType::julia;
+          else if (strlen(argv[arg]) == 10 && !strncmp(argv[arg] + 9, "c", 1))
+            language = LanguageOutputType::c;
           else
             {
               // we don't want temp terms in external functions (except Julia)
@@ -400,7 +472,9 @@ main(int argc, char **argv)
   main2(macro_output, basename, debug, clear_all, clear_global,
         no_tmp_terms, no_log, no_warn, warn_uninit, console, nograph, nointeractive,
         parallel, config_file, warnings, nostrict, stochastic, check_model_changes, minimal_workspace,
-        compute_xrefs, output_mode, language, params_derivs_order, transform_unary_ops
+        compute_xrefs, output_mode, language, params_derivs_order, nthreads, transform_unary_ops,
+        cse_tmpterms, tmpterms_costs_file, tmpterms_report, params_derivs_adjoint, split_c_files,
+        compilation_cache, block_cache, flat_bytecode
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
         , cygwin, msvc, mingw
 #endif
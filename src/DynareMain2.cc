@@ -32,7 +32,10 @@ main2(stringstream &in, string &basename, bool debug, bool clear_all, bool clear
       bool nograph, bool nointeractive, bool parallel, ConfigFile &config_file,
       WarningConsolidation &warnings, bool nostrict, bool stochastic, bool check_model_changes,
       bool minimal_workspace, bool compute_xrefs, FileOutputType output_mode,
-      LanguageOutputType language, int params_derivs_order, bool transform_unary_ops
+      LanguageOutputType language, int params_derivs_order, int nthreads, bool transform_unary_ops,
+      bool cse_tmpterms, const string &tmpterms_costs_file, bool tmpterms_report,
+      bool params_derivs_adjoint, int split_c_files, const string &compilation_cache,
+      const string &block_cache, bool flat_bytecode
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
       , bool cygwin, bool msvc, bool mingw
 #endif
@@ -42,7 +45,10 @@ main2(stringstream &in, string &basename, bool debug, bool clear_all, bool clear
 {
   ParsingDriver p(warnings, nostrict);
 
-  boost::filesystem::remove_all(basename + "/model/json");
+  /* With the fast option, the JSON files of the computing pass are only
+     rewritten if they changed (see ModFile::writeJsonComputingPassOutput()) */
+  if (!check_model_changes || json != JsonOutputPointType::computingpass)
+    boost::filesystem::remove_all(basename + "/model/json");
 
   // Do parsing and construct internal representation of mod file
   unique_ptr<ModFile> mod_file = p.parse(in, debug);
@@ -63,16 +69,20 @@ main2(stringstream &in, string &basename, bool debug, bool clear_all, bool clear
   mod_file->evalAllExpressions(warn_uninit, nopreprocessoroutput);
 
   // Do computations
-  mod_file->computingPass(no_tmp_terms, output_mode, params_derivs_order, nopreprocessoroutput);
+  mod_file->computingPass(no_tmp_terms, output_mode, params_derivs_order, nthreads,
+                          cse_tmpterms, tmpterms_costs_file, tmpterms_report, params_derivs_adjoint,
+                          block_cache, flat_bytecode, nopreprocessoroutput);
   if (json == JsonOutputPointType::computingpass)
-    mod_file->writeJsonOutput(basename, json, json_output_mode, onlyjson, nopreprocessoroutput, jsonderivsimple);
+    mod_file->writeJsonOutput(basename, json, json_output_mode, onlyjson, nopreprocessoroutput, jsonderivsimple,
+                              check_model_changes);
 
   // Write outputs
   if (output_mode != FileOutputType::none)
     mod_file->writeExternalFiles(basename, output_mode, language, nopreprocessoroutput);
   else
     mod_file->writeOutputFiles(basename, clear_all, clear_global, no_log, no_warn, console, nograph,
-                               nointeractive, config_file, check_model_changes, minimal_workspace, compute_xrefs
+                               nointeractive, config_file, check_model_changes, minimal_workspace, compute_xrefs,
+                               split_c_files, compilation_cache, language
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
                                , cygwin, msvc, mingw
 #endif
@@ -18,17 +18,355 @@
  */
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <iterator>
 #include <algorithm>
 
 #include <cassert>
 #include <cmath>
+#include <limits>
 
 #include <utility>
 
 #include "ExprNode.hh"
 #include "DataTree.hh"
 #include "ModFile.hh"
+#include "FlatBytecode.hh"
+
+void
+OperatorCosts::readFile(const string &filename)
+{
+  const map<string, UnaryOpcode> unary_names
+    = { { "uminus", UnaryOpcode::uminus }, { "exp", UnaryOpcode::exp }, { "log", UnaryOpcode::log },
+        { "log10", UnaryOpcode::log10 }, { "cos", UnaryOpcode::cos }, { "sin", UnaryOpcode::sin },
+        { "tan", UnaryOpcode::tan }, { "acos", UnaryOpcode::acos }, { "asin", UnaryOpcode::asin },
+        { "atan", UnaryOpcode::atan }, { "cosh", UnaryOpcode::cosh }, { "sinh", UnaryOpcode::sinh },
+        { "tanh", UnaryOpcode::tanh }, { "acosh", UnaryOpcode::acosh }, { "asinh", UnaryOpcode::asinh },
+        { "atanh", UnaryOpcode::atanh }, { "sqrt", UnaryOpcode::sqrt }, { "abs", UnaryOpcode::abs },
+        { "sign", UnaryOpcode::sign }, { "erf", UnaryOpcode::erf } };
+  const map<string, BinaryOpcode> binary_names
+    = { { "plus", BinaryOpcode::plus }, { "minus", BinaryOpcode::minus }, { "times", BinaryOpcode::times },
+        { "divide", BinaryOpcode::divide }, { "power", BinaryOpcode::power },
+        { "powerDeriv", BinaryOpcode::powerDeriv }, { "max", BinaryOpcode::max }, { "min", BinaryOpcode::min },
+        { "less", BinaryOpcode::less }, { "greater", BinaryOpcode::greater },
+        { "lessEqual", BinaryOpcode::lessEqual }, { "greaterEqual", BinaryOpcode::greaterEqual },
+        { "equalEqual", BinaryOpcode::equalEqual }, { "different", BinaryOpcode::different } };
+  const map<string, TrinaryOpcode> trinary_names
+    = { { "normcdf", TrinaryOpcode::normcdf }, { "normpdf", TrinaryOpcode::normpdf } };
+
+  ifstream f(filename);
+  if (!f.is_open())
+    {
+      cerr << "ERROR: Can't open operator costs file " << filename << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  string line;
+  int lineno = 0;
+  while (getline(f, line))
+    {
+      lineno++;
+      istringstream iss(line);
+      string target, op, trailing;
+      int cost;
+      if (!(iss >> target) || target[0] == '#')
+        continue;
+      if (!(iss >> op >> cost) || iss >> trailing || (target != "c" && target != "matlab") || cost < 0)
+        {
+          cerr << "ERROR: " << filename << ":" << lineno
+               << ": syntax error in operator costs file (expected \"c|matlab <operator> <cost>\")" << endl;
+          exit(EXIT_FAILURE);
+        }
+      int is_matlab = target == "matlab";
+
+      if (op == "temporary_term")
+        temporary_term[is_matlab] = cost;
+      else if (unary_names.find(op) != unary_names.end())
+        unary[is_matlab][unary_names.at(op)] = cost;
+      else if (binary_names.find(op) != binary_names.end())
+        binary[is_matlab][binary_names.at(op)] = cost;
+      else if (trinary_names.find(op) != trinary_names.end())
+        trinary[is_matlab][trinary_names.at(op)] = cost;
+      else
+        {
+          cerr << "ERROR: " << filename << ":" << lineno
+               << ": unknown operator '" << op << "' in operator costs file" << endl;
+          exit(EXIT_FAILURE);
+        }
+    }
+}
+
+DenseEvalContext::DenseEvalContext(const eval_context_t &eval_context) :
+  DenseEvalContext(vector<eval_context_t>{ eval_context })
+{
+}
+
+DenseEvalContext::DenseEvalContext(const vector<eval_context_t> &eval_contexts) :
+  npoints(eval_contexts.size())
+{
+  int nsymbols = 0;
+  for (const auto &eval_context : eval_contexts)
+    if (!eval_context.empty())
+      nsymbols = max(nsymbols, eval_context.rbegin()->first + 1);
+
+  values.resize(nsymbols * npoints, numeric_limits<double>::quiet_NaN());
+  known.resize(nsymbols * npoints, false);
+  for (int k = 0; k < npoints; k++)
+    for (const auto &it : eval_contexts[k])
+      if (it.first >= 0)
+        {
+          values[it.first * npoints + k] = it.second;
+          known[it.first * npoints + k] = true;
+        }
+}
+
+int
+EvalTape::find(int node_idx) const
+{
+  return node_idx < (int) positions.size() ? positions[node_idx] : -1;
+}
+
+int
+EvalTape::append(int node_idx, const Instruction &instruction)
+{
+  if (node_idx >= (int) positions.size())
+    positions.resize(node_idx + 1, -1);
+  positions[node_idx] = instructions.size();
+  instructions.push_back(instruction);
+  return positions[node_idx];
+}
+
+int
+EvalTape::addConstant(int node_idx, double value)
+{
+  return append(node_idx, { InstructionType::constant, 0, -1, -1, -1, value });
+}
+
+int
+EvalTape::addVariable(int node_idx, int symb_id)
+{
+  return append(node_idx, { InstructionType::variable, symb_id, -1, -1, -1, 0 });
+}
+
+int
+EvalTape::addUnary(int node_idx, UnaryOpcode op_code, int arg)
+{
+  return append(node_idx, { InstructionType::unary, static_cast<int>(op_code), arg, -1, -1, 0 });
+}
+
+int
+EvalTape::addBinary(int node_idx, BinaryOpcode op_code, int arg1, int arg2, int powerDerivOrder)
+{
+  return append(node_idx, { InstructionType::binary, static_cast<int>(op_code), arg1, arg2, -1,
+                            static_cast<double>(powerDerivOrder) });
+}
+
+int
+EvalTape::addTrinary(int node_idx, TrinaryOpcode op_code, int arg1, int arg2, int arg3)
+{
+  return append(node_idx, { InstructionType::trinary, static_cast<int>(op_code), arg1, arg2, arg3, 0 });
+}
+
+int
+EvalTape::addFailure(int node_idx, Status status)
+{
+  return append(node_idx, { InstructionType::failure, static_cast<int>(status), -1, -1, -1, 0 });
+}
+
+int
+StructuralHash::find(int node_idx) const
+{
+  return node_idx < (int) positions.size() ? positions[node_idx] : -1;
+}
+
+int
+StructuralHash::addRecord(int node_idx, NodeKind kind)
+{
+  if (node_idx >= (int) positions.size())
+    positions.resize(node_idx + 1, -1);
+  positions[node_idx] = record_nbr++;
+  update(static_cast<int64_t>(kind));
+  return positions[node_idx];
+}
+
+void
+StructuralHash::update(int64_t value)
+{
+  hash.update(static_cast<uint64_t>(value));
+}
+
+void
+StructuralHash::update(const string &value)
+{
+  // Length-prefixed, so that consecutive strings cannot be confused
+  hash.update(static_cast<uint64_t>(value.size()));
+  hash.update(value);
+}
+
+void
+StructuralHash::updateExpression(expr_t expression)
+{
+  update(expression->addToStructuralHash(*this));
+}
+
+string
+StructuralHash::hexDigest()
+{
+  return hash.hexDigest();
+}
+
+void
+EvalTape::evalUnary(UnaryOpcode op_code, const double *arg, double *value, Status *status, int n)
+{
+  // The most common operators get their own loop, which the compiler can vectorize
+  switch (op_code)
+    {
+    case UnaryOpcode::uminus:
+      for (int k = 0; k < n; k++)
+        value[k] = -arg[k];
+      return;
+    case UnaryOpcode::exp:
+      for (int k = 0; k < n; k++)
+        value[k] = exp(arg[k]);
+      return;
+    case UnaryOpcode::log:
+      for (int k = 0; k < n; k++)
+        value[k] = log(arg[k]);
+      return;
+    default:
+      for (int k = 0; k < n; k++)
+        if (status[k] == Status::ok)
+          try
+            {
+              value[k] = UnaryOpNode::eval_opcode(op_code, arg[k]);
+            }
+          catch (ExprNode::EvalExternalFunctionException &e)
+            {
+              status[k] = Status::externalFunction;
+            }
+          catch (ExprNode::EvalException &e)
+            {
+              status[k] = Status::error;
+            }
+    }
+}
+
+void
+EvalTape::evalBinary(BinaryOpcode op_code, int derivOrder, const double *arg1, const double *arg2,
+                     double *value, Status *status, int n)
+{
+  switch (op_code)
+    {
+    case BinaryOpcode::plus:
+      for (int k = 0; k < n; k++)
+        value[k] = arg1[k] + arg2[k];
+      return;
+    case BinaryOpcode::minus:
+      for (int k = 0; k < n; k++)
+        value[k] = arg1[k] - arg2[k];
+      return;
+    case BinaryOpcode::times:
+      for (int k = 0; k < n; k++)
+        value[k] = arg1[k] * arg2[k];
+      return;
+    case BinaryOpcode::divide:
+      for (int k = 0; k < n; k++)
+        value[k] = arg1[k] / arg2[k];
+      return;
+    case BinaryOpcode::power:
+      for (int k = 0; k < n; k++)
+        value[k] = pow(arg1[k], arg2[k]);
+      return;
+    default:
+      for (int k = 0; k < n; k++)
+        if (status[k] == Status::ok)
+          try
+            {
+              value[k] = BinaryOpNode::eval_opcode(arg1[k], op_code, arg2[k], derivOrder);
+            }
+          catch (ExprNode::EvalExternalFunctionException &e)
+            {
+              status[k] = Status::externalFunction;
+            }
+          catch (ExprNode::EvalException &e)
+            {
+              status[k] = Status::error;
+            }
+    }
+}
+
+void
+EvalTape::evalTrinary(TrinaryOpcode op_code, const double *arg1, const double *arg2, const double *arg3,
+                      double *value, Status *status, int n)
+{
+  for (int k = 0; k < n; k++)
+    if (status[k] == Status::ok)
+      try
+        {
+          value[k] = TrinaryOpNode::eval_opcode(arg1[k], op_code, arg2[k], arg3[k]);
+        }
+      catch (ExprNode::EvalExternalFunctionException &e)
+        {
+          status[k] = Status::externalFunction;
+        }
+      catch (ExprNode::EvalException &e)
+        {
+          status[k] = Status::error;
+        }
+}
+
+void
+EvalTape::eval(const DenseEvalContext &context, vector<double> &values, vector<Status> &status) const
+{
+  int n = context.npoints;
+  int nsymbols = n > 0 ? context.values.size() / n : 0;
+  values.assign(instructions.size() * n, 0);
+  status.assign(instructions.size() * n, Status::ok);
+
+  for (int i = 0; i < (int) instructions.size(); i++)
+    {
+      const Instruction &ins = instructions[i];
+      double *value = values.data() + i * n;
+      Status *st = status.data() + i * n;
+      switch (ins.type)
+        {
+        case InstructionType::constant:
+          fill(value, value + n, ins.value);
+          break;
+        case InstructionType::variable:
+          if (ins.op < nsymbols)
+            for (int k = 0; k < n; k++)
+              {
+                value[k] = context.values[ins.op * n + k];
+                if (!context.known[ins.op * n + k])
+                  st[k] = Status::error;
+              }
+          else
+            fill(st, st + n, Status::error);
+          break;
+        case InstructionType::failure:
+          fill(st, st + n, static_cast<Status>(ins.op));
+          break;
+        default:
+          // As in eval(), the first failing argument determines the failure
+          for (int arg : { ins.arg1, ins.arg2, ins.arg3 })
+            if (arg >= 0)
+              for (int k = 0; k < n; k++)
+                if (st[k] == Status::ok)
+                  st[k] = status[arg * n + k];
+
+          if (ins.type == InstructionType::unary)
+            evalUnary(static_cast<UnaryOpcode>(ins.op), values.data() + ins.arg1 * n, value, st, n);
+          else if (ins.type == InstructionType::binary)
+            evalBinary(static_cast<BinaryOpcode>(ins.op), static_cast<int>(ins.value),
+                       values.data() + ins.arg1 * n, values.data() + ins.arg2 * n, value, st, n);
+          else
+            evalTrinary(static_cast<TrinaryOpcode>(ins.op), values.data() + ins.arg1 * n,
+                        values.data() + ins.arg2 * n, values.data() + ins.arg3 * n, value, st, n);
+        }
+    }
+}
 
 ExprNode::ExprNode(DataTree &datatree_arg, int idx_arg) : datatree{datatree_arg}, idx{idx_arg}, preparedForDerivation{false}
 {
@@ -44,20 +382,76 @@ ExprNode::getDerivative(int deriv_id)
     prepareForDerivation();
 
   // Return zero if derivative is necessarily null (using symbolic a priori)
-  auto it = non_null_derivatives.find(deriv_id);
-  if (it == non_null_derivatives.end())
+  auto it = lower_bound(non_null_derivatives.begin(), non_null_derivatives.end(), deriv_id);
+  if (it == non_null_derivatives.end() || *it != deriv_id)
     return datatree.Zero;
 
   // If derivative is stored in cache, use the cached value, otherwise compute it (and cache it)
-  map<int, expr_t>::const_iterator it2 = derivatives.find(deriv_id);
-  if (it2 != derivatives.end())
-    return it2->second;
-  else
+  if (derivatives.empty())
+    derivatives.resize(non_null_derivatives.size(), nullptr);
+  int pos = it - non_null_derivatives.begin();
+  if (!derivatives[pos])
+    derivatives[pos] = computeDerivative(deriv_id);
+  return derivatives[pos];
+}
+
+vector<pair<expr_t, expr_t>>
+ExprNode::getArgumentsPartialDerivatives()
+{
+  return {};
+}
+
+int
+ExprNode::addToEvalTape(EvalTape &tape) const
+{
+  int pos = tape.find(idx);
+  if (pos >= 0)
+    return pos;
+  // By default, evaluation fails as in eval()
+  return tape.addFailure(idx, EvalTape::Status::error);
+}
+
+uint32_t
+ExprNode::addToRegisterCode(FlatRegisterCode &code, bool steady_state) const
+{
+  // By default, the node has no equivalent in the instruction set
+  code.unsupported = true;
+  return 0;
+}
+
+void
+ExprNode::unionNonNullDerivatives(const vector<expr_t> &args)
+{
+  non_null_derivatives.clear();
+  vector<int> tmp;
+  for (auto arg : args)
     {
-      expr_t d = computeDerivative(deriv_id);
-      derivatives[deriv_id] = d;
-      return d;
+      tmp.clear();
+      tmp.reserve(non_null_derivatives.size() + arg->non_null_derivatives.size());
+      set_union(non_null_derivatives.begin(), non_null_derivatives.end(),
+                arg->non_null_derivatives.begin(), arg->non_null_derivatives.end(),
+                back_inserter(tmp));
+      non_null_derivatives.swap(tmp);
     }
+  non_null_derivatives.shrink_to_fit();
+}
+
+expr_t
+ExprNode::cloneShared(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const
+{
+  auto it = cloned.find(const_cast<ExprNode *>(this));
+  if (it != cloned.end())
+    return it->second;
+
+  expr_t r = cloneSharedInternal(alt_datatree, cloned);
+  cloned[const_cast<ExprNode *>(this)] = r;
+  return r;
+}
+
+expr_t
+ExprNode::cloneSharedInternal(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const
+{
+  return cloneDynamic(alt_datatree);
 }
 
 int
@@ -95,6 +489,13 @@ ExprNode::cost(const map<NodeTreeReference, temporary_terms_t> &temp_terms_map,
   return 0;
 }
 
+int
+ExprNode::cost(const temporary_terms_t &temporary_terms, map<expr_t, int> &definition_costs, bool is_matlab) const
+{
+  // For a terminal node, the cost is null
+  return 0;
+}
+
 bool
 ExprNode::checkIfTemporaryTermThenWrite(ostream &output, ExprNodeOutputType output_type,
                                         const temporary_terms_t &temporary_terms,
@@ -107,16 +508,22 @@ ExprNode::checkIfTemporaryTermThenWrite(ostream &output, ExprNodeOutputType outp
   if (output_type == ExprNodeOutputType::matlabDynamicModelSparse)
     output << "T" << idx << "(it_)";
   else
-    if (output_type == ExprNodeOutputType::matlabStaticModelSparse || isCOutput(output_type))
+    if (output_type == ExprNodeOutputType::matlabStaticModelSparse
+        || (isCOutput(output_type)
+            && temporary_terms_idxs.find(const_cast<ExprNode *>(this)) == temporary_terms_idxs.end()))
       output << "T" << idx;
     else
       {
+        // In C, temporary terms which have an index are stored in the T buffer
         auto it2 = temporary_terms_idxs.find(const_cast<ExprNode *>(this));
         // It is the responsibility of the caller to ensure that all temporary terms have their index
         assert(it2 != temporary_terms_idxs.end());
-        output << "T" << LEFT_ARRAY_SUBSCRIPT(output_type)
-               << it2->second + ARRAY_SUBSCRIPT_OFFSET(output_type)
-               << RIGHT_ARRAY_SUBSCRIPT(output_type);
+        if (isCBatchOutput(output_type))
+          output << "T[" << it2->second << "*n+i]";
+        else
+          output << "T" << LEFT_ARRAY_SUBSCRIPT(output_type)
+                 << it2->second + ARRAY_SUBSCRIPT_OFFSET(output_type)
+                 << RIGHT_ARRAY_SUBSCRIPT(output_type);
       }
   return true;
 }
@@ -156,6 +563,13 @@ ExprNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference>> &refer
   // Nothing to do for a terminal node
 }
 
+void
+ExprNode::computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                                NodeTreeReference tr) const
+{
+  // Nothing to do for a terminal node
+}
+
 void
 ExprNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
                                 temporary_terms_t &temporary_terms,
@@ -386,6 +800,36 @@ NumConstNode::eval(const eval_context_t &eval_context) const noexcept(false)
   return (datatree.num_constants.getDouble(id));
 }
 
+int
+NumConstNode::addToEvalTape(EvalTape &tape) const
+{
+  int pos = tape.find(idx);
+  if (pos >= 0)
+    return pos;
+  return tape.addConstant(idx, datatree.num_constants.getDouble(id));
+}
+
+uint32_t
+NumConstNode::addToRegisterCode(FlatRegisterCode &code, bool steady_state) const
+{
+  // A constant has the same value inside and outside STEADY_STATE
+  int reg = code.find(idx, false);
+  if (reg >= 0)
+    return reg;
+  return code.setRegister(idx, false, code.addConstant(datatree.num_constants.getDouble(id)));
+}
+
+int
+NumConstNode::addToStructuralHash(StructuralHash &hash) const
+{
+  int pos = hash.find(idx);
+  if (pos >= 0)
+    return pos;
+  pos = hash.addRecord(idx, StructuralHash::NodeKind::constant);
+  hash.update(datatree.num_constants.get(id));
+  return pos;
+}
+
 void
 NumConstNode::compile(ostream &CompileCode, unsigned int &instruction_number,
                       bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -740,7 +1184,7 @@ VariableNode::prepareForDerivation()
     case SymbolType::trend:
     case SymbolType::logTrend:
       // For a variable or a parameter, the only non-null derivative is with respect to itself
-      non_null_derivatives.insert(datatree.getDerivID(symb_id, lag));
+      non_null_derivatives.push_back(datatree.getDerivID(symb_id, lag));
       break;
     case SymbolType::modelLocalVariable:
       datatree.getLocalVariable(symb_id)->prepareForDerivation();
@@ -935,7 +1379,8 @@ VariableNode::writeOutput(ostream &output, ExprNodeOutputType output_type,
     case SymbolType::modelLocalVariable:
       if (output_type == ExprNodeOutputType::matlabDynamicModelSparse || output_type == ExprNodeOutputType::matlabStaticModelSparse
           || output_type == ExprNodeOutputType::matlabDynamicSteadyStateOperator || output_type == ExprNodeOutputType::matlabDynamicSparseSteadyStateOperator
-          || output_type == ExprNodeOutputType::CDynamicSteadyStateOperator)
+          || output_type == ExprNodeOutputType::CDynamicSteadyStateOperator
+          || output_type == ExprNodeOutputType::CDynamicBatchSteadyStateOperator)
         {
           output << "(";
           datatree.getLocalVariable(symb_id)->writeOutput(output, output_type, temporary_terms, temporary_terms_idxs, tef_terms);
@@ -960,6 +1405,9 @@ VariableNode::writeOutput(ostream &output, ExprNodeOutputType output_type,
           i = datatree.getDynJacobianCol(datatree.getDerivID(symb_id, lag)) + ARRAY_SUBSCRIPT_OFFSET(output_type);
           output <<  "y" << LEFT_ARRAY_SUBSCRIPT(output_type) << i << RIGHT_ARRAY_SUBSCRIPT(output_type);
           break;
+        case ExprNodeOutputType::CDynamicModelBatch:
+          output << "y[" << datatree.getDynJacobianCol(datatree.getDerivID(symb_id, lag)) << "*n+i]";
+          break;
         case ExprNodeOutputType::CStaticModel:
         case ExprNodeOutputType::juliaStaticModel:
         case ExprNodeOutputType::matlabStaticModel:
@@ -985,6 +1433,7 @@ VariableNode::writeOutput(ostream &output, ExprNodeOutputType output_type,
           output << "steady_state" << LEFT_ARRAY_SUBSCRIPT(output_type) << tsid + 1 << RIGHT_ARRAY_SUBSCRIPT(output_type);
           break;
         case ExprNodeOutputType::CDynamicSteadyStateOperator:
+        case ExprNodeOutputType::CDynamicBatchSteadyStateOperator:
           output << "steady_state[" << tsid << "]";
           break;
         case ExprNodeOutputType::juliaSteadyStateFile:
@@ -1034,6 +1483,14 @@ VariableNode::writeOutput(ostream &output, ExprNodeOutputType output_type,
           else
             output <<  "x[it_" << lag << "+" << i << "*nb_row_x]";
           break;
+        case ExprNodeOutputType::CDynamicModelBatch:
+          if (lag == 0)
+            output <<  "x[(it_+" << i << "*nb_row_x)*n+i]";
+          else if (lag > 0)
+            output <<  "x[(it_+" << lag << "+" << i << "*nb_row_x)*n+i]";
+          else
+            output <<  "x[(it_" << lag << "+" << i << "*nb_row_x)*n+i]";
+          break;
         case ExprNodeOutputType::CStaticModel:
         case ExprNodeOutputType::juliaStaticModel:
         case ExprNodeOutputType::matlabStaticModel:
@@ -1094,6 +1551,14 @@ VariableNode::writeOutput(ostream &output, ExprNodeOutputType output_type,
           else
             output <<  "x[it_" << lag << "+" << i << "*nb_row_x]";
           break;
+        case ExprNodeOutputType::CDynamicModelBatch:
+          if (lag == 0)
+            output <<  "x[(it_+" << i << "*nb_row_x)*n+i]";
+          else if (lag > 0)
+            output <<  "x[(it_+" << lag << "+" << i << "*nb_row_x)*n+i]";
+          else
+            output <<  "x[(it_" << lag << "+" << i << "*nb_row_x)*n+i]";
+          break;
         case ExprNodeOutputType::CStaticModel:
         case ExprNodeOutputType::juliaStaticModel:
         case ExprNodeOutputType::matlabStaticModel:
@@ -1173,6 +1638,60 @@ VariableNode::eval(const eval_context_t &eval_context) const noexcept(false)
   return it->second;
 }
 
+int
+VariableNode::addToEvalTape(EvalTape &tape) const
+{
+  int pos = tape.find(idx);
+  if (pos >= 0)
+    return pos;
+  return tape.addVariable(idx, symb_id);
+}
+
+uint32_t
+VariableNode::addToRegisterCode(FlatRegisterCode &code, bool steady_state) const
+{
+  int reg = code.find(idx, steady_state);
+  if (reg >= 0)
+    return reg;
+  switch (type)
+    {
+    case SymbolType::modelLocalVariable:
+    case SymbolType::modFileLocalVariable:
+      return code.setRegister(idx, steady_state, datatree.getLocalVariable(symb_id)->addToRegisterCode(code, steady_state));
+    case SymbolType::endogenous:
+    case SymbolType::exogenous:
+    case SymbolType::exogenousDet:
+    case SymbolType::parameter:
+      {
+        int tsid = datatree.symbol_table.getTypeSpecificID(symb_id);
+        if (type == SymbolType::exogenousDet)
+          tsid += datatree.symbol_table.exo_nbr();
+        return code.setRegister(idx, steady_state, code.addLoad(type, tsid, lag, steady_state));
+      }
+    default:
+      code.unsupported = true;
+      return 0;
+    }
+}
+
+int
+VariableNode::addToStructuralHash(StructuralHash &hash) const
+{
+  int pos = hash.find(idx);
+  if (pos >= 0)
+    return pos;
+  // The definition of a local variable is part of the structure of the expressions using it
+  int def = -1;
+  if (type == SymbolType::modelLocalVariable || type == SymbolType::modFileLocalVariable)
+    def = datatree.getLocalVariable(symb_id)->addToStructuralHash(hash);
+  pos = hash.addRecord(idx, StructuralHash::NodeKind::variable);
+  hash.update(static_cast<int64_t>(type));
+  hash.update(symb_id);
+  hash.update(lag);
+  hash.update(def);
+  return pos;
+}
+
 void
 VariableNode::compile(ostream &CompileCode, unsigned int &instruction_number,
                       bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -1331,8 +1850,8 @@ VariableNode::getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recur
           auto it = recursive_variables.find(datatree.getDerivID(symb_id, lag));
           if (it != recursive_variables.end())
             {
-              map<int, expr_t>::const_iterator it2 = derivatives.find(deriv_id);
-              if (it2 != derivatives.end())
+              auto it2 = chain_rule_derivatives.find(deriv_id);
+              if (it2 != chain_rule_derivatives.end())
                 return it2->second;
               else
                 {
@@ -1341,7 +1860,7 @@ VariableNode::getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recur
                   //expr_t c = datatree.AddNonNegativeConstant("1");
                   expr_t d = datatree.AddUMinus(it->second->getChainRuleDerivative(deriv_id, recursive_vars2));
                   //d = datatree.AddTimes(c, d);
-                  derivatives[deriv_id] = d;
+                  chain_rule_derivatives[deriv_id] = d;
                   return d;
                 }
             }
@@ -1371,6 +1890,14 @@ VariableNode::getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recur
   exit(EXIT_FAILURE);
 }
 
+vector<pair<expr_t, expr_t>>
+VariableNode::getArgumentsPartialDerivatives()
+{
+  if (get_type() == SymbolType::modelLocalVariable)
+    return { { datatree.getLocalVariable(symb_id), datatree.One } };
+  return {};
+}
+
 expr_t
 VariableNode::toStatic(DataTree &static_datatree) const
 {
@@ -2036,7 +2563,11 @@ UnaryOpNode::prepareForDerivation()
   non_null_derivatives = arg->non_null_derivatives;
   if (op_code == UnaryOpcode::steadyState || op_code == UnaryOpcode::steadyStateParamDeriv
       || op_code == UnaryOpcode::steadyStateParam2ndDeriv)
-    datatree.addAllParamDerivId(non_null_derivatives);
+    {
+      set<int> deriv_id_set(non_null_derivatives.begin(), non_null_derivatives.end());
+      datatree.addAllParamDerivId(deriv_id_set);
+      non_null_derivatives.assign(deriv_id_set.begin(), deriv_id_set.end());
+    }
 }
 
 expr_t
@@ -2204,9 +2735,27 @@ UnaryOpNode::cost(const temporary_terms_t &temporary_terms, bool is_matlab) cons
   return cost(arg->cost(temporary_terms, is_matlab), is_matlab);
 }
 
+int
+UnaryOpNode::cost(const temporary_terms_t &temporary_terms, map<expr_t, int> &definition_costs, bool is_matlab) const
+{
+  expr_t this2 = const_cast<UnaryOpNode *>(this);
+  auto it = definition_costs.find(this2);
+  if (it == definition_costs.end())
+    it = definition_costs.emplace(this2, cost(arg->cost(temporary_terms, definition_costs, is_matlab), is_matlab)).first;
+
+  // For a temporary term, the cost is null
+  if (temporary_terms.find(this2) != temporary_terms.end())
+    return 0;
+  return it->second;
+}
+
 int
 UnaryOpNode::cost(int cost, bool is_matlab) const
 {
+  auto it = datatree.operator_costs.unary[is_matlab].find(op_code);
+  if (it != datatree.operator_costs.unary[is_matlab].end())
+    return cost + it->second;
+
   if (is_matlab)
     // Cost for Matlab files
     switch (op_code)
@@ -2330,6 +2879,21 @@ UnaryOpNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference>> &re
     }
 }
 
+void
+UnaryOpNode::computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                                   NodeTreeReference tr) const
+{
+  expr_t this2 = const_cast<UnaryOpNode *>(this);
+  auto it = reference_count.find(this2);
+  if (it == reference_count.end())
+    {
+      reference_count[this2] = { 1, tr };
+      arg->computeReferenceCount(reference_count, tr);
+    }
+  else
+    it->second.first++;
+}
+
 void
 UnaryOpNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
                                    temporary_terms_t &temporary_terms,
@@ -2708,7 +3272,8 @@ UnaryOpNode::writeOutput(ostream &output, ExprNodeOutputType output_type,
       output << "abs";
       break;
     case UnaryOpcode::sign:
-      if (output_type == ExprNodeOutputType::CDynamicModel || output_type == ExprNodeOutputType::CStaticModel)
+      if (output_type == ExprNodeOutputType::CDynamicModel || output_type == ExprNodeOutputType::CStaticModel
+          || output_type == ExprNodeOutputType::CDynamicModelBatch)
         output << "copysign";
       else
         output << "sign";
@@ -2726,6 +3291,9 @@ UnaryOpNode::writeOutput(ostream &output, ExprNodeOutputType output_type,
         case ExprNodeOutputType::CDynamicModel:
           new_output_type = ExprNodeOutputType::CDynamicSteadyStateOperator;
           break;
+        case ExprNodeOutputType::CDynamicModelBatch:
+          new_output_type = ExprNodeOutputType::CDynamicBatchSteadyStateOperator;
+          break;
         case ExprNodeOutputType::juliaDynamicModel:
           new_output_type = ExprNodeOutputType::juliaDynamicSteadyStateOperator;
           break;
@@ -2804,7 +3372,8 @@ UnaryOpNode::writeOutput(ostream &output, ExprNodeOutputType output_type,
           && arg->precedence(output_type, temporary_terms) < precedence(output_type, temporary_terms)))
     {
       output << LEFT_PAR(output_type);
-      if (op_code == UnaryOpcode::sign && (output_type == ExprNodeOutputType::CDynamicModel || output_type == ExprNodeOutputType::CStaticModel))
+      if (op_code == UnaryOpcode::sign && (output_type == ExprNodeOutputType::CDynamicModel || output_type == ExprNodeOutputType::CStaticModel
+                                           || output_type == ExprNodeOutputType::CDynamicModelBatch))
         output << "1.0,";
       close_parenthesis = true;
     }
@@ -2917,6 +3486,58 @@ UnaryOpNode::eval(const eval_context_t &eval_context) const noexcept(false)
   return eval_opcode(op_code, v);
 }
 
+int
+UnaryOpNode::addToEvalTape(EvalTape &tape) const
+{
+  int pos = tape.find(idx);
+  if (pos >= 0)
+    return pos;
+  int a = arg->addToEvalTape(tape);
+  return tape.addUnary(idx, op_code, a);
+}
+
+uint32_t
+UnaryOpNode::addToRegisterCode(FlatRegisterCode &code, bool steady_state) const
+{
+  int reg = code.find(idx, steady_state);
+  if (reg >= 0)
+    return reg;
+  switch (op_code)
+    {
+    case UnaryOpcode::steadyState:
+      return code.setRegister(idx, steady_state, arg->addToRegisterCode(code, true));
+    case UnaryOpcode::steadyStateParamDeriv:
+    case UnaryOpcode::steadyStateParam2ndDeriv:
+    case UnaryOpcode::expectation:
+    case UnaryOpcode::diff:
+    case UnaryOpcode::adl:
+      code.unsupported = true;
+      return 0;
+    default:
+      return code.setRegister(idx, steady_state, code.addUnary(op_code, arg->addToRegisterCode(code, steady_state)));
+    }
+}
+
+int
+UnaryOpNode::addToStructuralHash(StructuralHash &hash) const
+{
+  int pos = hash.find(idx);
+  if (pos >= 0)
+    return pos;
+  int a = arg->addToStructuralHash(hash);
+  pos = hash.addRecord(idx, StructuralHash::NodeKind::unary);
+  hash.update(static_cast<int64_t>(op_code));
+  hash.update(a);
+  hash.update(expectation_information_set);
+  hash.update(param1_symb_id);
+  hash.update(param2_symb_id);
+  hash.update(adl_param_name);
+  hash.update(adl_lags.size());
+  for (auto lag : adl_lags)
+    hash.update(lag);
+  return pos;
+}
+
 void
 UnaryOpNode::compile(ostream &CompileCode, unsigned int &instruction_number,
                      bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -3107,6 +3728,26 @@ UnaryOpNode::getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recurs
   return composeDerivatives(darg, deriv_id);
 }
 
+vector<pair<expr_t, expr_t>>
+UnaryOpNode::getArgumentsPartialDerivatives()
+{
+  switch (op_code)
+    {
+    case UnaryOpcode::steadyState:
+      if (datatree.isDynamic())
+        return {};
+      break;
+    case UnaryOpcode::steadyStateParamDeriv:
+    case UnaryOpcode::steadyStateParam2ndDeriv:
+      cerr << "UnaryOpNode::getArgumentsPartialDerivatives: not implemented on derivatives of STEADY_STATE" << endl;
+      exit(EXIT_FAILURE);
+    default:
+      break;
+    }
+  // The derivation ID is only used for STEADY_STATE in a dynamic model
+  return { { arg, composeDerivatives(datatree.One, -1) } };
+}
+
 expr_t
 UnaryOpNode::buildSimilarUnaryOpNode(expr_t alt_arg, DataTree &alt_datatree) const
 {
@@ -3191,6 +3832,21 @@ UnaryOpNode::cloneDynamic(DataTree &dynamic_datatree) const
   return buildSimilarUnaryOpNode(substarg, dynamic_datatree);
 }
 
+expr_t
+UnaryOpNode::cloneSharedInternal(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const
+{
+  expr_t substarg = arg->cloneShared(alt_datatree, cloned);
+  switch (op_code)
+    {
+    case UnaryOpcode::steadyStateParamDeriv:
+      return alt_datatree.AddSteadyStateParamDeriv(substarg, param1_symb_id);
+    case UnaryOpcode::steadyStateParam2ndDeriv:
+      return alt_datatree.AddSteadyStateParam2ndDeriv(substarg, param1_symb_id, param2_symb_id);
+    default:
+      return buildSimilarUnaryOpNode(substarg, alt_datatree);
+    }
+}
+
 int
 UnaryOpNode::maxEndoLead() const
 {
@@ -3783,12 +4439,7 @@ BinaryOpNode::prepareForDerivation()
   arg2->prepareForDerivation();
 
   // Non-null derivatives are the union of those of the arguments
-  // Compute set union of arg1->non_null_derivatives and arg2->non_null_derivatives
-  set_union(arg1->non_null_derivatives.begin(),
-            arg1->non_null_derivatives.end(),
-            arg2->non_null_derivatives.begin(),
-            arg2->non_null_derivatives.end(),
-            inserter(non_null_derivatives, non_null_derivatives.begin()));
+  unionNonNullDerivatives({ arg1, arg2 });
 }
 
 expr_t
@@ -4035,9 +4686,31 @@ BinaryOpNode::cost(const temporary_terms_t &temporary_terms, bool is_matlab) con
   return cost(arg_cost, is_matlab);
 }
 
+int
+BinaryOpNode::cost(const temporary_terms_t &temporary_terms, map<expr_t, int> &definition_costs, bool is_matlab) const
+{
+  expr_t this2 = const_cast<BinaryOpNode *>(this);
+  auto it = definition_costs.find(this2);
+  if (it == definition_costs.end())
+    {
+      int arg_cost = arg1->cost(temporary_terms, definition_costs, is_matlab)
+        + arg2->cost(temporary_terms, definition_costs, is_matlab);
+      it = definition_costs.emplace(this2, cost(arg_cost, is_matlab)).first;
+    }
+
+  // For a temporary term, the cost is null
+  if (temporary_terms.find(this2) != temporary_terms.end())
+    return 0;
+  return it->second;
+}
+
 int
 BinaryOpNode::cost(int cost, bool is_matlab) const
 {
+  auto it = datatree.operator_costs.binary[is_matlab].find(op_code);
+  if (it != datatree.operator_costs.binary[is_matlab].end())
+    return cost + it->second;
+
   if (is_matlab)
     // Cost for Matlab files
     switch (op_code)
@@ -4122,6 +4795,22 @@ BinaryOpNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference>> &r
     }
 }
 
+void
+BinaryOpNode::computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                                    NodeTreeReference tr) const
+{
+  expr_t this2 = const_cast<BinaryOpNode *>(this);
+  auto it = reference_count.find(this2);
+  if (it == reference_count.end())
+    {
+      reference_count[this2] = { 1, tr };
+      arg1->computeReferenceCount(reference_count, tr);
+      arg2->computeReferenceCount(reference_count, tr);
+    }
+  else
+    it->second.first++;
+}
+
 void
 BinaryOpNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
                                     temporary_terms_t &temporary_terms,
@@ -4216,6 +4905,139 @@ BinaryOpNode::eval(const eval_context_t &eval_context) const noexcept(false)
   return eval_opcode(v1, op_code, v2, powerDerivOrder);
 }
 
+int
+BinaryOpNode::addToEvalTape(EvalTape &tape) const
+{
+  int pos = tape.find(idx);
+  if (pos >= 0)
+    return pos;
+  int a1 = arg1->addToEvalTape(tape);
+  int a2 = arg2->addToEvalTape(tape);
+  return tape.addBinary(idx, op_code, a1, a2, powerDerivOrder);
+}
+
+pair<const VariableNode *, const VariableNode *>
+BinaryOpNode::matchParameterTimesVariable() const
+{
+  if (op_code != BinaryOpcode::times)
+    return { nullptr, nullptr };
+  const VariableNode *param = dynamic_cast<VariableNode *>(arg1);
+  const VariableNode *var = dynamic_cast<VariableNode *>(arg2);
+  if (!param || !var)
+    return { nullptr, nullptr };
+  if (var->get_type() == SymbolType::parameter)
+    swap(param, var);
+  if (param->get_type() != SymbolType::parameter
+      || (var->get_type() != SymbolType::endogenous && var->get_type() != SymbolType::exogenous
+          && var->get_type() != SymbolType::exogenousDet))
+    return { nullptr, nullptr };
+  return { param, var };
+}
+
+uint32_t
+BinaryOpNode::addToRegisterCode(FlatRegisterCode &code, bool steady_state) const
+{
+  int reg = code.find(idx, steady_state);
+  if (reg >= 0)
+    return reg;
+
+  // Fused instructions, chosen from the shape of the node
+  switch (op_code)
+    {
+    case BinaryOpcode::times:
+      if (!steady_state)
+        {
+          auto match = matchParameterTimesVariable();
+          if (match.first)
+            {
+              const VariableNode *param = match.first, *var = match.second;
+              int tsid = datatree.symbol_table.getTypeSpecificID(var->get_symb_id());
+              if (var->get_type() == SymbolType::exogenousDet)
+                tsid += datatree.symbol_table.exo_nbr();
+              return code.setRegister(idx, steady_state,
+                                      code.addParameterTimesVariable(datatree.symbol_table.getTypeSpecificID(param->get_symb_id()),
+                                                                     var->get_type(), tsid, var->get_lag()));
+            }
+        }
+      break;
+    case BinaryOpcode::plus:
+      {
+        // A product not yet computed, which is not better handled by parameterTimesVariable
+        auto isFusableProduct = [&](expr_t e)
+          {
+            auto product = dynamic_cast<BinaryOpNode *>(e);
+            return product && product->op_code == BinaryOpcode::times
+              && code.find(product->idx, steady_state) < 0
+              && (steady_state || !product->matchParameterTimesVariable().first);
+          };
+        expr_t product = nullptr, addend = nullptr;
+        if (isFusableProduct(arg1))
+          {
+            product = arg1;
+            addend = arg2;
+          }
+        else if (isFusableProduct(arg2))
+          {
+            product = arg2;
+            addend = arg1;
+          }
+        if (product)
+          {
+            auto product_node = dynamic_cast<BinaryOpNode *>(product);
+            uint32_t a1 = product_node->arg1->addToRegisterCode(code, steady_state);
+            uint32_t a2 = product_node->arg2->addToRegisterCode(code, steady_state);
+            uint32_t a3 = addend->addToRegisterCode(code, steady_state);
+            return code.setRegister(idx, steady_state, code.addMultiplyAdd(a1, a2, a3));
+          }
+      }
+      break;
+    case BinaryOpcode::power:
+      {
+        auto exponent = dynamic_cast<NumConstNode *>(arg2);
+        if (exponent)
+          {
+            /* Only the exponents for which the multiplications give the same
+               result as pow() (which is correctly rounded), since a product
+               of more than two factors rounds differently */
+            double value = datatree.num_constants.getDouble(exponent->get_id());
+            if (value == 2 || value == -1)
+              return code.setRegister(idx, steady_state,
+                                      code.addPowerInteger(arg1->addToRegisterCode(code, steady_state),
+                                                           static_cast<int>(value)));
+          }
+      }
+      break;
+    case BinaryOpcode::equal:
+      code.unsupported = true;
+      return 0;
+    default:
+      break;
+    }
+
+  uint32_t a1 = arg1->addToRegisterCode(code, steady_state);
+  uint32_t a2 = arg2->addToRegisterCode(code, steady_state);
+  if (op_code == BinaryOpcode::powerDeriv)
+    return code.setRegister(idx, steady_state, code.addPowerDeriv(a1, a2, powerDerivOrder));
+  return code.setRegister(idx, steady_state, code.addBinary(op_code, a1, a2));
+}
+
+int
+BinaryOpNode::addToStructuralHash(StructuralHash &hash) const
+{
+  int pos = hash.find(idx);
+  if (pos >= 0)
+    return pos;
+  int a1 = arg1->addToStructuralHash(hash);
+  int a2 = arg2->addToStructuralHash(hash);
+  pos = hash.addRecord(idx, StructuralHash::NodeKind::binary);
+  hash.update(static_cast<int64_t>(op_code));
+  hash.update(a1);
+  hash.update(a2);
+  hash.update(powerDerivOrder);
+  hash.update(adlparam);
+  return pos;
+}
+
 void
 BinaryOpNode::compile(ostream &CompileCode, unsigned int &instruction_number,
                       bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -4993,6 +5815,13 @@ BinaryOpNode::getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recur
   return composeDerivatives(darg1, darg2);
 }
 
+vector<pair<expr_t, expr_t>>
+BinaryOpNode::getArgumentsPartialDerivatives()
+{
+  return { { arg1, composeDerivatives(datatree.One, datatree.Zero) },
+           { arg2, composeDerivatives(datatree.Zero, datatree.One) } };
+}
+
 expr_t
 BinaryOpNode::buildSimilarBinaryOpNode(expr_t alt_arg1, expr_t alt_arg2, DataTree &alt_datatree) const
 {
@@ -5056,6 +5885,14 @@ BinaryOpNode::cloneDynamic(DataTree &dynamic_datatree) const
   return buildSimilarBinaryOpNode(substarg1, substarg2, dynamic_datatree);
 }
 
+expr_t
+BinaryOpNode::cloneSharedInternal(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const
+{
+  expr_t substarg1 = arg1->cloneShared(alt_datatree, cloned);
+  expr_t substarg2 = arg2->cloneShared(alt_datatree, cloned);
+  return buildSimilarBinaryOpNode(substarg1, substarg2, alt_datatree);
+}
+
 int
 BinaryOpNode::maxEndoLead() const
 {
@@ -5885,18 +6722,7 @@ TrinaryOpNode::prepareForDerivation()
   arg3->prepareForDerivation();
 
   // Non-null derivatives are the union of those of the arguments
-  // Compute set union of arg{1,2,3}->non_null_derivatives
-  set<int> non_null_derivatives_tmp;
-  set_union(arg1->non_null_derivatives.begin(),
-            arg1->non_null_derivatives.end(),
-            arg2->non_null_derivatives.begin(),
-            arg2->non_null_derivatives.end(),
-            inserter(non_null_derivatives_tmp, non_null_derivatives_tmp.begin()));
-  set_union(non_null_derivatives_tmp.begin(),
-            non_null_derivatives_tmp.end(),
-            arg3->non_null_derivatives.begin(),
-            arg3->non_null_derivatives.end(),
-            inserter(non_null_derivatives, non_null_derivatives.begin()));
+  unionNonNullDerivatives({ arg1, arg2, arg3 });
 }
 
 expr_t
@@ -6023,9 +6849,32 @@ TrinaryOpNode::cost(const temporary_terms_t &temporary_terms, bool is_matlab) co
   return cost(arg_cost, is_matlab);
 }
 
+int
+TrinaryOpNode::cost(const temporary_terms_t &temporary_terms, map<expr_t, int> &definition_costs, bool is_matlab) const
+{
+  expr_t this2 = const_cast<TrinaryOpNode *>(this);
+  auto it = definition_costs.find(this2);
+  if (it == definition_costs.end())
+    {
+      int arg_cost = arg1->cost(temporary_terms, definition_costs, is_matlab)
+        + arg2->cost(temporary_terms, definition_costs, is_matlab)
+        + arg3->cost(temporary_terms, definition_costs, is_matlab);
+      it = definition_costs.emplace(this2, cost(arg_cost, is_matlab)).first;
+    }
+
+  // For a temporary term, the cost is null
+  if (temporary_terms.find(this2) != temporary_terms.end())
+    return 0;
+  return it->second;
+}
+
 int
 TrinaryOpNode::cost(int cost, bool is_matlab) const
 {
+  auto it = datatree.operator_costs.trinary[is_matlab].find(op_code);
+  if (it != datatree.operator_costs.trinary[is_matlab].end())
+    return cost + it->second;
+
   if (is_matlab)
     // Cost for Matlab files
     switch (op_code)
@@ -6072,6 +6921,23 @@ TrinaryOpNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference>> &
     }
 }
 
+void
+TrinaryOpNode::computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                                     NodeTreeReference tr) const
+{
+  expr_t this2 = const_cast<TrinaryOpNode *>(this);
+  auto it = reference_count.find(this2);
+  if (it == reference_count.end())
+    {
+      reference_count[this2] = { 1, tr };
+      arg1->computeReferenceCount(reference_count, tr);
+      arg2->computeReferenceCount(reference_count, tr);
+      arg3->computeReferenceCount(reference_count, tr);
+    }
+  else
+    it->second.first++;
+}
+
 void
 TrinaryOpNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
                                      temporary_terms_t &temporary_terms,
@@ -6125,6 +6991,47 @@ TrinaryOpNode::eval(const eval_context_t &eval_context) const noexcept(false)
   return eval_opcode(v1, op_code, v2, v3);
 }
 
+int
+TrinaryOpNode::addToEvalTape(EvalTape &tape) const
+{
+  int pos = tape.find(idx);
+  if (pos >= 0)
+    return pos;
+  int a1 = arg1->addToEvalTape(tape);
+  int a2 = arg2->addToEvalTape(tape);
+  int a3 = arg3->addToEvalTape(tape);
+  return tape.addTrinary(idx, op_code, a1, a2, a3);
+}
+
+uint32_t
+TrinaryOpNode::addToRegisterCode(FlatRegisterCode &code, bool steady_state) const
+{
+  int reg = code.find(idx, steady_state);
+  if (reg >= 0)
+    return reg;
+  uint32_t a1 = arg1->addToRegisterCode(code, steady_state);
+  uint32_t a2 = arg2->addToRegisterCode(code, steady_state);
+  uint32_t a3 = arg3->addToRegisterCode(code, steady_state);
+  return code.setRegister(idx, steady_state, code.addTrinary(op_code, a1, a2, a3));
+}
+
+int
+TrinaryOpNode::addToStructuralHash(StructuralHash &hash) const
+{
+  int pos = hash.find(idx);
+  if (pos >= 0)
+    return pos;
+  int a1 = arg1->addToStructuralHash(hash);
+  int a2 = arg2->addToStructuralHash(hash);
+  int a3 = arg3->addToStructuralHash(hash);
+  pos = hash.addRecord(idx, StructuralHash::NodeKind::trinary);
+  hash.update(static_cast<int64_t>(op_code));
+  hash.update(a1);
+  hash.update(a2);
+  hash.update(a3);
+  return pos;
+}
+
 void
 TrinaryOpNode::compile(ostream &CompileCode, unsigned int &instruction_number,
                        bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -6373,6 +7280,14 @@ TrinaryOpNode::getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recu
   return composeDerivatives(darg1, darg2, darg3);
 }
 
+vector<pair<expr_t, expr_t>>
+TrinaryOpNode::getArgumentsPartialDerivatives()
+{
+  return { { arg1, composeDerivatives(datatree.One, datatree.Zero, datatree.Zero) },
+           { arg2, composeDerivatives(datatree.Zero, datatree.One, datatree.Zero) },
+           { arg3, composeDerivatives(datatree.Zero, datatree.Zero, datatree.One) } };
+}
+
 expr_t
 TrinaryOpNode::buildSimilarTrinaryOpNode(expr_t alt_arg1, expr_t alt_arg2, expr_t alt_arg3, DataTree &alt_datatree) const
 {
@@ -6413,6 +7328,15 @@ TrinaryOpNode::cloneDynamic(DataTree &dynamic_datatree) const
   return buildSimilarTrinaryOpNode(substarg1, substarg2, substarg3, dynamic_datatree);
 }
 
+expr_t
+TrinaryOpNode::cloneSharedInternal(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const
+{
+  expr_t substarg1 = arg1->cloneShared(alt_datatree, cloned);
+  expr_t substarg2 = arg2->cloneShared(alt_datatree, cloned);
+  expr_t substarg3 = arg3->cloneShared(alt_datatree, cloned);
+  return buildSimilarTrinaryOpNode(substarg1, substarg2, substarg3, alt_datatree);
+}
+
 int
 TrinaryOpNode::maxEndoLead() const
 {
@@ -6819,13 +7743,7 @@ AbstractExternalFunctionNode::prepareForDerivation()
   for (auto argument : arguments)
     argument->prepareForDerivation();
 
-  non_null_derivatives = arguments.at(0)->non_null_derivatives;
-  for (int i = 1; i < (int) arguments.size(); i++)
-    set_union(non_null_derivatives.begin(),
-              non_null_derivatives.end(),
-              arguments.at(i)->non_null_derivatives.begin(),
-              arguments.at(i)->non_null_derivatives.end(),
-              inserter(non_null_derivatives, non_null_derivatives.begin()));
+  unionNonNullDerivatives(arguments);
 
   preparedForDerivation = true;
 }
@@ -6850,6 +7768,20 @@ AbstractExternalFunctionNode::getChainRuleDerivative(int deriv_id, const map<int
   return composeDerivatives(dargs);
 }
 
+vector<pair<expr_t, expr_t>>
+AbstractExternalFunctionNode::getArgumentsPartialDerivatives()
+{
+  vector<pair<expr_t, expr_t>> partials;
+  vector<expr_t> dargs(arguments.size(), datatree.Zero);
+  for (int i = 0; i < (int) arguments.size(); i++)
+    {
+      dargs[i] = datatree.One;
+      partials.emplace_back(arguments[i], composeDerivatives(dargs));
+      dargs[i] = datatree.Zero;
+    }
+  return partials;
+}
+
 unsigned int
 AbstractExternalFunctionNode::compileExternalFunctionArguments(ostream &CompileCode, unsigned int &instruction_number,
                                                                bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -6895,6 +7827,39 @@ AbstractExternalFunctionNode::eval(const eval_context_t &eval_context) const noe
   throw EvalExternalFunctionException();
 }
 
+int
+AbstractExternalFunctionNode::addToEvalTape(EvalTape &tape) const
+{
+  int pos = tape.find(idx);
+  if (pos >= 0)
+    return pos;
+  return tape.addFailure(idx, EvalTape::Status::externalFunction);
+}
+
+int
+AbstractExternalFunctionNode::addExternalFunctionToStructuralHash(StructuralHash &hash, StructuralHash::NodeKind kind,
+                                                                  const vector<int> &input_indices) const
+{
+  int pos = hash.find(idx);
+  if (pos >= 0)
+    return pos;
+  vector<int> args;
+  for (auto argument : arguments)
+    args.push_back(argument->addToStructuralHash(hash));
+  pos = hash.addRecord(idx, kind);
+  hash.update(symb_id);
+  hash.update(datatree.symbol_table.getName(symb_id));
+  hash.update(datatree.external_functions_table.getNargs(symb_id));
+  hash.update(datatree.external_functions_table.getFirstDerivSymbID(symb_id));
+  hash.update(datatree.external_functions_table.getSecondDerivSymbID(symb_id));
+  hash.update(args.size());
+  for (auto arg : args)
+    hash.update(arg);
+  for (auto input_index : input_indices)
+    hash.update(input_index);
+  return pos;
+}
+
 int
 AbstractExternalFunctionNode::maxEndoLead() const
 {
@@ -7187,6 +8152,21 @@ AbstractExternalFunctionNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTr
   temp_terms_map[tr].insert(const_cast<AbstractExternalFunctionNode *>(this));
 }
 
+void
+AbstractExternalFunctionNode::computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                                                    NodeTreeReference tr) const
+{
+  /* External function nodes are always temporary terms (see
+     computeTemporaryTerms()), so only record the first tree in which they
+     appear. As with the other engine, arguments are not traversed. */
+  expr_t this2 = const_cast<AbstractExternalFunctionNode *>(this);
+  auto it = reference_count.find(this2);
+  if (it == reference_count.end())
+    reference_count[this2] = { 1, tr };
+  else
+    it->second.first++;
+}
+
 bool
 AbstractExternalFunctionNode::isNumConstNodeEqualTo(double value) const
 {
@@ -7254,6 +8234,15 @@ AbstractExternalFunctionNode::removeTrendLeadLag(map<int, expr_t> trend_symbols_
   return buildSimilarExternalFunctionNode(arguments_subst, datatree);
 }
 
+expr_t
+AbstractExternalFunctionNode::cloneSharedInternal(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const
+{
+  vector<expr_t> alt_arguments;
+  for (auto argument : arguments)
+    alt_arguments.push_back(argument->cloneShared(alt_datatree, cloned));
+  return buildSimilarExternalFunctionNode(alt_arguments, alt_datatree);
+}
+
 bool
 AbstractExternalFunctionNode::isInStaticForm() const
 {
@@ -7724,6 +8713,12 @@ ExternalFunctionNode::writeJsonExternalFunctionOutput(vector<string> &efout,
     }
 }
 
+int
+ExternalFunctionNode::addToStructuralHash(StructuralHash &hash) const
+{
+  return addExternalFunctionToStructuralHash(hash, StructuralHash::NodeKind::externalFunction, {});
+}
+
 expr_t
 ExternalFunctionNode::toStatic(DataTree &static_datatree) const
 {
@@ -8123,6 +9118,13 @@ FirstDerivExternalFunctionNode::buildSimilarExternalFunctionNode(vector<expr_t>
   return alt_datatree.AddFirstDerivExternalFunction(symb_id, alt_args, inputIndex);
 }
 
+int
+FirstDerivExternalFunctionNode::addToStructuralHash(StructuralHash &hash) const
+{
+  return addExternalFunctionToStructuralHash(hash, StructuralHash::NodeKind::firstDerivExternalFunction,
+                                             { inputIndex });
+}
+
 expr_t
 FirstDerivExternalFunctionNode::toStatic(DataTree &static_datatree) const
 {
@@ -8446,6 +9448,13 @@ SecondDerivExternalFunctionNode::buildSimilarExternalFunctionNode(vector<expr_t>
   return alt_datatree.AddSecondDerivExternalFunction(symb_id, alt_args, inputIndex1, inputIndex2);
 }
 
+int
+SecondDerivExternalFunctionNode::addToStructuralHash(StructuralHash &hash) const
+{
+  return addExternalFunctionToStructuralHash(hash, StructuralHash::NodeKind::secondDerivExternalFunction,
+                                             { inputIndex1, inputIndex2 });
+}
+
 expr_t
 SecondDerivExternalFunctionNode::toStatic(DataTree &static_datatree) const
 {
@@ -8517,6 +9526,14 @@ VarExpectationNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReferenc
   exit(EXIT_FAILURE);
 }
 
+void
+VarExpectationNode::computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                                          NodeTreeReference tr) const
+{
+  cerr << "VarExpectationNode::computeReferenceCount not implemented." << endl;
+  exit(EXIT_FAILURE);
+}
+
 void
 VarExpectationNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
                                           temporary_terms_t &temporary_terms,
@@ -8529,6 +9546,17 @@ VarExpectationNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
   exit(EXIT_FAILURE);
 }
 
+int
+VarExpectationNode::addToStructuralHash(StructuralHash &hash) const
+{
+  int pos = hash.find(idx);
+  if (pos >= 0)
+    return pos;
+  pos = hash.addRecord(idx, StructuralHash::NodeKind::varExpectation);
+  hash.update(model_name);
+  return pos;
+}
+
 expr_t
 VarExpectationNode::toStatic(DataTree &static_datatree) const
 {
@@ -8658,6 +9686,13 @@ VarExpectationNode::getChainRuleDerivative(int deriv_id, const map<int, expr_t>
   exit(EXIT_FAILURE);
 }
 
+vector<pair<expr_t, expr_t>>
+VarExpectationNode::getArgumentsPartialDerivatives()
+{
+  cerr << "VarExpectationNode::getArgumentsPartialDerivatives not implemented." << endl;
+  exit(EXIT_FAILURE);
+}
+
 bool
 VarExpectationNode::containsExternalFunction() const
 {
@@ -8982,6 +10017,19 @@ PacExpectationNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReferenc
   temp_terms_map[tr].insert(const_cast<PacExpectationNode *>(this));
 }
 
+void
+PacExpectationNode::computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                                          NodeTreeReference tr) const
+{
+  // Always a temporary term (see computeTemporaryTerms()), so only record the first tree in which it appears
+  expr_t this2 = const_cast<PacExpectationNode *>(this);
+  auto it = reference_count.find(this2);
+  if (it == reference_count.end())
+    reference_count[this2] = { 1, tr };
+  else
+    it->second.first++;
+}
+
 void
 PacExpectationNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
                                           temporary_terms_t &temporary_terms,
@@ -8996,6 +10044,33 @@ PacExpectationNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
   v_temporary_terms[Curr_block][equation].insert(this2);
 }
 
+int
+PacExpectationNode::addToStructuralHash(StructuralHash &hash) const
+{
+  int pos = hash.find(idx);
+  if (pos >= 0)
+    return pos;
+  pos = hash.addRecord(idx, StructuralHash::NodeKind::pacExpectation);
+  hash.update(model_name);
+  hash.update(var_model_name);
+  hash.update(growth_symb_id);
+  hash.update(lhs.size());
+  for (auto l : lhs)
+    hash.update(l);
+  hash.update(max_lag);
+  hash.update(pac_max_lag);
+  hash.update(h0_indices.size());
+  for (auto i : h0_indices)
+    hash.update(i);
+  hash.update(h1_indices.size());
+  for (auto i : h1_indices)
+    hash.update(i);
+  hash.update(growth_param_index);
+  hash.update(equation_number);
+  hash.update(optim_share_index);
+  return pos;
+}
+
 expr_t
 PacExpectationNode::toStatic(DataTree &static_datatree) const
 {
@@ -9220,6 +10295,13 @@ PacExpectationNode::getChainRuleDerivative(int deriv_id, const map<int, expr_t>
   exit(EXIT_FAILURE);
 }
 
+vector<pair<expr_t, expr_t>>
+PacExpectationNode::getArgumentsPartialDerivatives()
+{
+  cerr << "PacExpectationNode::getArgumentsPartialDerivatives: shouldn't arrive here." << endl;
+  exit(EXIT_FAILURE);
+}
+
 bool
 PacExpectationNode::containsExternalFunction() const
 {
@@ -22,6 +22,7 @@
 
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <ostream>
 #include <functional>
@@ -32,12 +33,14 @@ using namespace std;
 #include "CodeInterpreter.hh"
 #include "ExternalFunctionsTable.hh"
 #include "SymbolList.hh"
+#include "ContentHash.hh"
 
 class DataTree;
 class VariableNode;
 class UnaryOpNode;
 class BinaryOpNode;
 class PacExpectationNode;
+class FlatRegisterCode;
 
 using expr_t = class ExprNode *;
 
@@ -88,7 +91,9 @@ enum class ExprNodeOutputType
     steadyStateFile,                             //!< Matlab code, in the generated steady state file
     juliaSteadyStateFile,                        //!< Julia code, in the generated steady state file
     matlabDseries,                               //!< Matlab code for dseries
-    epilogueFile                                 //!< Matlab code, in the generated epilogue file
+    epilogueFile,                                //!< Matlab code, in the generated epilogue file
+    CDynamicModelBatch,                          //!< C code, dynamic model evaluated at n points (element k of point i at index k*n+i)
+    CDynamicBatchSteadyStateOperator             //!< C code, dynamic model evaluated at n points, inside a steady state operator
   };
 
 inline bool
@@ -120,7 +125,16 @@ isCOutput(ExprNodeOutputType output_type)
 {
   return output_type == ExprNodeOutputType::CDynamicModel
     || output_type == ExprNodeOutputType::CStaticModel
-    || output_type == ExprNodeOutputType::CDynamicSteadyStateOperator;
+    || output_type == ExprNodeOutputType::CDynamicSteadyStateOperator
+    || output_type == ExprNodeOutputType::CDynamicModelBatch
+    || output_type == ExprNodeOutputType::CDynamicBatchSteadyStateOperator;
+}
+
+inline bool
+isCBatchOutput(ExprNodeOutputType output_type)
+{
+  return output_type == ExprNodeOutputType::CDynamicModelBatch
+    || output_type == ExprNodeOutputType::CDynamicBatchSteadyStateOperator;
 }
 
 inline bool
@@ -143,6 +157,161 @@ isLatexOutput(ExprNodeOutputType output_type)
 #define LEFT_PAR(output_type) (isLatexOutput(output_type) ? "\\left(" : "(")
 #define RIGHT_PAR(output_type) (isLatexOutput(output_type) ? "\\right)" : ")")
 
+//! Costs of operators, overriding those hardcoded in the cost() methods of the nodes
+/*! Arrays are indexed by target language: 0 for C, 1 for MATLAB (i.e. by the
+  is_matlab argument of the cost() methods) */
+class OperatorCosts
+{
+public:
+  map<UnaryOpcode, int> unary[2];
+  map<BinaryOpcode, int> binary[2];
+  map<TrinaryOpcode, int> trinary[2];
+  //! Cost of storing a temporary term and reading it back (used by the "cse" temporary terms engine)
+  int temporary_term[2]{8, 180};
+
+  //! Reads costs from a file
+  /*! Each line is of the form "<target> <operator> <cost>", where <target> is
+    "c" or "matlab", and <operator> is the name of an opcode (e.g. "exp",
+    "times", "normcdf") or "temporary_term". Lines beginning with '#' are
+    ignored. Any other line (trailing tokens, unknown target or operator,
+    negative cost) is an error, reported with its file name and line number. */
+  void readFile(const string &filename);
+};
+
+//! Dense version of evaluation contexts, indexed by symbol ID
+/*! It may hold several points, in structure-of-arrays layout: the values
+  of a given symbol at all the points are contiguous */
+class DenseEvalContext
+{
+public:
+  explicit DenseEvalContext(const eval_context_t &eval_context);
+  explicit DenseEvalContext(const vector<eval_context_t> &eval_contexts);
+  //! Number of points
+  int npoints;
+  //! Value of symbol symb_id at point k is values[symb_id*npoints+k] (NaN if it has no value)
+  vector<double> values;
+  //! Whether symbol symb_id has a value at point k (same layout as values)
+  vector<char> known;
+};
+
+//! Flattened representation of some expressions, for fast numerical evaluation
+/*! The nodes reachable from the expressions are stored once, in topological
+  order (arguments before the nodes using them). Evaluating the tape hence
+  evaluates each node of the DAG exactly once, without recursion nor map
+  lookups, whereas ExprNode::eval() evaluates a shared subexpression as many
+  times as it is referenced. */
+class EvalTape
+{
+public:
+  //! Outcome of the evaluation of a node
+  /*! A failure propagates to the nodes using the failed node. The
+    externalFunction and error statuses correspond respectively to the
+    ExprNode::EvalExternalFunctionException and ExprNode::EvalException
+    exceptions thrown by ExprNode::eval() */
+  enum class Status : char
+    {
+      ok,
+      externalFunction,
+      error
+    };
+private:
+  enum class InstructionType
+    {
+      constant,
+      variable,
+      unary,
+      binary,
+      trinary,
+      failure
+    };
+  struct Instruction
+  {
+    InstructionType type;
+    //! Opcode, symbol ID (for a variable) or status (for a failure)
+    int op;
+    int arg1, arg2, arg3;
+    //! Value of a constant, or derivation order of a powerDeriv
+    double value;
+  };
+  vector<Instruction> instructions;
+  //! Position in the tape of each node, indexed by node index (-1 if not in the tape)
+  vector<int> positions;
+  int append(int node_idx, const Instruction &instruction);
+  //! Evaluates an operator at n points; points whose status is not ok are skipped where it matters
+  static void evalUnary(UnaryOpcode op_code, const double *arg, double *value, Status *status, int n);
+  static void evalBinary(BinaryOpcode op_code, int derivOrder, const double *arg1, const double *arg2,
+                         double *value, Status *status, int n);
+  static void evalTrinary(TrinaryOpcode op_code, const double *arg1, const double *arg2, const double *arg3,
+                          double *value, Status *status, int n);
+public:
+  //! Returns the position in the tape of the node with the given index, or -1
+  int find(int node_idx) const;
+  //! Appends a node to the tape, and returns its position
+  /*! The arguments are positions in the tape */
+  int addConstant(int node_idx, double value);
+  int addVariable(int node_idx, int symb_id);
+  int addUnary(int node_idx, UnaryOpcode op_code, int arg);
+  int addBinary(int node_idx, BinaryOpcode op_code, int arg1, int arg2, int powerDerivOrder);
+  int addTrinary(int node_idx, TrinaryOpcode op_code, int arg1, int arg2, int arg3);
+  //! Appends a node whose evaluation always fails with the given status
+  int addFailure(int node_idx, Status status);
+  //! Number of nodes in the tape
+  int
+  size() const
+  {
+    return instructions.size();
+  };
+  //! Evaluates all the nodes of the tape, at all the points of the context
+  /*! The value and status at point k of the node at position pos in the
+    tape are values[pos*context.npoints+k] and status[pos*context.npoints+k] */
+  void eval(const DenseEvalContext &context, vector<double> &values, vector<Status> &status) const;
+};
+
+//! Digest of the structure of some expressions
+/*! The digest is computed on the DAG rather than on a textual rendering of
+  the expressions. Each node reachable from the expressions is fed once to
+  the hash, as a record made of its kind, its own fields and the positions of
+  its arguments in the sequence of records (arguments come before the nodes
+  using them, as in EvalTape). A shared subexpression is hence hashed once,
+  and the digest does not depend on the indices of the nodes in the
+  DataTree. */
+class StructuralHash
+{
+public:
+  enum class NodeKind
+    {
+      constant,
+      variable,
+      unary,
+      binary,
+      trinary,
+      externalFunction,
+      firstDerivExternalFunction,
+      secondDerivExternalFunction,
+      varExpectation,
+      pacExpectation
+    };
+private:
+  ContentHash hash;
+  //! Position of the record of each node, indexed by node index (-1 if not yet fed)
+  vector<int> positions;
+  int record_nbr{0};
+public:
+  //! Returns the position of the record of the node with the given index, or -1
+  int find(int node_idx) const;
+  //! Starts the record of a node, and returns its position
+  /*! The records of its arguments must have been added before; the fields of
+    the node are then fed with update() */
+  int addRecord(int node_idx, NodeKind kind);
+  void update(int64_t value);
+  void update(const string &value);
+  //! Feeds the position of the record of an expression, adding the records of its nodes if needed
+  /*! Used for the roots of a set of expressions (equations, derivatives...) */
+  void updateExpression(expr_t expression);
+  //! Returns the digest (see ContentHash::hexDigest())
+  string hexDigest();
+};
+
 //! Base class for expression nodes
 class ExprNode
     {
@@ -174,11 +343,19 @@ class ExprNode
       //! Is the data member non_null_derivatives initialized ?
       bool preparedForDerivation;
 
-      //! Set of derivation IDs with respect to which the derivative is potentially non-null
-      set<int> non_null_derivatives;
+      //! Sorted vector of derivation IDs with respect to which the derivative is potentially non-null
+      /*! A sorted vector is used rather than a set, since it is much more compact
+        and is only modified once, in prepareForDerivation() */
+      vector<int> non_null_derivatives;
 
       //! Used for caching of first order derivatives (when non-null)
-      map<int, expr_t> derivatives;
+      /*! Has the same size as non_null_derivatives (once allocated), and
+        derivatives[i] is the derivative with respect to
+        non_null_derivatives[i], or nullptr if it has not been computed yet */
+      vector<expr_t> derivatives;
+
+      //! Stores in non_null_derivatives the union of the non-null derivatives of the given nodes
+      void unionNonNullDerivatives(const vector<expr_t> &args);
 
       const static int min_cost_matlab{40*90};
       const static int min_cost_c{40*4};
@@ -189,6 +366,12 @@ class ExprNode
       virtual int cost(int cost, bool is_matlab) const;
       virtual int cost(const temporary_terms_t &temporary_terms, bool is_matlab) const;
       virtual int cost(const map<NodeTreeReference, temporary_terms_t> &temp_terms_map, bool is_matlab) const;
+      //! Cost of computing current node, memoizing the cost of the nodes in definition_costs
+      /*! Nodes included in temporary_terms are considered having a null cost;
+        but their definition cost (i.e. the cost of their expression, for
+        which temporary terms below them are considered having a null cost)
+        is still stored in definition_costs */
+      virtual int cost(const temporary_terms_t &temporary_terms, map<expr_t, int> &definition_costs, bool is_matlab) const;
 
       //! For creating equation cross references
       struct EquationInfo
@@ -225,6 +408,14 @@ class ExprNode
       */
       virtual expr_t getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recursive_variables) = 0;
 
+      //! Returns the partial derivatives of the node w.r. to each of its arguments, for reverse-mode differentiation
+      /*! The result contains (argument, partial derivative) pairs. The
+        "arguments" of a model local variable are its definition. An equal
+        node is considered as lhs minus rhs. Nodes with no argument (and the
+        STEADY_STATE operator in a dynamic model, whose dependence on
+        parameters is given by ss_param_deriv) return an empty vector. */
+      virtual vector<pair<expr_t, expr_t>> getArgumentsPartialDerivatives();
+
       //! Returns precedence of node
       /*! Equals 100 for constants, variables, unary ops, and temporary terms */
       virtual int precedence(ExprNodeOutputType output_t, const temporary_terms_t &temporary_terms) const;
@@ -235,6 +426,13 @@ class ExprNode
                                          map<NodeTreeReference, temporary_terms_t> &temp_terms_map,
                                          bool is_matlab, NodeTreeReference tr) const;
 
+      //! Counts the references to the node and to its descendants, and records the first tree in which they appear
+      /*! Used by the "cse" temporary terms engine, which selects temporary
+        terms once all the reference counts are known (see
+        ModelTree::computeTemporaryTermsCSE()). Terminal nodes are not recorded. */
+      virtual void computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                                         NodeTreeReference tr) const;
+
       //! Writes output of node, using a Txxx notation for nodes in temporary_terms, and specifiying the set of already written external functions
       /*!
         \param[in] output the output stream
@@ -348,6 +546,14 @@ class ExprNode
       };
 
       virtual double eval(const eval_context_t &eval_context) const noexcept(false) = 0;
+      //! Adds the node (and its arguments) to an evaluation tape, if not already there; returns its position in the tape
+      virtual int addToEvalTape(EvalTape &tape) const;
+      //! Adds the node (and its arguments) to register-based flat bytecode, if not already there; returns the register holding its value
+      /*! steady_state is true inside a STEADY_STATE operator. Sets
+        code.unsupported if the node cannot be expressed in the instruction set */
+      virtual uint32_t addToRegisterCode(FlatRegisterCode &code, bool steady_state) const;
+      //! Adds the record of the node (and of its arguments) to a structural hash, if not already there; returns its position
+      virtual int addToStructuralHash(StructuralHash &hash) const = 0;
       virtual void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, const deriv_node_temp_terms_t &tef_terms) const = 0;
       void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic) const;
       //! Creates a static version of this node
@@ -536,6 +742,16 @@ class ExprNode
       //! Add ExprNodes to the provided datatree
       virtual expr_t cloneDynamic(DataTree &dynamic_datatree) const = 0;
 
+      //! Add ExprNodes to the provided datatree, visiting shared subexpressions only once
+      /*! Contrary to cloneDynamic(), the cost is linear in the size of the DAG
+        (and not of the equivalent tree), which matters for derivatives.
+        \param[in,out] cloned maps the nodes already copied to their copy */
+      expr_t cloneShared(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const;
+
+      //! Implementation of cloneShared() for the current node (the cache lookup is done by the caller)
+      /*! The default implementation, used by leaf nodes, calls cloneDynamic() */
+      virtual expr_t cloneSharedInternal(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const;
+
       //! Move a trend variable with lag/lead to time t by dividing/multiplying by its growth factor
       virtual expr_t removeTrendLeadLag(map<int, expr_t> trend_symbols_map) const = 0;
 
@@ -622,6 +838,9 @@ public:
   void collectDynamicVariables(SymbolType type_arg, set<pair<int, int>> &result) const override;
   void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const override;
   double eval(const eval_context_t &eval_context) const noexcept(false) override;
+  int addToEvalTape(EvalTape &tape) const override;
+  uint32_t addToRegisterCode(FlatRegisterCode &code, bool steady_state) const override;
+  int addToStructuralHash(StructuralHash &hash) const override;
   void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, const deriv_node_temp_terms_t &tef_terms) const override;
   expr_t toStatic(DataTree &static_datatree) const override;
   void computeXrefs(EquationInfo &ei) const override;
@@ -691,6 +910,8 @@ private:
   const SymbolType type;
   //! A positive value is a lead, a negative is a lag
   const int lag;
+  //! Used for caching of chain rule derivatives (with respect to recursive variables)
+  map<int, expr_t> chain_rule_derivatives;
   expr_t computeDerivative(int deriv_id) override;
 public:
   VariableNode(DataTree &datatree_arg, int idx_arg, int symb_id_arg, int lag_arg);
@@ -709,6 +930,9 @@ public:
                                      int equation) const override;
   void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const override;
   double eval(const eval_context_t &eval_context) const noexcept(false) override;
+  int addToEvalTape(EvalTape &tape) const override;
+  uint32_t addToRegisterCode(FlatRegisterCode &code, bool steady_state) const override;
+  int addToStructuralHash(StructuralHash &hash) const override;
   void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, const deriv_node_temp_terms_t &tef_terms) const override;
   expr_t toStatic(DataTree &static_datatree) const override;
   void computeXrefs(EquationInfo &ei) const override;
@@ -729,6 +953,7 @@ public:
   };
   pair<int, expr_t> normalizeEquation(int symb_id_endo, vector<pair<int, pair<expr_t, expr_t>>>  &List_of_Op_RHS) const override;
   expr_t getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recursive_variables) override;
+  vector<pair<expr_t, expr_t>> getArgumentsPartialDerivatives() override;
   int maxEndoLead() const override;
   int maxExoLead() const override;
   int maxEndoLag() const override;
@@ -800,6 +1025,7 @@ private:
   int cost(int cost, bool is_matlab) const override;
   int cost(const temporary_terms_t &temporary_terms, bool is_matlab) const override;
   int cost(const map<NodeTreeReference, temporary_terms_t> &temp_terms_map, bool is_matlab) const override;
+  int cost(const temporary_terms_t &temporary_terms, map<expr_t, int> &definition_costs, bool is_matlab) const override;
   //! Returns the derivative of this node if darg is the derivative of the argument
   expr_t composeDerivatives(expr_t darg, int deriv_id);
 public:
@@ -808,6 +1034,8 @@ public:
   void computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
                                      map<NodeTreeReference, temporary_terms_t> &temp_terms_map,
                                      bool is_matlab, NodeTreeReference tr) const override;
+  void computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                             NodeTreeReference tr) const override;
   void writeOutput(ostream &output, ExprNodeOutputType output_type, const temporary_terms_t &temporary_terms, const temporary_terms_idxs_t &temporary_terms_idxs, const deriv_node_temp_terms_t &tef_terms) const override;
   void writeJsonAST(ostream &output) const override;
   void writeJsonOutput(ostream &output, const temporary_terms_t &temporary_terms, const deriv_node_temp_terms_t &tef_terms, const bool isdynamic) const override;
@@ -835,6 +1063,9 @@ public:
   void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const override;
   static double eval_opcode(UnaryOpcode op_code, double v) noexcept(false);
   double eval(const eval_context_t &eval_context) const noexcept(false) override;
+  int addToEvalTape(EvalTape &tape) const override;
+  uint32_t addToRegisterCode(FlatRegisterCode &code, bool steady_state) const override;
+  int addToStructuralHash(StructuralHash &hash) const override;
   void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, const deriv_node_temp_terms_t &tef_terms) const override;
   //! Returns operand
   expr_t
@@ -852,6 +1083,7 @@ public:
   void computeXrefs(EquationInfo &ei) const override;
   pair<int, expr_t> normalizeEquation(int symb_id_endo, vector<pair<int, pair<expr_t, expr_t>>>  &List_of_Op_RHS) const override;
   expr_t getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recursive_variables) override;
+  vector<pair<expr_t, expr_t>> getArgumentsPartialDerivatives() override;
   int maxEndoLead() const override;
   int maxExoLead() const override;
   int maxEndoLag() const override;
@@ -889,6 +1121,7 @@ public:
   expr_t replaceTrendVar() const override;
   expr_t detrend(int symb_id, bool log_trend, expr_t trend) const override;
   expr_t cloneDynamic(DataTree &dynamic_datatree) const override;
+  expr_t cloneSharedInternal(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const override;
   expr_t removeTrendLeadLag(map<int, expr_t> trend_symbols_map) const override;
   bool isInStaticForm() const override;
   void addParamInfoToPac(pair<int, int> &lhs_arg, int optim_share_arg, pair<int, pair<vector<int>, vector<bool>>> &ec_params_and_vars_arg, set<pair<int, pair<int, int>>> &params_and_vars_arg, set<pair<int, pair<pair<int, int>, double>>> &params_vars_and_scaling_factor_arg) override;
@@ -920,6 +1153,7 @@ private:
   int cost(int cost, bool is_matlab) const override;
   int cost(const temporary_terms_t &temporary_terms, bool is_matlab) const override;
   int cost(const map<NodeTreeReference, temporary_terms_t> &temp_terms_map, bool is_matlab) const override;
+  int cost(const temporary_terms_t &temporary_terms, map<expr_t, int> &definition_costs, bool is_matlab) const override;
   //! Returns the derivative of this node if darg1 and darg2 are the derivatives of the arguments
   expr_t composeDerivatives(expr_t darg1, expr_t darg2);
   const int powerDerivOrder;
@@ -933,6 +1167,8 @@ public:
   void computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
                                      map<NodeTreeReference, temporary_terms_t> &temp_terms_map,
                                      bool is_matlab, NodeTreeReference tr) const override;
+  void computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                             NodeTreeReference tr) const override;
   void writeOutput(ostream &output, ExprNodeOutputType output_type, const temporary_terms_t &temporary_terms, const temporary_terms_idxs_t &temporary_terms_idxs, const deriv_node_temp_terms_t &tef_terms) const override;
   void writeJsonAST(ostream &output) const override;
   void writeJsonOutput(ostream &output, const temporary_terms_t &temporary_terms, const deriv_node_temp_terms_t &tef_terms, const bool isdynamic) const override;
@@ -960,8 +1196,13 @@ public:
   void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const override;
   static double eval_opcode(double v1, BinaryOpcode op_code, double v2, int derivOrder) noexcept(false);
   double eval(const eval_context_t &eval_context) const noexcept(false) override;
+  int addToEvalTape(EvalTape &tape) const override;
+  uint32_t addToRegisterCode(FlatRegisterCode &code, bool steady_state) const override;
+  int addToStructuralHash(StructuralHash &hash) const override;
   void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, const deriv_node_temp_terms_t &tef_terms) const override;
   virtual expr_t Compute_RHS(expr_t arg1, expr_t arg2, int op, int op_type) const;
+  //! If the node is the product of a parameter and an endogenous or exogenous variable, returns them
+  pair<const VariableNode *, const VariableNode *> matchParameterTimesVariable() const;
   //! Returns first operand
   expr_t
   get_arg1() const
@@ -999,6 +1240,7 @@ public:
   void computeXrefs(EquationInfo &ei) const override;
   pair<int, expr_t> normalizeEquation(int symb_id_endo, vector<pair<int, pair<expr_t, expr_t>>>  &List_of_Op_RHS) const override;
   expr_t getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recursive_variables) override;
+  vector<pair<expr_t, expr_t>> getArgumentsPartialDerivatives() override;
   int maxEndoLead() const override;
   int maxExoLead() const override;
   int maxEndoLag() const override;
@@ -1037,6 +1279,7 @@ public:
   expr_t replaceTrendVar() const override;
   expr_t detrend(int symb_id, bool log_trend, expr_t trend) const override;
   expr_t cloneDynamic(DataTree &dynamic_datatree) const override;
+  expr_t cloneSharedInternal(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const override;
   expr_t removeTrendLeadLag(map<int, expr_t> trend_symbols_map) const override;
   //! Function to write out the oPowerNode in expr_t terms as opposed to writing out the function itself
   expr_t unpackPowerDeriv() const;
@@ -1080,6 +1323,7 @@ private:
   int cost(int cost, bool is_matlab) const override;
   int cost(const temporary_terms_t &temporary_terms, bool is_matlab) const override;
   int cost(const map<NodeTreeReference, temporary_terms_t> &temp_terms_map, bool is_matlab) const override;
+  int cost(const temporary_terms_t &temporary_terms, map<expr_t, int> &definition_costs, bool is_matlab) const override;
   //! Returns the derivative of this node if darg1, darg2 and darg3 are the derivatives of the arguments
   expr_t composeDerivatives(expr_t darg1, expr_t darg2, expr_t darg3);
 public:
@@ -1090,6 +1334,8 @@ public:
   void computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
                                      map<NodeTreeReference, temporary_terms_t> &temp_terms_map,
                                      bool is_matlab, NodeTreeReference tr) const override;
+  void computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                             NodeTreeReference tr) const override;
   void writeOutput(ostream &output, ExprNodeOutputType output_type, const temporary_terms_t &temporary_terms, const temporary_terms_idxs_t &temporary_terms_idxs, const deriv_node_temp_terms_t &tef_terms) const override;
   void writeJsonAST(ostream &output) const override;
   void writeJsonOutput(ostream &output, const temporary_terms_t &temporary_terms, const deriv_node_temp_terms_t &tef_terms, const bool isdynamic) const override;
@@ -1117,11 +1363,15 @@ public:
   void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const override;
   static double eval_opcode(double v1, TrinaryOpcode op_code, double v2, double v3) noexcept(false);
   double eval(const eval_context_t &eval_context) const noexcept(false) override;
+  int addToEvalTape(EvalTape &tape) const override;
+  uint32_t addToRegisterCode(FlatRegisterCode &code, bool steady_state) const override;
+  int addToStructuralHash(StructuralHash &hash) const override;
   void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, const deriv_node_temp_terms_t &tef_terms) const override;
   expr_t toStatic(DataTree &static_datatree) const override;
   void computeXrefs(EquationInfo &ei) const override;
   pair<int, expr_t> normalizeEquation(int symb_id_endo, vector<pair<int, pair<expr_t, expr_t>>>  &List_of_Op_RHS) const override;
   expr_t getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recursive_variables) override;
+  vector<pair<expr_t, expr_t>> getArgumentsPartialDerivatives() override;
   int maxEndoLead() const override;
   int maxExoLead() const override;
   int maxEndoLag() const override;
@@ -1158,6 +1408,7 @@ public:
   expr_t replaceTrendVar() const override;
   expr_t detrend(int symb_id, bool log_trend, expr_t trend) const override;
   expr_t cloneDynamic(DataTree &dynamic_datatree) const override;
+  expr_t cloneSharedInternal(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const override;
   expr_t removeTrendLeadLag(map<int, expr_t> trend_symbols_map) const override;
   bool isInStaticForm() const override;
   void addParamInfoToPac(pair<int, int> &lhs_arg, int optim_share_arg, pair<int, pair<vector<int>, vector<bool>>> &ec_params_and_vars_arg, set<pair<int, pair<int, int>>> &params_and_vars_arg, set<pair<int, pair<pair<int, int>, double>>> &params_vars_and_scaling_factor_arg) override;
@@ -1204,6 +1455,9 @@ protected:
     function which is computed by the same external function call (i.e. it has
     the same so-called "Tef" index) */
   virtual function<bool (expr_t)> sameTefTermPredicate() const = 0;
+  //! Adds the record of the node to a structural hash, with the indices of the arguments w.r. to which it is derived
+  int addExternalFunctionToStructuralHash(StructuralHash &hash, StructuralHash::NodeKind kind,
+                                          const vector<int> &input_indices) const;
 public:
   AbstractExternalFunctionNode(DataTree &datatree_arg, int idx_arg, int symb_id_arg,
                                vector<expr_t> arguments_arg);
@@ -1211,6 +1465,8 @@ public:
   void computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
                                      map<NodeTreeReference, temporary_terms_t> &temp_terms_map,
                                      bool is_matlab, NodeTreeReference tr) const override;
+  void computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                             NodeTreeReference tr) const override;
   void writeOutput(ostream &output, ExprNodeOutputType output_type, const temporary_terms_t &temporary_terms, const temporary_terms_idxs_t &temporary_terms_idxs, const deriv_node_temp_terms_t &tef_terms) const override = 0;
   void writeJsonAST(ostream &output) const override = 0;
   void writeJsonOutput(ostream &output, const temporary_terms_t &temporary_terms, const deriv_node_temp_terms_t &tef_terms, const bool isdynamic = true) const override = 0;
@@ -1237,6 +1493,7 @@ public:
   void collectDynamicVariables(SymbolType type_arg, set<pair<int, int>> &result) const override;
   void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const override;
   double eval(const eval_context_t &eval_context) const noexcept(false) override;
+  int addToEvalTape(EvalTape &tape) const override;
   unsigned int compileExternalFunctionArguments(ostream &CompileCode, unsigned int &instruction_number,
                                                 bool lhs_rhs, const temporary_terms_t &temporary_terms,
                                                 const map_idx_t &map_idx, bool dynamic, bool steady_dynamic,
@@ -1247,6 +1504,7 @@ public:
   void computeXrefs(EquationInfo &ei) const override = 0;
   pair<int, expr_t> normalizeEquation(int symb_id_endo, vector<pair<int, pair<expr_t, expr_t>>>  &List_of_Op_RHS) const override;
   expr_t getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recursive_variables) override;
+  vector<pair<expr_t, expr_t>> getArgumentsPartialDerivatives() override;
   int maxEndoLead() const override;
   int maxExoLead() const override;
   int maxEndoLag() const override;
@@ -1283,6 +1541,7 @@ public:
   expr_t replaceTrendVar() const override;
   expr_t detrend(int symb_id, bool log_trend, expr_t trend) const override;
   expr_t cloneDynamic(DataTree &dynamic_datatree) const override = 0;
+  expr_t cloneSharedInternal(DataTree &alt_datatree, unordered_map<expr_t, expr_t> &cloned) const override;
   expr_t removeTrendLeadLag(map<int, expr_t> trend_symbols_map) const override;
   bool isInStaticForm() const override;
   void addParamInfoToPac(pair<int, int> &lhs_arg, int optim_share_arg, pair<int, pair<vector<int>, vector<bool>>> &ec_params_and_vars_arg, set<pair<int, pair<int, int>>> &params_and_vars_arg, set<pair<int, pair<pair<int, int>, double>>> &params_vars_and_scaling_factor_arg) override;
@@ -1338,6 +1597,7 @@ public:
                                      int equation) const override;
   void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, const deriv_node_temp_terms_t &tef_terms) const override;
   expr_t toStatic(DataTree &static_datatree) const override;
+  int addToStructuralHash(StructuralHash &hash) const override;
   void computeXrefs(EquationInfo &ei) const override;
   expr_t buildSimilarExternalFunctionNode(vector<expr_t> &alt_args, DataTree &alt_datatree) const override;
   expr_t cloneDynamic(DataTree &dynamic_datatree) const override;
@@ -1381,6 +1641,7 @@ public:
                                              const map_idx_t &map_idx, bool dynamic, bool steady_dynamic,
                                              deriv_node_temp_terms_t &tef_terms) const override;
   expr_t toStatic(DataTree &static_datatree) const override;
+  int addToStructuralHash(StructuralHash &hash) const override;
   void computeXrefs(EquationInfo &ei) const override;
   expr_t buildSimilarExternalFunctionNode(vector<expr_t> &alt_args, DataTree &alt_datatree) const override;
   expr_t cloneDynamic(DataTree &dynamic_datatree) const override;
@@ -1426,6 +1687,7 @@ public:
                                              const map_idx_t &map_idx, bool dynamic, bool steady_dynamic,
                                              deriv_node_temp_terms_t &tef_terms) const override;
   expr_t toStatic(DataTree &static_datatree) const override;
+  int addToStructuralHash(StructuralHash &hash) const override;
   void computeXrefs(EquationInfo &ei) const override;
   expr_t buildSimilarExternalFunctionNode(vector<expr_t> &alt_args, DataTree &alt_datatree) const override;
   expr_t cloneDynamic(DataTree &dynamic_datatree) const override;
@@ -1440,6 +1702,8 @@ public:
   void computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
                                      map<NodeTreeReference, temporary_terms_t> &temp_terms_map,
                                      bool is_matlab, NodeTreeReference tr) const override;
+  void computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                             NodeTreeReference tr) const override;
   void writeOutput(ostream &output, ExprNodeOutputType output_type, const temporary_terms_t &temporary_terms, const temporary_terms_idxs_t &temporary_terms_idxs, const deriv_node_temp_terms_t &tef_terms) const override;
   void computeTemporaryTerms(map<expr_t, int> &reference_count,
                                      temporary_terms_t &temporary_terms,
@@ -1448,6 +1712,7 @@ public:
                                      vector< vector<temporary_terms_t>> &v_temporary_terms,
                                      int equation) const override;
   expr_t toStatic(DataTree &static_datatree) const override;
+  int addToStructuralHash(StructuralHash &hash) const override;
   expr_t cloneDynamic(DataTree &dynamic_datatree) const override;
   int maxEndoLead() const override;
   int maxExoLead() const override;
@@ -1463,6 +1728,7 @@ public:
   void prepareForDerivation() override;
   expr_t computeDerivative(int deriv_id) override;
   expr_t getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recursive_variables) override;
+  vector<pair<expr_t, expr_t>> getArgumentsPartialDerivatives() override;
   bool containsExternalFunction() const override;
   double eval(const eval_context_t &eval_context) const noexcept(false) override;
   void computeXrefs(EquationInfo &ei) const override;
@@ -1539,6 +1805,8 @@ public:
   void computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
                                      map<NodeTreeReference, temporary_terms_t> &temp_terms_map,
                                      bool is_matlab, NodeTreeReference tr) const override;
+  void computeReferenceCount(map<expr_t, pair<int, NodeTreeReference>> &reference_count,
+                             NodeTreeReference tr) const override;
   void writeOutput(ostream &output, ExprNodeOutputType output_type, const temporary_terms_t &temporary_terms, const temporary_terms_idxs_t &temporary_terms_idxs, const deriv_node_temp_terms_t &tef_terms) const override;
   void computeTemporaryTerms(map<expr_t, int> &reference_count,
                                      temporary_terms_t &temporary_terms,
@@ -1547,6 +1815,7 @@ public:
                                      vector< vector<temporary_terms_t>> &v_temporary_terms,
                                      int equation) const override;
   expr_t toStatic(DataTree &static_datatree) const override;
+  int addToStructuralHash(StructuralHash &hash) const override;
   expr_t cloneDynamic(DataTree &dynamic_datatree) const override;
   int maxEndoLead() const override;
   int maxExoLead() const override;
@@ -1562,6 +1831,7 @@ public:
   void prepareForDerivation() override;
   expr_t computeDerivative(int deriv_id) override;
   expr_t getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recursive_variables) override;
+  vector<pair<expr_t, expr_t>> getArgumentsPartialDerivatives() override;
   bool containsExternalFunction() const override;
   double eval(const eval_context_t &eval_context) const noexcept(false) override;
   void computeXrefs(EquationInfo &ei) const override;
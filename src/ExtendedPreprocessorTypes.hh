@@ -34,6 +34,7 @@ enum class LanguageOutputType
     matlab,                           // outputs files for Matlab/Octave processing
     cuda,                             // outputs files for CUDA (not yet implemented)
     julia,                            // outputs files for Julia
+    c,                                // outputs a standalone C library
     python,                           // outputs files for Python (not yet implemented) (not yet implemented)
   };
 
@@ -0,0 +1,1168 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+#include "FlatBytecode.hh"
+#include "CodeInterpreter.hh"
+
+//! Reads a field of an instruction of a .cod file
+template<typename T>
+inline T
+readField(const uint8_t *code, size_t offset)
+{
+  T value;
+  memcpy(&value, code + offset, sizeof(T));
+  return value;
+}
+
+FlatBytecode::FlatBytecode(const string &filename)
+{
+  using namespace boost::interprocess;
+
+  try
+    {
+      file = file_mapping(filename.c_str(), read_only);
+      region = mapped_region(file, read_only);
+    }
+  catch (interprocess_exception &e)
+    {
+      cerr << "Error: Can't map file " << filename << " in memory: " << e.what() << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  auto error = [&filename](const string &message)
+    {
+      cerr << "Error: " << filename << " is not a valid flat bytecode file: " << message << endl;
+      exit(EXIT_FAILURE);
+    };
+
+  auto base = static_cast<const char *>(region.get_address());
+  uint64_t size = region.get_size();
+  if (size < sizeof(FlatBytecodeHeader))
+    error("the file is too short");
+  header = reinterpret_cast<const FlatBytecodeHeader *>(base);
+  if (memcmp(header->magic, flat_bytecode_magic, sizeof(flat_bytecode_magic)))
+    error("wrong magic string");
+  if (header->byte_order != flat_bytecode_byte_order)
+    error("the file was written on a machine with a different byte order");
+  if (header->version != flat_bytecode_version)
+    error("version " + to_string(header->version) + " of the format is not supported");
+  if (header->header_size != sizeof(FlatBytecodeHeader))
+    error("wrong size of the header");
+
+  auto checkSection = [&](uint64_t offset, uint64_t nbr, uint64_t element_size, const string &name)
+    {
+      if (offset % flat_bytecode_alignment || offset < sizeof(FlatBytecodeHeader)
+          || offset > size || nbr > (size - offset) / element_size)
+        error("wrong position of the " + name);
+      return base + offset;
+    };
+  size_t instruction_size;
+  switch (static_cast<FlatInstructionSet>(header->instruction_set))
+    {
+    case FlatInstructionSet::stack:
+      instruction_size = sizeof(FlatInstruction);
+      break;
+    case FlatInstructionSet::registers:
+      instruction_size = sizeof(FlatRegisterInstruction);
+      break;
+    default:
+      error("unknown instruction set");
+    }
+  instructions = checkSection(header->instructions_offset, header->instruction_nbr, instruction_size, "instructions");
+  constants = reinterpret_cast<const double *>(checkSection(header->constants_offset, header->constant_nbr, sizeof(double), "constant pool"));
+  jacobian = reinterpret_cast<const FlatJacobianElement *>(checkSection(header->jacobian_offset, header->jacobian_nnz, sizeof(FlatJacobianElement), "Jacobian table"));
+
+  string message = header->instruction_set == static_cast<uint32_t>(FlatInstructionSet::stack)
+    ? checkInstructions() : checkRegisterInstructions();
+  if (!message.empty())
+    error(message);
+}
+
+//! Whether an operator can be evaluated by the flat bytecode interpreter
+static bool
+isSupportedUnary(uint8_t op_code)
+{
+  return op_code <= static_cast<uint8_t>(UnaryOpcode::erf)
+    && (op_code < static_cast<uint8_t>(UnaryOpcode::steadyStateParamDeriv)
+        || op_code > static_cast<uint8_t>(UnaryOpcode::expectation));
+}
+
+static bool
+isSupportedBinary(uint8_t op_code)
+{
+  return op_code <= static_cast<uint8_t>(BinaryOpcode::different)
+    && op_code != static_cast<uint8_t>(BinaryOpcode::equal);
+}
+
+static bool
+isSupportedTrinary(uint8_t op_code)
+{
+  return op_code <= static_cast<uint8_t>(TrinaryOpcode::normpdf);
+}
+
+pair<int, int>
+FlatBytecode::stackEffect(const FlatInstruction &instruction)
+{
+  switch (instruction.op_code)
+    {
+    case FLDZ:
+    case FLDC:
+    case FLDT:
+    case FLDST:
+    case FLDU:
+    case FLDSU:
+    case FLDV:
+    case FLDSV:
+    case FLDVS:
+    case FLDR:
+      return { 0, 1 };
+    case FSTPT:
+    case FSTPST:
+    case FSTPU:
+    case FSTPSU:
+    case FSTPV:
+    case FSTPSV:
+    case FSTPR:
+    case FSTPG:
+    case FSTPG2:
+    case FSTPG3:
+      return { 1, -1 };
+    case FCUML:
+      return { 2, -1 };
+    case FUNARY:
+      return { 1, 0 };
+    case FBINARY:
+      if (static_cast<BinaryOpcode>(instruction.type) == BinaryOpcode::powerDeriv)
+        return { 3, -2 };
+      return { 2, -1 };
+    case FTRINARY:
+      return { 3, -2 };
+    default:
+      return { 0, 0 };
+    }
+}
+
+string
+FlatBytecode::checkInstructions() const
+{
+  const FlatInstruction *instructions = getInstructions();
+  uint64_t n = header->instruction_nbr;
+  if (n == 0 || instructions[n-1].op_code != FEND)
+    return "the code does not end with FEND";
+
+  // Depth of the stack before each instruction
+  vector<int> depth(n+1, 0);
+  for (uint64_t i = 0; i < n; i++)
+    {
+      const FlatInstruction &ins = instructions[i];
+      string where = "instruction " + to_string(i) + ": ";
+      uint64_t bound = numeric_limits<uint64_t>::max();
+      switch (ins.op_code)
+        {
+        case FLDZ:
+        case FEND:
+        case FENDBLOCK:
+        case FENDEQU:
+        case FCUML:
+        case FDIMT:
+        case FDIMST:
+        case FNUMEXPR:
+        case FOK:
+        case FBEGINBLOCK:
+          break;
+        case FLDC:
+          bound = header->constant_nbr;
+          break;
+        case FLDT:
+        case FLDST:
+        case FSTPT:
+        case FSTPST:
+          bound = header->temporary_terms_nbr;
+          break;
+        case FLDU:
+        case FLDSU:
+        case FSTPU:
+        case FSTPSU:
+          bound = header->u_nbr;
+          break;
+        case FLDR:
+        case FSTPR:
+          bound = header->residual_nbr;
+          break;
+        case FSTPG:
+        case FSTPG2:
+        case FSTPG3:
+          bound = header->jacobian_nnz;
+          break;
+        case FLDV:
+        case FSTPV:
+        case FLDSV:
+        case FSTPSV:
+        case FLDVS:
+          switch (static_cast<SymbolType>(ins.type))
+            {
+            case SymbolType::endogenous:
+              bound = header->endo_nbr;
+              break;
+            case SymbolType::exogenous:
+            case SymbolType::exogenousDet:
+              if (ins.op_code == FSTPV || ins.op_code == FSTPSV)
+                return where + "assignment of an exogenous variable";
+              bound = header->exo_nbr + header->exo_det_nbr;
+              break;
+            case SymbolType::parameter:
+              if (ins.op_code == FSTPV || ins.op_code == FSTPSV)
+                return where + "assignment of a parameter";
+              bound = header->param_nbr;
+              break;
+            default:
+              return where + "unsupported type of variable";
+            }
+          break;
+        case FUNARY:
+          if (!isSupportedUnary(ins.type))
+            return where + "unsupported unary operator";
+          break;
+        case FBINARY:
+          if (!isSupportedBinary(ins.type))
+            return where + "unsupported binary operator";
+          break;
+        case FTRINARY:
+          if (!isSupportedTrinary(ins.type))
+            return where + "unsupported trinary operator";
+          break;
+        case FJMP:
+        case FJMPIFEVAL:
+          if (ins.arg >= n - i - 1)
+            return where + "jump beyond the end of the code";
+          // When only the residuals are computed, the jump lands on the FJMP skipping the Jacobian
+          if (ins.op_code == FJMPIFEVAL && (ins.arg == 0 || instructions[i+ins.arg].op_code != FJMP))
+            return where + "FJMPIFEVAL not followed by FJMP";
+          break;
+        default:
+          return where + "unsupported instruction";
+        }
+      if (ins.arg >= bound)
+        return where + "argument out of range";
+
+      auto effect = stackEffect(ins);
+      if (depth[i] < effect.first)
+        return where + "not enough operands on the stack";
+      depth[i+1] = depth[i] + effect.second;
+      if (depth[i+1] > (int) header->stack_size)
+        return where + "stack overflow";
+    }
+
+  // Both sides of a jump must leave the stack at the same depth
+  for (uint64_t i = 0; i < n; i++)
+    if ((instructions[i].op_code == FJMP || instructions[i].op_code == FJMPIFEVAL)
+        && depth[i+1] != depth[i+1+instructions[i].arg])
+      return "instruction " + to_string(i) + ": jump to a different depth of the stack";
+
+  return "";
+}
+
+string
+FlatBytecode::checkRegisterInstructions() const
+{
+  const FlatRegisterInstruction *instructions = getRegisterInstructions();
+  uint64_t n = header->instruction_nbr;
+  if (n == 0 || instructions[n-1].op_code != static_cast<uint8_t>(FlatRegisterOpcode::end))
+    return "the code does not end with an end instruction";
+
+  bool residuals_done = false;
+  for (uint64_t i = 0; i < n; i++)
+    {
+      const FlatRegisterInstruction &ins = instructions[i];
+      string where = "instruction " + to_string(i) + ": ";
+      // A register can be read if it holds a constant, or the result of a previous instruction
+      auto isReadable = [&](uint32_t reg)
+        {
+          return reg < i || (reg >= n && reg - n < header->constant_nbr);
+        };
+      auto checkVariable = [&](uint8_t type, uint32_t id, bool steady_state) -> string
+        {
+          uint64_t bound;
+          switch (static_cast<SymbolType>(type))
+            {
+            case SymbolType::endogenous:
+              bound = header->endo_nbr;
+              break;
+            case SymbolType::exogenous:
+            case SymbolType::exogenousDet:
+              bound = header->exo_nbr + header->exo_det_nbr;
+              break;
+            case SymbolType::parameter:
+              if (steady_state)
+                return "steady state of a parameter";
+              bound = header->param_nbr;
+              break;
+            default:
+              return "unsupported type of variable";
+            }
+          return id < bound ? "" : "variable out of range";
+        };
+      string message;
+      bool readable = true;
+      switch (static_cast<FlatRegisterOpcode>(ins.op_code))
+        {
+        case FlatRegisterOpcode::load:
+          message = checkVariable(ins.type, ins.arg1, false);
+          break;
+        case FlatRegisterOpcode::loadSteadyState:
+          if (!header->dynamic)
+            message = "steady state in a static model";
+          else
+            message = checkVariable(ins.type, ins.arg1, true);
+          break;
+        case FlatRegisterOpcode::unary:
+          if (!isSupportedUnary(ins.type))
+            message = "unsupported unary operator";
+          readable = isReadable(ins.arg1);
+          break;
+        case FlatRegisterOpcode::binary:
+          if (!isSupportedBinary(ins.type))
+            message = "unsupported binary operator";
+          readable = isReadable(ins.arg1) && isReadable(ins.arg2);
+          break;
+        case FlatRegisterOpcode::trinary:
+          if (!isSupportedTrinary(ins.type))
+            message = "unsupported trinary operator";
+          readable = isReadable(ins.arg1) && isReadable(ins.arg2) && isReadable(ins.arg3);
+          break;
+        case FlatRegisterOpcode::powerDeriv:
+        case FlatRegisterOpcode::powerInteger:
+          readable = isReadable(ins.arg1);
+          break;
+        case FlatRegisterOpcode::multiplyAdd:
+          readable = isReadable(ins.arg1) && isReadable(ins.arg2) && isReadable(ins.arg3);
+          break;
+        case FlatRegisterOpcode::parameterTimesVariable:
+          message = checkVariable(ins.type, ins.arg1, false);
+          if (ins.arg2 >= header->param_nbr)
+            message = "parameter out of range";
+          break;
+        case FlatRegisterOpcode::residual:
+          if (residuals_done)
+            message = "residual after the end of the residuals";
+          else if (ins.arg1 >= header->residual_nbr)
+            message = "residual out of range";
+          readable = isReadable(ins.arg2) && isReadable(ins.arg3);
+          break;
+        case FlatRegisterOpcode::endResiduals:
+          if (residuals_done)
+            message = "second end of the residuals";
+          residuals_done = true;
+          break;
+        case FlatRegisterOpcode::jacobian:
+          if (!residuals_done)
+            message = "Jacobian element before the end of the residuals";
+          else if (ins.arg1 >= header->jacobian_nnz)
+            message = "Jacobian element out of range";
+          readable = isReadable(ins.arg2);
+          break;
+        case FlatRegisterOpcode::end:
+          if (i != n-1)
+            message = "end before the last instruction";
+          break;
+        default:
+          message = "unsupported instruction";
+        }
+      if (!message.empty())
+        return where + message;
+      if (!readable)
+        return where + "register read before being assigned";
+    }
+  return "";
+}
+
+uint64_t
+FlatBytecode::dispatchedInstructions(bool residuals_only) const
+{
+  uint64_t dispatched = 0;
+  if (header->instruction_set == static_cast<uint32_t>(FlatInstructionSet::stack))
+    {
+      // Follows the jumps, as FlatBytecodeInterpreter::evaluate() does
+      const FlatInstruction *instructions = getInstructions();
+      for (uint64_t i = 0;; i++)
+        {
+          dispatched++;
+          if (instructions[i].op_code == FEND)
+            break;
+          if (instructions[i].op_code == FJMPIFEVAL && residuals_only)
+            i += instructions[i].arg - 1;
+          else if (instructions[i].op_code == FJMP || instructions[i].op_code == FJMPIFEVAL)
+            i += instructions[i].arg;
+        }
+    }
+  else
+    {
+      const FlatRegisterInstruction *instructions = getRegisterInstructions();
+      for (uint64_t i = 0;; i++)
+        {
+          dispatched++;
+          auto op_code = static_cast<FlatRegisterOpcode>(instructions[i].op_code);
+          if (op_code == FlatRegisterOpcode::end
+              || (op_code == FlatRegisterOpcode::endResiduals && residuals_only))
+            break;
+        }
+    }
+  return dispatched;
+}
+
+//! Writes a flat bytecode file
+/*! The sizes and positions of the sections in the header are computed from
+  the arguments, the other fields must be filled by the caller */
+static void
+writeFile(const string &filename, FlatBytecodeHeader header, const void *instructions,
+          uint64_t instruction_nbr, size_t instruction_size,
+          const vector<double> &constants, const vector<FlatJacobianElement> &jacobian)
+{
+  auto align = [](uint64_t offset)
+    {
+      return (offset + flat_bytecode_alignment - 1) / flat_bytecode_alignment * flat_bytecode_alignment;
+    };
+  memcpy(header.magic, flat_bytecode_magic, sizeof(flat_bytecode_magic));
+  header.version = flat_bytecode_version;
+  header.byte_order = flat_bytecode_byte_order;
+  header.header_size = sizeof(FlatBytecodeHeader);
+  header.instruction_nbr = instruction_nbr;
+  header.instructions_offset = align(sizeof(FlatBytecodeHeader));
+  header.constant_nbr = constants.size();
+  header.constants_offset = align(header.instructions_offset + instruction_nbr * instruction_size);
+  header.jacobian_nnz = jacobian.size();
+  header.jacobian_offset = align(header.constants_offset + constants.size() * sizeof(double));
+
+  ofstream output(filename, ios::out | ios::binary);
+  if (!output.is_open())
+    {
+      cerr << "Error: Can't open file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  auto writeSection = [&output](uint64_t offset, const void *data, size_t size)
+    {
+      while ((uint64_t) output.tellp() < offset)
+        output.put(0);
+      output.write(static_cast<const char *>(data), size);
+    };
+  writeSection(0, &header, sizeof(header));
+  writeSection(header.instructions_offset, instructions, instruction_nbr * instruction_size);
+  writeSection(header.constants_offset, constants.data(), constants.size() * sizeof(double));
+  writeSection(header.jacobian_offset, jacobian.data(), jacobian.size() * sizeof(FlatJacobianElement));
+  output.close();
+}
+
+bool
+FlatBytecode::convert(const string &code_filename, const string &filename, FlatBytecodeHeader header)
+{
+  ifstream code_file(code_filename, ios::in | ios::binary);
+  if (!code_file.is_open())
+    {
+      cerr << "Error: Can't open file " << code_filename << " for reading" << endl;
+      exit(EXIT_FAILURE);
+    }
+  vector<uint8_t> code{istreambuf_iterator<char>(code_file), istreambuf_iterator<char>()};
+  code_file.close();
+
+  vector<FlatInstruction> instructions;
+  vector<double> constants;
+  vector<FlatJacobianElement> jacobian;
+  // The derivative announced by the last FNUMEXPR
+  FlatJacobianElement derivative{0, 0, 0, FirstEndoDerivative};
+  header.residual_nbr = header.temporary_terms_nbr = header.u_nbr = header.block_nbr = 0;
+
+  size_t pos = 0;
+  auto fetch = [&](size_t size)
+    {
+      if (pos + size > code.size())
+        {
+          cerr << "Error: " << code_filename << " is truncated" << endl;
+          exit(EXIT_FAILURE);
+        }
+      const uint8_t *p = code.data() + pos;
+      pos += size;
+      return p;
+    };
+  auto updateSize = [](uint32_t &size, uint32_t index)
+    {
+      size = max(size, index + 1);
+    };
+
+  bool done = false;
+  while (!done)
+    {
+      if (pos >= code.size())
+        {
+          cerr << "Error: " << code_filename << " is truncated" << endl;
+          exit(EXIT_FAILURE);
+        }
+      FlatInstruction ins{code[pos], 0, 0, 0};
+      const uint8_t *p;
+      switch (ins.op_code)
+        {
+        case FLDZ:
+          fetch(sizeof(FLDZ_));
+          break;
+        case FEND:
+          fetch(sizeof(FEND_));
+          done = true;
+          break;
+        case FENDBLOCK:
+          fetch(sizeof(FENDBLOCK_));
+          break;
+        case FENDEQU:
+          fetch(sizeof(FENDEQU_));
+          break;
+        case FCUML:
+          fetch(sizeof(FCUML_));
+          break;
+        case FDIMT:
+        case FDIMST:
+          p = fetch(sizeof(FDIMT_));
+          ins.arg = readField<unsigned int>(p, 1);
+          header.temporary_terms_nbr = max(header.temporary_terms_nbr, ins.arg);
+          break;
+        case FLDC:
+          p = fetch(sizeof(FLDC_));
+          constants.push_back(readField<double>(p, 1));
+          ins.arg = constants.size() - 1;
+          break;
+        case FLDT:
+        case FLDST:
+        case FSTPT:
+        case FSTPST:
+          p = fetch(sizeof(FLDT_));
+          ins.arg = readField<unsigned int>(p, 1);
+          updateSize(header.temporary_terms_nbr, ins.arg);
+          break;
+        case FLDU:
+        case FLDSU:
+        case FSTPU:
+        case FSTPSU:
+          p = fetch(sizeof(FLDU_));
+          ins.arg = readField<unsigned int>(p, 1);
+          updateSize(header.u_nbr, ins.arg);
+          break;
+        case FLDR:
+        case FSTPR:
+          p = fetch(sizeof(FLDR_));
+          ins.arg = readField<unsigned int>(p, 1);
+          updateSize(header.residual_nbr, ins.arg);
+          break;
+        case FLDV:
+        case FSTPV:
+          p = fetch(sizeof(FLDV_));
+          ins.type = readField<uint8_t>(p, 1);
+          ins.arg = readField<unsigned int>(p, 2);
+          ins.lag = readField<int>(p, 2 + sizeof(unsigned int));
+          break;
+        case FLDSV:
+        case FSTPSV:
+        case FLDVS:
+          p = fetch(sizeof(FLDSV_));
+          ins.type = readField<uint8_t>(p, 1);
+          ins.arg = readField<unsigned int>(p, 2);
+          break;
+        case FSTPG:
+          fetch(sizeof(FSTPG_));
+          jacobian.push_back(derivative);
+          ins.arg = jacobian.size() - 1;
+          break;
+        case FSTPG2:
+          p = fetch(sizeof(FSTPG2_));
+          jacobian.push_back({ readField<unsigned int>(p, 1), readField<unsigned int>(p, 1 + sizeof(unsigned int)),
+                0, derivative.type });
+          ins.arg = jacobian.size() - 1;
+          break;
+        case FSTPG3:
+          p = fetch(sizeof(FSTPG3_));
+          jacobian.push_back({ readField<unsigned int>(p, 1), readField<unsigned int>(p, 1 + sizeof(unsigned int)),
+                readField<int>(p, 1 + 2*sizeof(unsigned int)), derivative.type });
+          ins.arg = jacobian.size() - 1;
+          break;
+        case FUNARY:
+        case FBINARY:
+        case FTRINARY:
+          p = fetch(sizeof(FUNARY_));
+          ins.type = readField<uint8_t>(p, 1);
+          break;
+        case FOK:
+          p = fetch(sizeof(FOK_));
+          ins.arg = readField<int>(p, 1);
+          break;
+        case FNUMEXPR:
+          {
+            p = fetch(sizeof(FNUMEXPR_));
+            size_t offset = 1 + sizeof(ExpressionType);
+            derivative.type = readField<ExpressionType>(p, 1);
+            derivative.equation = readField<unsigned int>(p, offset);
+            derivative.variable = readField<uint16_t>(p, offset + sizeof(unsigned int));
+            derivative.lag = readField<int8_t>(p, offset + sizeof(unsigned int) + 3*sizeof(uint16_t));
+          }
+          break;
+        case FJMPIFEVAL:
+        case FJMP:
+          p = fetch(sizeof(FJMP_));
+          ins.arg = readField<unsigned int>(p, 1);
+          break;
+        case FBEGINBLOCK:
+          {
+            // See FBEGINBLOCK_::write() for the layout of the instruction
+            fetch(sizeof(uint8_t));
+            int size = readField<int>(fetch(sizeof(int)), 0);
+            ins.type = readField<uint8_t>(fetch(sizeof(uint8_t)), 0);
+            fetch(size * 2 * sizeof(int));
+            if (ins.type == SOLVE_TWO_BOUNDARIES_SIMPLE || ins.type == SOLVE_TWO_BOUNDARIES_COMPLETE
+                || ins.type == SOLVE_BACKWARD_COMPLETE || ins.type == SOLVE_FORWARD_COMPLETE)
+              fetch(sizeof(bool) + 4*sizeof(int));
+            fetch(sizeof(int));
+            p = fetch(6*sizeof(unsigned int));
+            unsigned int det_exo_size = readField<unsigned int>(p, 0);
+            unsigned int exo_size = readField<unsigned int>(p, 2*sizeof(unsigned int));
+            unsigned int other_endo_size = readField<unsigned int>(p, 4*sizeof(unsigned int));
+            fetch((det_exo_size + exo_size + other_endo_size) * sizeof(unsigned int));
+            ins.arg = header.block_nbr++;
+          }
+          break;
+        case FCALL:
+        case FPUSH:
+        case FPOP:
+        case FLDTEF:
+        case FSTPTEF:
+        case FLDTEFD:
+        case FSTPTEFD:
+        case FLDTEFDD:
+        case FSTPTEFDD:
+          return false;
+        default:
+          cerr << "Error: unknown instruction " << (int) ins.op_code << " in " << code_filename << endl;
+          exit(EXIT_FAILURE);
+        }
+      instructions.push_back(ins);
+    }
+
+  // The maximal depth of the stack, along the linear order of the code
+  int depth = 0;
+  header.stack_size = 0;
+  for (const auto &ins : instructions)
+    {
+      depth += stackEffect(ins).second;
+      header.stack_size = max(header.stack_size, (uint32_t) max(depth, 0));
+    }
+
+  header.instruction_set = static_cast<uint32_t>(FlatInstructionSet::stack);
+  writeFile(filename, header, instructions.data(), instructions.size(), sizeof(FlatInstruction),
+            constants, jacobian);
+  return true;
+}
+
+FlatRegisterCode::FlatRegisterCode(bool dynamic_arg) :
+  dynamic(dynamic_arg)
+{
+}
+
+int
+FlatRegisterCode::find(int node_idx, bool steady_state) const
+{
+  auto it = registers.find({ node_idx, steady_state });
+  if (it == registers.end())
+    return -1;
+  return it->second;
+}
+
+uint32_t
+FlatRegisterCode::setRegister(int node_idx, bool steady_state, uint32_t reg)
+{
+  registers[{ node_idx, steady_state }] = reg;
+  return reg;
+}
+
+uint32_t
+FlatRegisterCode::append(FlatRegisterOpcode op_code, uint8_t type, int lag, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+  instructions.push_back({ static_cast<uint8_t>(op_code), type, static_cast<int16_t>(lag), arg1, arg2, arg3 });
+  return instructions.size() - 1;
+}
+
+uint32_t
+FlatRegisterCode::addConstant(double value)
+{
+  constants.push_back(value);
+  return (constants.size() - 1) | constant_flag;
+}
+
+uint32_t
+FlatRegisterCode::addLoad(SymbolType type, int tsid, int lag, bool steady_state)
+{
+  if (!dynamic || type == SymbolType::parameter)
+    lag = 0;
+  if (steady_state && dynamic && type != SymbolType::parameter)
+    return append(FlatRegisterOpcode::loadSteadyState, static_cast<uint8_t>(type), 0, tsid, 0, 0);
+  return append(FlatRegisterOpcode::load, static_cast<uint8_t>(type), lag, tsid, 0, 0);
+}
+
+uint32_t
+FlatRegisterCode::addUnary(UnaryOpcode op_code, uint32_t arg)
+{
+  return append(FlatRegisterOpcode::unary, static_cast<uint8_t>(op_code), 0, arg, 0, 0);
+}
+
+uint32_t
+FlatRegisterCode::addBinary(BinaryOpcode op_code, uint32_t arg1, uint32_t arg2)
+{
+  return append(FlatRegisterOpcode::binary, static_cast<uint8_t>(op_code), 0, arg1, arg2, 0);
+}
+
+uint32_t
+FlatRegisterCode::addTrinary(TrinaryOpcode op_code, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+  return append(FlatRegisterOpcode::trinary, static_cast<uint8_t>(op_code), 0, arg1, arg2, arg3);
+}
+
+uint32_t
+FlatRegisterCode::addPowerDeriv(uint32_t arg1, uint32_t arg2, int order)
+{
+  return append(FlatRegisterOpcode::powerDeriv, 0, 0, arg1, arg2, order);
+}
+
+uint32_t
+FlatRegisterCode::addMultiplyAdd(uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+  return append(FlatRegisterOpcode::multiplyAdd, 0, 0, arg1, arg2, arg3);
+}
+
+uint32_t
+FlatRegisterCode::addParameterTimesVariable(int param_tsid, SymbolType type, int tsid, int lag)
+{
+  return append(FlatRegisterOpcode::parameterTimesVariable, static_cast<uint8_t>(type),
+                dynamic ? lag : 0, tsid, param_tsid, 0);
+}
+
+uint32_t
+FlatRegisterCode::addPowerInteger(uint32_t arg, int exponent)
+{
+  return append(FlatRegisterOpcode::powerInteger, 0, 0, arg, static_cast<uint32_t>(exponent), 0);
+}
+
+void
+FlatRegisterCode::addResidual(uint32_t lhs, uint32_t rhs)
+{
+  append(FlatRegisterOpcode::residual, 0, 0, residual_nbr++, lhs, rhs);
+}
+
+void
+FlatRegisterCode::addEndResiduals()
+{
+  append(FlatRegisterOpcode::endResiduals, 0, 0, 0, 0, 0);
+}
+
+void
+FlatRegisterCode::addJacobian(const FlatJacobianElement &element, uint32_t arg)
+{
+  jacobian.push_back(element);
+  append(FlatRegisterOpcode::jacobian, 0, 0, jacobian.size() - 1, arg, 0);
+}
+
+void
+FlatRegisterCode::write(const string &filename, FlatBytecodeHeader header)
+{
+  append(FlatRegisterOpcode::end, 0, 0, 0, 0, 0);
+
+  // The constants are stored in the registers following those of the instructions
+  uint32_t n = instructions.size();
+  auto relocate = [n](uint32_t &reg)
+    {
+      if (reg & constant_flag)
+        reg = n + (reg & ~constant_flag);
+    };
+  for (auto &ins : instructions)
+    switch (static_cast<FlatRegisterOpcode>(ins.op_code))
+      {
+      case FlatRegisterOpcode::unary:
+      case FlatRegisterOpcode::powerInteger:
+        relocate(ins.arg1);
+        break;
+      case FlatRegisterOpcode::binary:
+      case FlatRegisterOpcode::powerDeriv:
+        relocate(ins.arg1);
+        relocate(ins.arg2);
+        break;
+      case FlatRegisterOpcode::trinary:
+      case FlatRegisterOpcode::multiplyAdd:
+        relocate(ins.arg1);
+        relocate(ins.arg2);
+        relocate(ins.arg3);
+        break;
+      case FlatRegisterOpcode::residual:
+        relocate(ins.arg2);
+        relocate(ins.arg3);
+        break;
+      case FlatRegisterOpcode::jacobian:
+        relocate(ins.arg2);
+        break;
+      default:
+        break;
+      }
+
+  header.residual_nbr = residual_nbr;
+  header.temporary_terms_nbr = header.u_nbr = header.stack_size = header.block_nbr = 0;
+  header.instruction_set = static_cast<uint32_t>(FlatInstructionSet::registers);
+  writeFile(filename, header, instructions.data(), instructions.size(), sizeof(FlatRegisterInstruction),
+            constants, jacobian);
+}
+
+static inline double
+evalUnary(UnaryOpcode op_code, double v)
+{
+  switch (op_code)
+    {
+    case UnaryOpcode::uminus:
+      return -v;
+    case UnaryOpcode::exp:
+      return exp(v);
+    case UnaryOpcode::log:
+      return log(v);
+    case UnaryOpcode::log10:
+      return log10(v);
+    case UnaryOpcode::cos:
+      return cos(v);
+    case UnaryOpcode::sin:
+      return sin(v);
+    case UnaryOpcode::tan:
+      return tan(v);
+    case UnaryOpcode::acos:
+      return acos(v);
+    case UnaryOpcode::asin:
+      return asin(v);
+    case UnaryOpcode::atan:
+      return atan(v);
+    case UnaryOpcode::cosh:
+      return cosh(v);
+    case UnaryOpcode::sinh:
+      return sinh(v);
+    case UnaryOpcode::tanh:
+      return tanh(v);
+    case UnaryOpcode::acosh:
+      return acosh(v);
+    case UnaryOpcode::asinh:
+      return asinh(v);
+    case UnaryOpcode::atanh:
+      return atanh(v);
+    case UnaryOpcode::sqrt:
+      return sqrt(v);
+    case UnaryOpcode::abs:
+      return fabs(v);
+    case UnaryOpcode::sign:
+      return (v > 0) ? 1 : ((v < 0) ? -1 : 0);
+    case UnaryOpcode::erf:
+      return erf(v);
+    default:
+      return v;
+    }
+}
+
+static inline double
+evalBinary(BinaryOpcode op_code, double v1, double v2)
+{
+  switch (op_code)
+    {
+    case BinaryOpcode::plus:
+      return v1 + v2;
+    case BinaryOpcode::minus:
+      return v1 - v2;
+    case BinaryOpcode::times:
+      return v1 * v2;
+    case BinaryOpcode::divide:
+      return v1 / v2;
+    case BinaryOpcode::power:
+      return pow(v1, v2);
+    case BinaryOpcode::max:
+      return max(v1, v2);
+    case BinaryOpcode::min:
+      return min(v1, v2);
+    case BinaryOpcode::less:
+      return v1 < v2;
+    case BinaryOpcode::greater:
+      return v1 > v2;
+    case BinaryOpcode::lessEqual:
+      return v1 <= v2;
+    case BinaryOpcode::greaterEqual:
+      return v1 >= v2;
+    case BinaryOpcode::equalEqual:
+      return v1 == v2;
+    case BinaryOpcode::different:
+      return v1 != v2;
+    default:
+      return v1;
+    }
+}
+
+static inline double
+evalPowerDeriv(double v1, double v2, int order)
+{
+  if (fabs(v1) < near_zero && v2 > 0 && order > v2
+      && fabs(v2-nearbyint(v2)) < near_zero)
+    return 0;
+  double dxp = pow(v1, v2-order);
+  for (int i = 0; i < order; i++)
+    dxp *= v2--;
+  return dxp;
+}
+
+static inline double
+evalTrinary(TrinaryOpcode op_code, double v1, double v2, double v3)
+{
+  if (op_code == TrinaryOpcode::normcdf)
+    return 0.5*(1+erf((v1-v2)/v3/M_SQRT2));
+  return 1/(v3*sqrt(2*M_PI)*exp(pow((v1-v2)/v3, 2)/2));
+}
+
+//! Raises to an integer power by repeated squaring
+/*! For exponents other than 0, 1, 2 and -1, the result may differ in the
+  last bits from that of pow(), used by ExprNode::eval() and the stack
+  instruction set; this is why the compiler only uses it for 2 and -1 */
+static inline double
+evalPowerInteger(double v, int exponent)
+{
+  double result = 1;
+  for (unsigned int n = abs(exponent); n; n >>= 1)
+    {
+      if (n & 1)
+        result *= v;
+      v *= v;
+    }
+  return exponent < 0 ? 1/result : result;
+}
+
+FlatBytecodeInterpreter::FlatBytecodeInterpreter(const FlatBytecode &code_arg) :
+  code(code_arg),
+  T(code_arg.getHeader().temporary_terms_nbr),
+  u(code_arg.getHeader().u_nbr),
+  stack(code_arg.getHeader().stack_size)
+{
+  // The constants are loaded once and for all in the registers following those of the instructions
+  const FlatBytecodeHeader &header = code.getHeader();
+  if (header.instruction_set == static_cast<uint32_t>(FlatInstructionSet::registers))
+    {
+      registers.resize(header.instruction_nbr + header.constant_nbr);
+      copy(code.getConstants(), code.getConstants() + header.constant_nbr,
+           registers.begin() + header.instruction_nbr);
+    }
+}
+
+void
+FlatBytecodeInterpreter::evaluate(double *y, const double *x, int nb_row_x, const double *params,
+                                  const double *steady_state, int it_, double *residual, double *g1)
+{
+  if (code.getHeader().instruction_set == static_cast<uint32_t>(FlatInstructionSet::stack))
+    evaluateStack(y, x, nb_row_x, params, steady_state, it_, residual, g1);
+  else
+    evaluateRegisters(y, x, nb_row_x, params, steady_state, it_, residual, g1);
+}
+
+void
+FlatBytecodeInterpreter::evaluateStack(double *y, const double *x, int nb_row_x, const double *params,
+                                       const double *steady_state, int it_, double *residual, double *g1)
+{
+  const FlatBytecodeHeader &header = code.getHeader();
+  const double *constants = code.getConstants();
+  const int endo_nbr = header.endo_nbr;
+  const bool dynamic = header.dynamic;
+  double *sp = stack.data(); // Points just above the top of the stack
+
+  // Address of the variable referred to by FLDV, FSTPV, FLDSV, FSTPSV or FLDVS
+  auto variable = [&](const FlatInstruction *ins) -> double *
+    {
+      switch (static_cast<SymbolType>(ins->type))
+        {
+        case SymbolType::endogenous:
+          if (ins->op_code == FLDVS)
+            return const_cast<double *>(steady_state) + ins->arg;
+          if (dynamic && (ins->op_code == FLDV || ins->op_code == FSTPV))
+            return y + (it_ + ins->lag) * endo_nbr + ins->arg;
+          return y + ins->arg;
+        case SymbolType::exogenous:
+        case SymbolType::exogenousDet:
+          if (dynamic && ins->op_code == FLDV)
+            return const_cast<double *>(x) + it_ + ins->lag + ins->arg * nb_row_x;
+          return const_cast<double *>(x) + (dynamic ? ins->arg * nb_row_x : ins->arg);
+        default:
+          return const_cast<double *>(params) + ins->arg;
+        }
+    };
+
+  for (const FlatInstruction *ins = code.getInstructions();; ins++)
+    switch (ins->op_code)
+      {
+      case FLDZ:
+        *sp++ = 0;
+        break;
+      case FLDC:
+        *sp++ = constants[ins->arg];
+        break;
+      case FLDT:
+      case FLDST:
+        *sp++ = T[ins->arg];
+        break;
+      case FSTPT:
+      case FSTPST:
+        T[ins->arg] = *--sp;
+        break;
+      case FLDU:
+      case FLDSU:
+        *sp++ = u[ins->arg];
+        break;
+      case FSTPU:
+      case FSTPSU:
+        u[ins->arg] = *--sp;
+        break;
+      case FLDR:
+        *sp++ = residual[ins->arg];
+        break;
+      case FSTPR:
+        residual[ins->arg] = *--sp;
+        break;
+      case FSTPG:
+      case FSTPG2:
+      case FSTPG3:
+        g1[ins->arg] = *--sp;
+        break;
+      case FLDV:
+      case FLDSV:
+      case FLDVS:
+        *sp++ = *variable(ins);
+        break;
+      case FSTPV:
+      case FSTPSV:
+        *variable(ins) = *--sp;
+        break;
+      case FCUML:
+        sp--;
+        sp[-1] += *sp;
+        break;
+      case FUNARY:
+        sp[-1] = evalUnary(static_cast<UnaryOpcode>(ins->type), sp[-1]);
+        break;
+      case FBINARY:
+        sp--;
+        if (static_cast<BinaryOpcode>(ins->type) == BinaryOpcode::powerDeriv)
+          {
+            // The order of the derivative is below the operands, its slot receives the result
+            sp--;
+            *(sp-1) = evalPowerDeriv(*sp, sp[1], static_cast<int>(sp[-1]));
+          }
+        else
+          sp[-1] = evalBinary(static_cast<BinaryOpcode>(ins->type), sp[-1], *sp);
+        break;
+      case FTRINARY:
+        sp -= 2;
+        sp[-1] = evalTrinary(static_cast<TrinaryOpcode>(ins->type), sp[-1], sp[0], sp[1]);
+        break;
+      case FJMPIFEVAL:
+        // When only the residuals are computed, land on the FJMP that skips the Jacobian
+        ins += g1 ? ins->arg : ins->arg - 1;
+        break;
+      case FJMP:
+        ins += ins->arg;
+        break;
+      case FEND:
+        return;
+      default:
+        break;
+      }
+}
+
+void
+FlatBytecodeInterpreter::evaluateRegisters(const double *y, const double *x, int nb_row_x, const double *params,
+                                           const double *steady_state, int it_, double *residual, double *g1)
+{
+  const FlatBytecodeHeader &header = code.getHeader();
+  const int endo_nbr = header.endo_nbr;
+  const bool dynamic = header.dynamic;
+  double *r = registers.data();
+
+  auto load = [&](const FlatRegisterInstruction *ins)
+    {
+      switch (static_cast<SymbolType>(ins->type))
+        {
+        case SymbolType::endogenous:
+          return dynamic ? y[(it_ + ins->lag) * endo_nbr + ins->arg1] : y[ins->arg1];
+        case SymbolType::exogenous:
+        case SymbolType::exogenousDet:
+          return dynamic ? x[it_ + ins->lag + ins->arg1 * nb_row_x] : x[ins->arg1];
+        default:
+          return params[ins->arg1];
+        }
+    };
+
+  const FlatRegisterInstruction *ins = code.getRegisterInstructions();
+  for (uint64_t i = 0;; i++, ins++)
+    switch (static_cast<FlatRegisterOpcode>(ins->op_code))
+      {
+      case FlatRegisterOpcode::load:
+        r[i] = load(ins);
+        break;
+      case FlatRegisterOpcode::loadSteadyState:
+        // As FLDVS, the steady state of an exogenous variable is read in the first row of x
+        r[i] = static_cast<SymbolType>(ins->type) == SymbolType::endogenous
+          ? steady_state[ins->arg1] : x[ins->arg1 * nb_row_x];
+        break;
+      case FlatRegisterOpcode::unary:
+        r[i] = evalUnary(static_cast<UnaryOpcode>(ins->type), r[ins->arg1]);
+        break;
+      case FlatRegisterOpcode::binary:
+        r[i] = evalBinary(static_cast<BinaryOpcode>(ins->type), r[ins->arg1], r[ins->arg2]);
+        break;
+      case FlatRegisterOpcode::trinary:
+        r[i] = evalTrinary(static_cast<TrinaryOpcode>(ins->type), r[ins->arg1], r[ins->arg2], r[ins->arg3]);
+        break;
+      case FlatRegisterOpcode::powerDeriv:
+        r[i] = evalPowerDeriv(r[ins->arg1], r[ins->arg2], ins->arg3);
+        break;
+      case FlatRegisterOpcode::multiplyAdd:
+        r[i] = r[ins->arg1] * r[ins->arg2] + r[ins->arg3];
+        break;
+      case FlatRegisterOpcode::parameterTimesVariable:
+        r[i] = params[ins->arg2] * load(ins);
+        break;
+      case FlatRegisterOpcode::powerInteger:
+        r[i] = evalPowerInteger(r[ins->arg1], static_cast<int32_t>(ins->arg2));
+        break;
+      case FlatRegisterOpcode::residual:
+        residual[ins->arg1] = r[ins->arg2] - r[ins->arg3];
+        break;
+      case FlatRegisterOpcode::endResiduals:
+        if (!g1)
+          return;
+        break;
+      case FlatRegisterOpcode::jacobian:
+        g1[ins->arg1] = r[ins->arg2];
+        break;
+      case FlatRegisterOpcode::end:
+        return;
+      }
+}
@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLATBYTECODE_HH
+#define _FLATBYTECODE_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "CodeInterpreter.hh"
+
+using namespace std;
+
+/*! \file
+  The flat bytecode format.
+
+  A flat bytecode file (.fbc) contains the same code as the .cod file read by
+  the bytecode DLL, in a form that can be mapped in memory and run without any
+  decoding. It is made of four sections, each starting at a multiple of
+  flat_bytecode_alignment bytes from the beginning of the file:
+  - the header (FlatBytecodeHeader), which starts with flat_bytecode_magic and
+    the version of the format, and gives the position of the other sections;
+  - the instruction stream, in one of two instruction sets (see
+    FlatInstructionSet);
+  - the constant pool, as doubles;
+  - the Jacobian table: one FlatJacobianElement per element of the Jacobian
+    stored by the code.
+
+  Integers and doubles are stored in the byte order of the machine that wrote
+  the file, which the byte_order field of the header allows to check.
+
+  The temporary terms, the U vector, the residuals and the evaluation stack are
+  not stored in the file, but the header gives their sizes so that a reader can
+  allocate them once and for all. */
+
+const char flat_bytecode_magic[8] = { 'D', 'Y', 'N', 'F', 'B', 'C', '\0', '\0' };
+const uint32_t flat_bytecode_version = 2;
+const uint32_t flat_bytecode_byte_order = 0x01020304;
+const uint64_t flat_bytecode_alignment = 64;
+
+//! Instruction sets of the flat bytecode
+enum class FlatInstructionSet : uint32_t
+  {
+    //! The stack machine of the .cod files: one FlatInstruction per instruction of the .cod file, in the same order, so that the number of instructions skipped by FJMP and FJMPIFEVAL is unchanged; FLDC loads from the constant pool
+    stack,
+    //! Straight-line code of FlatRegisterInstruction, compiled from the expression trees of the model
+    registers
+  };
+
+struct FlatBytecodeHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t header_size;            //!< sizeof(FlatBytecodeHeader)
+  uint32_t dynamic;                //!< 1 for the dynamic model, 0 for the static model
+  uint32_t endo_nbr, exo_nbr, exo_det_nbr, param_nbr;
+  int32_t max_lag, max_lead;
+  uint32_t residual_nbr;           //!< Size of the residual vector
+  uint32_t temporary_terms_nbr;    //!< Size of the temporary terms vector
+  uint32_t u_nbr;                  //!< Size of the U vector
+  uint32_t stack_size;             //!< Maximal depth of the evaluation stack
+  uint32_t block_nbr;              //!< Number of FBEGINBLOCK instructions
+  uint32_t instruction_set;        //!< A value of FlatInstructionSet
+  uint64_t instructions_offset, instruction_nbr;
+  uint64_t constants_offset, constant_nbr;
+  uint64_t jacobian_offset, jacobian_nnz;
+};
+
+//! An instruction of the flat bytecode
+/*! The meaning of the fields depends on op_code (a value of Tags):
+  - FLDV, FSTPV, FLDSV, FSTPSV, FLDVS: type is the SymbolType, arg the
+    type specific ID of the variable (exogenous deterministic variables come
+    after the exogenous variables), lag its lead or lag;
+  - FLDC: arg is the index in the constant pool;
+  - FSTPG, FSTPG2, FSTPG3: arg is the index in the Jacobian table;
+  - FUNARY, FBINARY, FTRINARY: type is the UnaryOpcode, BinaryOpcode or
+    TrinaryOpcode; FBINARY with BinaryOpcode::powerDeriv has three operands,
+    the first one being the order of the derivative;
+  - FJMP, FJMPIFEVAL: arg is the number of instructions to skip;
+  - FBEGINBLOCK: type is the BlockSimulationType, arg the number of the block;
+  - otherwise, arg is the single argument of the original instruction. */
+struct FlatInstruction
+{
+  uint8_t op_code;
+  uint8_t type;
+  int16_t lag;
+  uint32_t arg;
+};
+
+//! Opcodes of the register-based instruction set
+/*! The result of instruction i is stored in register i. The registers
+  following those of the instructions hold the constant pool, so that
+  constants need no instruction. The fused instructions (multiplyAdd,
+  parameterTimesVariable, powerInteger, residual) replace the most common
+  sequences of instructions of the stack machine */
+enum class FlatRegisterOpcode : uint8_t
+  {
+    load,                   //!< Loads variable arg1 of SymbolType type, with lead or lag lag
+    loadSteadyState,        //!< Loads the steady state of variable arg1 of SymbolType type (STEADY_STATE operator)
+    unary,                  //!< Applies UnaryOpcode type to register arg1
+    binary,                 //!< Applies BinaryOpcode type to registers arg1 and arg2
+    trinary,                //!< Applies TrinaryOpcode type to registers arg1, arg2 and arg3
+    powerDeriv,             //!< Derivative of order arg3 of register arg1 raised to the power of register arg2
+    multiplyAdd,            //!< Register arg1 times register arg2 plus register arg3
+    parameterTimesVariable, //!< Parameter arg2 times the variable loaded as by load
+    powerInteger,           //!< Register arg1 raised to the power of (int32_t) arg2, by repeated multiplications (only generated for 2 and -1, for which the result is that of pow())
+    residual,               //!< Stores register arg2 minus register arg3 as residual arg1
+    endResiduals,           //!< Ends the evaluation when only the residuals are requested
+    jacobian,               //!< Stores register arg2 as element arg1 of the Jacobian
+    end                     //!< Ends the evaluation
+  };
+
+//! An instruction of the register-based instruction set
+struct FlatRegisterInstruction
+{
+  uint8_t op_code; //!< A value of FlatRegisterOpcode
+  uint8_t type;
+  int16_t lag;
+  uint32_t arg1, arg2, arg3;
+};
+
+//! An element of the Jacobian table
+struct FlatJacobianElement
+{
+  uint32_t equation;
+  uint32_t variable;
+  int32_t lag;
+  uint32_t type; //!< ExpressionType of the derivative
+};
+
+static_assert(sizeof(FlatBytecodeHeader) == 120, "Unexpected size of FlatBytecodeHeader");
+static_assert(sizeof(FlatInstruction) == 8, "Unexpected size of FlatInstruction");
+static_assert(sizeof(FlatRegisterInstruction) == 16, "Unexpected size of FlatRegisterInstruction");
+static_assert(sizeof(FlatJacobianElement) == 16, "Unexpected size of FlatJacobianElement");
+
+//! A flat bytecode file, mapped in memory
+class FlatBytecode
+{
+private:
+  boost::interprocess::file_mapping file;
+  boost::interprocess::mapped_region region;
+  const FlatBytecodeHeader *header;
+  const void *instructions;
+  const double *constants;
+  const FlatJacobianElement *jacobian;
+  //! Checks that the instructions only refer to existing elements and fit in the stack
+  /*! Returns an empty string if the code is valid, an error message otherwise */
+  string checkInstructions() const;
+  string checkRegisterInstructions() const;
+  //! Returns the number of operands taken from the stack by an instruction, and the change of the depth of the stack
+  static pair<int, int> stackEffect(const FlatInstruction &instruction);
+public:
+  //! Maps the file and checks its contents
+  /*! Exits with an error message if the file is not a valid flat bytecode
+    file, so that the interpreter does not need to check the instructions */
+  explicit FlatBytecode(const string &filename);
+  inline const FlatBytecodeHeader &
+  getHeader() const
+  {
+    return *header;
+  };
+  //! Returns the instructions, if the instruction set is FlatInstructionSet::stack
+  inline const FlatInstruction *
+  getInstructions() const
+  {
+    return static_cast<const FlatInstruction *>(instructions);
+  };
+  //! Returns the instructions, if the instruction set is FlatInstructionSet::registers
+  inline const FlatRegisterInstruction *
+  getRegisterInstructions() const
+  {
+    return static_cast<const FlatRegisterInstruction *>(instructions);
+  };
+  inline const double *
+  getConstants() const
+  {
+    return constants;
+  };
+  inline const FlatJacobianElement *
+  getJacobian() const
+  {
+    return jacobian;
+  };
+  //! Returns the number of instructions dispatched by an evaluation
+  /*! If residuals_only is true, the evaluation only computes the residuals
+    (see FlatBytecodeInterpreter::evaluate()) */
+  uint64_t dispatchedInstructions(bool residuals_only) const;
+  //! Converts a .cod file into a flat bytecode file
+  /*! The dimensions of the model (endo_nbr, exo_nbr, exo_det_nbr, param_nbr,
+    max_lag, max_lead and dynamic) are taken from the header given in argument,
+    the other fields are computed from the code.
+    Returns false, without writing anything, if the code contains
+    instructions that have no equivalent in the flat format (calls to external
+    functions) */
+  static bool convert(const string &code_filename, const string &filename, FlatBytecodeHeader header);
+};
+
+//! Builder of flat bytecode in the register-based instruction set
+/*! The code is built by ExprNode::addToRegisterCode(), which adds each node of
+  the expression DAG once (a node inside a STEADY_STATE operator is
+  distinct from the same node outside it), and chooses fused instructions by
+  matching the shape of the nodes. */
+class FlatRegisterCode
+{
+private:
+  const bool dynamic;
+  vector<FlatRegisterInstruction> instructions;
+  vector<double> constants;
+  vector<FlatJacobianElement> jacobian;
+  uint32_t residual_nbr{0};
+  //! Register holding the value of each node already in the code, indexed by node index and STEADY_STATE context
+  map<pair<int, bool>, uint32_t> registers;
+  //! Registers of constants are numbered from this flag until the code is written, since the number of instructions is not known before
+  static const uint32_t constant_flag = 1u << 30;
+  uint32_t append(FlatRegisterOpcode op_code, uint8_t type, int lag, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+public:
+  //! Set when an expression has no equivalent in the instruction set (calls to external functions...)
+  bool unsupported{false};
+  explicit FlatRegisterCode(bool dynamic_arg);
+  //! Returns the register holding the value of a node, or -1 if the node is not yet in the code
+  int find(int node_idx, bool steady_state) const;
+  //! Records the register holding the value of a node, and returns it
+  uint32_t setRegister(int node_idx, bool steady_state, uint32_t reg);
+  //! The following functions append an instruction and return the register of its result
+  /*! Their arguments are registers, except for symbol type specific IDs,
+    parameter IDs and exponents */
+  uint32_t addConstant(double value);
+  uint32_t addLoad(SymbolType type, int tsid, int lag, bool steady_state);
+  uint32_t addUnary(UnaryOpcode op_code, uint32_t arg);
+  uint32_t addBinary(BinaryOpcode op_code, uint32_t arg1, uint32_t arg2);
+  uint32_t addTrinary(TrinaryOpcode op_code, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+  uint32_t addPowerDeriv(uint32_t arg1, uint32_t arg2, int order);
+  uint32_t addMultiplyAdd(uint32_t arg1, uint32_t arg2, uint32_t arg3);
+  uint32_t addParameterTimesVariable(int param_tsid, SymbolType type, int tsid, int lag);
+  uint32_t addPowerInteger(uint32_t arg, int exponent);
+  //! Stores lhs minus rhs as the next residual
+  void addResidual(uint32_t lhs, uint32_t rhs);
+  //! Marks the end of the computation of the residuals
+  void addEndResiduals();
+  //! Stores a register as the next element of the Jacobian
+  void addJacobian(const FlatJacobianElement &element, uint32_t arg);
+  //! Writes the code to a flat bytecode file
+  /*! The dimensions of the model are taken from the header given in argument,
+    as in FlatBytecode::convert() */
+  void write(const string &filename, FlatBytecodeHeader header);
+};
+
+//! Reference interpreter of the flat bytecode
+/*! It runs the instructions once, and thus computes the residuals and the
+  Jacobian at a given period. Code in the stack instruction set is run the
+  way the bytecode DLL does when it only evaluates the model (i.e. the jumps
+  of FJMPIFEVAL are taken).
+  The endogenous variables of the dynamic model are stored period by period:
+  variable k at period t is y[t*endo_nbr+k]. The exogenous variables are a
+  nb_row_x × (exo_nbr+exo_det_nbr) matrix, stored column by column. In the
+  static model, y and x hold a single value per variable. FLDVS (the
+  STEADY_STATE operator) reads the endogenous variables in steady_state and the
+  exogenous variables in the first row of x. The Jacobian is
+  stored as a vector of jacobian_nnz elements, described by the Jacobian
+  table. */
+class FlatBytecodeInterpreter
+{
+private:
+  const FlatBytecode &code;
+  vector<double> T, u, stack, registers;
+  void evaluateStack(double *y, const double *x, int nb_row_x, const double *params,
+                     const double *steady_state, int it_, double *residual, double *g1);
+  void evaluateRegisters(const double *y, const double *x, int nb_row_x, const double *params,
+                         const double *steady_state, int it_, double *residual, double *g1);
+public:
+  explicit FlatBytecodeInterpreter(const FlatBytecode &code_arg);
+  //! Evaluates the model
+  /*! If g1 is NULL, only the residuals are computed */
+  void evaluate(double *y, const double *x, int nb_row_x, const double *params,
+                const double *steady_state, int it_, double *residual, double *g1);
+};
+
+#endif
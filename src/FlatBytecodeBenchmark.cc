@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file
+  Measures the cost of running a flat bytecode file (see FlatBytecode.hh)
+  with the reference interpreter.
+
+  Usage: flat_bytecode_benchmark <file.fbc> [replications]
+
+  The model is evaluated at arbitrary values of the variables and parameters,
+  so that the timings do not depend on the calibration of the model. Both
+  full evaluations (residuals and Jacobian) and evaluations of the residuals
+  alone are timed, with the number of instructions dispatched by each, so
+  that the stack and register-based versions of a model can be compared. */
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+
+#include "FlatBytecode.hh"
+
+int
+main(int argc, char **argv)
+{
+  if (argc < 2 || argc > 3)
+    {
+      cerr << "Usage: " << argv[0] << " <file.fbc> [replications]" << endl;
+      exit(EXIT_FAILURE);
+    }
+  int replications = argc == 3 ? atoi(argv[2]) : 10000;
+  if (replications <= 0)
+    {
+      cerr << "Error: the number of replications must be positive" << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  FlatBytecode code(argv[1]);
+  const FlatBytecodeHeader &header = code.getHeader();
+  FlatBytecodeInterpreter interpreter(code);
+
+  int periods = header.dynamic ? header.max_lag + header.max_lead + 1 : 1;
+  int it_ = header.dynamic ? header.max_lag : 0;
+  int exo_nbr = header.exo_nbr + header.exo_det_nbr;
+  vector<double> y(periods * header.endo_nbr), x(periods * exo_nbr), params(header.param_nbr),
+    steady_state(header.endo_nbr), residual(header.residual_nbr), g1(header.jacobian_nnz);
+  for (size_t i = 0; i < y.size(); i++)
+    y[i] = 1 + 0.01 * (i % 17);
+  for (size_t i = 0; i < x.size(); i++)
+    x[i] = 0.01 * (i % 7);
+  for (size_t i = 0; i < params.size(); i++)
+    params[i] = 0.5 + 0.01 * (i % 13);
+  for (size_t i = 0; i < steady_state.size(); i++)
+    steady_state[i] = 1;
+
+  // The variables assigned by the code must be reset before each evaluation
+  vector<double> y0 = y;
+  auto time = [&](double *g)
+    {
+      interpreter.evaluate(y.data(), x.data(), periods, params.data(), steady_state.data(), it_,
+                           residual.data(), g);
+      auto start = chrono::steady_clock::now();
+      for (int r = 0; r < replications; r++)
+        {
+          copy(y0.begin(), y0.end(), y.begin());
+          interpreter.evaluate(y.data(), x.data(), periods, params.data(), steady_state.data(), it_,
+                               residual.data(), g);
+        }
+      chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+      return elapsed.count() / replications;
+    };
+  double residuals_time = time(nullptr);
+  double full_time = time(g1.data());
+  uint64_t residuals_dispatched = code.dispatchedInstructions(true);
+  uint64_t full_dispatched = code.dispatchedInstructions(false);
+
+  double checksum = 0;
+  for (auto r : residual)
+    checksum += r;
+  for (auto g : g1)
+    checksum += g;
+
+  cout << "Instruction set: "
+       << (header.instruction_set == static_cast<uint32_t>(FlatInstructionSet::stack) ? "stack" : "registers") << endl
+       << "Instructions: " << header.instruction_nbr << endl
+       << "Constants: " << header.constant_nbr << ", temporary terms: " << header.temporary_terms_nbr
+       << ", stack size: " << header.stack_size << endl
+       << "Residuals: " << header.residual_nbr << ", Jacobian elements: " << header.jacobian_nnz << endl
+       << "Residuals only: " << residuals_dispatched << " instructions dispatched, "
+       << residuals_time << " ns per evaluation, " << residuals_time / residuals_dispatched << " ns per instruction" << endl
+       << "Residuals and Jacobian: " << full_dispatched << " instructions dispatched, "
+       << full_time << " ns per evaluation, " << full_time / full_dispatched << " ns per instruction" << endl
+       << "Checksum: " << checksum << endl;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <algorithm>
+
+#include "IncidenceMatrix.hh"
+
+IncidenceMatrix::IncidenceMatrix(int nrows_arg, int ncols_arg, const vector<Element> &elements) :
+  nrows{nrows_arg}, ncols{ncols_arg}, row_begin(nrows + 1, 0), col_begin(ncols + 1, 0)
+{
+  // Bucket the elements by row, keeping their order within each row
+  for (const auto &e : elements)
+    {
+      assert(e.row >= 0 && e.row < nrows && e.col >= 0 && e.col < ncols);
+      row_begin[e.row + 1]++;
+    }
+  for (int i = 0; i < nrows; i++)
+    row_begin[i+1] += row_begin[i];
+  vector<const Element *> sorted(elements.size());
+  vector<int> next(row_begin.begin(), row_begin.end() - 1);
+  for (const auto &e : elements)
+    sorted[next[e.row]++] = &e;
+
+  // Sort each row by column, and merge the duplicates
+  cols.reserve(elements.size());
+  static_values.reserve(elements.size());
+  contemporaneous_values.reserve(elements.size());
+  contemporaneous.reserve(elements.size());
+  int begin = 0;
+  for (int i = 0; i < nrows; i++)
+    {
+      int end = row_begin[i+1];
+      stable_sort(sorted.begin() + begin, sorted.begin() + end, [](const Element *a, const Element *b)
+                  {
+                    return a->col < b->col;
+                  });
+      row_begin[i] = cols.size();
+      for (int k = begin; k < end; k++)
+        {
+          const Element &e = *sorted[k];
+          if (k > begin && e.col == cols.back())
+            {
+              static_values.back() += e.static_value;
+              if (e.contemporaneous)
+                {
+                  contemporaneous_values.back() += e.contemporaneous_value;
+                  contemporaneous.back() = true;
+                }
+              continue;
+            }
+          cols.push_back(e.col);
+          static_values.push_back(e.static_value);
+          contemporaneous.push_back(e.contemporaneous);
+          contemporaneous_values.push_back(e.contemporaneous ? e.contemporaneous_value : 0);
+        }
+      begin = end;
+    }
+  row_begin[nrows] = cols.size();
+
+  // Transpose into the compressed sparse column form (the rows come out sorted)
+  for (int col : cols)
+    col_begin[col + 1]++;
+  for (int j = 0; j < ncols; j++)
+    col_begin[j+1] += col_begin[j];
+  rows.resize(cols.size());
+  next.assign(col_begin.begin(), col_begin.end() - 1);
+  for (int i = 0; i < nrows; i++)
+    for (int pos = row_begin[i]; pos < row_begin[i+1]; pos++)
+      rows[next[cols[pos]]++] = i;
+}
+
+vector<IncidenceMatrix::Element>
+IncidenceMatrix::getElements() const
+{
+  vector<Element> elements;
+  elements.reserve(cols.size());
+  for (int i = 0; i < nrows; i++)
+    for (int pos = row_begin[i]; pos < row_begin[i+1]; pos++)
+      elements.push_back({ i, cols[pos], static_values[pos], contemporaneous[pos], contemporaneous_values[pos] });
+  return elements;
+}
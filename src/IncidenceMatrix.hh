@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _INCIDENCEMATRIX_HH
+#define _INCIDENCEMATRIX_HH
+
+#include <vector>
+
+using namespace std;
+
+//! Sparse incidence matrix of the endogenous variables in the equations of a model
+/*! Rows are equations, columns are endogenous variables (type specific IDs).
+  The matrix is stored both in compressed sparse row form (the elements of
+  row i are at positions rowBegin(i) to rowEnd(i)-1, sorted by column) and in
+  compressed sparse column form (the rows in which column j appears are
+  getRow(colBegin(j)) to getRow(colEnd(j)-1), sorted), so that it can be
+  traversed in either direction in time proportional to its number of
+  elements.
+
+  Each element carries the value of the static Jacobian (the sum of the
+  derivatives w.r. to the variable at all its leads and lags) and, when the
+  variable appears at the current period, the value of the contemporaneous
+  Jacobian. */
+class IncidenceMatrix
+{
+public:
+  //! An element of the matrix, as given to the constructor
+  struct Element
+  {
+    int row, col;
+    double static_value;
+    //! Whether the variable appears at the current period
+    bool contemporaneous;
+    double contemporaneous_value;
+  };
+private:
+  int nrows{0}, ncols{0};
+  //! Compressed sparse row form
+  vector<int> row_begin{0}, cols;
+  vector<double> static_values, contemporaneous_values;
+  vector<bool> contemporaneous;
+  //! Compressed sparse column form
+  vector<int> col_begin{0}, rows;
+public:
+  IncidenceMatrix() = default;
+  //! Builds the matrix from elements given in any order
+  /*! Duplicate elements are merged: their values are summed (in the order in
+    which they are given), and the merged element is contemporaneous if one of
+    them is. */
+  IncidenceMatrix(int nrows_arg, int ncols_arg, const vector<Element> &elements);
+  int
+  getRowNbr() const
+  {
+    return nrows;
+  };
+  int
+  getColNbr() const
+  {
+    return ncols;
+  };
+  //! Number of elements
+  int
+  getNnz() const
+  {
+    return cols.size();
+  };
+  int
+  rowBegin(int row) const
+  {
+    return row_begin[row];
+  };
+  int
+  rowEnd(int row) const
+  {
+    return row_begin[row+1];
+  };
+  //! Column of the element at a given position of the compressed sparse row form
+  int
+  getCol(int pos) const
+  {
+    return cols[pos];
+  };
+  double
+  getStaticValue(int pos) const
+  {
+    return static_values[pos];
+  };
+  bool
+  isContemporaneous(int pos) const
+  {
+    return contemporaneous[pos];
+  };
+  double
+  getContemporaneousValue(int pos) const
+  {
+    return contemporaneous_values[pos];
+  };
+  int
+  colBegin(int col) const
+  {
+    return col_begin[col];
+  };
+  int
+  colEnd(int col) const
+  {
+    return col_begin[col+1];
+  };
+  //! Row of the element at a given position of the compressed sparse column form
+  int
+  getRow(int pos) const
+  {
+    return rows[pos];
+  };
+  //! Returns the elements of the matrix, sorted by row and then by column
+  vector<Element> getElements() const;
+};
+
+#endif
@@ -18,6 +18,8 @@
  */
 
 #include <iostream>
+#include <algorithm>
+#include <utility>
 
 #include "MinimumFeedbackSet.hh"
 
@@ -456,4 +458,297 @@ namespace MFS
     if (num_vertices(G))
       cout << "Error in the computation of feedback vertex set\n";
   }
+
+  FlatGraph::FlatGraph(vector<int> original_index_arg) :
+    original_index{std::move(original_index_arg)},
+    in(original_index.size()), out(original_index.size()),
+    next(original_index.size()), prev(original_index.size())
+  {
+    nb_vertices = original_index.size();
+    for (int v = 0; v < nb_vertices; v++)
+      {
+        prev[v] = v - 1;
+        next[v] = v + 1 < nb_vertices ? v + 1 : -1;
+      }
+    if (nb_vertices > 0)
+      first = 0;
+  }
+
+  void
+  FlatGraph::add_edge(int source, int target)
+  {
+    if (edges.insert(edgeKey(source, target)).second)
+      {
+        out[source].push_back(target);
+        in[target].push_back(source);
+      }
+  }
+
+  void
+  FlatGraph::Suppress(int v)
+  {
+    for (int target : out[v])
+      {
+        edges.erase(edgeKey(v, target));
+        if (target != v)
+          in[target].erase(find(in[target].begin(), in[target].end(), v));
+      }
+    for (int source : in[v])
+      if (source != v)
+        {
+          edges.erase(edgeKey(source, v));
+          out[source].erase(find(out[source].begin(), out[source].end(), v));
+        }
+    vector<int>().swap(in[v]);
+    vector<int>().swap(out[v]);
+
+    if (prev[v] >= 0)
+      next[prev[v]] = next[v];
+    else
+      first = next[v];
+    if (next[v] >= 0)
+      prev[next[v]] = prev[v];
+    nb_vertices--;
+  }
+
+  FlatGraph
+  extract_flat_subgraph(const AdjacencyList_t &G1, const set<int> &select_index)
+  {
+    auto v1_index = get(vertex_index, G1);
+    vector<int> original_index(select_index.begin(), select_index.end());
+    map<int, int> reverse_index;
+    for (int i = 0; i < static_cast<int>(original_index.size()); i++)
+      reverse_index[original_index[i]] = i;
+    /* The vertices of G1 are fetched in a single pass, since vertex() walks
+       the list of vertices */
+    vector<AdjacencyList_t::vertex_descriptor> descriptors;
+    descriptors.reserve(original_index.size());
+    auto its = select_index.begin();
+    AdjacencyList_t::vertex_iterator it, it_end;
+    int num = 0;
+    for (tie(it, it_end) = vertices(G1); it != it_end && its != select_index.end(); ++it, num++)
+      if (num == *its)
+        {
+          descriptors.push_back(*it);
+          ++its;
+        }
+
+    FlatGraph G(original_index);
+    for (int i = 0; i < static_cast<int>(descriptors.size()); i++)
+      {
+        AdjacencyList_t::out_edge_iterator it_out, out_end;
+        for (tie(it_out, out_end) = out_edges(descriptors[i], G1); it_out != out_end; ++it_out)
+          {
+            auto it_target = reverse_index.find(v1_index[target(*it_out, G1)]);
+            if (it_target != reverse_index.end())
+              G.add_edge(i, it_target->second);
+          }
+      }
+    return G;
+  }
+
+  /*! Applies a rule to the vertices, following the traversal of the
+    AdjacencyList_t version of the steps: when a vertex has been removed, the
+    traversal resumes after the previous vertex, or after the first vertex of
+    the graph if the removed vertex was the first one (the new first vertex
+    is then skipped). rule(v) returns true if v has been removed. */
+  template<typename Rule>
+  static bool
+  apply_rule(FlatGraph &G, Rule rule)
+  {
+    bool something_has_been_done = false;
+    int i = 0, previous = -1;
+    for (int v = G.first_vertex(); v >= 0; v = G.next_vertex(v), i++)
+      {
+        if (rule(v))
+          {
+            something_has_been_done = true;
+            if (i > 0)
+              v = previous;
+            else
+              {
+                v = G.first_vertex();
+                i--;
+                if (v < 0)
+                  break;
+              }
+          }
+        previous = v;
+      }
+    return something_has_been_done;
+  }
+
+  void
+  Eliminate(int vertex_to_eliminate, FlatGraph &G)
+  {
+    const vector<int> &in = G.in_vertices(vertex_to_eliminate), &out = G.out_vertices(vertex_to_eliminate);
+    if (!in.empty() && !out.empty())
+      for (int source : in)
+        for (int target : out)
+          G.add_edge(source, target);
+    G.Suppress(vertex_to_eliminate);
+  }
+
+  bool
+  Vertex_Belong_to_a_Clique(int vertex, const FlatGraph &G)
+  {
+    const vector<int> &in = G.in_vertices(vertex), &out = G.out_vertices(vertex);
+    vector<int> liste;
+    bool agree = true;
+    size_t k = 0;
+    for (; k < in.size() && k < out.size() && agree; k++)
+      {
+        agree = (in[k] == out[k] && in[k] != vertex); //not a loop
+        liste.push_back(in[k]);
+      }
+    if (agree)
+      {
+        if (k < in.size() || k < out.size())
+          agree = false;
+        for (size_t i = 1; i < liste.size() && agree; i++)
+          for (size_t j = i + 1; j < liste.size() && agree; j++)
+            agree = G.has_edge(liste[i], liste[j]) && G.has_edge(liste[j], liste[i]);
+      }
+    return agree;
+  }
+
+  bool
+  Elimination_of_Vertex_With_One_or_Less_Indegree_or_Outdegree_Step(FlatGraph &G)
+  {
+    return apply_rule(G, [&G](int v)
+                      {
+                        size_t in_degree_n = G.in_vertices(v).size(), out_degree_n = G.out_vertices(v).size();
+                        // Do not eliminate a vertex if it loops on itself!
+                        if ((in_degree_n <= 1 || out_degree_n <= 1) && !G.has_edge(v, v))
+                          {
+                            Eliminate(v, G);
+                            return true;
+                          }
+                        return false;
+                      });
+  }
+
+  bool
+  Elimination_of_Vertex_belonging_to_a_clique_Step(FlatGraph &G)
+  {
+    return apply_rule(G, [&G](int v)
+                      {
+                        if (Vertex_Belong_to_a_Clique(v, G))
+                          {
+                            Eliminate(v, G);
+                            return true;
+                          }
+                        return false;
+                      });
+  }
+
+  bool
+  Suppression_of_Vertex_X_if_it_loops_store_in_set_of_feedback_vertex_Step(set<int> &feed_back_vertices, FlatGraph &G)
+  {
+    return apply_rule(G, [&](int v)
+                      {
+                        if (G.has_edge(v, v))
+                          {
+                            feed_back_vertices.insert(v);
+                            G.Suppress(v);
+                            return true;
+                          }
+                        return false;
+                      });
+  }
+
+  bool
+  has_cycle(const FlatGraph &G)
+  {
+    // Depth-first search with an explicit stack, since blocks can be large
+    vector<default_color_type> color(G.vertex_id_bound(), white_color);
+    vector<pair<int, size_t>> stack;
+    for (int root = G.first_vertex(); root >= 0; root = G.next_vertex(root))
+      if (color[root] == white_color)
+        {
+          color[root] = gray_color;
+          stack.emplace_back(root, 0);
+          while (!stack.empty())
+            {
+              int u = stack.back().first;
+              size_t &k = stack.back().second;
+              const vector<int> &out = G.out_vertices(u);
+              if (k < out.size())
+                {
+                  int v = out[k++];
+                  if (color[v] == gray_color)
+                    return true;
+                  if (color[v] == white_color)
+                    {
+                      color[v] = gray_color;
+                      stack.emplace_back(v, 0);
+                    }
+                }
+              else
+                {
+                  color[u] = black_color;
+                  stack.pop_back();
+                }
+            }
+        }
+    return false;
+  }
+
+  FlatGraph
+  Minimal_set_of_feedback_vertex(set<int> &feed_back_vertices, const FlatGraph &G1)
+  {
+    bool something_has_been_done = true;
+    feed_back_vertices.clear();
+    FlatGraph G(G1);
+    while (G.num_vertices() > 0)
+      {
+        while (something_has_been_done && G.num_vertices() > 0)
+          {
+            //Rule 1
+            something_has_been_done = Elimination_of_Vertex_With_One_or_Less_Indegree_or_Outdegree_Step(G);
+            //Rule 2
+            something_has_been_done = (Elimination_of_Vertex_belonging_to_a_clique_Step(G) || something_has_been_done);
+            //Rule 3
+            something_has_been_done = (Suppression_of_Vertex_X_if_it_loops_store_in_set_of_feedback_vertex_Step(feed_back_vertices, G) || something_has_been_done);
+          }
+        if (!has_cycle(G))
+          return G;
+        /*if nothing has been done in the three previous rules then cut the
+          vertex with the maximum in_degree+out_degree*/
+        size_t max_degree = 0;
+        int max_degree_index = -1;
+        for (int v = G.first_vertex(); v >= 0; v = G.next_vertex(v))
+          if (G.in_vertices(v).size() + G.out_vertices(v).size() > max_degree)
+            {
+              max_degree = G.in_vertices(v).size() + G.out_vertices(v).size();
+              max_degree_index = v;
+            }
+        feed_back_vertices.insert(max_degree_index);
+        G.Suppress(max_degree_index);
+        something_has_been_done = true;
+      }
+    return G;
+  }
+
+  void
+  Reorder_the_recursive_variables(const FlatGraph &G1, const set<int> &feedback_vertices, vector<int> &Reordered_Vertices)
+  {
+    FlatGraph G(G1);
+    for (int v : feedback_vertices)
+      G.Suppress(v);
+    bool something_has_been_done = true;
+    while (something_has_been_done)
+      something_has_been_done = apply_rule(G, [&](int v)
+                                           {
+                                             if (G.in_vertices(v).empty())
+                                               {
+                                                 Reordered_Vertices.push_back(G.index(v));
+                                                 G.Suppress(v);
+                                                 return true;
+                                               }
+                                             return false;
+                                           });
+    if (G.num_vertices())
+      cout << "Error in the computation of feedback vertex set\n";
+  }
 }
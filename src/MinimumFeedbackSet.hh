@@ -21,7 +21,10 @@
 #define _MINIMUMFEEDBACKSET_HH
 
 #include <map>
+#include <set>
 #include <vector>
+#include <unordered_set>
+#include <cstdint>
 #include <boost/graph/adjacency_list.hpp>
 
 using namespace std;
@@ -78,6 +81,96 @@ namespace MFS
   //! Reorder the recursive variables
   /*! They appear first in a quasi triangular form and they are followed by the feedback variables */
   void Reorder_the_recursive_variables(const AdjacencyList_t &G1, set<int> &feedback_vertices, vector< int> &Reordered_Vertices);
+
+  //! Directed graph stored in flat vectors, for the computation of the feedback set of large blocks
+  /*! The heuristic mostly removes vertices, and tests the existence of edges
+    when eliminating them. Here the vertices are numbered once and for all (0
+    to n-1) and chained in a doubly linked list, the predecessors and
+    successors of each vertex are stored in vectors, and the edges in a hash
+    set. Like in AdjacencyList_t, vertices and edges are kept in their order of
+    creation, so that the heuristic gives exactly the same results on both
+    representations. Parallel edges are not stored. */
+  class FlatGraph
+  {
+  private:
+    //! Index of each vertex in the graph from which it was extracted (i.e. the vertex_index property of AdjacencyList_t)
+    vector<int> original_index;
+    vector<vector<int>> in, out;
+    //! Doubly linked list of the vertices not yet suppressed (-1 at both ends)
+    vector<int> next, prev;
+    int first{-1}, nb_vertices{0};
+    unordered_set<uint64_t> edges;
+    static uint64_t
+    edgeKey(int source, int target)
+    {
+      return (static_cast<uint64_t>(source) << 32) | static_cast<uint32_t>(target);
+    }
+  public:
+    //! Creates a graph without edges, whose vertices have the given original indices
+    explicit FlatGraph(vector<int> original_index_arg);
+    int
+    num_vertices() const
+    {
+      return nb_vertices;
+    }
+    //! Upper bound on the vertex numbers (the number of vertices at creation)
+    int
+    vertex_id_bound() const
+    {
+      return original_index.size();
+    }
+    //! First vertex not yet suppressed (-1 if the graph is empty)
+    int
+    first_vertex() const
+    {
+      return first;
+    }
+    //! Vertex following v (-1 if v is the last one)
+    int
+    next_vertex(int v) const
+    {
+      return next[v];
+    }
+    int
+    index(int v) const
+    {
+      return original_index[v];
+    }
+    const vector<int> &
+    in_vertices(int v) const
+    {
+      return in[v];
+    }
+    const vector<int> &
+    out_vertices(int v) const
+    {
+      return out[v];
+    }
+    bool
+    has_edge(int source, int target) const
+    {
+      return edges.find(edgeKey(source, target)) != edges.end();
+    }
+    //! Adds an edge, if it does not already exist
+    void add_edge(int source, int target);
+    //! Clears all in and out edges of v, and removes v from the graph
+    void Suppress(int v);
+  };
+
+  //! Extracts a subgraph, in flat form
+  /*! Same as extract_subgraph(): FlatGraph::index() gives the indices of the
+    vertices in the original graph, while the vertex numbers are contiguous
+    and specific to the subgraph */
+  FlatGraph extract_flat_subgraph(const AdjacencyList_t &G1, const set<int> &select_index);
+  //! Same as the above functions, on a FlatGraph
+  void Eliminate(int vertex_to_eliminate, FlatGraph &G);
+  bool Vertex_Belong_to_a_Clique(int vertex, const FlatGraph &G);
+  bool Elimination_of_Vertex_With_One_or_Less_Indegree_or_Outdegree_Step(FlatGraph &G);
+  bool Elimination_of_Vertex_belonging_to_a_clique_Step(FlatGraph &G);
+  bool Suppression_of_Vertex_X_if_it_loops_store_in_set_of_feedback_vertex_Step(set<int> &feed_back_vertices, FlatGraph &G);
+  bool has_cycle(const FlatGraph &G);
+  FlatGraph Minimal_set_of_feedback_vertex(set<int> &feed_back_vertices, const FlatGraph &G1);
+  void Reorder_the_recursive_variables(const FlatGraph &G1, const set<int> &feedback_vertices, vector<int> &Reordered_Vertices);
 };
 
 #endif // _MINIMUMFEEDBACKSET_HH
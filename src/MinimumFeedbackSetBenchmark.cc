@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file
+  Compares the computation of the feedback variables of a block on the
+  AdjacencyList_t and FlatGraph representations (see MinimumFeedbackSet.hh).
+
+  Usage: mfs_benchmark [vertices] [out_degree] [seed]
+
+  The block is a random graph, made strongly connected by a cycle through all
+  its vertices, in which every vertex has on average out_degree other
+  successors. As in ModelTree::computeBlockDecompositionAndFeedbackVariablesForEachBlock(),
+  one vertex in twenty loops on itself, which forces it into the feedback
+  set. Both representations must give the same feedback set and the same
+  ordering of the recursive variables. */
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+
+#include "MinimumFeedbackSet.hh"
+
+using namespace MFS;
+
+int
+main(int argc, char **argv)
+{
+  if (argc > 4)
+    {
+      cerr << "Usage: " << argv[0] << " [vertices] [out_degree] [seed]" << endl;
+      exit(EXIT_FAILURE);
+    }
+  int n = argc >= 2 ? atoi(argv[1]) : 10000;
+  double out_degree = argc >= 3 ? atof(argv[2]) : 2;
+  unsigned int seed = argc >= 4 ? atoi(argv[3]) : 0;
+  if (n <= 1 || out_degree < 0)
+    {
+      cerr << "Error: the number of vertices must be greater than one, and the out-degree non-negative" << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  mt19937 gen(seed);
+  vector<int> cycle(n);
+  iota(cycle.begin(), cycle.end(), 0);
+  shuffle(cycle.begin(), cycle.end(), gen);
+  set<pair<int, int>> edges;
+  vector<pair<int, int>> edge_list;
+  auto add = [&](int source, int target)
+    {
+      if (edges.emplace(source, target).second)
+        edge_list.emplace_back(source, target);
+    };
+  for (int i = 0; i < n; i++)
+    add(cycle[i], cycle[(i + 1) % n]);
+  uniform_int_distribution<int> vertex_dist(0, n - 1);
+  poisson_distribution<int> degree_dist(out_degree);
+  for (int i = 0; i < n; i++)
+    for (int k = degree_dist(gen); k > 0; k--)
+      {
+        int j = vertex_dist(gen);
+        if (j != i)
+          add(i, j);
+      }
+  for (int i = 0; i < n; i += 20)
+    add(i, i);
+
+  AdjacencyList_t G2(n);
+  auto v_index = get(boost::vertex_index, G2);
+  for (int i = 0; i < n; i++)
+    put(v_index, vertex(i, G2), i);
+  vector<AdjacencyList_t::vertex_descriptor> descriptors;
+  AdjacencyList_t::vertex_iterator it, it_end;
+  for (tie(it, it_end) = vertices(G2); it != it_end; ++it)
+    descriptors.push_back(*it);
+  for (auto &e : edge_list)
+    add_edge(descriptors[e.first], descriptors[e.second], G2);
+  set<int> all_vertices;
+  for (int i = 0; i < n; i++)
+    all_vertices.insert(i);
+
+  auto time = [](auto f)
+    {
+      auto start = chrono::steady_clock::now();
+      f();
+      chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+      return elapsed.count();
+    };
+
+  set<int> feedback_vertices, flat_feedback_vertices;
+  vector<int> reordered_vertices, flat_reordered_vertices;
+  double boost_time = time([&]()
+                           {
+                             AdjacencyList_t G = extract_subgraph(G2, all_vertices);
+                             Minimal_set_of_feedback_vertex(feedback_vertices, G);
+                             Reorder_the_recursive_variables(G, feedback_vertices, reordered_vertices);
+                           });
+  double flat_time = time([&]()
+                          {
+                            FlatGraph G = extract_flat_subgraph(G2, all_vertices);
+                            Minimal_set_of_feedback_vertex(flat_feedback_vertices, G);
+                            Reorder_the_recursive_variables(G, flat_feedback_vertices, flat_reordered_vertices);
+                          });
+
+  bool identical = feedback_vertices == flat_feedback_vertices
+    && reordered_vertices == flat_reordered_vertices;
+  cout << "Vertices: " << n << ", edges: " << edge_list.size() << endl
+       << "Feedback vertices: " << feedback_vertices.size()
+       << ", recursive vertices: " << reordered_vertices.size() << endl
+       << "AdjacencyList_t: " << boost_time << " s" << endl
+       << "FlatGraph: " << flat_time << " s" << endl
+       << "Results: " << (identical ? "identical" : "DIFFERENT") << endl;
+  if (!identical)
+    exit(EXIT_FAILURE);
+}
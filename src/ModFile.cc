@@ -18,6 +18,7 @@
  */
 
 #include <cstdlib>
+#include <cctype>
 #include <iostream>
 #include <fstream>
 #include <typeinfo>
@@ -133,6 +134,12 @@ ModFile::checkPass(bool nostrict, bool stochastic)
   if (!mod_file_struct.order_option)
     mod_file_struct.order_option = 2;
 
+  if (!higher_order_equations.empty() && (linear || mod_file_struct.ramsey_model_present))
+    {
+      cerr << "ERROR: The 'higher_order_equations' option of the model block cannot be used with a linear model or with Ramsey policy." << endl;
+      exit(EXIT_FAILURE);
+    }
+
   param_used_with_lead_lag = dynamic_model.ParamUsedWithLeadLag();
   if (param_used_with_lead_lag)
     warnings << "WARNING: A parameter was used with a lead or a lag in the model block" << endl;
@@ -379,6 +386,7 @@ ModFile::transformPass(bool nostrict, bool stochastic, bool compute_xrefs, const
     for (auto & it1 : it.second)
       eqtags.insert(it1);
 
+  output_options.push_back("transform_unary_ops=" + to_string(transform_unary_ops));
   if (transform_unary_ops)
     dynamic_model.substituteUnaryOps(diff_static_model);
   else
@@ -673,8 +681,48 @@ ModFile::transformPass(bool nostrict, bool stochastic, bool compute_xrefs, const
 }
 
 void
-ModFile::computingPass(bool no_tmp_terms, FileOutputType output, int params_derivs_order, const bool nopreprocessoroutput)
+ModFile::computingPass(bool no_tmp_terms, FileOutputType output, int params_derivs_order, int nthreads,
+                       bool cse_tmp_terms, const string &tmp_terms_costs_file, bool tmp_terms_report,
+                       bool params_derivs_adjoint, const string &block_cache, bool flat_bytecode,
+                       const bool nopreprocessoroutput)
 {
+  static_model.nthreads = nthreads;
+  dynamic_model.nthreads = nthreads;
+  orig_ramsey_dynamic_model.nthreads = nthreads;
+  static_model.block_cache = block_cache;
+  dynamic_model.block_cache = block_cache;
+  static_model.flat_bytecode = flat_bytecode;
+  dynamic_model.flat_bytecode = flat_bytecode;
+  static_model.cse_temporary_terms = cse_tmp_terms;
+  dynamic_model.cse_temporary_terms = cse_tmp_terms;
+  orig_ramsey_dynamic_model.cse_temporary_terms = cse_tmp_terms;
+  static_model.temporary_terms_report = tmp_terms_report;
+  dynamic_model.temporary_terms_report = tmp_terms_report;
+  static_model.params_derivs_adjoint = params_derivs_adjoint;
+  dynamic_model.params_derivs_adjoint = params_derivs_adjoint;
+  output_options.push_back("output=" + to_string(static_cast<int>(output)));
+  output_options.push_back("params_derivs_order=" + to_string(params_derivs_order));
+  output_options.push_back("cse_tmpterms=" + to_string(cse_tmp_terms));
+  output_options.push_back("params_derivs_adjoint=" + to_string(params_derivs_adjoint));
+  output_options.push_back("flat_bytecode=" + to_string(flat_bytecode));
+  if (!tmp_terms_costs_file.empty())
+    {
+      OperatorCosts costs;
+      costs.readFile(tmp_terms_costs_file);
+      static_model.operator_costs = costs;
+      dynamic_model.operator_costs = costs;
+      orig_ramsey_dynamic_model.operator_costs = costs;
+      // The costs file is identified by its contents
+      ifstream input(tmp_terms_costs_file, ios::in | ios::binary);
+      ostringstream contents;
+      contents << input.rdbuf();
+      ContentHash costs_hash;
+      costs_hash.update(contents.str());
+      output_options.push_back("tmpterms_costs=" + costs_hash.hexDigest());
+    }
+  if (!higher_order_equations.empty())
+    dynamic_model.restrictHigherOrderDerivatives(higher_order_equations, warnings);
+
   // Mod file may have no equation (for example in a standalone BVAR estimation)
   if (dynamic_model.equation_number() > 0)
     {
@@ -770,18 +818,51 @@ ModFile::computingPass(bool no_tmp_terms, FileOutputType output, int params_deri
 void
 ModFile::writeOutputFiles(const string &basename, bool clear_all, bool clear_global, bool no_log, bool no_warn,
                           bool console, bool nograph, bool nointeractive, const ConfigFile &config_file,
-                          bool check_model_changes, bool minimal_workspace, bool compute_xrefs
+                          bool check_model_changes, bool minimal_workspace, bool compute_xrefs, int split_c_files,
+                          const string &compilation_cache, LanguageOutputType language
 #if defined(_WIN32) || defined(__CYGWIN32__)
                           , bool cygwin, bool msvc, bool mingw
 #endif
                           , const bool nopreprocessoroutput
                           ) const
 {
-  bool hasModelChanged = !dynamic_model.isChecksumMatching(basename);
-  if (!check_model_changes)
-    hasModelChanged = true;
+#if defined(_WIN32) || defined(__CYGWIN32__)
+  // The translation units are compiled by make, which these toolchains are not set up with
+  if (use_dll && split_c_files > 0 && (msvc || cygwin || mingw))
+    {
+      cerr << "ERROR: the split_c_files option cannot be used with the msvc, cygwin or mingw options" << endl;
+      exit(EXIT_FAILURE);
+    }
+#endif
 
-  if (hasModelChanged)
+  /* The digests of the outputs of the previous run are compared to the
+     current ones, computed on the DAG. The options changing the contents of
+     the outputs are part of the configuration entry: if it changed, or
+     without the fast option, everything is regenerated */
+  OutputManifest manifest(basename + "/manifest");
+  ContentHash configuration;
+  ostringstream version;
+  version << PACKAGE_VERSION;
+  configuration.update(version.str());
+  for (int option : { static_cast<int>(block), static_cast<int>(byte_code), static_cast<int>(use_dll),
+        split_c_files, mod_file_struct.order_option, static_cast<int>(no_static),
+        static_cast<int>(mod_file_struct.ramsey_model_present) })
+    configuration.update(static_cast<uint64_t>(option));
+  addOutputOptionsToDigest(configuration, language);
+  bool regenerate_all = manifest.update("configuration", configuration.hexDigest()) || !check_model_changes;
+  bool symbols_changed = manifest.update("symbols", computeSymbolsDigest());
+  map<string, string> static_digests = static_model.computeStructuralDigests();
+  bool static_changed = updateModelDigests(manifest, "static", static_digests, false) || symbols_changed;
+  bool dynamic_changed = updateModelDigests(manifest, "dynamic", dynamic_model.computeStructuralDigests(), false)
+    || symbols_changed;
+  ContentHash steady_state;
+  steady_state.update(steady_state_model.computeDefinitionsDigest());
+  // The auxiliary equations of the static model are also written to the steady state file
+  steady_state.update(static_digests["equations"]);
+  bool steady_state_changed = manifest.update("steady_state", steady_state.hexDigest()) || symbols_changed;
+  bool epilogue_changed = manifest.update("epilogue", epilogue.computeDefinitionsDigest()) || symbols_changed;
+
+  if (regenerate_all)
     {
       // Erase possible remnants of previous runs
       /* Under MATLAB+Windows (but not under Octave nor under GNU/Linux or
@@ -961,30 +1042,81 @@ ModFile::writeOutputFiles(const string &basename, bool clear_all, bool clear_glo
 
   // Compile the dynamic MEX file for use_dll option
   // When check_model_changes is true, don't force compile if MEX is fresher than source
-  if (use_dll)
+  ostringstream compile_code;
+  if (use_dll && split_c_files > 0)
+    {
+      // The translation units are compiled in parallel by make, which only rebuilds what changed
+      compile_code << "if isoctave" << endl
+                  << "    mex_cmd = ['MEX=\"mkoctfile --mex\" MEXOUT=-o MEXEXT=' mexext];" << endl
+                  << "else" << endl
+                  << "    mex_cmd = ['MEX=\"' fullfile(matlabroot, 'bin', 'mex') '\" MEXFLAGS=-O MEXEXT=' mexext];" << endl
+                  << "end" << endl;
+      vector<string> models;
+      if (!no_static)
+        models.push_back("static");
+      models.push_back("dynamic");
+      for (const auto &model : models)
+        compile_code << "[status, cmd_output] = system(['make -j -C " << basename << "/model/src -f " << model << ".mk ' mex_cmd]);" << endl
+                    << "if status" << endl
+                    << "    error(['Compilation of the " << model << " model failed: ' cmd_output])" << endl
+                    << "end" << endl;
+    }
+  else if (use_dll)
     {
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
       if (msvc)
         // MATLAB/Windows + Microsoft Visual C++
-        mOutputFile << "dyn_mex('msvc', '" << basename << "', " << !check_model_changes << ")" <<  endl;
+        compile_code << "dyn_mex('msvc', '" << basename << "', " << !check_model_changes << ")" <<  endl;
       else if (cygwin)
         // MATLAB/Windows + Cygwin g++
-        mOutputFile << "dyn_mex('cygwin', '" << basename << "', " << !check_model_changes << ")" << endl;
+        compile_code << "dyn_mex('cygwin', '" << basename << "', " << !check_model_changes << ")" << endl;
       else if (mingw)
         // MATLAB/Windows + MinGW g++
-        mOutputFile << "dyn_mex('mingw', '" << basename << "', " << !check_model_changes << ")" << endl;
+        compile_code << "dyn_mex('mingw', '" << basename << "', " << !check_model_changes << ")" << endl;
       else
-        mOutputFile << "if isoctave" << endl
+        compile_code << "if isoctave" << endl
                     << "    dyn_mex('', '" << basename << "', " << !check_model_changes << ")" << endl
                     << "else" << endl
                     << "    error('When using the USE_DLL option on Matlab, you must give the ''cygwin'', ''msvc'', or ''mingw'' option to the ''dynare'' command')" << endl
                     << "end" << endl;
 #else
       // other configurations
-      mOutputFile << "dyn_mex('', '" << basename << "', " << !check_model_changes << ")" << endl;
+      compile_code << "dyn_mex('', '" << basename << "', " << !check_model_changes << ")" << endl;
 #endif
     }
 
+  if (use_dll && !compilation_cache.empty())
+    {
+      // The compiler is only called if the cache holds no MEX files compiled from the same code
+      string cache = compilation_cache, indented_compile_code;
+      istringstream compile_lines(compile_code.str());
+      for (string line; getline(compile_lines, line);)
+        indented_compile_code += "    " + line + "\n";
+      for (size_t pos = cache.find('\''); pos != string::npos; pos = cache.find('\'', pos + 2))
+        cache.insert(pos, "'");
+      mOutputFile << "dyn_cache_entry = fullfile('" << cache << "', [strtrim(fileread('" << basename
+                  << "/model/src/compilation_cache_key')) '-' mexext]);" << endl
+                  << "if exist(dyn_cache_entry, 'dir')" << endl
+                  << "    copyfile(fullfile(dyn_cache_entry, ['*.' mexext]), '+" << basename << "');" << endl
+                  << "else" << endl
+                  << indented_compile_code
+                  << "    if ~exist('" << cache << "', 'dir')" << endl
+                  << "        mkdir('" << cache << "');" << endl
+                  << "    end" << endl
+                  // The entry is filled under a temporary name, so that concurrent runs never see it incomplete
+                  << "    dyn_cache_tmp = tempname('" << cache << "');" << endl
+                  << "    mkdir(dyn_cache_tmp);" << endl
+                  << "    copyfile(['+" << basename << "/*.' mexext], dyn_cache_tmp);" << endl
+                  << "    if exist(dyn_cache_entry, 'dir')" << endl
+                  << "        rmdir(dyn_cache_tmp, 's');" << endl
+                  << "    else" << endl
+                  << "        movefile(dyn_cache_tmp, dyn_cache_entry);" << endl
+                  << "    end" << endl
+                  << "end" << endl;
+    }
+  else
+    mOutputFile << compile_code.str();
+
   mOutputFile << "M_.orig_eq_nbr = " << mod_file_struct.orig_eq_nbr << ";" << endl
               << "M_.eq_nbr = " << dynamic_model.equation_number() << ";" << endl
               << "M_.ramsey_eq_nbr = " << mod_file_struct.ramsey_eq_nbr << ";" << endl
@@ -1055,46 +1187,394 @@ ModFile::writeOutputFiles(const string &basename, bool clear_all, bool clear_glo
 
   mOutputFile.close();
 
-  if (hasModelChanged)
+  // Create static and dynamic files
+  /* The files of a model are rewritten together, even if only some of its
+     parts changed, since they share the temporary terms */
+  if (dynamic_model.equation_number() > 0)
     {
-      // Create static and dynamic files
-      if (dynamic_model.equation_number() > 0)
+      if (!no_static && (regenerate_all || static_changed))
         {
-          if (!no_static)
-            {
-              static_model.writeStaticFile(basename, block, byte_code, use_dll, false);
-              static_model.writeParamsDerivativesFile(basename, false);
-            }
+          if (!regenerate_all)
+            removeModelFiles(basename, "static");
+          static_model.writeStaticFile(basename, block, byte_code, use_dll, false, split_c_files);
+          static_model.writeParamsDerivativesFile(basename, false);
+          static_model.writeParamsAdjointFile(basename);
+        }
 
-          dynamic_model.writeDynamicFile(basename, block, byte_code, use_dll, mod_file_struct.order_option, false);
+      if (regenerate_all || dynamic_changed)
+        {
+          if (!regenerate_all)
+            removeModelFiles(basename, "dynamic");
+          dynamic_model.writeDynamicFile(basename, block, byte_code, use_dll, mod_file_struct.order_option, false, split_c_files);
           dynamic_model.writeParamsDerivativesFile(basename, false);
+          dynamic_model.writeParamsAdjointFile(basename);
         }
+    }
 
-      // Create steady state file
+  // Create steady state file (nothing is written if there is no steady_state_model block)
+  if (regenerate_all || steady_state_changed)
+    {
+      boost::filesystem::remove("+" + basename + "/steadystate.m");
       steady_state_model.writeSteadyStateFile(basename, mod_file_struct.ramsey_model_present, false);
+    }
 
-      // Create epilogue file
+  // Create epilogue file (same remark)
+  if (regenerate_all || epilogue_changed)
+    {
+      boost::filesystem::remove("+" + basename + "/epilogue.m");
       epilogue.writeEpilogueFile(basename);
     }
 
+  boost::filesystem::create_directories(basename);
+  manifest.save();
+
+  if (use_dll && !compilation_cache.empty())
+    writeCompilationCacheKey(basename, compile_code.str(), split_c_files);
+
   if (!nopreprocessoroutput)
     cout << "done" << endl;
 }
 
+string
+ModFile::computeSymbolsDigest() const
+{
+  ContentHash hash;
+  for (int symb_id = 0; symb_id <= symbol_table.maxID(); symb_id++)
+    {
+      hash.update(static_cast<uint64_t>(symbol_table.getType(symb_id)));
+      hash.update(static_cast<uint64_t>(symbol_table.getTypeSpecificID(symb_id)));
+      string name = symbol_table.getName(symb_id);
+      hash.update(static_cast<uint64_t>(name.size()));
+      hash.update(name);
+    }
+  return hash.hexDigest();
+}
+
+bool
+ModFile::updateModelDigests(OutputManifest &manifest, const string &name, const map<string, string> &digests,
+                            bool with_lines) const
+{
+  bool changed = false;
+  for (const auto &it : digests)
+    if (with_lines || it.first != "lines")
+      changed = manifest.update(name + "/" + it.first, it.second) || changed;
+  return changed;
+}
+
+void
+ModFile::removeModelFiles(const string &basename, const string &name) const
+{
+  vector<boost::filesystem::path> files;
+  for (const auto &dir : { basename + "/model/src", basename + "/model/bytecode" })
+    if (boost::filesystem::is_directory(dir))
+      for (boost::filesystem::directory_iterator it(dir), end; it != end; ++it)
+        {
+          string filename = it->path().filename().string();
+          if (filename.compare(0, name.size() + 1, name + ".") == 0
+              || filename.compare(0, name.size() + 1, name + "_") == 0)
+            files.push_back(it->path());
+        }
+  for (const auto &file : files)
+    boost::filesystem::remove(file);
+}
+
+void
+ModFile::writeCompilationCacheKey(const string &basename, const string &compile_code, int split_c_files) const
+{
+  // Masks the paths containing the basename
+  auto mask = [&basename](string text)
+    {
+      const string placeholder = "<basename>";
+      for (const auto &path : { basename + "/model/src", "+" + basename + "/", "'" + basename + "'" })
+        for (size_t pos = text.find(path); pos != string::npos; pos = text.find(path, pos + placeholder.size()))
+          text.replace(pos, path.size(), placeholder);
+      return text;
+    };
+
+  string src_dir = basename + "/model/src";
+  auto readFile = [&src_dir](const string &file)
+    {
+      ifstream input(src_dir + "/" + file, ios::in | ios::binary);
+      if (!input.is_open())
+        {
+          cerr << "Error: Can't open file " << src_dir << "/" << file << " for reading" << endl;
+          exit(EXIT_FAILURE);
+        }
+      ostringstream contents;
+      contents << input.rdbuf();
+      return contents.str();
+    };
+
+  /* Only the sources that are compiled are hashed, not the objects or other
+     files that the compilation may leave in the directory. With split_c_files,
+     the translation units of a model are those of its makefile (which may not
+     have been rewritten by this run, if the model did not change). */
+  vector<string> files, models;
+  if (!no_static)
+    models.push_back("static");
+  models.push_back("dynamic");
+  for (const auto &model : models)
+    if (split_c_files > 0)
+      {
+        files.push_back(model + ".mk");
+        files.push_back(model + ".h");
+        istringstream makefile(readFile(model + ".mk"));
+        // The objects are listed one per line, as "\t<unit>.o \\"
+        for (string line; getline(makefile, line);)
+          {
+            if (line.size() > 2 && line.compare(line.size() - 2, 2, " \\") == 0)
+              line.erase(line.size() - 2);
+            if (line.size() > 3 && line[0] == '\t' && line.find(' ') == string::npos
+                && line.compare(line.size() - 2, 2, ".o") == 0)
+              files.push_back(line.substr(1, line.size() - 3) + ".c");
+          }
+      }
+    else
+      {
+        files.push_back(model + ".c");
+        files.push_back(model + "_mex.c");
+      }
+
+  ContentHash hash;
+  ostringstream version;
+  version << "Dynare compilation cache " << PACKAGE_VERSION;
+  hash.update(version.str());
+  hash.update(mask(compile_code));
+  for (const auto &file : files)
+    {
+      string masked = mask(readFile(file));
+      // The sizes delimit the names and contents of the files
+      hash.update((uint64_t) file.size());
+      hash.update(file);
+      hash.update((uint64_t) masked.size());
+      hash.update(masked);
+    }
+
+  string filename = src_dir + "/compilation_cache_key";
+  ofstream output(filename, ios::out | ios::binary);
+  if (!output.is_open())
+    {
+      cerr << "Error: Can't open file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  output << hash.hexDigest() << endl;
+  output.close();
+}
+
+void
+ModFile::addOutputOptionsToDigest(ContentHash &configuration, LanguageOutputType language) const
+{
+  configuration.update(static_cast<uint64_t>(language));
+  configuration.update(static_cast<uint64_t>(output_options.size()));
+  for (const auto &option : output_options)
+    {
+      configuration.update(static_cast<uint64_t>(option.size()));
+      configuration.update(option);
+    }
+}
+
 void
 ModFile::writeExternalFiles(const string &basename, FileOutputType output, LanguageOutputType language, const bool nopreprocessoroutput) const
 {
+  /* These files are not recorded in the manifest, and may overwrite files of
+     writeOutputFiles(): the next run with the fast option must regenerate
+     everything */
+  boost::filesystem::remove(basename + "/manifest");
+
   switch (language)
     {
     case LanguageOutputType::julia:
       writeExternalFilesJulia(basename, output, nopreprocessoroutput);
       break;
+    case LanguageOutputType::c:
+      writeExternalFilesC(basename, output, nopreprocessoroutput);
+      break;
     default:
       cerr << "This case shouldn't happen. Contact the authors of Dynare" << endl;
       exit(EXIT_FAILURE);
     }
 }
 
+void
+ModFile::writeExternalFilesC(const string &basename, FileOutputType output, const bool nopreprocessoroutput) const
+{
+  if (dynamic_model.equation_number() == 0)
+    {
+      cerr << "ERROR: the C library output (language=c) requires a model block" << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  if (!nopreprocessoroutput)
+    cout << "Processing outputs ..." << endl;
+
+  boost::filesystem::create_directories(basename + "/model/src");
+  string filename_h = basename + "/model/src/model.h";
+  string filename_symbols = basename + "/model/src/symbols.c";
+
+  /* The symbols of the library are prefixed with the basename (turned into a
+     C identifier), so that the libraries of several models can be linked
+     into the same program */
+  string prefix = basename;
+  for (auto &c : prefix)
+    if (!isalnum(static_cast<unsigned char>(c)))
+      c = '_';
+  if (isdigit(static_cast<unsigned char>(prefix[0])))
+    prefix = "_" + prefix;
+  prefix += "_";
+
+  // The declarations of the header are collected while writing the sources
+  ostringstream declarations;
+  vector<string> sources = { "symbols.c" };
+
+  ofstream cOutputFile;
+  cOutputFile.open(filename_symbols, ios::out | ios::binary);
+  if (!cOutputFile.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename_symbols << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  cOutputFile << "/*" << endl
+              << " * " << filename_symbols << " : Symbols of model " << basename << endl
+              << " *" << endl
+              << " * Warning : this file is generated automatically by Dynare" << endl
+              << " *           from model file (.mod)" << endl
+              << " */" << endl
+              << "#include <stddef.h>" << endl
+              << "#include \"model.h\"" << endl;
+  symbol_table.writeCLibraryOutput(declarations, cOutputFile, prefix);
+  cOutputFile.close();
+
+  if (!no_static)
+    {
+      static_model.writeStaticCLibraryFile(basename, prefix, declarations);
+      sources.emplace_back("static.c");
+    }
+  dynamic_model.writeDynamicCLibraryFile(basename, prefix, mod_file_struct.order_option, declarations);
+  sources.emplace_back("dynamic.c");
+
+  cOutputFile.open(filename_h, ios::out | ios::binary);
+  if (!cOutputFile.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename_h << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  cOutputFile << "/*" << endl
+              << " * " << filename_h << " : Interface of the C library of model " << basename << endl
+              << " *" << endl
+              << " * Warning : this file is generated automatically by Dynare" << endl
+              << " *           from model file (.mod)" << endl
+              << " *" << endl
+              << " * All the symbols are prefixed with " << prefix << " (omitted below)." << endl
+              << " *" << endl
+              << " * Matrices are stored in column-major order. The arguments of the model" << endl
+              << " * functions are:" << endl
+              << " *   y            endogenous variables: for the static model, the endo_nbr" << endl
+              << " *                variables; for the dynamic model, the variables at the" << endl
+              << " *                periods where they appear, at the positions given by" << endl
+              << " *                dynamic_lead_lag_incidence (-1 if absent), whose rows are" << endl
+              << " *                the periods from -dynamic_max_lag to dynamic_max_lead" << endl
+              << " *   x            exogenous variables, nb_row_x by exo_nbr+exo_det_nbr matrix" << endl
+              << " *                (the dynamic model uses the 0-based row it_)" << endl
+              << " *   params       parameter values" << endl
+              << " *   steady_state steady state of the endogenous variables" << endl
+              << " *   T            buffer of <model>_ntt temporary terms" << endl
+              << " *   residual     <model>_equation_nbr residuals" << endl
+              << " *   g1           <model>_equation_nbr by <model>_g1_ncols Jacobian, of which" << endl
+              << " *                <model>_g1_idx lists the 0-based rows, then the columns of" << endl
+              << " *                the <model>_nnz[0] nonzero elements" << endl
+              << " *   v2, v3       <model>_nnz[1] (resp. <model>_nnz[2]) by 3 matrices of the" << endl
+              << " *                1-based row, column and value of the nonzero second (resp." << endl
+              << " *                third) derivatives" << endl
+              << " *" << endl
+              << " * Static() and Dynamic() compute all orders up to the last non-NULL output." << endl
+              << " * Alternatively, call <model>_<order>_tt() with the highest order needed," << endl
+              << " * then <model>_resid(), <model>_g1()... up to that order with the same T." << endl
+              << " * The dynamic_*_batch() functions evaluate the residuals and the Jacobian" << endl
+              << " * of the dynamic model at n points at once (see below for their layout)." << endl
+              << " */" << endl
+              << "#ifndef _" << prefix << "MODEL_H" << endl
+              << "#define _" << prefix << "MODEL_H" << endl << endl
+              << "#define DYNARE_MODEL_ABI_VERSION 1" << endl << endl
+              << "/* Marks the arrays given to the batch functions, which must not overlap */" << endl
+              << "#if defined(__cplusplus) || defined(_MSC_VER)" << endl
+              << "# define DYNARE_RESTRICT __restrict" << endl
+              << "#else" << endl
+              << "# define DYNARE_RESTRICT restrict" << endl
+              << "#endif" << endl << endl
+              << "#ifdef __cplusplus" << endl
+              << "extern \"C\" {" << endl
+              << "#endif" << endl << endl
+              << declarations.str()
+              << "#ifdef __cplusplus" << endl
+              << "}" << endl
+              << "#endif" << endl << endl
+              << "#endif" << endl;
+  cOutputFile.close();
+
+  // Build stubs
+  string filename_makefile = basename + "/model/src/Makefile";
+  cOutputFile.open(filename_makefile, ios::out | ios::binary);
+  if (!cOutputFile.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename_makefile << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  cOutputFile << "# " << filename_makefile << " : Builds the shared library of model " << basename << endl
+              << "#" << endl
+              << "# Warning : this file is generated automatically by Dynare" << endl
+              << "#           from model file (.mod)" << endl << endl
+              << "CC ?= cc" << endl
+              << "CFLAGS ?= -O2" << endl
+              << "CFLAGS += -fPIC -fopenmp-simd" << endl << endl
+              << "OBJS =";
+  for (const auto &source : sources)
+    cOutputFile << " " << source.substr(0, source.size() - 2) << ".o";
+  cOutputFile << endl << endl
+              << "lib" << basename << ".so: $(OBJS)" << endl
+              << "\t$(CC) -shared $(LDFLAGS) -o $@ $(OBJS) -lm" << endl << endl
+              << "%.o: %.c model.h" << endl
+              << "\t$(CC) $(CFLAGS) -c $<" << endl << endl
+              << "clean:" << endl
+              << "\trm -f $(OBJS) lib" << basename << ".so" << endl << endl
+              << ".PHONY: clean" << endl;
+  cOutputFile.close();
+
+  string filename_cmake = basename + "/model/src/CMakeLists.txt";
+  cOutputFile.open(filename_cmake, ios::out | ios::binary);
+  if (!cOutputFile.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename_cmake << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  cOutputFile << "# " << filename_cmake << " : Builds the shared library of model " << basename << endl
+              << "#" << endl
+              << "# Warning : this file is generated automatically by Dynare" << endl
+              << "#           from model file (.mod)" << endl << endl
+              << "cmake_minimum_required(VERSION 3.1)" << endl
+              << "project(" << basename << " C)" << endl << endl
+              << "add_library(" << basename << " SHARED";
+  for (const auto &source : sources)
+    cOutputFile << " " << source;
+  cOutputFile << ")" << endl
+              << "set_target_properties(" << basename << " PROPERTIES PUBLIC_HEADER model.h)" << endl
+              << "# Enables the vectorization of the batch functions (#pragma omp simd), without the OpenMP runtime" << endl
+              << "if(CMAKE_C_COMPILER_ID MATCHES \"GNU|Clang\")" << endl
+              << "  target_compile_options(" << basename << " PRIVATE -fopenmp-simd)" << endl
+              << "endif()" << endl
+              << "if(UNIX)" << endl
+              << "  target_link_libraries(" << basename << " m)" << endl
+              << "endif()" << endl
+              << "install(TARGETS " << basename << endl
+              << "        LIBRARY DESTINATION lib" << endl
+              << "        ARCHIVE DESTINATION lib" << endl
+              << "        RUNTIME DESTINATION bin" << endl
+              << "        PUBLIC_HEADER DESTINATION include/" << basename << ")" << endl;
+  cOutputFile.close();
+
+  if (!nopreprocessoroutput)
+    cout << "done" << endl;
+}
+
 void
 ModFile::writeExternalFilesJulia(const string &basename, FileOutputType output, const bool nopreprocessoroutput) const
 {
@@ -1184,11 +1664,11 @@ ModFile::writeExternalFilesJulia(const string &basename, FileOutputType output,
                                 mod_file_struct.estimation_present, false, true);
       if (!no_static)
         {
-          static_model.writeStaticFile(basename, false, false, false, true);
+          static_model.writeStaticFile(basename, false, false, false, true, 0);
           static_model.writeParamsDerivativesFile(basename, true);
         }
       dynamic_model.writeDynamicFile(basename, block, byte_code, use_dll,
-                                     mod_file_struct.order_option, true);
+                                     mod_file_struct.order_option, true, 0);
       dynamic_model.writeParamsDerivativesFile(basename, true);
     }
   steady_state_model.writeSteadyStateFile(basename, mod_file_struct.ramsey_model_present, true);
@@ -1224,7 +1704,7 @@ ModFile::writeExternalFilesJulia(const string &basename, FileOutputType output,
 }
 
 void
-ModFile::writeJsonOutput(const string &basename, JsonOutputPointType json, JsonFileOutputType json_output_mode, bool onlyjson, const bool nopreprocessoroutput, bool jsonderivsimple)
+ModFile::writeJsonOutput(const string &basename, JsonOutputPointType json, JsonFileOutputType json_output_mode, bool onlyjson, const bool nopreprocessoroutput, bool jsonderivsimple, bool check_model_changes)
 {
   if (json == JsonOutputPointType::nojson)
     return;
@@ -1242,7 +1722,7 @@ ModFile::writeJsonOutput(const string &basename, JsonOutputPointType json, JsonF
     symbol_table.unfreeze();
 
   if (json == JsonOutputPointType::computingpass)
-    writeJsonComputingPassOutput(basename, json_output_mode, jsonderivsimple);
+    writeJsonComputingPassOutput(basename, json_output_mode, jsonderivsimple, check_model_changes);
 
   if (json_output_mode == JsonFileOutputType::standardout)
     cout << "}" << endl
@@ -1414,7 +1894,8 @@ ModFile::writeJsonOutputParsingCheck(const string &basename, JsonFileOutputType
 }
 
 void
-ModFile::writeJsonComputingPassOutput(const string &basename, JsonFileOutputType json_output_mode, bool jsonderivsimple) const
+ModFile::writeJsonComputingPassOutput(const string &basename, JsonFileOutputType json_output_mode, bool jsonderivsimple,
+                                      bool check_model_changes) const
 {
   if (basename.empty() && json_output_mode != JsonFileOutputType::standardout)
     {
@@ -1422,56 +1903,87 @@ ModFile::writeJsonComputingPassOutput(const string &basename, JsonFileOutputType
       exit(EXIT_FAILURE);
     }
 
-  ostringstream tmp_out, static_output, dynamic_output, static_paramsd_output, dynamic_paramsd_output;
+  // As in writeOutputFiles(), only the files of the models that changed are rewritten
+  bool write_static = true, write_dynamic = true;
+  OutputManifest manifest(json_output_mode == JsonFileOutputType::standardout ? "" : basename + "/model/json/manifest");
+  if (json_output_mode != JsonFileOutputType::standardout)
+    {
+      ContentHash configuration;
+      ostringstream version;
+      version << PACKAGE_VERSION;
+      configuration.update(version.str());
+      configuration.update(static_cast<uint64_t>(jsonderivsimple));
+      addOutputOptionsToDigest(configuration, LanguageOutputType::matlab);
+      bool regenerate_all = manifest.update("configuration", configuration.hexDigest()) || !check_model_changes;
+      bool symbols_changed = manifest.update("symbols", computeSymbolsDigest());
+      write_static = updateModelDigests(manifest, "static", static_model.computeStructuralDigests(), true)
+        || symbols_changed || regenerate_all;
+      write_dynamic = updateModelDigests(manifest, "dynamic", dynamic_model.computeStructuralDigests(), true)
+        || symbols_changed || regenerate_all;
+    }
+
+  OutputSection static_output, dynamic_output, static_paramsd_output, dynamic_paramsd_output;
+  OutputSection static_paramsd_tmp, dynamic_paramsd_tmp;
 
-  static_output << "{";
-  static_model.writeJsonComputingPassOutput(static_output, !jsonderivsimple);
-  static_output << "}";
+  if (write_static)
+    {
+      static_output << "{";
+      static_model.writeJsonComputingPassOutput(static_output, !jsonderivsimple);
+      static_output << "}";
 
-  dynamic_output << "{";
-  dynamic_model.writeJsonComputingPassOutput(dynamic_output, !jsonderivsimple);
-  dynamic_output << "}";
+      static_model.writeJsonParamsDerivativesFile(static_paramsd_tmp, !jsonderivsimple);
+      if (!static_paramsd_tmp.empty())
+        static_paramsd_output << "{" << static_paramsd_tmp << "}" << endl;
+    }
 
-  tmp_out << "";
-  static_paramsd_output << "";
-  static_model.writeJsonParamsDerivativesFile(tmp_out, !jsonderivsimple);
-  if (!tmp_out.str().empty())
-    static_paramsd_output << "{" << tmp_out.str() << "}" << endl;
+  if (write_dynamic)
+    {
+      dynamic_output << "{";
+      dynamic_model.writeJsonComputingPassOutput(dynamic_output, !jsonderivsimple);
+      dynamic_output << "}";
 
-  tmp_out.str("");
-  dynamic_paramsd_output << "";
-  dynamic_model.writeJsonParamsDerivativesFile(tmp_out, !jsonderivsimple);
-  if (!tmp_out.str().empty())
-    dynamic_paramsd_output << "{" << tmp_out.str() << "}" << endl;
+      dynamic_model.writeJsonParamsDerivativesFile(dynamic_paramsd_tmp, !jsonderivsimple);
+      if (!dynamic_paramsd_tmp.empty())
+        dynamic_paramsd_output << "{" << dynamic_paramsd_tmp << "}" << endl;
+    }
 
   if (json_output_mode == JsonFileOutputType::standardout)
     {
-      cout << ", \"static_model\": " << static_output.str() << endl
-           << ", \"dynamic_model\": " << dynamic_output.str() << endl;
+      cout << ", \"static_model\": " << static_output << endl
+           << ", \"dynamic_model\": " << dynamic_output << endl;
 
-      if (!static_paramsd_output.str().empty())
-        cout << ", \"static_params_deriv\": " << static_paramsd_output.str() << endl;
+      if (!static_paramsd_output.empty())
+        cout << ", \"static_params_deriv\": " << static_paramsd_output << endl;
 
-      if (!dynamic_paramsd_output.str().empty())
-        cout << ", \"dynamic_params_deriv\": " << dynamic_paramsd_output.str() << endl;
+      if (!dynamic_paramsd_output.empty())
+        cout << ", \"dynamic_params_deriv\": " << dynamic_paramsd_output << endl;
     }
   else
     {
       boost::filesystem::create_directories(basename + "/model/json");
 
-      writeJsonFileHelper(basename + "/model/json/static.json", static_output);
-      writeJsonFileHelper(basename + "/model/json/dynamic.json", dynamic_output);
+      if (write_static)
+        {
+          writeJsonFileHelper(basename + "/model/json/static.json", static_output);
+          boost::filesystem::remove(basename + "/model/json/static_params_derivs.json");
+          if (!static_paramsd_output.empty())
+            writeJsonFileHelper(basename + "/model/json/static_params_derivs.json", static_paramsd_output);
+        }
 
-      if (!static_paramsd_output.str().empty())
-        writeJsonFileHelper(basename + "/model/json/static_params_derivs.json", static_paramsd_output);
+      if (write_dynamic)
+        {
+          writeJsonFileHelper(basename + "/model/json/dynamic.json", dynamic_output);
+          boost::filesystem::remove(basename + "/model/json/params_derivs.json");
+          if (!dynamic_paramsd_output.empty())
+            writeJsonFileHelper(basename + "/model/json/params_derivs.json", dynamic_paramsd_output);
+        }
 
-      if (!dynamic_paramsd_output.str().empty())
-        writeJsonFileHelper(basename + "/model/json/params_derivs.json", dynamic_paramsd_output);
+      manifest.save();
     }
 }
 
 void
-ModFile::writeJsonFileHelper(const string &fname, ostringstream &output) const
+ModFile::writeJsonFileHelper(const string &fname, OutputSection &output) const
 {
   ofstream jsonOutput;
   jsonOutput.open(fname, ios::out | ios::binary);
@@ -1480,6 +1992,6 @@ ModFile::writeJsonFileHelper(const string &fname, ostringstream &output) const
       cerr << "ERROR: Can't open file " << fname << " for writing" << endl;
       exit(EXIT_FAILURE);
     }
-  jsonOutput << output.str();
+  jsonOutput << output;
   jsonOutput.close();
 }
@@ -39,6 +39,7 @@ using namespace std;
 #include "WarningConsolidation.hh"
 #include "ExtendedPreprocessorTypes.hh"
 #include "SubModel.hh"
+#include "ContentHash.hh"
 
 //! The abstract representation of a "mod" file
 class ModFile
@@ -114,7 +115,20 @@ public:
   /*! (i.e. option parallel_local_files of model block) */
   vector<string> parallel_local_files;
 
+  //! Names of the equations for which derivatives of order 2 and 3 are computed
+  /*! (i.e. option higher_order_equations of model block); if empty, they
+    are computed for all equations. Otherwise, the second and third order
+    derivatives of the other equations (except the auxiliary ones) are zero
+    in the output (g2, g3 and the derivatives of the Hessian w.r. to
+    parameters), and a warning lists these equations */
+  vector<string> higher_order_equations;
+
 private:
+  //! Options of the transform and computing passes that change the generated files, as "name=value" strings
+  /*! Part of the configuration digests of the manifests (see writeOutputFiles()) */
+  vector<string> output_options;
+  //! Feeds the options that change the generated files to a configuration digest
+  void addOutputOptionsToDigest(ContentHash &configuration, LanguageOutputType language) const;
   //! List of statements
   vector<unique_ptr<Statement>> statements;
   //! Structure of the mod file
@@ -123,8 +137,26 @@ private:
   WarningConsolidation &warnings;
   //! Functions used in writing of JSON outut. See writeJsonOutput
   void writeJsonOutputParsingCheck(const string &basename, JsonFileOutputType json_output_mode, bool transformpass, bool computingpass) const;
-  void writeJsonComputingPassOutput(const string &basename, JsonFileOutputType json_output_mode, bool jsonderivsimple) const;
-  void writeJsonFileHelper(const string &fname, ostringstream &output) const;
+  void writeJsonComputingPassOutput(const string &basename, JsonFileOutputType json_output_mode, bool jsonderivsimple,
+                                    bool check_model_changes) const;
+  void writeJsonFileHelper(const string &fname, OutputSection &output) const;
+  //! Writes the key of the compiled MEX files in the compilation cache (<basename>/model/src/compilation_cache_key)
+  /*! The key is the SHA-256 digest of the C sources of the MEX files (and,
+    with split_c_files, of their makefiles) and of the MATLAB code compiling
+    them (which holds the compiler options), so that identical code is
+    compiled only once. The basename is masked, so that
+    models from different .mod files can share their MEX files. */
+  void writeCompilationCacheKey(const string &basename, const string &compile_code, int split_c_files) const;
+  //! Computes the digest of the symbol table (type, name and type specific ID of every symbol)
+  string computeSymbolsDigest() const;
+  //! Records the digests of the parts of a model in a manifest (as entries "<name>/<part>"), and returns true if one of them changed
+  /*! The line numbers of the equations are only recorded if with_lines is true */
+  bool updateModelDigests(OutputManifest &manifest, const string &name, const map<string, string> &digests,
+                          bool with_lines) const;
+  //! Removes the files of a model in <basename>/model/src and <basename>/model/bytecode
+  /*! Called before rewriting the files of a model whose structure changed,
+    since their number may change (e.g. with the split_c_files option) */
+  void removeModelFiles(const string &basename, const string &name) const;
 public:
   //! Add a statement
   void addStatement(unique_ptr<Statement> st);
@@ -142,7 +174,17 @@ public:
   //! Execute computations
   /*! \param no_tmp_terms if true, no temporary terms will be computed in the static and dynamic files */
   /*! \param params_derivs_order compute this order of derivs wrt parameters */
-  void computingPass(bool no_tmp_terms, FileOutputType output, int params_derivs_order, const bool nopreprocessoroutput);
+  /*! \param nthreads number of threads used for computing the derivatives of the static and dynamic models */
+  /*! \param cse_tmp_terms if true, use the cost-based engine for selecting temporary terms */
+  /*! \param tmp_terms_costs_file if non-empty, file overriding the default operator costs */
+  /*! \param tmp_terms_report if true, print the cost of the temporary terms selected by both engines */
+  /*! \param params_derivs_adjoint if true, compute the derivatives of the residuals and Jacobian w.r. to parameters in reverse mode */
+  /*! \param block_cache with the block option, directory where the block decompositions are kept for reuse (empty to disable the cache) */
+  /*! \param flat_bytecode with the bytecode option, if true, also write the flat bytecode files (<model>.fbc and <model>_register.fbc) */
+  void computingPass(bool no_tmp_terms, FileOutputType output, int params_derivs_order, int nthreads,
+                     bool cse_tmp_terms, const string &tmp_terms_costs_file, bool tmp_terms_report,
+                     bool params_derivs_adjoint, const string &block_cache, bool flat_bytecode,
+                     const bool nopreprocessoroutput);
   //! Writes Matlab/Octave output files
   /*!
     \param basename The base name used for writing output files. Should be the name of the mod file without its extension
@@ -153,11 +195,16 @@ public:
     \param cygwin Should the MEX command of use_dll be adapted for Cygwin?
     \param msvc Should the MEX command of use_dll be adapted for MSVC?
     \param mingw Should the MEX command of use_dll be adapted for MinGW?
+    \param check_model_changes if true, only rewrite the files of the models that changed since the previous run (as recorded in <basename>/manifest)
     \param compute_xrefs if true, equation cross references will be computed
+    \param split_c_files with use_dll, maximum number of statements per generated C file (0 for a single file)
+    \param compilation_cache with use_dll, directory where the compiled MEX files are kept for reuse (empty to disable the cache)
+    \param language the language option (only recorded in the manifest, since it does not apply to these files)
   */
   void writeOutputFiles(const string &basename, bool clear_all, bool clear_global, bool no_log, bool no_warn,
                         bool console, bool nograph, bool nointeractive, const ConfigFile &config_file,
-                        bool check_model_changes, bool minimal_workspace, bool compute_xrefs
+                        bool check_model_changes, bool minimal_workspace, bool compute_xrefs, int split_c_files,
+                        const string &compilation_cache, LanguageOutputType language
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
                         , bool cygwin, bool msvc, bool mingw
 #endif
@@ -165,13 +212,16 @@ public:
                         ) const;
   void writeExternalFiles(const string &basename, FileOutputType output, LanguageOutputType language, const bool nopreprocessoroutput) const;
   void writeExternalFilesJulia(const string &basename, FileOutputType output, const bool nopreprocessoroutput) const;
+  //! Writes the model as a standalone C library, without dependency on MATLAB/Octave
+  void writeExternalFilesC(const string &basename, FileOutputType output, const bool nopreprocessoroutput) const;
 
   void computeChecksum();
   //! Write JSON representation of ModFile object
   //! Initially created to enable Julia to work with .mod files
   //! Potentially outputs ModFile after the various parts of processing (parsing, checkPass, transformPass, computingPass)
   //! Allows user of other host language platforms (python, fortran, etc) to provide support for dynare .mod files
-  void writeJsonOutput(const string &basename, JsonOutputPointType json, JsonFileOutputType json_output_mode, bool onlyjson, const bool nopreprocessoroutput, bool jsonderivsimple = false);
+  //! With check_model_changes, only the files of the computing pass whose contents changed are rewritten (see writeOutputFiles())
+  void writeJsonOutput(const string &basename, JsonOutputPointType json, JsonFileOutputType json_output_mode, bool onlyjson, const bool nopreprocessoroutput, bool jsonderivsimple = false, bool check_model_changes = false);
 };
 
 #endif // ! MOD_FILE_HH
@@ -107,6 +107,21 @@ SteadyStateModel::checkPass(ModFileStructure &mod_file_struct, WarningConsolidat
     }
 }
 
+string
+SteadyStateModel::computeDefinitionsDigest() const
+{
+  StructuralHash hash;
+  hash.update(def_table.size());
+  for (const auto &it : def_table)
+    {
+      hash.update(it.first.size());
+      for (auto symb_id : it.first)
+        hash.update(symb_id);
+      hash.updateExpression(it.second);
+    }
+  return hash.hexDigest();
+}
+
 void
 SteadyStateModel::writeLatexSteadyStateFile(const string &basename) const
 {
@@ -372,3 +387,22 @@ Epilogue::writeEpilogueFile(const string &basename) const
          << "end" << endl;
   output.close();
 }
+
+string
+Epilogue::computeDefinitionsDigest() const
+{
+  StructuralHash hash;
+  hash.update(def_table.size());
+  for (const auto &it : def_table)
+    {
+      hash.update(it.first);
+      hash.updateExpression(it.second);
+    }
+  for (const auto *symbols : { &endogs, &exogs })
+    {
+      hash.update(symbols->size());
+      for (auto symb_id : *symbols)
+        hash.update(symb_id);
+    }
+  return hash.hexDigest();
+}
@@ -54,6 +54,9 @@ public:
     \param[in] ramsey_model Is there a Ramsey model in the MOD file? If yes, then use the "ys" in argument of the steady state file as initial values
   */
   void writeSteadyStateFile(const string &basename, bool ramsey_model, bool julia) const;
+  //! Computes the digest of the definitions (see StructuralHash)
+  /*! The auxiliary equations of the static model, also written to the steady state file, are not included */
+  string computeDefinitionsDigest() const;
   //! Writes LaTeX file with the equations of the dynamic model (for the steady state model)
   void writeLatexSteadyStateFile(const string &basename) const;
   //! Writes JSON output
@@ -84,6 +87,9 @@ public:
 
   //! Write the steady state file
   void writeEpilogueFile(const string &basename) const;
+
+  //! Computes the digest of the definitions (see StructuralHash)
+  string computeDefinitionsDigest() const;
 };
 
 
@@ -22,81 +22,53 @@
 #include <cmath>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
 
 #include "ModelTree.hh"
 #include "MinimumFeedbackSet.hh"
+#include "FlatBytecode.hh"
 #include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/max_cardinality_matching.hpp>
 #include <boost/graph/strong_components.hpp>
 #include <boost/graph/topological_sort.hpp>
 
 using namespace MFS;
 
 bool
-ModelTree::computeNormalization(const jacob_map_t &contemporaneous_jacobian, bool verbose)
+ModelTree::computeNormalization(const IncidenceMatrix &incidence, bool verbose)
 {
   const int n = equations.size();
 
-  assert(n == symbol_table.endo_nbr());
+  assert(n == symbol_table.endo_nbr() && incidence.getRowNbr() == n);
 
-  using BipartiteGraph = boost::adjacency_list<boost::vecS, boost::vecS, boost::undirectedS>;
+  vector<int> row_begin(n + 1), adj(incidence.getNnz());
+  for (int eq = 0; eq <= n; eq++)
+    row_begin[eq] = eq < n ? incidence.rowBegin(eq) : incidence.getNnz();
+  for (int pos = 0; pos < incidence.getNnz(); pos++)
+    adj[pos] = incidence.getCol(pos);
 
-  /*
-    Vertices 0 to n-1 are for endogenous (using type specific ID)
-    Vertices n to 2*n-1 are for equations (using equation no.)
-  */
-  BipartiteGraph g(2 * n);
-
-  // Fill in the graph
-  set<pair<int, int>> endo;
-
-  for (const auto & it : contemporaneous_jacobian)
-    add_edge(it.first.first + n, it.first.second, g);
-
-  // Compute maximum cardinality matching
-  vector<int> mate_map(2*n);
-
-#if 1
-  bool check = checked_edmonds_maximum_cardinality_matching(g, &mate_map[0]);
-#else // Alternative way to compute normalization, by giving an initial matching using natural normalizations
-  fill(mate_map.begin(), mate_map.end(), graph_traits<BipartiteGraph>::null_vertex());
-
-  multimap<int, int> natural_endo2eqs;
-  computeNormalizedEquations(natural_endo2eqs);
-
-  for (int i = 0; i < symbol_table.endo_nbr(); i++)
-    {
-      if (natural_endo2eqs.count(i) == 0)
-        continue;
-
-      int j = natural_endo2eqs.find(i)->second;
-
-      put(&mate_map[0], i, n+j);
-      put(&mate_map[0], n+j, i);
-    }
-
-  edmonds_augmenting_path_finder<BipartiteGraph, size_t *, property_map<BipartiteGraph, vertex_index_t>::type> augmentor(g, &mate_map[0], get(vertex_index, g));
-  bool not_maximum_yet = true;
-  while (not_maximum_yet)
-    {
-      not_maximum_yet = augmentor.augment_matching();
-    }
-  augmentor.get_current_matching(&mate_map[0]);
+  BipartiteMatching matching(n, n, move(row_begin), move(adj));
+  return applyNormalization(matching, verbose);
+}
 
-  bool check = maximum_cardinality_matching_verifier<BipartiteGraph, size_t *, property_map<BipartiteGraph, vertex_index_t>::type>::verify_matching(g, &mate_map[0], get(vertex_index, g));
-#endif
+bool
+ModelTree::applyNormalization(BipartiteMatching &matching, bool verbose)
+{
+  const int n = equations.size();
 
-  assert(check);
+  bool check = matching.augment() == n;
 
-#ifdef DEBUG
-  for (int i = 0; i < n; i++)
-    cout << "Endogenous " << symbol_table.getName(symbol_table.getID(eEndogenous, i))
-         << " matched with equation " << (mate_map[i]-n+1) << endl;
-#endif
-
-  // Create the resulting map, by copying the n first elements of mate_map, and substracting n to them
-  endo2eq.resize(equations.size());
-  transform(mate_map.begin(), mate_map.begin() + n, endo2eq.begin(), bind2nd(minus<int>(), n));
+  const vector<int> &eq2endo = matching.getLeftMates();
+  endo2eq.assign(n, -1);
+  for (int eq = 0; eq < n; eq++)
+    if (eq2endo[eq] >= 0)
+      endo2eq[eq2endo[eq]] = eq;
 
 #ifdef DEBUG
   multimap<int, int> natural_endo2eqs;
@@ -123,101 +95,133 @@ ModelTree::computeNormalization(const jacob_map_t &contemporaneous_jacobian, boo
 #endif
 
   // Check if all variables are normalized
-  auto it = find(mate_map.begin(), mate_map.begin() + n, boost::graph_traits<BipartiteGraph>::null_vertex());
-  if (it != mate_map.begin() + n)
-    {
-      if (verbose)
-        cerr << "ERROR: Could not normalize the model. Variable "
-             << symbol_table.getName(symbol_table.getID(SymbolType::endogenous, it - mate_map.begin()))
-             << " is not in the maximum cardinality matching." << endl;
-      check = false;
-    }
+  auto it = find(endo2eq.begin(), endo2eq.end(), -1);
+  if (it != endo2eq.end() && verbose)
+    cerr << "ERROR: Could not normalize the model. Variable "
+         << symbol_table.getName(symbol_table.getID(SymbolType::endogenous, it - endo2eq.begin()))
+         << " is not in the maximum cardinality matching." << endl;
   return check;
 }
 
 void
-ModelTree::computeNonSingularNormalization(jacob_map_t &contemporaneous_jacobian, double cutoff, jacob_map_t &static_jacobian, dynamic_jacob_map_t &dynamic_jacobian)
+ModelTree::computeNonSingularNormalization(IncidenceMatrix &incidence, double cutoff, dynamic_jacob_map_t &dynamic_jacobian)
 {
-  bool check = false;
-
   cout << "Normalizing the model..." << endl;
 
   int n = equations.size();
 
-  // compute the maximum value of each row of the contemporaneous Jacobian matrix
-  //jacob_map normalized_contemporaneous_jacobian;
-  jacob_map_t normalized_contemporaneous_jacobian(contemporaneous_jacobian);
-  vector<double> max_val(n, 0.0);
-  for (jacob_map_t::const_iterator iter = contemporaneous_jacobian.begin(); iter != contemporaneous_jacobian.end(); iter++)
-    if (fabs(iter->second) > max_val[iter->first.first])
-      max_val[iter->first.first] = fabs(iter->second);
-
-  for (auto & iter : normalized_contemporaneous_jacobian)
-    iter.second /= max_val[iter.first.first];
-
-  //We start with the highest value of the cutoff and try to normalize the model
-  double current_cutoff = 0.99999999;
+  /* Contemporaneous Jacobian in compressed sparse row form (rows are
+     equations), each row being sorted by decreasing magnitude normalized by
+     the maximum of the row: the elements above a given cutoff are then a
+     prefix of each row */
+  vector<pair<double, int>> row;
+  vector<int> row_begin{0}, adj;
+  vector<double> magnitudes;
+  for (int eq = 0; eq < n; eq++)
+    {
+      double max_val = 0.0;
+      for (int pos = incidence.rowBegin(eq); pos < incidence.rowEnd(eq); pos++)
+        if (incidence.isContemporaneous(pos))
+          max_val = max(max_val, fabs(incidence.getContemporaneousValue(pos)));
+      row.clear();
+      for (int pos = incidence.rowBegin(eq); pos < incidence.rowEnd(eq); pos++)
+        if (incidence.isContemporaneous(pos))
+          {
+            double magnitude = fabs(incidence.getContemporaneousValue(pos)) / max_val;
+            // Elements that could not be evaluated are only used in the last attempt, as null ones
+            row.emplace_back(isnan(magnitude) ? 0 : magnitude, incidence.getCol(pos));
+          }
+      stable_sort(row.begin(), row.end(), [](const pair<double, int> &a, const pair<double, int> &b)
+                  {
+                    return a.first > b.first;
+                  });
+      for (const auto &it : row)
+        {
+          adj.push_back(it.second);
+          magnitudes.push_back(it.first);
+        }
+      row_begin.push_back(adj.size());
+    }
+  BipartiteMatching matching(n, n, row_begin, adj);
 
-  int suppressed = 0;
-  while (!check && current_cutoff > 1e-19)
+  // Restricts the matching to the elements whose normalized magnitude is at least threshold
+  auto set_threshold = [&](double threshold)
     {
-      jacob_map_t tmp_normalized_contemporaneous_jacobian;
-      int suppress = 0;
-      for (auto & iter : normalized_contemporaneous_jacobian)
-        if (fabs(iter.second) > max(current_cutoff, cutoff))
-          tmp_normalized_contemporaneous_jacobian[{ iter.first.first, iter.first.second }] = iter.second;
-        else
-          suppress++;
+      for (int eq = 0; eq < n; eq++)
+        {
+          auto end = upper_bound(magnitudes.begin() + row_begin[eq], magnitudes.begin() + row_begin[eq+1],
+                                 threshold, greater<double>());
+          matching.setActiveDegree(eq, end - (magnitudes.begin() + row_begin[eq]));
+        }
+    };
+
+  /* We look for the highest cutoff for which the model can be normalized.
+     Since removing elements can only make normalization harder, it is found
+     by bisection over the distinct magnitudes above the cutoff given by the
+     user. The matching of each step is a warm start for the next one. */
+  vector<double> thresholds;
+  for (auto magnitude : magnitudes)
+    if (magnitude > max(cutoff, 1e-19))
+      thresholds.push_back(magnitude);
+  sort(thresholds.begin(), thresholds.end(), greater<double>());
+  thresholds.erase(unique(thresholds.begin(), thresholds.end()), thresholds.end());
 
-      if (suppress != suppressed)
-        check = computeNormalization(tmp_normalized_contemporaneous_jacobian, false);
-      suppressed = suppress;
-      if (!check)
+  bool check = false;
+  if (!thresholds.empty())
+    {
+      set_threshold(thresholds.back());
+      check = matching.augment() == n;
+    }
+  if (check)
+    {
+      // Invariant: normalization fails at thresholds[lo-1] (if lo > 0) and succeeds at thresholds[hi]
+      size_t lo = 0, hi = thresholds.size() - 1;
+      while (lo < hi)
         {
-          current_cutoff /= 2;
-          // In this last case try to normalize with the complete jacobian
-          if (current_cutoff <= 1e-19)
-            check = computeNormalization(normalized_contemporaneous_jacobian, false);
+          size_t mid = (lo + hi) / 2;
+          set_threshold(thresholds[mid]);
+          if (matching.augment() == n)
+            hi = mid;
+          else
+            lo = mid + 1;
         }
+      set_threshold(thresholds[hi]);
     }
+  else
+    // In this last case try to normalize with the complete jacobian
+    set_threshold(0);
+  check = applyNormalization(matching, false);
 
   if (!check)
     {
       cout << "Normalization failed with cutoff, trying symbolic normalization..." << endl;
       //if no non-singular normalization can be found, try to find a normalization even with a potential singularity
-      jacob_map_t tmp_normalized_contemporaneous_jacobian;
-      set<pair<int, int>> endo;
-      for (int i = 0; i < n; i++)
-        {
-          endo.clear();
-          equations[i]->collectEndogenous(endo);
-          for (const auto & it : endo)
-            tmp_normalized_contemporaneous_jacobian[{ i, it.first }] = 1;
-        }
-      check = computeNormalization(tmp_normalized_contemporaneous_jacobian, true);
+      IncidenceMatrix symbolic_incidence = computeSymbolicIncidence();
+      check = computeNormalization(symbolic_incidence, true);
       if (check)
         {
-          // Update the jacobian matrix
-          for (jacob_map_t::const_iterator it = tmp_normalized_contemporaneous_jacobian.begin(); it != tmp_normalized_contemporaneous_jacobian.end(); it++)
-            {
-              if (static_jacobian.find({ it->first.first, it->first.second }) == static_jacobian.end())
-                static_jacobian[{ it->first.first, it->first.second }] = 0;
-              if (dynamic_jacobian.find({ 0, { it->first.first, it->first.second } }) == dynamic_jacobian.end())
-                dynamic_jacobian[{ 0, { it->first.first, it->first.second } }] = nullptr;
-              if (contemporaneous_jacobian.find({ it->first.first, it->first.second }) == contemporaneous_jacobian.end())
-                contemporaneous_jacobian[{ it->first.first, it->first.second }] = 0;
-              try
-                {
-                  if (first_derivatives.find({ it->first.first, getDerivID(symbol_table.getID(SymbolType::endogenous, it->first.second), 0) }) == first_derivatives.end())
-                    first_derivatives[{ it->first.first, getDerivID(symbol_table.getID(SymbolType::endogenous, it->first.second), 0) }] = Zero;
-                }
-              catch (DataTree::UnknownDerivIDException &e)
-                {
-                  cerr << "The variable " << symbol_table.getName(symbol_table.getID(SymbolType::endogenous, it->first.second))
-                       << " does not appear at the current period (i.e. with no lead and no lag); this case is not handled by the 'block' option of the 'model' block." << endl;
-                  exit(EXIT_FAILURE);
-                }
-            }
+          // Update the jacobian matrices, adding zeros for the elements that are only in the symbolic incidence matrix
+          vector<IncidenceMatrix::Element> elements = incidence.getElements();
+          for (int eq = 0; eq < n; eq++)
+            for (int pos = symbolic_incidence.rowBegin(eq); pos < symbolic_incidence.rowEnd(eq); pos++)
+              {
+                int var = symbolic_incidence.getCol(pos);
+                elements.push_back({ eq, var, 0, true, 0 });
+                if (dynamic_jacobian.find({ 0, { eq, var } }) == dynamic_jacobian.end())
+                  dynamic_jacobian[{ 0, { eq, var } }] = nullptr;
+                try
+                  {
+                    if (first_derivatives.find({ eq, getDerivID(symbol_table.getID(SymbolType::endogenous, var), 0) }) == first_derivatives.end())
+                      first_derivatives[{ eq, getDerivID(symbol_table.getID(SymbolType::endogenous, var), 0) }] = Zero;
+                  }
+                catch (DataTree::UnknownDerivIDException &e)
+                  {
+                    cerr << "The variable " << symbol_table.getName(symbol_table.getID(SymbolType::endogenous, var))
+                         << " does not appear at the current period (i.e. with no lead and no lag); this case is not handled by the 'block' option of the 'model' block." << endl;
+                    exit(EXIT_FAILURE);
+                  }
+              }
+          incidence = IncidenceMatrix(n, n, elements);
         }
     }
 
@@ -252,10 +256,22 @@ ModelTree::computeNormalizedEquations(multimap<int, int> &endo2eqs) const
 }
 
 void
-ModelTree::evaluateAndReduceJacobian(const eval_context_t &eval_context, jacob_map_t &contemporaneous_jacobian, jacob_map_t &static_jacobian, dynamic_jacob_map_t &dynamic_jacobian, double cutoff, bool verbose)
+ModelTree::evaluateAndReduceJacobian(const eval_context_t &eval_context, IncidenceMatrix &incidence, dynamic_jacob_map_t &dynamic_jacobian, double cutoff, bool verbose)
 {
   int nb_elements_contemparenous_Jacobian = 0;
   set<pair<int, int>> jacobian_elements_to_delete;
+  vector<IncidenceMatrix::Element> elements;
+
+  // Evaluate all the derivatives at once, each node of the DAG being evaluated only once
+  EvalTape tape;
+  map<expr_t, int> tape_positions;
+  for (const auto &first_derivative : first_derivatives)
+    if (getTypeByDerivID(first_derivative.first.second) == SymbolType::endogenous)
+      tape_positions[first_derivative.second] = first_derivative.second->addToEvalTape(tape);
+  vector<double> tape_values;
+  vector<EvalTape::Status> tape_status;
+  tape.eval(DenseEvalContext(eval_context), tape_values, tape_status);
+
   for (first_derivatives_t::const_iterator it = first_derivatives.begin();
        it != first_derivatives.end(); it++)
     {
@@ -267,16 +283,11 @@ ModelTree::evaluateAndReduceJacobian(const eval_context_t &eval_context, jacob_m
           int symb = getSymbIDByDerivID(deriv_id);
           int var = symbol_table.getTypeSpecificID(symb);
           int lag = getLagByDerivID(deriv_id);
-          double val = 0;
-          try
-            {
-              val = Id->eval(eval_context);
-            }
-          catch (ExprNode::EvalExternalFunctionException &e)
-            {
-              val = 1;
-            }
-          catch (ExprNode::EvalException &e)
+          int pos = tape_positions[Id];
+          double val = tape_values[pos];
+          if (tape_status[pos] == EvalTape::Status::externalFunction)
+            val = 1;
+          else if (tape_status[pos] == EvalTape::Status::error)
             {
               cerr << "ERROR: evaluation of Jacobian failed for equation " << eq+1 << " (line " << equations_lineno[eq] << ") and variable " << symbol_table.getName(symb) << "(" << lag << ") [" << symb << "] !" << endl;
               Id->writeOutput(cerr, ExprNodeOutputType::matlabDynamicModelSparse, temporary_terms, {});
@@ -292,18 +303,16 @@ ModelTree::evaluateAndReduceJacobian(const eval_context_t &eval_context, jacob_m
           else
             {
               if (lag == 0)
-                {
-                  nb_elements_contemparenous_Jacobian++;
-                  contemporaneous_jacobian[{ eq, var }] = val;
-                }
-              if (static_jacobian.find({ eq, var }) != static_jacobian.end())
-                static_jacobian[{ eq, var }] += val;
-              else
-                static_jacobian[{ eq, var }] = val;
+                nb_elements_contemparenous_Jacobian++;
+              elements.push_back({ eq, var, val, lag == 0, val });
               dynamic_jacobian[{ lag, { eq, var } }] = Id;
             }
         }
     }
+  incidence = IncidenceMatrix(equations.size(), symbol_table.endo_nbr(), elements);
+
+  if (!jacobian_elements_to_delete.empty())
+    checkCutoffRobustness(eval_context, jacobian_elements_to_delete, cutoff);
 
   // Get rid of the elements of the Jacobian matrix below the cutoff
   for (const auto & it : jacobian_elements_to_delete)
@@ -317,35 +326,298 @@ ModelTree::evaluateAndReduceJacobian(const eval_context_t &eval_context, jacob_m
 }
 
 void
-ModelTree::computePrologueAndEpilogue(const jacob_map_t &static_jacobian_arg, vector<int> &equation_reordered, vector<int> &variable_reordered)
+ModelTree::evaluateResidualsAndJacobian(const DenseEvalContext &context, vector<double> &residuals,
+                                        map<pair<int, int>, vector<double>> &jacobian) const
 {
-  vector<int> eq2endo(equations.size(), 0);
-  equation_reordered.resize(equations.size());
-  variable_reordered.resize(equations.size());
-  bool *IM;
-  int n = equations.size();
-  IM = (bool *) calloc(n*n, sizeof(bool));
-  int i = 0;
-  for (vector<int>::const_iterator it = endo2eq.begin(); it != endo2eq.end(); it++, i++)
+  EvalTape tape;
+  vector<pair<int, int>> residuals_positions;
+  for (auto equation : equations)
+    residuals_positions.emplace_back(equation->get_arg1()->addToEvalTape(tape),
+                                     equation->get_arg2()->addToEvalTape(tape));
+  vector<int> jacobian_positions;
+  for (const auto &first_derivative : first_derivatives)
+    jacobian_positions.push_back(first_derivative.second->addToEvalTape(tape));
+
+  vector<double> values;
+  vector<EvalTape::Status> status;
+  tape.eval(context, values, status);
+
+  int n = context.npoints;
+  const double nan = numeric_limits<double>::quiet_NaN();
+  residuals.assign(equations.size() * n, nan);
+  for (int eq = 0; eq < (int) equations.size(); eq++)
     {
-      eq2endo[*it] = i;
-      equation_reordered[i] = i;
-      variable_reordered[*it] = i;
+      int lhs, rhs;
+      tie(lhs, rhs) = residuals_positions[eq];
+      for (int k = 0; k < n; k++)
+        if (status[lhs * n + k] == EvalTape::Status::ok && status[rhs * n + k] == EvalTape::Status::ok)
+          residuals[eq * n + k] = values[lhs * n + k] - values[rhs * n + k];
     }
-  if (cutoff == 0)
+
+  jacobian.clear();
+  auto pos = jacobian_positions.begin();
+  for (const auto &first_derivative : first_derivatives)
     {
-      set<pair<int, int>> endo;
-      for (int i = 0; i < n; i++)
+      vector<double> &v = jacobian[first_derivative.first];
+      v.assign(n, nan);
+      for (int k = 0; k < n; k++)
+        if (status[*pos * n + k] == EvalTape::Status::ok)
+          v[k] = values[*pos * n + k];
+      pos++;
+    }
+}
+
+void
+ModelTree::checkCutoffRobustness(const eval_context_t &eval_context, const set<pair<int, int>> &below_cutoff, double cutoff) const
+{
+  /* Draws the points: the first one is the given calibration, and the others
+     multiply each nonzero parameter by a random factor. Zero parameters are
+     left unchanged, since they usually switch off a part of the model. The
+     generator has a fixed seed, so that the check is reproducible. */
+  const int draws = 8;
+  mt19937 gen(0);
+  uniform_real_distribution<double> factor(0.5, 1.5);
+  vector<eval_context_t> points(draws + 1, eval_context);
+  for (int k = 1; k <= draws; k++)
+    for (auto &it : points[k])
+      if (it.first >= 0 && symbol_table.getType(it.first) == SymbolType::parameter && it.second != 0)
+        it.second *= factor(gen);
+
+  vector<double> residuals;
+  map<pair<int, int>, vector<double>> jacobian;
+  evaluateResidualsAndJacobian(DenseEvalContext(points), residuals, jacobian);
+
+  // An element is fragile if it is above the cutoff at one of the draws
+  vector<pair<int, int>> fragile;
+  for (const auto &it : below_cutoff)
+    {
+      const vector<double> &values = jacobian.at(it);
+      if (any_of(values.begin() + 1, values.end(), [cutoff](double v) { return fabs(v) >= cutoff; }))
+        fragile.push_back(it);
+    }
+  if (fragile.empty())
+    return;
+
+  cerr << "WARNING: " << fragile.size() << " elements of the Jacobian are below the cutoff (" << cutoff
+       << ") at the given parameter values, but not when the parameters are perturbed by up to 50%."
+       << " The block decomposition may not be valid for other calibrations:" << endl;
+  for (const auto &it : fragile)
+    {
+      int eq = it.first, deriv_id = it.second;
+      cerr << "  equation " << eq+1;
+      if (equations_lineno[eq] == -1)
+        cerr << " (auxiliary)";
+      else
+        cerr << " (line " << equations_lineno[eq] << ")";
+      cerr << ", variable " << symbol_table.getName(getSymbIDByDerivID(deriv_id)) << "(" << getLagByDerivID(deriv_id) << ")" << endl;
+    }
+}
+
+//! Returns the elements of a derivative key (equation, then derivation IDs)
+template<typename Key, size_t... I>
+static vector<int>
+derivativeKeyElements(const Key &key, index_sequence<I...>)
+{
+  return { get<I>(key)... };
+}
+
+map<string, string>
+ModelTree::computeStructuralDigests() const
+{
+  map<string, string> digests;
+
+  auto add_deriv_id = [this](StructuralHash &hash, int deriv_id)
+    {
+      hash.update(deriv_id);
+      hash.update(getSymbIDByDerivID(deriv_id));
+      hash.update(getLagByDerivID(deriv_id));
+    };
+  auto add_derivatives = [&](StructuralHash &hash, const auto &derivatives)
+    {
+      hash.update(derivatives.size());
+      for (const auto &it : derivatives)
         {
-          endo.clear();
-          equations[i]->collectEndogenous(endo);
-          for (const auto & it : endo)
-            IM[i * n + endo2eq[it.first]] = true;
+          using Key = typename decay<decltype(it.first)>::type;
+          vector<int> key = derivativeKeyElements(it.first, make_index_sequence<tuple_size<Key>::value>());
+          hash.update(key[0]);
+          for (size_t i = 1; i < key.size(); i++)
+            add_deriv_id(hash, key[i]);
+          hash.updateExpression(it.second);
         }
+    };
+
+  StructuralHash equations_hash;
+  equations_hash.update(equations.size());
+  for (auto equation : equations)
+    equations_hash.updateExpression(equation);
+  for (const auto &equation_tag : equation_tags)
+    {
+      equations_hash.update(equation_tag.first);
+      equations_hash.update(equation_tag.second.first);
+      equations_hash.update(equation_tag.second.second);
     }
-  else
-    for (const auto & it : static_jacobian_arg)
-      IM[it.first.first * n + endo2eq[it.first.second]] = true;
+  equations_hash.update(aux_equations.size());
+  for (auto aux_equation : aux_equations)
+    equations_hash.updateExpression(aux_equation);
+  digests["equations"] = equations_hash.hexDigest();
+
+  ContentHash lines_hash;
+  for (auto lineno : equations_lineno)
+    lines_hash.update(static_cast<uint64_t>(lineno));
+  digests["lines"] = lines_hash.hexDigest();
+
+  StructuralHash first_hash, second_hash, third_hash;
+  add_derivatives(first_hash, first_derivatives);
+  digests["first_derivatives"] = first_hash.hexDigest();
+  add_derivatives(second_hash, second_derivatives);
+  digests["second_derivatives"] = second_hash.hexDigest();
+  add_derivatives(third_hash, third_derivatives);
+  digests["third_derivatives"] = third_hash.hexDigest();
+
+  /* Temporary terms are identified by the position of their node among the
+     nodes of the equations and derivatives (the order of the sets depends on
+     the indices of the nodes, hence the sort) */
+  auto add_temporary_terms = [](StructuralHash &hash, const temporary_terms_t &tt, const temporary_terms_idxs_t &tt_idxs)
+    {
+      vector<pair<int, int>> terms;
+      for (auto term : tt)
+        {
+          auto it = tt_idxs.find(term);
+          terms.emplace_back(it == tt_idxs.end() ? -1 : it->second, term->addToStructuralHash(hash));
+        }
+      sort(terms.begin(), terms.end());
+      hash.update(terms.size());
+      for (const auto &term : terms)
+        {
+          hash.update(term.first);
+          hash.update(term.second);
+        }
+    };
+  StructuralHash tt_hash;
+  for (auto equation : equations)
+    tt_hash.updateExpression(equation);
+  add_derivatives(tt_hash, first_derivatives);
+  add_derivatives(tt_hash, second_derivatives);
+  add_derivatives(tt_hash, third_derivatives);
+  for (const auto *tt : { &temporary_terms, &temporary_terms_res, &temporary_terms_g1,
+        &temporary_terms_g2, &temporary_terms_g3 })
+    add_temporary_terms(tt_hash, *tt, temporary_terms_idxs);
+  vector<pair<int, int>> mlv;
+  for (const auto &it : temporary_terms_mlv)
+    mlv.emplace_back(it.first->addToStructuralHash(tt_hash), it.second->addToStructuralHash(tt_hash));
+  sort(mlv.begin(), mlv.end());
+  tt_hash.update(mlv.size());
+  for (const auto &it : mlv)
+    {
+      tt_hash.update(it.first);
+      tt_hash.update(it.second);
+    }
+  digests["temporary_terms"] = tt_hash.hexDigest();
+
+  StructuralHash params_hash;
+  add_derivatives(params_hash, residuals_params_derivatives);
+  add_derivatives(params_hash, residuals_params_second_derivatives);
+  add_derivatives(params_hash, jacobian_params_derivatives);
+  add_derivatives(params_hash, jacobian_params_second_derivatives);
+  add_derivatives(params_hash, hessian_params_derivatives);
+  for (const auto *tt : { &params_derivs_temporary_terms, &params_derivs_temporary_terms_res,
+        &params_derivs_temporary_terms_g1, &params_derivs_temporary_terms_res2,
+        &params_derivs_temporary_terms_g12, &params_derivs_temporary_terms_g2 })
+    add_temporary_terms(params_hash, *tt, params_derivs_temporary_terms_idxs);
+  digests["params_derivatives"] = params_hash.hexDigest();
+
+  StructuralHash blocks_hash;
+  addBlockDecompositionToStructuralHash(blocks_hash);
+  digests["blocks"] = blocks_hash.hexDigest();
+
+  return digests;
+}
+
+void
+ModelTree::addBlockDecompositionToStructuralHash(StructuralHash &hash) const
+{
+  for (const auto *reordering : { &equation_reordered, &variable_reordered })
+    {
+      hash.update(reordering->size());
+      for (auto i : *reordering)
+        hash.update(i);
+    }
+}
+
+void
+ModelTree::addBlocksToStructuralHash(StructuralHash &hash,
+                                     const equation_type_and_normalized_equation_t &equation_type_and_normalized_equation,
+                                     const block_type_firstequation_size_mfs_t &block_type_firstequation_size_mfs,
+                                     const vector<bool> &blocks_linear) const
+{
+  ModelTree::addBlockDecompositionToStructuralHash(hash);
+  hash.update(equation_type_and_normalized_equation.size());
+  for (const auto &it : equation_type_and_normalized_equation)
+    {
+      hash.update(static_cast<int64_t>(it.first));
+      hash.update(it.second ? it.second->addToStructuralHash(hash) : -1);
+    }
+  hash.update(block_type_firstequation_size_mfs.size());
+  for (const auto &it : block_type_firstequation_size_mfs)
+    {
+      hash.update(static_cast<int64_t>(it.first.first));
+      hash.update(it.first.second);
+      hash.update(it.second.first);
+      hash.update(it.second.second);
+    }
+  hash.update(blocks_linear.size());
+  for (auto linear : blocks_linear)
+    hash.update(linear);
+}
+
+IncidenceMatrix
+ModelTree::computeSymbolicIncidence() const
+{
+  vector<IncidenceMatrix::Element> elements;
+  set<pair<int, int>> endo;
+  for (int eq = 0; eq < (int) equations.size(); eq++)
+    {
+      endo.clear();
+      equations[eq]->collectEndogenous(endo);
+      for (const auto &it : endo)
+        elements.push_back({ eq, it.first, 0, it.second == 0, 0 });
+    }
+  return IncidenceMatrix(equations.size(), symbol_table.endo_nbr(), elements);
+}
+
+void
+ModelTree::computePrologueAndEpilogue(const IncidenceMatrix &incidence, vector<int> &equation_reordered, vector<int> &variable_reordered)
+{
+  int n = equations.size();
+  equation_reordered.resize(n);
+  variable_reordered.resize(n);
+  /* The incidence matrix is reordered by permuting its rows and columns: row
+     (resp. column) i of the reordered matrix is equation eq_at[i] (resp.
+     endogenous endo_at[i]). Initially, the endogenous are placed on the
+     diagonal according to the normalization. */
+  vector<int> eq_at(n), eq_pos(n), endo_at(n), endo_pos(n);
+  for (int i = 0; i < n; i++)
+    {
+      equation_reordered[i] = i;
+      eq_at[i] = eq_pos[i] = i;
+      variable_reordered[endo2eq[i]] = i;
+      endo_at[endo2eq[i]] = i;
+      endo_pos[i] = endo2eq[i];
+    }
+  auto swap_rows = [&](int i, int j)
+    {
+      swap(eq_at[i], eq_at[j]);
+      eq_pos[eq_at[i]] = i;
+      eq_pos[eq_at[j]] = j;
+      swap(equation_reordered[i], equation_reordered[j]);
+    };
+  auto swap_cols = [&](int i, int j)
+    {
+      swap(endo_at[i], endo_at[j]);
+      endo_pos[endo_at[i]] = i;
+      endo_pos[endo_at[j]] = j;
+      swap(variable_reordered[i], variable_reordered[j]);
+    };
   bool something_has_been_done = true;
   prologue = 0;
   int k = 0;
@@ -357,32 +629,17 @@ ModelTree::computePrologueAndEpilogue(const jacob_map_t &static_jacobian_arg, ve
       for (int i = prologue; i < n; i++)
         {
           int nze = 0;
-          for (int j = tmp_prologue; j < n; j++)
-            if (IM[i * n + j])
+          int eq = eq_at[i];
+          for (int pos = incidence.rowBegin(eq); pos < incidence.rowEnd(eq); pos++)
+            if (endo_pos[incidence.getCol(pos)] >= tmp_prologue)
               {
                 nze++;
-                k = j;
+                k = endo_pos[incidence.getCol(pos)];
               }
           if (nze == 1)
             {
-              for (int j = 0; j < n; j++)
-                {
-                  bool tmp_bool = IM[tmp_prologue * n + j];
-                  IM[tmp_prologue * n + j] = IM[i * n + j];
-                  IM[i * n + j] = tmp_bool;
-                }
-              int tmp = equation_reordered[tmp_prologue];
-              equation_reordered[tmp_prologue] = equation_reordered[i];
-              equation_reordered[i] = tmp;
-              for (int j = 0; j < n; j++)
-                {
-                  bool tmp_bool = IM[j * n + tmp_prologue];
-                  IM[j * n + tmp_prologue] = IM[j * n + k];
-                  IM[j * n + k] = tmp_bool;
-                }
-              tmp = variable_reordered[tmp_prologue];
-              variable_reordered[tmp_prologue] = variable_reordered[k];
-              variable_reordered[k] = tmp;
+              swap_rows(tmp_prologue, i);
+              swap_cols(tmp_prologue, k);
               tmp_prologue++;
               something_has_been_done = true;
             }
@@ -400,39 +657,23 @@ ModelTree::computePrologueAndEpilogue(const jacob_map_t &static_jacobian_arg, ve
       for (int i = prologue; i < n - (int) epilogue; i++)
         {
           int nze = 0;
-          for (int j = prologue; j < n - tmp_epilogue; j++)
-            if (IM[j * n + i])
+          int endo = endo_at[i];
+          for (int pos = incidence.colBegin(endo); pos < incidence.colEnd(endo); pos++)
+            if (eq_pos[incidence.getRow(pos)] >= (int) prologue && eq_pos[incidence.getRow(pos)] < n - tmp_epilogue)
               {
                 nze++;
-                k = j;
+                k = eq_pos[incidence.getRow(pos)];
               }
           if (nze == 1)
             {
-              for (int j = 0; j < n; j++)
-                {
-                  bool tmp_bool = IM[(n - 1 - tmp_epilogue) * n + j];
-                  IM[(n - 1 - tmp_epilogue) * n + j] = IM[k * n + j];
-                  IM[k * n + j] = tmp_bool;
-                }
-              int tmp = equation_reordered[n - 1 - tmp_epilogue];
-              equation_reordered[n - 1 - tmp_epilogue] = equation_reordered[k];
-              equation_reordered[k] = tmp;
-              for (int j = 0; j < n; j++)
-                {
-                  bool tmp_bool = IM[j * n + n - 1 - tmp_epilogue];
-                  IM[j * n + n - 1 - tmp_epilogue] = IM[j * n + i];
-                  IM[j * n + i] = tmp_bool;
-                }
-              tmp = variable_reordered[n - 1 - tmp_epilogue];
-              variable_reordered[n - 1 - tmp_epilogue] = variable_reordered[i];
-              variable_reordered[i] = tmp;
+              swap_rows(n - 1 - tmp_epilogue, k);
+              swap_cols(n - 1 - tmp_epilogue, i);
               tmp_epilogue++;
               something_has_been_done = true;
             }
         }
       epilogue = tmp_epilogue;
     }
-  free(IM);
 }
 
 equation_type_and_normalized_equation_t
@@ -526,12 +767,194 @@ ModelTree::getVariableLeadLagByBlock(const dynamic_jacob_map_t &dynamic_jacobian
     }
 }
 
+string
+ModelTree::computeBlockDecompositionDigest(const IncidenceMatrix &incidence, const dynamic_jacob_map_t &dynamic_jacobian, const vector<int> &equation_reordered, const vector<int> &variable_reordered, const equation_type_and_normalized_equation_t &Equation_Type, bool select_feedback_variable, int mfs) const
+{
+  ContentHash hash;
+  auto add = [&hash](int value)
+    {
+      hash.update(static_cast<uint64_t>(static_cast<int64_t>(value)));
+    };
+  auto add_vector = [&](const vector<int> &values)
+    {
+      add(values.size());
+      for (int value : values)
+        add(value);
+    };
+  ostringstream version;
+  version << "Dynare block decomposition " << PACKAGE_VERSION;
+  hash.update(version.str());
+  add(select_feedback_variable);
+  add(mfs);
+  add(prologue);
+  add(epilogue);
+  add_vector(equation_reordered);
+  add_vector(variable_reordered);
+  add_vector(endo2eq);
+  add(incidence.getRowNbr());
+  for (int eq = 0; eq < incidence.getRowNbr(); eq++)
+    {
+      add(incidence.rowEnd(eq) - incidence.rowBegin(eq));
+      for (int pos = incidence.rowBegin(eq); pos < incidence.rowEnd(eq); pos++)
+        add(incidence.getCol(pos));
+    }
+  add(dynamic_jacobian.size());
+  for (const auto &it : dynamic_jacobian)
+    {
+      add(it.first.first);
+      add(it.first.second.first);
+      add(it.first.second.second);
+    }
+  add(Equation_Type.size());
+  for (const auto &it : Equation_Type)
+    add(it.first);
+  return hash.hexDigest();
+}
+
+//! Computes the digest of the graph of a block, used as the key of its feedback variables in the block cache
+/*! The feedback variables and the ordering of the recursive variables only
+  depend on the edges of the graph, in the order in which they are stored */
+static string
+feedbackVariablesDigest(const FlatGraph &G)
+{
+  ContentHash hash;
+  ostringstream version;
+  version << "Dynare feedback variables " << PACKAGE_VERSION;
+  hash.update(version.str());
+  hash.update(static_cast<uint64_t>(G.vertex_id_bound()));
+  for (int v = 0; v < G.vertex_id_bound(); v++)
+    for (const auto *adjacent : { &G.out_vertices(v), &G.in_vertices(v) })
+      {
+        hash.update(static_cast<uint64_t>(adjacent->size()));
+        for (int w : *adjacent)
+          hash.update(static_cast<uint64_t>(w));
+      }
+  return hash.hexDigest();
+}
+
+//! Minimum size of the blocks whose feedback variables are kept in the block cache (they are cheap to compute on smaller blocks)
+static const int block_cache_min_size = 10;
+
+//! Checks that a record loaded from the block cache is a permutation of 0, …, n-1
+static bool
+isPermutationRecord(const vector<int> &record, int n)
+{
+  if ((int) record.size() != n)
+    return false;
+  vector<bool> seen(n, false);
+  for (int i : record)
+    {
+      if (i < 0 || i >= n || seen[i])
+        return false;
+      seen[i] = true;
+    }
+  return true;
+}
+
 void
-ModelTree::computeBlockDecompositionAndFeedbackVariablesForEachBlock(const jacob_map_t &static_jacobian, const dynamic_jacob_map_t &dynamic_jacobian, vector<int> &equation_reordered, vector<int> &variable_reordered, vector<pair<int, int>> &blocks, const equation_type_and_normalized_equation_t &Equation_Type, bool verbose_, bool select_feedback_variable, int mfs, vector<int> &inv_equation_reordered, vector<int> &inv_variable_reordered, lag_lead_vector_t &equation_lag_lead, lag_lead_vector_t &variable_lag_lead, vector<unsigned int> &n_static, vector<unsigned int> &n_forward, vector<unsigned int> &n_backward, vector<unsigned int> &n_mixed) const
+ModelTree::computeBlockDecompositionAndFeedbackVariablesForEachBlock(const IncidenceMatrix &incidence, const dynamic_jacob_map_t &dynamic_jacobian, vector<int> &equation_reordered, vector<int> &variable_reordered, vector<pair<int, int>> &blocks, const equation_type_and_normalized_equation_t &Equation_Type, bool verbose_, bool select_feedback_variable, int mfs, vector<int> &inv_equation_reordered, vector<int> &inv_variable_reordered, lag_lead_vector_t &equation_lag_lead, lag_lead_vector_t &variable_lag_lead, vector<unsigned int> &n_static, vector<unsigned int> &n_forward, vector<unsigned int> &n_backward, vector<unsigned int> &n_mixed) const
 {
   int nb_var = variable_reordered.size();
   int n = nb_var - prologue - epilogue;
 
+  auto compute_inverse_reordering = [&]()
+    {
+      inv_equation_reordered = vector<int>(nb_var);
+      inv_variable_reordered = vector<int>(nb_var);
+      for (int i = 0; i < nb_var; i++)
+        {
+          inv_variable_reordered[variable_reordered[i]] = i;
+          inv_equation_reordered[equation_reordered[i]] = i;
+        }
+    };
+
+  /* The records of an entry of the block cache are: the reorderings of the
+     equations and variables, the blocks, the lags and leads of the equations
+     and variables, and the dynamic structure of each block */
+  auto pairs_record = [](const vector<pair<int, int>> &pairs)
+    {
+      vector<int> record;
+      for (const auto &it : pairs)
+        {
+          record.push_back(it.first);
+          record.push_back(it.second);
+        }
+      return record;
+    };
+  auto pairs_from_record = [](const vector<int> &record)
+    {
+      vector<pair<int, int>> pairs;
+      for (size_t i = 0; i + 1 < record.size(); i += 2)
+        pairs.emplace_back(record[i], record[i+1]);
+      return pairs;
+    };
+
+  // Checks an entry of the cache, which may have been corrupted
+  auto valid_records = [&](const vector<vector<int>> &records)
+    {
+      if (records.size() != 9
+          || !isPermutationRecord(records[0], nb_var) || !isPermutationRecord(records[1], nb_var)
+          || records[2].size() % 2 != 0
+          || (int) records[3].size() != 2 * nb_var || (int) records[4].size() != 2 * nb_var)
+        return false;
+      for (int k = 3; k < 5; k++)
+        if (any_of(records[k].begin(), records[k].end(), [](int lag) { return lag < 0; }))
+          return false;
+      // The blocks (size, number of feedback variables) cover the variables between the prologue and the epilogue
+      vector<pair<int, int>> cached_blocks = pairs_from_record(records[2]);
+      int total = 0;
+      for (const auto &it : cached_blocks)
+        {
+          if (it.first <= 0 || it.first > n - total || it.second < 0 || it.second > it.first)
+            return false;
+          total += it.first;
+        }
+      if (total != n)
+        return false;
+      // Each variable is counted once in the dynamic structure of its block
+      size_t nb_blocks = prologue + cached_blocks.size() + epilogue;
+      for (int k = 5; k < 9; k++)
+        if (records[k].size() != nb_blocks)
+          return false;
+      for (size_t b = 0; b < nb_blocks; b++)
+        {
+          int size = b < prologue || b >= prologue + cached_blocks.size() ? 1 : cached_blocks[b - prologue].first;
+          int count = 0;
+          for (int k = 5; k < 9; k++)
+            {
+              if (records[k][b] < 0 || records[k][b] > size - count)
+                return false;
+              count += records[k][b];
+            }
+          if (count != size)
+            return false;
+        }
+      return true;
+    };
+
+  unique_ptr<DigestCache> cache;
+  string digest;
+  if (!block_cache.empty())
+    {
+      cache = make_unique<DigestCache>(block_cache);
+      digest = computeBlockDecompositionDigest(incidence, dynamic_jacobian, equation_reordered, variable_reordered, Equation_Type, select_feedback_variable, mfs);
+      vector<vector<int>> records;
+      if (cache->load(digest, records) && valid_records(records))
+        {
+          equation_reordered = records[0];
+          variable_reordered = records[1];
+          blocks = pairs_from_record(records[2]);
+          equation_lag_lead = pairs_from_record(records[3]);
+          variable_lag_lead = pairs_from_record(records[4]);
+          n_static.assign(records[5].begin(), records[5].end());
+          n_forward.assign(records[6].begin(), records[6].end());
+          n_backward.assign(records[7].begin(), records[7].end());
+          n_mixed.assign(records[8].begin(), records[8].end());
+          compute_inverse_reordering();
+          return;
+        }
+    }
+
   AdjacencyList_t G2(n);
 
   // It is necessary to manually initialize vertex_index property since this graph uses listS and not vecS as underlying vertex container
@@ -546,28 +969,17 @@ ModelTree::computeBlockDecompositionAndFeedbackVariablesForEachBlock(const jacob
       reverse_equation_reordered[equation_reordered[i]] = i;
       reverse_variable_reordered[variable_reordered[i]] = i;
     }
-  jacob_map_t tmp_normalized_contemporaneous_jacobian;
-  if (cutoff == 0)
-    {
-      set<pair<int, int>> endo;
-      for (int i = 0; i < nb_var; i++)
-        {
-          endo.clear();
-          equations[i]->collectEndogenous(endo);
-          for (const auto & it : endo)
-            tmp_normalized_contemporaneous_jacobian[{ i, it.first }] = 1;
-
-        }
-    }
-  else
-    tmp_normalized_contemporaneous_jacobian = static_jacobian;
-  for (jacob_map_t::const_iterator it = tmp_normalized_contemporaneous_jacobian.begin(); it != tmp_normalized_contemporaneous_jacobian.end(); it++)
-    if (reverse_equation_reordered[it->first.first] >= (int) prologue && reverse_equation_reordered[it->first.first] < (int) (nb_var - epilogue)
-        && reverse_variable_reordered[it->first.second] >= (int) prologue && reverse_variable_reordered[it->first.second] < (int) (nb_var - epilogue)
-        && it->first.first != endo2eq[it->first.second])
-      add_edge(vertex(reverse_equation_reordered[endo2eq[it->first.second]]-prologue, G2),
-               vertex(reverse_equation_reordered[it->first.first]-prologue, G2),
-               G2);
+  for (int eq = 0; eq < nb_var; eq++)
+    for (int pos = incidence.rowBegin(eq); pos < incidence.rowEnd(eq); pos++)
+      {
+        int var = incidence.getCol(pos);
+        if (reverse_equation_reordered[eq] >= (int) prologue && reverse_equation_reordered[eq] < (int) (nb_var - epilogue)
+            && reverse_variable_reordered[var] >= (int) prologue && reverse_variable_reordered[var] < (int) (nb_var - epilogue)
+            && eq != endo2eq[var])
+          add_edge(vertex(reverse_equation_reordered[endo2eq[var]]-prologue, G2),
+                   vertex(reverse_equation_reordered[eq]-prologue, G2),
+                   G2);
+      }
 
   vector<int> endo2block(num_vertices(G2)), discover_time(num_vertices(G2));
   boost::iterator_property_map<int *, boost::property_map<AdjacencyList_t, boost::vertex_index_t>::type, int, int &> endo2block_map(&endo2block[0], get(boost::vertex_index, G2));
@@ -658,22 +1070,64 @@ ModelTree::computeBlockDecompositionAndFeedbackVariablesForEachBlock(const jacob
   // and the non-feedback variables are reordered to get
   // a sub-recursive block without feedback variables
 
+  /* The blocks are independent at this stage, so this is done block by block
+     with forEachBlock(); the feedback variables are stored with their indices
+     in G2, for the reordering of the equations and variables below. With a
+     block cache, the feedback variables of the large blocks are looked up by
+     the digest of their graph (in the cache, vertices are numbered by their
+     rank in the block) */
+  vector<vector<int>> feedback_indices(num);
+  forEachBlock(num, [&](unsigned int i, int thread)
+               {
+                 FlatGraph G = extract_flat_subgraph(G2, components_set[i].first);
+                 set<int> &feed_back_vertices = components_set[i].second.first;
+                 vector<int> &reordered_vertices = components_set[i].second.second;
+                 vector<int> members(components_set[i].first.begin(), components_set[i].first.end());
+                 int size = members.size();
+                 string block_digest;
+                 vector<vector<int>> records;
+                 if (cache && size >= block_cache_min_size)
+                   block_digest = feedbackVariablesDigest(G);
+                 // The feedback and the reordered vertices must together be a permutation of the block
+                 bool cached = !block_digest.empty() && cache->load(block_digest, records) && records.size() == 2;
+                 if (cached)
+                   {
+                     vector<int> all_vertices = records[0];
+                     all_vertices.insert(all_vertices.end(), records[1].begin(), records[1].end());
+                     cached = isPermutationRecord(all_vertices, size);
+                   }
+                 if (cached)
+                   {
+                     feed_back_vertices.insert(records[0].begin(), records[0].end());
+                     for (int v : records[1])
+                       reordered_vertices.push_back(members[v]);
+                   }
+                 else
+                   {
+                     Minimal_set_of_feedback_vertex(feed_back_vertices, G);
+                     Reorder_the_recursive_variables(G, feed_back_vertices, reordered_vertices);
+                     if (!block_digest.empty())
+                       {
+                         records.assign(2, {});
+                         records[0].assign(feed_back_vertices.begin(), feed_back_vertices.end());
+                         for (int index : reordered_vertices)
+                           records[1].push_back(lower_bound(members.begin(), members.end(), index) - members.begin());
+                         cache->store(block_digest, records);
+                       }
+                   }
+                 for (int feed_back_vertice : feed_back_vertices)
+                   feedback_indices[i].push_back(G.index(feed_back_vertice));
+               });
+
   for (int i = 0; i < num; i++)
     {
-      AdjacencyList_t G = extract_subgraph(G2, components_set[i].first);
-      set<int> feed_back_vertices;
-      //Print(G);
-      AdjacencyList_t G1 = Minimal_set_of_feedback_vertex(feed_back_vertices, G);
-      auto v_index = get(boost::vertex_index, G);
-      components_set[i].second.first = feed_back_vertices;
-      blocks[i].second = feed_back_vertices.size();
-      vector<int> Reordered_Vertice;
-      Reorder_the_recursive_variables(G, feed_back_vertices, Reordered_Vertice);
+      blocks[i].second = feedback_indices[i].size();
+      const vector<int> &Reordered_Vertice = components_set[i].second.second;
 
       //First we have the recursive equations conditional on feedback variables
       for (int j = 0; j < 4; j++)
         {
-          for (int & its : Reordered_Vertice)
+          for (int its : Reordered_Vertice)
             {
               bool something_done = false;
               if      (j == 2 && variable_lag_lead[tmp_variable_reordered[its +prologue]].first != 0 && variable_lag_lead[tmp_variable_reordered[its +prologue]].second != 0)
@@ -704,37 +1158,36 @@ ModelTree::computeBlockDecompositionAndFeedbackVariablesForEachBlock(const jacob
                 }
             }
         }
-      components_set[i].second.second = Reordered_Vertice;
       //Second we have the equations related to the feedback variables
       for (int j = 0; j < 4; j++)
         {
-          for (int feed_back_vertice : feed_back_vertices)
+          for (int feed_back_vertice : feedback_indices[i])
             {
               bool something_done = false;
-              if      (j == 2 && variable_lag_lead[tmp_variable_reordered[v_index[vertex(feed_back_vertice, G)]+prologue]].first != 0 && variable_lag_lead[tmp_variable_reordered[v_index[vertex(feed_back_vertice, G)]+prologue]].second != 0)
+              if      (j == 2 && variable_lag_lead[tmp_variable_reordered[feed_back_vertice+prologue]].first != 0 && variable_lag_lead[tmp_variable_reordered[feed_back_vertice+prologue]].second != 0)
                 {
                   n_mixed[prologue+i]++;
                   something_done = true;
                 }
-              else if (j == 3 && variable_lag_lead[tmp_variable_reordered[v_index[vertex(feed_back_vertice, G)]+prologue]].first == 0 && variable_lag_lead[tmp_variable_reordered[v_index[vertex(feed_back_vertice, G)]+prologue]].second != 0)
+              else if (j == 3 && variable_lag_lead[tmp_variable_reordered[feed_back_vertice+prologue]].first == 0 && variable_lag_lead[tmp_variable_reordered[feed_back_vertice+prologue]].second != 0)
                 {
                   n_forward[prologue+i]++;
                   something_done = true;
                 }
-              else if (j == 1 && variable_lag_lead[tmp_variable_reordered[v_index[vertex(feed_back_vertice, G)]+prologue]].first != 0 && variable_lag_lead[tmp_variable_reordered[v_index[vertex(feed_back_vertice, G)]+prologue]].second == 0)
+              else if (j == 1 && variable_lag_lead[tmp_variable_reordered[feed_back_vertice+prologue]].first != 0 && variable_lag_lead[tmp_variable_reordered[feed_back_vertice+prologue]].second == 0)
                 {
                   n_backward[prologue+i]++;
                   something_done = true;
                 }
-              else if (j == 0 && variable_lag_lead[tmp_variable_reordered[v_index[vertex(feed_back_vertice, G)]+prologue]].first == 0 && variable_lag_lead[tmp_variable_reordered[v_index[vertex(feed_back_vertice, G)]+prologue]].second == 0)
+              else if (j == 0 && variable_lag_lead[tmp_variable_reordered[feed_back_vertice+prologue]].first == 0 && variable_lag_lead[tmp_variable_reordered[feed_back_vertice+prologue]].second == 0)
                 {
                   n_static[prologue+i]++;
                   something_done = true;
                 }
               if (something_done)
                 {
-                  equation_reordered[order] = tmp_equation_reordered[v_index[vertex(feed_back_vertice, G)]+prologue];
-                  variable_reordered[order] = tmp_variable_reordered[v_index[vertex(feed_back_vertice, G)]+prologue];
+                  equation_reordered[order] = tmp_equation_reordered[feed_back_vertice+prologue];
+                  variable_reordered[order] = tmp_variable_reordered[feed_back_vertice+prologue];
                   order++;
                 }
             }
@@ -753,13 +1206,13 @@ ModelTree::computeBlockDecompositionAndFeedbackVariablesForEachBlock(const jacob
         n_static[prologue+num+i]++;
     }
 
-  inv_equation_reordered = vector<int>(nb_var);
-  inv_variable_reordered = vector<int>(nb_var);
-  for (int i = 0; i < nb_var; i++)
-    {
-      inv_variable_reordered[variable_reordered[i]] = i;
-      inv_equation_reordered[equation_reordered[i]] = i;
-    }
+  compute_inverse_reordering();
+
+  if (cache)
+    cache->store(digest, { equation_reordered, variable_reordered, pairs_record(blocks),
+          pairs_record(equation_lag_lead), pairs_record(variable_lag_lead),
+          vector<int>(n_static.begin(), n_static.end()), vector<int>(n_forward.begin(), n_forward.end()),
+          vector<int>(n_backward.begin(), n_backward.end()), vector<int>(n_mixed.begin(), n_mixed.end()) });
 }
 
 void
@@ -1006,6 +1459,11 @@ ModelTree::ModelTree(SymbolTable &symbol_table_arg,
                      ExternalFunctionsTable &external_functions_table_arg) :
   DataTree(symbol_table_arg, num_constants_arg, external_functions_table_arg),
   cutoff(1e-15),
+  nthreads(1),
+  flat_bytecode(false),
+  cse_temporary_terms(false),
+  temporary_terms_report(false),
+  params_derivs_adjoint(false),
   mfs(0)
 
 {
@@ -1031,77 +1489,337 @@ ModelTree::writeDerivative(ostream &output, int eq, int symb_id, int lag,
     output << 0;
 }
 
+//! DataTree in which a worker thread computes a subset of the derivatives of a model
+/*! It has its own nodes and numerical constants, so that worker threads never
+  modify shared data. Derivation IDs are those of the model being derived. */
+class DerivationShardTree : public DataTree
+{
+private:
+  DataTree &model;
+public:
+  DerivationShardTree(DataTree &model_arg, NumericalConstants &num_constants_arg) :
+    DataTree(model_arg.symbol_table, num_constants_arg, model_arg.external_functions_table),
+    model(model_arg)
+  {
+  }
+  VariableNode *
+  AddVariable(int symb_id, int lag = 0) override
+  {
+    return AddVariableInternal(symb_id, lag);
+  }
+  int
+  getDerivID(int symb_id, int lag) const noexcept(false) override
+  {
+    return model.getDerivID(symb_id, lag);
+  }
+  SymbolType
+  getTypeByDerivID(int deriv_id) const noexcept(false) override
+  {
+    return model.getTypeByDerivID(deriv_id);
+  }
+  int
+  getLagByDerivID(int deriv_id) const noexcept(false) override
+  {
+    return model.getLagByDerivID(deriv_id);
+  }
+  int
+  getSymbIDByDerivID(int deriv_id) const noexcept(false) override
+  {
+    return model.getSymbIDByDerivID(deriv_id);
+  }
+  int
+  getDynJacobianCol(int deriv_id) const noexcept(false) override
+  {
+    return model.getDynJacobianCol(deriv_id);
+  }
+  void
+  addAllParamDerivId(set<int> &deriv_id_set) override
+  {
+    model.addAllParamDerivId(deriv_id_set);
+  }
+  bool
+  isDynamic() const override
+  {
+    return model.isDynamic();
+  }
+};
+
+/* The derivatives are computed in a fixed number of units of work,
+   independently of nthreads. Since each unit is derived in a DataTree of its
+   own, the nodes that it creates (and thus the order of the operands of
+   commutative operators) only depend on the unit, and since the units are
+   copied back in order, the output does not depend on nthreads. */
+static const int derivation_units = 64;
+
+//! Unit of work in ModelTree::computeDerivativesParallel() and ModelTree::computeChainRuleDerivativesParallel()
+struct DerivationShard
+{
+  NumericalConstants num_constants;
+  DerivationShardTree tree;
+  vector<pair<vector<int>, expr_t>> derivs;
+  DerivationShard(DataTree &model, const NumericalConstants &model_num_constants) :
+    num_constants(model_num_constants), tree(model, num_constants)
+  {
+  }
+};
+
 void
-ModelTree::computeJacobian(const set<int> &vars)
+ModelTree::computeDerivativesParallel(const indexed_exprs_t &exprs, const set<int> &vars, bool symmetric, indexed_exprs_t &derivs)
 {
-  for (int var : vars)
+  auto derive = [&](DerivationShard &shard, size_t begin, size_t end)
     {
-      for (int eq = 0; eq < (int) equations.size(); eq++)
+      unordered_map<expr_t, expr_t> cloned;
+      for (const auto &it : local_variables_table)
+        shard.tree.AddLocalVariable(it.first, it.second->cloneShared(shard.tree, cloned));
+
+      for (size_t i = begin; i < end; i++)
         {
-          expr_t d1 = equations[eq]->getDerivative(var);
-          if (d1 == Zero)
-            continue;
-          first_derivatives[{ eq, var }] = d1;
-          ++NNZDerivatives[0];
+          expr_t e = exprs[i].second->cloneShared(shard.tree, cloned);
+          for (int var : vars)
+            {
+              if (symmetric && var > exprs[i].first.back())
+                break;
+              expr_t d = e->getDerivative(var);
+              if (d == shard.tree.Zero)
+                continue;
+              vector<int> idx = exprs[i].first;
+              idx.push_back(var);
+              shard.derivs.emplace_back(move(idx), d);
+            }
         }
+    };
+
+  /* Split the expressions into contiguous units of roughly equal size,
+     without separating expressions of the same equation (which generally
+     share many subexpressions) */
+  vector<size_t> unit_begin;
+  size_t chunk_size = max<size_t>((exprs.size() + derivation_units - 1) / derivation_units, 1);
+  for (size_t begin = 0; begin < exprs.size();)
+    {
+      unit_begin.push_back(begin);
+      size_t end = min(begin + chunk_size, exprs.size());
+      while (end < exprs.size() && exprs[end].first[0] == exprs[end-1].first[0])
+        end++;
+      begin = end;
     }
+  unit_begin.push_back(exprs.size());
+
+  /* The units are processed in waves of nthreads units, each wave being
+     copied back (in the order of the units) and freed before the next one,
+     so that at most nthreads units are alive at the same time */
+  size_t nb_units = unit_begin.size() - 1, wave_size = max(nthreads, 1);
+  for (size_t wave = 0; wave < nb_units; wave += wave_size)
+    {
+      vector<unique_ptr<DerivationShard>> shards(min(wave_size, nb_units - wave));
+      forEachBlock(shards.size(), [&](unsigned int i, int thread)
+                   {
+                     shards[i] = make_unique<DerivationShard>(*this, num_constants);
+                     derive(*shards[i], unit_begin[wave+i], unit_begin[wave+i+1]);
+                   });
+
+      for (auto &shard : shards)
+        {
+          unordered_map<expr_t, expr_t> cloned;
+          for (const auto &it : shard->derivs)
+            derivs.emplace_back(it.first, it.second->cloneShared(*this, cloned));
+          shard.reset();
+        }
+    }
+}
+
+void
+ModelTree::forEachBlock(unsigned int nb_blocks, const function<void(unsigned int, int)> &f) const
+{
+  if (nthreads <= 1)
+    {
+      for (unsigned int block = 0; block < nb_blocks; block++)
+        f(block, 0);
+      return;
+    }
+
+  atomic<unsigned int> next_block{0};
+  vector<exception_ptr> errors(nthreads);
+  vector<thread> workers;
+  for (int t = 0; t < nthreads && t < (int) nb_blocks; t++)
+    workers.emplace_back([&, t]
+                         {
+                           try
+                             {
+                               for (unsigned int block = next_block++; block < nb_blocks; block = next_block++)
+                                 f(block, t);
+                             }
+                           catch (...)
+                             {
+                               errors[t] = current_exception();
+                             }
+                         });
+  for (auto &worker : workers)
+    worker.join();
+  for (auto &error : errors)
+    if (error)
+      rethrow_exception(error);
+}
+
+void
+ModelTree::computeChainRuleDerivativesParallel(const vector<map<int, expr_t>> &recursive_variables, vector<vector<pair<expr_t, int>>> &derivs)
+{
+  auto derive = [&](DerivationShard &shard, size_t begin, size_t end)
+    {
+      unordered_map<expr_t, expr_t> cloned;
+      for (const auto &it : local_variables_table)
+        shard.tree.AddLocalVariable(it.first, it.second->cloneShared(shard.tree, cloned));
+
+      for (size_t block = begin; block < end; block++)
+        {
+          map<int, expr_t> block_recursive_variables;
+          for (const auto &it : recursive_variables[block])
+            block_recursive_variables[it.first] = it.second->cloneShared(shard.tree, cloned);
+          for (auto &it : derivs[block])
+            it.first = it.first->cloneShared(shard.tree, cloned)->getChainRuleDerivative(it.second, block_recursive_variables);
+        }
+    };
+
+  // Split the blocks into contiguous units with roughly the same number of derivatives
+  size_t total = 0;
+  for (const auto &it : derivs)
+    total += it.size();
+  if (total == 0)
+    return;
+  size_t nb_blocks = derivs.size();
+  while (derivs[nb_blocks-1].empty())
+    nb_blocks--;
+  size_t chunk_size = (total + derivation_units - 1) / derivation_units;
+  vector<size_t> unit_begin;
+  for (size_t begin = 0; begin < nb_blocks;)
+    {
+      unit_begin.push_back(begin);
+      size_t end = begin, size = 0;
+      while (end < nb_blocks && (size < chunk_size || end == begin))
+        size += derivs[end++].size();
+      begin = end;
+    }
+  unit_begin.push_back(nb_blocks);
+
+  // As in computeDerivativesParallel(), at most nthreads units are alive at the same time
+  size_t nb_units = unit_begin.size() - 1, wave_size = max(nthreads, 1);
+  for (size_t wave = 0; wave < nb_units; wave += wave_size)
+    {
+      vector<unique_ptr<DerivationShard>> shards(min(wave_size, nb_units - wave));
+      forEachBlock(shards.size(), [&](unsigned int i, int thread)
+                   {
+                     shards[i] = make_unique<DerivationShard>(*this, num_constants);
+                     derive(*shards[i], unit_begin[wave+i], unit_begin[wave+i+1]);
+                   });
+
+      for (size_t i = 0; i < shards.size(); i++)
+        {
+          unordered_map<expr_t, expr_t> cloned;
+          for (size_t block = unit_begin[wave+i]; block < unit_begin[wave+i+1]; block++)
+            for (auto &it : derivs[block])
+              it.first = it.first->cloneShared(*this, cloned);
+          shards[i].reset();
+        }
+    }
+}
+
+void
+ModelTree::computeJacobian(const set<int> &vars)
+{
+  indexed_exprs_t exprs, derivs;
+  for (int eq = 0; eq < (int) equations.size(); eq++)
+    exprs.emplace_back(vector<int>{ eq }, equations[eq]);
+  computeDerivativesParallel(exprs, vars, false, derivs);
+  for (const auto &it : derivs)
+    first_derivatives[{ it.first[0], it.first[1] }] = it.second;
+  NNZDerivatives[0] += derivs.size();
 }
 
 void
 ModelTree::computeHessian(const set<int> &vars)
 {
+  // Store only second derivatives with var2 <= var1
+  indexed_exprs_t exprs, derivs;
   for (const auto &it : first_derivatives)
+    if (higher_order_eqs.empty() || higher_order_eqs.find(it.first.first) != higher_order_eqs.end())
+      exprs.emplace_back(vector<int>{ it.first.first, it.first.second }, it.second);
+  computeDerivativesParallel(exprs, vars, true, derivs);
+  for (const auto &it : derivs)
     {
-      int eq, var1;
-      tie(eq, var1) = it.first;
-      expr_t d1 = it.second;
+      int eq = it.first[0], var1 = it.first[1], var2 = it.first[2];
+      second_derivatives.append({ eq, var1, var2 }, it.second);
+      if (var2 == var1)
+        ++NNZDerivatives[1];
+      else
+        NNZDerivatives[1] += 2;
+    }
+}
 
-      // Store only second derivatives with var2 <= var1
-      for (int var2 : vars)
-        {
-          if (var2 > var1)
-            continue;
+void
+ModelTree::restrictHigherOrderDerivatives(const vector<string> &eq_names, WarningConsolidation &warnings)
+{
+  higher_order_eqs.clear();
+  for (const auto &eq_name : eq_names)
+    {
+      int eq = -1;
+      for (const auto &equation_tag : equation_tags)
+        if (equation_tag.second.first == "name"
+            && equation_tag.second.second == eq_name)
+          {
+            eq = equation_tag.first;
+            break;
+          }
 
-          expr_t d2 = d1->getDerivative(var2);
-          if (d2 == Zero)
-            continue;
-          second_derivatives[{ eq, var1, var2 }] = d2;
-          if (var2 == var1)
-            ++NNZDerivatives[1];
-          else
-            NNZDerivatives[1] += 2;
+      if (eq == -1)
+        {
+          cerr << "ERROR: equation tag '" << eq_name << "' not found (in the higher_order_equations option)" << endl;
+          exit(EXIT_FAILURE);
         }
+      higher_order_eqs.insert(eq);
     }
+
+  /* The auxiliary equations (added by the transformations, with no line
+     number) cannot be named, and may be nonlinear definitions used by the
+     selected equations (e.g. AUX_UOP = log(x)): they are always kept */
+  for (int eq = 0; eq < (int) equations.size(); eq++)
+    if (equations_lineno[eq] == -1)
+      higher_order_eqs.insert(eq);
+
+  // List the equations whose derivatives of order 2 and 3 will be zero in the output
+  string discarded;
+  for (int eq = 0; eq < (int) equations.size(); eq++)
+    if (higher_order_eqs.find(eq) == higher_order_eqs.end())
+      {
+        // No quotes around the name, since the warnings end up in MATLAB strings
+        string name;
+        for (const auto &equation_tag : equation_tags)
+          if (equation_tag.first == eq && equation_tag.second.first == "name")
+            name = " [name=" + equation_tag.second.second + "]";
+        discarded += (discarded.empty() ? "" : ", ") + to_string(eq+1) + name
+          + " (line " + to_string(equations_lineno[eq]) + ")";
+      }
+  if (!discarded.empty())
+    warnings << "WARNING: because of the higher_order_equations option, the second and third order derivatives of the following equations are set to zero: "
+             << discarded << endl;
 }
 
 void
 ModelTree::computeThirdDerivatives(const set<int> &vars)
 {
+  // Store only third derivatives such that var3 <= var2 <= var1
+  indexed_exprs_t exprs, derivs;
   for (const auto &it : second_derivatives)
+    exprs.emplace_back(vector<int>{ get<0>(it.first), get<1>(it.first), get<2>(it.first) }, it.second);
+  computeDerivativesParallel(exprs, vars, true, derivs);
+  for (const auto &it : derivs)
     {
-      int eq, var1, var2;
-      tie(eq, var1, var2) = it.first;
-      // By construction, var2 <= var1
-
-      expr_t d2 = it.second;
-
-      // Store only third derivatives such that var3 <= var2 <= var1
-      for (int var3 : vars)
-        {
-          if (var3 > var2)
-            continue;
-
-          expr_t d3 = d2->getDerivative(var3);
-          if (d3 == Zero)
-            continue;
-          third_derivatives[{ eq, var1, var2, var3 }] = d3;
-          if (var3 == var2 && var2 == var1)
-            ++NNZDerivatives[2];
-          else if (var3 == var2 || var2 == var1)
-            NNZDerivatives[2] += 3;
-          else
-            NNZDerivatives[2] += 6;
-        }
+      int eq = it.first[0], var1 = it.first[1], var2 = it.first[2], var3 = it.first[3];
+      third_derivatives.append({ eq, var1, var2, var3 }, it.second);
+      if (var3 == var2 && var2 == var1)
+        ++NNZDerivatives[2];
+      else if (var3 == var2 || var2 == var1)
+        NNZDerivatives[2] += 3;
+      else
+        NNZDerivatives[2] += 6;
     }
 }
 
@@ -1135,25 +1853,54 @@ ModelTree::computeTemporaryTerms(bool is_matlab)
   temp_terms_map[NodeTreeReference::secondDeriv] = temporary_terms_g2;
   temp_terms_map[NodeTreeReference::thirdDeriv] = temporary_terms_g3;
 
-  for (auto & equation : equations)
-    equation->computeTemporaryTerms(reference_count,
-                                 temp_terms_map,
-                                 is_matlab, NodeTreeReference::residuals);
+  if (!cse_temporary_terms || temporary_terms_report)
+    {
+      for (auto & equation : equations)
+        equation->computeTemporaryTerms(reference_count,
+                                        temp_terms_map,
+                                        is_matlab, NodeTreeReference::residuals);
+
+      for (const auto &first_derivative : first_derivatives)
+        first_derivative.second->computeTemporaryTerms(reference_count,
+                                                       temp_terms_map,
+                                                       is_matlab, NodeTreeReference::firstDeriv);
+
+      for (const auto &second_derivative : second_derivatives)
+        second_derivative.second->computeTemporaryTerms(reference_count,
+                                                        temp_terms_map,
+                                                        is_matlab, NodeTreeReference::secondDeriv);
+
+      for (const auto &third_derivative : third_derivatives)
+        third_derivative.second->computeTemporaryTerms(reference_count,
+                                                       temp_terms_map,
+                                                       is_matlab, NodeTreeReference::thirdDeriv);
+    }
 
-  for (auto & first_derivative : first_derivatives)
-    first_derivative.second->computeTemporaryTerms(reference_count,
-                                      temp_terms_map,
-                                      is_matlab, NodeTreeReference::firstDeriv);
+  if (cse_temporary_terms || temporary_terms_report)
+    {
+      map<NodeTreeReference, temporary_terms_t> cse_temp_terms_map;
+      computeTemporaryTermsCSE(is_matlab, cse_temp_terms_map);
 
-  for (auto & second_derivative : second_derivatives)
-    second_derivative.second->computeTemporaryTerms(reference_count,
-                                      temp_terms_map,
-                                      is_matlab, NodeTreeReference::secondDeriv);
+      if (temporary_terms_report)
+        {
+          auto count = [](const map<NodeTreeReference, temporary_terms_t> &m)
+            {
+              size_t n = 0;
+              for (const auto &it : m)
+                n += it.second.size();
+              return n;
+            };
+          cout << "Temporary terms of the " << (isDynamic() ? "dynamic" : "static") << " model ("
+               << (is_matlab ? "MATLAB" : "C") << " costs): default engine: "
+               << count(temp_terms_map) << " terms, cost " << temporaryTermsCost(temp_terms_map, is_matlab)
+               << "; cse engine: "
+               << count(cse_temp_terms_map) << " terms, cost " << temporaryTermsCost(cse_temp_terms_map, is_matlab)
+               << endl;
+        }
 
-  for (auto & third_derivative : third_derivatives)
-    third_derivative.second->computeTemporaryTerms(reference_count,
-                                      temp_terms_map,
-                                      is_matlab, NodeTreeReference::thirdDeriv);
+      if (cse_temporary_terms)
+        temp_terms_map = cse_temp_terms_map;
+    }
 
   for (map<NodeTreeReference, temporary_terms_t>::const_iterator it = temp_terms_map.begin();
        it != temp_terms_map.end(); it++)
@@ -1182,6 +1929,93 @@ ModelTree::computeTemporaryTerms(bool is_matlab)
     temporary_terms_idxs[it] = idx++;
 }
 
+void
+ModelTree::computeTemporaryTermsCSE(bool is_matlab, map<NodeTreeReference, temporary_terms_t> &temp_terms_map) const
+{
+  map<expr_t, pair<int, NodeTreeReference>> reference_count;
+  for (auto equation : equations)
+    equation->computeReferenceCount(reference_count, NodeTreeReference::residuals);
+  for (const auto &it : first_derivatives)
+    it.second->computeReferenceCount(reference_count, NodeTreeReference::firstDeriv);
+  for (const auto &it : second_derivatives)
+    it.second->computeReferenceCount(reference_count, NodeTreeReference::secondDeriv);
+  for (const auto &it : third_derivatives)
+    it.second->computeReferenceCount(reference_count, NodeTreeReference::thirdDeriv);
+
+  vector<expr_t> nodes;
+  for (const auto &it : reference_count)
+    nodes.push_back(it.first);
+  sort(nodes.begin(), nodes.end(), ExprNodeLess());
+
+  /* External functions and PAC expectations are always temporary terms.
+     They are handled by their computeTemporaryTerms() method, tree by tree in
+     the order of the default engine, since it may promote a term to an
+     earlier tree if a term of the same external function call is already
+     there. */
+  temporary_terms_t temp_terms;
+  for (auto tr : { NodeTreeReference::residuals, NodeTreeReference::firstDeriv,
+        NodeTreeReference::secondDeriv, NodeTreeReference::thirdDeriv })
+    for (auto node : nodes)
+      if (reference_count[node].second == tr
+          && (dynamic_cast<AbstractExternalFunctionNode *>(node)
+              || dynamic_cast<PacExpectationNode *>(node)))
+        {
+          node->computeTemporaryTerms(reference_count, temp_terms_map, is_matlab, tr);
+          temp_terms.insert(node);
+        }
+
+  map<expr_t, int> definition_costs;
+  for (auto node : nodes)
+    {
+      int count;
+      NodeTreeReference tr;
+      tie(count, tr) = reference_count[node];
+      if (count < 2 || temp_terms.find(node) != temp_terms.end())
+        continue;
+
+      // Equal nodes are never temporary terms
+      auto bnode = dynamic_cast<BinaryOpNode *>(node);
+      if (bnode && bnode->get_op_code() == BinaryOpcode::equal)
+        continue;
+
+      if ((count - 1) * node->cost(temp_terms, definition_costs, is_matlab) > operator_costs.temporary_term[is_matlab])
+        {
+          temp_terms_map[tr].insert(node);
+          temp_terms.insert(node);
+        }
+    }
+}
+
+long
+ModelTree::temporaryTermsCost(const map<NodeTreeReference, temporary_terms_t> &temp_terms_map, bool is_matlab) const
+{
+  temporary_terms_t temp_terms;
+  for (const auto &it : temp_terms_map)
+    temp_terms.insert(it.second.begin(), it.second.end());
+
+  map<expr_t, int> definition_costs;
+  long total = 0;
+  // Each temporary term is computed once
+  for (auto tt : temp_terms)
+    {
+      tt->cost(temp_terms, definition_costs, is_matlab);
+      auto it = definition_costs.find(tt);
+      if (it != definition_costs.end())
+        total += it->second;
+    }
+
+  for (expr_t equation : equations)
+    total += equation->cost(temp_terms, definition_costs, is_matlab);
+  for (const auto &it : first_derivatives)
+    total += it.second->cost(temp_terms, definition_costs, is_matlab);
+  for (const auto &it : second_derivatives)
+    total += it.second->cost(temp_terms, definition_costs, is_matlab);
+  for (const auto &it : third_derivatives)
+    total += it.second->cost(temp_terms, definition_costs, is_matlab);
+
+  return total;
+}
+
 void
 ModelTree::writeModelLocalVariableTemporaryTerms(const temporary_terms_t &tto, const map<expr_t, expr_t, ExprNodeLess> &tt,
                                                  ostream &output, ExprNodeOutputType output_type,
@@ -1190,7 +2024,7 @@ ModelTree::writeModelLocalVariableTemporaryTerms(const temporary_terms_t &tto, c
   temporary_terms_t tt2;
   for (auto it : tt)
     {
-      if (isCOutput(output_type))
+      if (isCOutput(output_type) && temporary_terms_idxs.find(it.first) == temporary_terms_idxs.end())
         output << "double ";
       else if (isJuliaOutput(output_type))
         output << "    @inbounds const ";
@@ -1222,7 +2056,7 @@ ModelTree::writeTemporaryTerms(const temporary_terms_t &tt,
       if (dynamic_cast<AbstractExternalFunctionNode *>(*it) != nullptr)
         (*it)->writeExternalFunctionOutput(output, output_type, tt2, tt_idxs, tef_terms);
 
-      if (isCOutput(output_type))
+      if (isCOutput(output_type) && tt_idxs.find(*it) == tt_idxs.end())
         output << "double ";
       else if (isJuliaOutput(output_type))
         output << "    @inbounds ";
@@ -1299,11 +2133,43 @@ ModelTree::fixNestedParenthesis(ostringstream &output, map<string, string> &tmp_
   string str = output.str();
   if (!testNestedParenthesis(str))
     return;
+  int i1 = 0;
+  fixNestedParenthesis(str, tmp_paren_vars, i1, message_printed);
+  output.str(str);
+}
+
+void
+ModelTree::fixNestedParenthesis(OutputSection &output, map<string, string> &tmp_paren_vars, bool &message_printed) const
+{
+  string line;
+  bool found = false;
+  output.rewind();
+  while (!found && getline(output, line))
+    found = testNestedParenthesis(line);
+  output.clear();
+  output.seekp(0, ios::end);
+  if (!found)
+    return;
+
+  OutputSection fixed_output;
+  int i1 = 0;
+  output.rewind();
+  while (getline(output, line))
+    {
+      if (testNestedParenthesis(line))
+        fixNestedParenthesis(line, tmp_paren_vars, i1, message_printed);
+      fixed_output << line << endl;
+    }
+  output.swap(fixed_output);
+}
+
+void
+ModelTree::fixNestedParenthesis(string &str, map<string, string> &tmp_paren_vars, int &i1, bool &message_printed) const
+{
   int open = 0;
   int first_open_paren = 0;
   int matching_paren = 0;
   bool hit_limit = false;
-  int i1 = 0;
   map<string, string>::iterator it;
   for (size_t i = 0; i < str.length(); i++)
     {
@@ -1396,7 +2262,6 @@ ModelTree::fixNestedParenthesis(ostringstream &output, map<string, string> &tmp_
           first_open_paren = matching_paren = open = 0;
         }
     }
-  output.str(str);
 }
 
 bool
@@ -1543,19 +2408,17 @@ ModelTree::writeModelEquations(ostream &output, ExprNodeOutputType output_type,
                    << "rhs = ";
             rhs->writeOutput(output, output_type, temporary_terms, temporary_terms_idxs);
             output << ";" << endl
-                   << "residual" << LEFT_ARRAY_SUBSCRIPT(output_type)
-                   << eq + ARRAY_SUBSCRIPT_OFFSET(output_type)
-                   << RIGHT_ARRAY_SUBSCRIPT(output_type)
-                   << " = lhs - rhs;" << endl;
+                   << "residual";
+            residualHelper(output, eq, output_type);
+            output << " = lhs - rhs;" << endl;
           }
       else // The right hand side of the equation is empty ==> residual=lhs;
         {
           if (isJuliaOutput(output_type))
             output << "    @inbounds ";
-          output << "residual" << LEFT_ARRAY_SUBSCRIPT(output_type)
-                 << eq + ARRAY_SUBSCRIPT_OFFSET(output_type)
-                 << RIGHT_ARRAY_SUBSCRIPT(output_type)
-                 << " = ";
+          output << "residual";
+          residualHelper(output, eq, output_type);
+          output << " = ";
           lhs->writeOutput(output, output_type, temporary_terms, temporary_terms_idxs);
           output << ";" << endl;
         }
@@ -1602,6 +2465,56 @@ ModelTree::compileModelEquations(ostream &code_file, unsigned int &instruction_n
     }
 }
 
+void
+ModelTree::writeFlatBytecode(const string &basename, const string &model_name, bool dynamic, int max_lag, int max_lead) const
+{
+  FlatBytecodeHeader header;
+  header.dynamic = dynamic;
+  header.endo_nbr = symbol_table.endo_nbr();
+  header.exo_nbr = symbol_table.exo_nbr();
+  header.exo_det_nbr = symbol_table.exo_det_nbr();
+  header.param_nbr = symbol_table.param_nbr();
+  header.max_lag = max_lag;
+  header.max_lead = max_lead;
+  FlatBytecode::convert(basename + "/model/bytecode/" + model_name + ".cod",
+                        basename + "/model/bytecode/" + model_name + ".fbc", header);
+
+  // Register-based code, compiled from the expression trees: the residuals, then the Jacobian
+  FlatRegisterCode code(dynamic);
+  for (auto equation : equations)
+    {
+      uint32_t lhs = equation->get_arg1()->addToRegisterCode(code, false);
+      uint32_t rhs = equation->get_arg2()->addToRegisterCode(code, false);
+      code.addResidual(lhs, rhs);
+    }
+  code.addEndResiduals();
+  for (const auto &first_derivative : first_derivatives)
+    {
+      int deriv_id = first_derivative.first.second;
+      FlatJacobianElement element;
+      switch (getTypeByDerivID(deriv_id))
+        {
+        case SymbolType::endogenous:
+          element.type = FirstEndoDerivative;
+          break;
+        case SymbolType::exogenous:
+          element.type = FirstExoDerivative;
+          break;
+        case SymbolType::exogenousDet:
+          element.type = FirstExodetDerivative;
+          break;
+        default:
+          continue;
+        }
+      element.equation = first_derivative.first.first;
+      element.variable = symbol_table.getTypeSpecificID(getSymbIDByDerivID(deriv_id));
+      element.lag = dynamic ? getLagByDerivID(deriv_id) : 0;
+      code.addJacobian(element, first_derivative.second->addToRegisterCode(code, false));
+    }
+  if (!code.unsupported)
+    code.write(basename + "/model/bytecode/" + model_name + "_register.fbc", header);
+}
+
 void
 ModelTree::Write_Inf_To_Bin_File(const string &filename,
                                  int &u_count_int, bool &file_open, bool is_two_boundaries, int block_mfs) const
@@ -1808,6 +2721,16 @@ ModelTree::jacobianHelper(ostream &output, int eq_nb, int col_nb, ExprNodeOutput
   output << RIGHT_ARRAY_SUBSCRIPT(output_type);
 }
 
+void
+ModelTree::residualHelper(ostream &output, int eq_nb, ExprNodeOutputType output_type) const
+{
+  if (isCBatchOutput(output_type))
+    output << "[" << eq_nb << "*n+i]";
+  else
+    output << LEFT_ARRAY_SUBSCRIPT(output_type) << eq_nb + ARRAY_SUBSCRIPT_OFFSET(output_type)
+           << RIGHT_ARRAY_SUBSCRIPT(output_type);
+}
+
 void
 ModelTree::sparseHelper(int order, ostream &output, int row_nb, int col_nb, ExprNodeOutputType output_type) const
 {
@@ -1819,6 +2742,229 @@ ModelTree::sparseHelper(int order, ostream &output, int row_nb, int col_nb, Expr
   output << RIGHT_ARRAY_SUBSCRIPT(output_type);
 }
 
+void
+ModelTree::writeSparseIndexTable(ostream &output, int order, const vector<pair<int, int>> &indices, ExprNodeOutputType output_type) const
+{
+  if (indices.empty())
+    return;
+
+  if (isCOutput(output_type))
+    {
+      output << "static const double v" << order << "_idx[" << 2*indices.size() << "] = {";
+      int i = 0;
+      for (const auto &it : indices)
+        output << (i++ % 16 == 0 ? "\n  " : " ") << it.first << ",";
+      for (const auto &it : indices)
+        output << (i++ % 16 == 0 ? "\n  " : " ") << it.second << ",";
+      output << endl << "};" << endl << endl;
+    }
+  else if (isMatlabOutput(output_type))
+    {
+      output << "v" << order << "(:,1:2) = [";
+      for (const auto &it : indices)
+        output << endl << it.first << "," << it.second;
+      output << "];" << endl;
+    }
+}
+
+void
+ModelTree::writeSparseSymmetricCopies(ostream &table_output, ostream &output, int order, const vector<pair<int, int>> &copies, ExprNodeOutputType output_type) const
+{
+  if (copies.empty())
+    return;
+
+  if (isCOutput(output_type))
+    {
+      table_output << "static const int v" << order << "_sym[" << 2*copies.size() << "] = {";
+      int i = 0;
+      for (const auto &it : copies)
+        table_output << (i++ % 8 == 0 ? "\n  " : " ") << it.first << ", " << it.second << ",";
+      table_output << endl << "};" << endl << endl;
+
+      int offset = 2*NNZDerivatives[order-1];
+      output << "  for (int i = 0; i < " << copies.size() << "; i++)" << endl
+             << "    v" << order << "[v" << order << "_sym[2*i]+" << offset << "] = v"
+             << order << "[v" << order << "_sym[2*i+1]+" << offset << "];" << endl;
+    }
+  else if (isMatlabOutput(output_type))
+    {
+      int i = 0;
+      output << "v" << order << "([";
+      for (const auto &it : copies)
+        output << (i++ % 20 == 0 ? "\n" : " ") << it.first + 1 << ";";
+      output << "],3) = v" << order << "([";
+      i = 0;
+      for (const auto &it : copies)
+        output << (i++ % 20 == 0 ? "\n" : " ") << it.second + 1 << ";";
+      output << "],3);" << endl;
+    }
+}
+
+void
+ModelTree::writeCSplitSection(const string &basename, const string &header, const string &name,
+                              const string &params, const string &args, bool residuals,
+                              OutputSection &code, int statements_per_file,
+                              ostream &prototypes, ostream &calls, const string &indent,
+                              vector<string> &sources) const
+{
+  if (code.empty())
+    return;
+
+  ofstream output;
+  int nfiles = 0, nstatements = 0;
+  bool can_split = true;
+  string line;
+  code.rewind();
+  while (getline(code, line))
+    {
+      if (output.is_open() && can_split && nstatements >= statements_per_file)
+        {
+          output << "}" << endl;
+          output.close();
+        }
+
+      if (!output.is_open())
+        {
+          string fname = name + "_" + to_string(nfiles++);
+          string filename = basename + "/model/src/" + fname + ".c";
+          output.open(filename, ios::out | ios::binary);
+          if (!output.is_open())
+            {
+              cerr << "Error: Can't open file " << filename << " for writing" << endl;
+              exit(EXIT_FAILURE);
+            }
+          output << "/*" << endl
+                 << " * " << filename << " : Part of the model computed by "
+                 << header.substr(0, header.size() - 2) << ".c" << endl
+                 << " *" << endl
+                 << " * Warning : this file is generated automatically by Dynare" << endl
+                 << " *           from model file (.mod)" << endl
+                 << " */" << endl << endl
+                 << "#include \"" << header << "\"" << endl << endl
+                 << "void " << fname << "(" << params << ")" << endl
+                 << "{" << endl;
+          if (residuals)
+            output << "  double lhs, rhs;" << endl << endl;
+
+          prototypes << "void " << fname << "(" << params << ");" << endl;
+          calls << indent << fname << "(" << args << ");" << endl;
+          sources.push_back(fname + ".c");
+          nstatements = 0;
+        }
+
+      output << line << endl;
+      nstatements++;
+      can_split = line.compare(0, 5, "lhs =") != 0 && line.compare(0, 5, "rhs =") != 0;
+    }
+  output << "}" << endl;
+  output.close();
+  code.clear();
+  code.seekp(0, ios::end);
+}
+
+void
+ModelTree::writeCSplitMakefile(const string &basename, const string &name, const string &header,
+                               const vector<string> &sources) const
+{
+  string filename = basename + "/model/src/" + name + ".mk";
+  ofstream output;
+  output.open(filename, ios::out | ios::binary);
+  if (!output.is_open())
+    {
+      cerr << "Error: Can't open file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  output << "# " << filename << " : Compiles the " << name << " model MEX file from its" << endl
+         << "# translation units. Run from " << basename << "/model/src with:" << endl
+         << "#   make -j -f " << name << ".mk MEXEXT=<extension of the MEX files>" << endl
+         << "#" << endl
+         << "# Warning : this file is generated automatically by Dynare" << endl
+         << "#           from model file (.mod)" << endl << endl
+         << "MEX ?= mex" << endl
+         << "MEXFLAGS ?=" << endl
+         << "MEXOUT ?= -output" << endl
+         << "MEXEXT ?= mexa64" << endl << endl
+         << "OBJS =";
+  for (const auto &source : sources)
+    output << " \\" << endl << "\t" << source.substr(0, source.size() - 2) << ".o";
+  output << endl << endl
+         << "../../../+" << basename << "/" << name << ".$(MEXEXT): $(OBJS)" << endl
+         << "\t$(MEX) $(MEXFLAGS) $(MEXOUT) $@ $(OBJS)" << endl << endl
+         << "%.o: %.c " << header << endl
+         << "\t$(MEX) $(MEXFLAGS) -c $<" << endl;
+  output.close();
+}
+
+void
+ModelTree::writeCLibraryDeclarations(ostream &output, const string &prefix, const string &model_name,
+                                     const string &params, const string &signature) const
+{
+  string name = prefix + model_name;
+  output << "/* Functions and metadata of the " << model_name << " model */" << endl
+         << "extern const int " << name << "_equation_nbr;" << endl
+         << "extern const int " << name << "_ntt;" << endl
+         << "extern const int " << name << "_g1_ncols;" << endl
+         << "extern const int " << name << "_nnz[3];" << endl
+         << "extern const int " << name << "_g1_idx[];" << endl
+         << signature << ";" << endl
+         << "void " << name << "_resid_tt(" << params << ");" << endl
+         << "void " << name << "_resid(" << params << ", double *residual);" << endl
+         << "void " << name << "_g1_tt(" << params << ");" << endl
+         << "void " << name << "_g1(" << params << ", double *g1);" << endl;
+  if (second_derivatives.size())
+    output << "void " << name << "_g2_tt(" << params << ");" << endl
+           << "void " << name << "_g2(" << params << ", double *v2);" << endl;
+  if (third_derivatives.size())
+    output << "void " << name << "_g3_tt(" << params << ");" << endl
+           << "void " << name << "_g3(" << params << ", double *v3);" << endl;
+  output << endl;
+}
+
+void
+ModelTree::writeCLibraryRenames(ostream &output, const string &prefix, const string &model_name,
+                                const vector<string> &other_symbols) const
+{
+  vector<string> symbols = { "equation_nbr", "ntt", "g1_ncols", "nnz", "g1_idx",
+                             "resid_tt", "resid", "g1_tt", "g1" };
+  if (second_derivatives.size())
+    symbols.insert(symbols.end(), { "g2_tt", "g2" });
+  if (third_derivatives.size())
+    symbols.insert(symbols.end(), { "g3_tt", "g3" });
+  for (const auto &symbol : symbols)
+    output << "#define " << model_name << "_" << symbol << " " << prefix << model_name << "_" << symbol << endl;
+  for (const auto &symbol : other_symbols)
+    output << "#define " << symbol << " " << prefix << symbol << endl;
+  // Both models are linked into the same library, so their helper functions need distinct names
+  for (const string symbol : { "getPowerDeriv", "normcdf" })
+    output << "#define " << symbol << " " << prefix << model_name << "_" << symbol << endl;
+}
+
+void
+ModelTree::writeCLibraryMetadata(ostream &output, const string &model_name, int g1_ncols,
+                                 const vector<pair<int, int>> &g1_indices) const
+{
+  int ntt = temporary_terms_mlv.size() + temporary_terms_res.size() + temporary_terms_g1.size()
+    + temporary_terms_g2.size() + temporary_terms_g3.size();
+  output << "const int " << model_name << "_equation_nbr = " << equations.size() << ";" << endl
+         << "const int " << model_name << "_ntt = " << ntt << ";" << endl
+         << "const int " << model_name << "_g1_ncols = " << g1_ncols << ";" << endl
+         << "const int " << model_name << "_nnz[3] = { " << g1_indices.size() << ", "
+         << (second_derivatives.size() ? NNZDerivatives[1] : 0) << ", "
+         << (third_derivatives.size() ? NNZDerivatives[2] : 0) << " };" << endl;
+
+  // Rows, then columns, as in the sparse index tables of v2 and v3
+  output << "const int " << model_name << "_g1_idx[" << max<size_t>(2*g1_indices.size(), 1) << "] = {";
+  int i = 0;
+  for (const auto &it : g1_indices)
+    output << (i++ % 16 == 0 ? "\n  " : " ") << it.first << ",";
+  for (const auto &it : g1_indices)
+    output << (i++ % 16 == 0 ? "\n  " : " ") << it.second << ",";
+  if (g1_indices.empty())
+    output << " 0";
+  output << endl << "};" << endl << endl;
+}
+
 void
 ModelTree::computeParamsDerivatives(int paramsDerivsOrder)
 {
@@ -1827,65 +2973,77 @@ ModelTree::computeParamsDerivatives(int paramsDerivsOrder)
   set<int> deriv_id_set;
   addAllParamDerivId(deriv_id_set);
 
-  for (int param : deriv_id_set)
+  /* The loops are organized so that the derivatives are computed in
+     increasing key order, as required by SparseDerivatives */
+  for (int eq = 0; eq < (int) equations.size(); eq++)
+    for (int param : deriv_id_set)
+      {
+        expr_t d1 = equations[eq]->getDerivative(param);
+        if (d1 == Zero)
+          continue;
+        residuals_params_derivatives.append({ eq, param }, d1);
+      }
+
+  for (const auto &it : first_derivatives)
     {
-      for (int eq = 0; eq < (int) equations.size(); eq++)
+      int eq, var;
+      tie(eq, var) = it.first;
+      expr_t d1 = it.second;
+
+      for (int param : deriv_id_set)
         {
-          expr_t d1 = equations[eq]->getDerivative(param);
-          if (d1 == Zero)
+          expr_t d2 = d1->getDerivative(param);
+          if (d2 == Zero)
             continue;
-          residuals_params_derivatives[{ eq, param }] = d1;
+          jacobian_params_derivatives.append({ eq, var, param }, d2);
         }
+    }
 
-      if (paramsDerivsOrder == 2)
-        for (const auto &it : residuals_params_derivatives)
-          {
-            int eq, param1;
-            tie(eq, param1) = it.first;
-            expr_t d1 = it.second;
-
-            expr_t d2 = d1->getDerivative(param);
-            if (d2 == Zero)
-              continue;
-            residuals_params_second_derivatives[{ eq, param1, param }] = d2;
-          }
-
-      for (const auto &it : first_derivatives)
+  if (paramsDerivsOrder == 2)
+    {
+      // Store only second derivatives w.r. to parameters with param2 >= param1
+      for (const auto &it : residuals_params_derivatives)
         {
-          int eq, var;
-          tie(eq, var) = it.first;
+          int eq, param1;
+          tie(eq, param1) = it.first;
           expr_t d1 = it.second;
 
-          expr_t d2 = d1->getDerivative(param);
-          if (d2 == Zero)
-            continue;
-          jacobian_params_derivatives[{ eq, var, param }] = d2;
+          for (auto param2 = deriv_id_set.find(param1); param2 != deriv_id_set.end(); ++param2)
+            {
+              expr_t d2 = d1->getDerivative(*param2);
+              if (d2 == Zero)
+                continue;
+              residuals_params_second_derivatives.append({ eq, param1, *param2 }, d2);
+            }
         }
 
-      if (paramsDerivsOrder == 2)
+      for (const auto &it : jacobian_params_derivatives)
         {
-          for (const auto &it : jacobian_params_derivatives)
-            {
-              int eq, var, param1;
-              tie(eq, var, param1) = it.first;
-              expr_t d1 = it.second;
+          int eq, var, param1;
+          tie(eq, var, param1) = it.first;
+          expr_t d1 = it.second;
 
-              expr_t d2 = d1->getDerivative(param);
+          for (auto param2 = deriv_id_set.find(param1); param2 != deriv_id_set.end(); ++param2)
+            {
+              expr_t d2 = d1->getDerivative(*param2);
               if (d2 == Zero)
                 continue;
-              jacobian_params_second_derivatives[{ eq, var, param1, param }] = d2;
+              jacobian_params_second_derivatives.append({ eq, var, param1, *param2 }, d2);
             }
+        }
 
-          for (const auto &it : second_derivatives)
-            {
-              int eq, var1, var2;
-              tie(eq, var1, var2) = it.first;
-              expr_t d1 = it.second;
+      for (const auto &it : second_derivatives)
+        {
+          int eq, var1, var2;
+          tie(eq, var1, var2) = it.first;
+          expr_t d1 = it.second;
 
+          for (int param : deriv_id_set)
+            {
               expr_t d2 = d1->getDerivative(param);
               if (d2 == Zero)
                 continue;
-              hessian_params_derivatives[{ eq, var1, var2, param }] = d2;
+              hessian_params_derivatives.append({ eq, var1, var2, param }, d2);
             }
         }
     }
@@ -1903,12 +3061,12 @@ ModelTree::computeParamsDerivativesTemporaryTerms()
   temp_terms_map[NodeTreeReference::jacobianParamsSecondDeriv] = params_derivs_temporary_terms_g12;
   temp_terms_map[NodeTreeReference::hessianParamsDeriv] = params_derivs_temporary_terms_g2;
 
-  for (auto & residuals_params_derivative : residuals_params_derivatives)
+  for (const auto &residuals_params_derivative : residuals_params_derivatives)
     residuals_params_derivative.second->computeTemporaryTerms(reference_count,
                                       temp_terms_map,
                                       true, NodeTreeReference::residualsParamsDeriv);
 
-  for (auto & jacobian_params_derivative : jacobian_params_derivatives)
+  for (const auto &jacobian_params_derivative : jacobian_params_derivatives)
     jacobian_params_derivative.second->computeTemporaryTerms(reference_count,
                                       temp_terms_map,
                                       true, NodeTreeReference::jacobianParamsDeriv);
@@ -1958,6 +3116,199 @@ ModelTree::computeParamsDerivativesTemporaryTerms()
     params_derivs_temporary_terms_idxs[tt] = idx++;
 }
 
+void
+ModelTree::computeParamsAdjointSweep(const vector<expr_t> &roots, adjoint_sweep_t &sweep)
+{
+  // Whether the value of a node depends on parameters
+  auto dependsOnParams = [this](expr_t node)
+    {
+      node->prepareForDerivation();
+      for (int deriv_id : node->non_null_derivatives)
+        try
+          {
+            if (getTypeByDerivID(deriv_id) == SymbolType::parameter)
+              return true;
+          }
+        catch (UnknownDerivIDException &e)
+          {
+          }
+      return false;
+    };
+
+  /* Depth-first traversal of the nodes depending on parameters: a node is
+     appended once all its arguments have been, so that the reverse order is
+     a topological order suitable for propagating adjoints */
+  set<expr_t> visited;
+  sweep.clear();
+  function<void(expr_t)> visit = [&](expr_t node)
+    {
+      visited.insert(node);
+
+      auto unode = dynamic_cast<UnaryOpNode *>(node);
+      if (unode && unode->get_op_code() == UnaryOpcode::steadyState && isDynamic()
+          && !dynamic_cast<VariableNode *>(unode->get_arg()))
+        {
+          cerr << "ERROR: STEADY_STATE() should only be used on standalone variables (like STEADY_STATE(y)) "
+               << "to be derivable w.r.t. parameters" << endl;
+          exit(EXIT_FAILURE);
+        }
+
+      vector<pair<expr_t, expr_t>> partials;
+      for (const auto &it : node->getArgumentsPartialDerivatives())
+        if (it.second != Zero && dependsOnParams(it.first))
+          {
+            if (visited.find(it.first) == visited.end())
+              visit(it.first);
+            partials.push_back(it);
+          }
+      sweep.emplace_back(node, partials);
+    };
+
+  for (auto root : roots)
+    if (visited.find(root) == visited.end() && dependsOnParams(root))
+      visit(root);
+
+  reverse(sweep.begin(), sweep.end());
+}
+
+void
+ModelTree::computeParamsAdjoint(bool no_tmp_terms)
+{
+  computeParamsAdjointSweep(vector<expr_t>(equations.begin(), equations.end()), residuals_params_adjoint);
+
+  vector<expr_t> jacobian;
+  for (const auto &first_derivative : first_derivatives)
+    jacobian.push_back(first_derivative.second);
+  computeParamsAdjointSweep(jacobian, jacobian_params_adjoint);
+
+  params_adjoint_temporary_terms_res.clear();
+  params_adjoint_temporary_terms_g1.clear();
+  params_adjoint_temporary_terms_idxs.clear();
+  if (no_tmp_terms)
+    return;
+
+  // The partial derivatives are the only expressions written in the sweeps
+  map<expr_t, pair<int, NodeTreeReference>> reference_count;
+  map<NodeTreeReference, temporary_terms_t> temp_terms_map;
+  for (const auto &it : residuals_params_adjoint)
+    for (const auto &partial : it.second)
+      partial.second->computeTemporaryTerms(reference_count, temp_terms_map,
+                                            true, NodeTreeReference::residuals);
+  for (const auto &it : jacobian_params_adjoint)
+    for (const auto &partial : it.second)
+      partial.second->computeTemporaryTerms(reference_count, temp_terms_map,
+                                            true, NodeTreeReference::firstDeriv);
+
+  params_adjoint_temporary_terms_res = temp_terms_map[NodeTreeReference::residuals];
+  params_adjoint_temporary_terms_g1 = temp_terms_map[NodeTreeReference::firstDeriv];
+
+  int idx = 0;
+  for (auto tt : params_adjoint_temporary_terms_res)
+    params_adjoint_temporary_terms_idxs[tt] = idx++;
+  for (auto tt : params_adjoint_temporary_terms_g1)
+    params_adjoint_temporary_terms_idxs[tt] = idx++;
+}
+
+void
+ModelTree::writeParamsAdjointSweep(ostream &output, ExprNodeOutputType output_type, const adjoint_sweep_t &sweep,
+                                   const vector<pair<expr_t, string>> &seeds, const string &result,
+                                   const temporary_terms_t &tt, deriv_node_temp_terms_t &tef_terms) const
+{
+  map<expr_t, int> adjoint_idx;
+  for (int i = 0; i < (int) sweep.size(); i++)
+    adjoint_idx[sweep[i].first] = i + 1;
+
+  output << result << " = zeros(1, " << symbol_table.param_nbr() << ");" << endl
+         << "A = zeros(" << sweep.size() << ", 1);" << endl;
+
+  for (const auto &seed : seeds)
+    {
+      auto it = adjoint_idx.find(seed.first);
+      if (it != adjoint_idx.end())
+        output << "A(" << it->second << ") = A(" << it->second << ") + " << seed.second << ";" << endl;
+    }
+
+  for (const auto &it : sweep)
+    {
+      int i = adjoint_idx.at(it.first);
+
+      // When its turn comes, the adjoint of a node has received all its contributions
+      auto vnode = dynamic_cast<VariableNode *>(it.first);
+      if (vnode && vnode->get_type() == SymbolType::parameter)
+        {
+          int param_col = symbol_table.getTypeSpecificID(vnode->get_symb_id()) + 1;
+          output << result << "(" << param_col << ") = " << result << "(" << param_col << ") + A(" << i << ");" << endl;
+        }
+
+      auto unode = dynamic_cast<UnaryOpNode *>(it.first);
+      if (unode && unode->get_op_code() == UnaryOpcode::steadyState && isDynamic())
+        {
+          auto varg = dynamic_cast<VariableNode *>(unode->get_arg());
+          if (varg->get_type() == SymbolType::endogenous)
+            output << result << " = " << result << " + A(" << i << ")*ss_param_deriv("
+                   << symbol_table.getTypeSpecificID(varg->get_symb_id()) + 1 << ",:);" << endl;
+        }
+
+      for (const auto &partial : it.second)
+        {
+          int j = adjoint_idx.at(partial.first);
+          output << "A(" << j << ") = A(" << j << ")";
+          if (partial.second == One)
+            output << " + A(" << i << ")";
+          else if (partial.second == MinusOne)
+            output << " - A(" << i << ")";
+          else
+            {
+              // Parenthesize if the precedence is lower than that of the multiplication
+              bool paren = partial.second->precedence(output_type, tt) < 4;
+              output << " + A(" << i << ")*" << (paren ? "(" : "");
+              partial.second->writeOutput(output, output_type, tt, params_adjoint_temporary_terms_idxs, tef_terms);
+              output << (paren ? ")" : "");
+            }
+          output << ";" << endl;
+        }
+    }
+}
+
+void
+ModelTree::writeParamsAdjoint(ostream &output, ExprNodeOutputType output_type,
+                              const vector<pair<expr_t, string>> &residuals_seeds,
+                              const vector<pair<expr_t, string>> &jacobian_seeds) const
+{
+  deriv_node_temp_terms_t tef_terms;
+  temporary_terms_t no_temporary_terms;
+  temporary_terms_idxs_t no_temporary_terms_idxs;
+
+  output << "T = NaN(" << params_adjoint_temporary_terms_idxs.size() << ",1);" << endl;
+
+  // Model local variables, which may appear in the partial derivatives
+  set<int> used_local_vars;
+  for (auto equation : equations)
+    equation->collectVariables(SymbolType::modelLocalVariable, used_local_vars);
+  for (int used_local_var : used_local_vars)
+    {
+      output << symbol_table.getName(used_local_var) << "__ = ";
+      local_variables_table.at(used_local_var)->writeOutput(output, output_type, no_temporary_terms,
+                                                            no_temporary_terms_idxs, tef_terms);
+      output << ";" << endl;
+    }
+
+  writeTemporaryTerms(params_adjoint_temporary_terms_res, {}, params_adjoint_temporary_terms_idxs,
+                      output, output_type, tef_terms);
+  writeParamsAdjointSweep(output, output_type, residuals_params_adjoint, residuals_seeds, "rp_bar",
+                          params_adjoint_temporary_terms_res, tef_terms);
+
+  temporary_terms_t tt_all = params_adjoint_temporary_terms_res;
+  tt_all.insert(params_adjoint_temporary_terms_g1.begin(), params_adjoint_temporary_terms_g1.end());
+
+  output << "if nargout >= 2" << endl;
+  writeTemporaryTerms(params_adjoint_temporary_terms_g1, params_adjoint_temporary_terms_res,
+                      params_adjoint_temporary_terms_idxs, output, output_type, tef_terms);
+  writeParamsAdjointSweep(output, output_type, jacobian_params_adjoint, jacobian_seeds, "gp_bar",
+                          tt_all, tef_terms);
+  output << "end" << endl;
+}
+
 bool
 ModelTree::isNonstationary(int symb_id) const
 {
@@ -26,10 +26,20 @@ using namespace std;
 #include <vector>
 #include <deque>
 #include <map>
+#include <array>
+#include <tuple>
+#include <utility>
+#include <iterator>
+#include <cassert>
 #include <ostream>
+#include <functional>
 
 #include "DataTree.hh"
 #include "ExtendedPreprocessorTypes.hh"
+#include "OutputSection.hh"
+#include "BipartiteMatching.hh"
+#include "IncidenceMatrix.hh"
+#include "WarningConsolidation.hh"
 
 //! Vector describing equations: BlockSimulationType, if BlockSimulationType == EVALUATE_s then a expr_t on the new normalized equation
 using equation_type_and_normalized_equation_t = vector<pair<EquationType, expr_t >>;
@@ -46,6 +56,121 @@ using block_derivatives_equation_variable_laglead_nodeid_t = vector< pair<pair<i
 //! for all blocks derivatives description
 using blocks_derivatives_t = vector<block_derivatives_equation_variable_laglead_nodeid_t>;
 
+//! Sparse storage of non-null derivatives, in compressed row format
+/*! Key is a pair or a tuple of integers, whose first element is the equation
+  number (the row), and the other elements are the indices w.r. to which the
+  derivative is computed (the columns). Entries of a given equation are
+  contiguous, and the equation number is only stored once per row.
+
+  Entries must be appended in strictly increasing key order, which is the
+  order in which derivatives are computed. Iteration then yields the same
+  sequence of (key, derivative) pairs as a map<Key, expr_t> would (the pairs
+  are built on the fly, hence iterators return them by value). */
+template<typename Key>
+class SparseDerivatives
+{
+public:
+  using value_type = pair<Key, expr_t>;
+  static const size_t ncols = tuple_size<Key>::value - 1;
+  using cols_t = array<int, ncols>;
+private:
+  //! Position in cols/values of the first entry of each equation (with an extra element pointing past the last entry)
+  vector<size_t> row_begin{0};
+  vector<cols_t> cols;
+  vector<expr_t> values;
+
+  template<size_t... I>
+  static Key
+  makeKey(int eq, const cols_t &c, index_sequence<I...>)
+  {
+    return Key{eq, c[I]...};
+  }
+  template<size_t... I>
+  static cols_t
+  makeCols(const Key &key, index_sequence<I...>)
+  {
+    return { get<I+1>(key)... };
+  }
+public:
+  class const_iterator
+  {
+  private:
+    const SparseDerivatives *sd;
+    size_t pos;
+    int eq;
+    void
+    skipEmptyRows()
+    {
+      while (eq + 1 < (int) sd->row_begin.size() - 1 && sd->row_begin[eq+1] <= pos)
+        eq++;
+    }
+  public:
+    using iterator_category = forward_iterator_tag;
+    using value_type = SparseDerivatives::value_type;
+    using difference_type = ptrdiff_t;
+    using pointer = const value_type *;
+    using reference = value_type;
+    //! Returned by operator->(), since the pairs are not stored as such
+    struct arrow_proxy
+    {
+      value_type v;
+      const value_type *operator->() const { return &v; };
+    };
+    const_iterator(const SparseDerivatives *sd_arg, size_t pos_arg) : sd{sd_arg}, pos{pos_arg}, eq{0}
+    {
+      skipEmptyRows();
+    };
+    value_type
+    operator*() const
+    {
+      return { makeKey(eq, sd->cols[pos], make_index_sequence<ncols>()), sd->values[pos] };
+    };
+    arrow_proxy operator->() const { return { **this }; };
+    const_iterator &
+    operator++()
+    {
+      pos++;
+      skipEmptyRows();
+      return *this;
+    };
+    const_iterator
+    operator++(int)
+    {
+      const_iterator tmp = *this;
+      ++*this;
+      return tmp;
+    };
+    bool operator==(const const_iterator &other) const { return pos == other.pos; };
+    bool operator!=(const const_iterator &other) const { return pos != other.pos; };
+  };
+
+  const_iterator begin() const { return { this, 0 }; };
+  const_iterator end() const { return { this, values.size() }; };
+  size_t size() const { return values.size(); };
+  bool empty() const { return values.empty(); };
+  void
+  clear()
+  {
+    row_begin.assign(1, 0);
+    cols.clear();
+    values.clear();
+  };
+  //! Appends a derivative, whose key must be greater than those already stored
+  void
+  append(const Key &key, expr_t d)
+  {
+    int eq = get<0>(key);
+    cols_t c = makeCols(key, make_index_sequence<ncols>());
+    assert(eq + 1 >= (int) row_begin.size() - 1);
+    while ((int) row_begin.size() - 1 <= eq)
+      row_begin.push_back(row_begin.back());
+    assert(row_begin[eq] == cols.size() || cols.back() < c);
+    cols.push_back(c);
+    values.push_back(d);
+    row_begin.back()++;
+  };
+};
+
 //! Shared code for static and dynamic models
 class ModelTree : public DataTree
 {
@@ -76,6 +201,9 @@ protected:
   //! Number of non-zero derivatives
   int NNZDerivatives[3];
 
+  //! Equations for which derivatives of order 2 and 3 are computed (if empty, all equations)
+  set<int> higher_order_eqs;
+
   using first_derivatives_t = map<pair<int, int>, expr_t>;
   //! First order derivatives
   /*! First index is equation number, second is variable w.r. to which is computed the derivative.
@@ -84,19 +212,19 @@ protected:
   */
   first_derivatives_t first_derivatives;
 
-  using second_derivatives_t = map<tuple<int, int, int>, expr_t>;
+  using second_derivatives_t = SparseDerivatives<tuple<int, int, int>>;
   //! Second order derivatives
   /*! First index is equation number, second and third are variables w.r. to which is computed the derivative.
-    Only non-null derivatives are stored in the map.
+    Only non-null derivatives are stored.
     Contains only second order derivatives where var1 >= var2 (for obvious symmetry reasons).
     Variable indices are those of the getDerivID() method.
   */
   second_derivatives_t second_derivatives;
 
-  using third_derivatives_t = map<tuple<int, int, int, int>, expr_t>;
+  using third_derivatives_t = SparseDerivatives<tuple<int, int, int, int>>;
   //! Third order derivatives
   /*! First index is equation number, second, third and fourth are variables w.r. to which is computed the derivative.
-    Only non-null derivatives are stored in the map.
+    Only non-null derivatives are stored.
     Contains only third order derivatives where var1 >= var2 >= var3 (for obvious symmetry reasons).
     Variable indices are those of the getDerivID() method.
   */
@@ -104,35 +232,35 @@ protected:
 
   //! Derivatives of the residuals w.r. to parameters
   /*! First index is equation number, second is parameter.
-    Only non-null derivatives are stored in the map.
+    Only non-null derivatives are stored.
     Parameter indices are those of the getDerivID() method.
   */
-  first_derivatives_t residuals_params_derivatives;
+  SparseDerivatives<pair<int, int>> residuals_params_derivatives;
 
   //! Second derivatives of the residuals w.r. to parameters
   /*! First index is equation number, second and third indeces are parameters.
-    Only non-null derivatives are stored in the map.
+    Only non-null derivatives are stored.
     Parameter indices are those of the getDerivID() method.
   */
   second_derivatives_t residuals_params_second_derivatives;
 
   //! Derivatives of the jacobian w.r. to parameters
   /*! First index is equation number, second is endo/exo/exo_det variable, and third is parameter.
-    Only non-null derivatives are stored in the map.
+    Only non-null derivatives are stored.
     Variable and parameter indices are those of the getDerivID() method.
   */
   second_derivatives_t jacobian_params_derivatives;
 
   //! Second derivatives of the jacobian w.r. to parameters
   /*! First index is equation number, second is endo/exo/exo_det variable, and third and fourth are parameters.
-    Only non-null derivatives are stored in the map.
+    Only non-null derivatives are stored.
     Variable and parameter indices are those of the getDerivID() method.
   */
   third_derivatives_t jacobian_params_second_derivatives;
 
   //! Derivatives of the hessian w.r. to parameters
   /*! First index is equation number, first and second are endo/exo/exo_det variable, and third is parameter.
-    Only non-null derivatives are stored in the map.
+    Only non-null derivatives are stored.
     Variable and parameter indices are those of the getDerivID() method.
   */
   third_derivatives_t hessian_params_derivatives;
@@ -157,6 +285,21 @@ protected:
 
   temporary_terms_idxs_t params_derivs_temporary_terms_idxs;
 
+  //! Reverse-mode (adjoint) sweep through the nodes depending on parameters
+  /*! Nodes are in reverse topological order (every node comes before its
+    arguments), and each of them is stored together with the partial
+    derivatives w.r. to those of its arguments that depend on parameters */
+  using adjoint_sweep_t = vector<pair<expr_t, vector<pair<expr_t, expr_t>>>>;
+
+  //! Reverse-mode sweeps for the derivatives of the residuals and of the Jacobian w.r. to parameters
+  adjoint_sweep_t residuals_params_adjoint, jacobian_params_adjoint;
+
+  //! Temporary terms for the file containing the reverse-mode parameters derivatives
+  temporary_terms_t params_adjoint_temporary_terms_res;
+  temporary_terms_t params_adjoint_temporary_terms_g1;
+
+  temporary_terms_idxs_t params_adjoint_temporary_terms_idxs;
+
   //! Trend variables and their growth factors
   map<int, expr_t> trend_symbols_map;
 
@@ -181,14 +324,76 @@ protected:
   //! Computes 3rd derivatives
   /*! \param vars the derivation IDs w.r. to which derive the 2nd derivatives */
   void computeThirdDerivatives(const set<int> &vars);
+  //! Expressions to be derived (or derivatives), indexed by equation number followed by derivation IDs
+  using indexed_exprs_t = vector<pair<vector<int>, expr_t>>;
+  //! Computes the derivatives of some expressions using nthreads worker threads
+  /*! The expressions are split into contiguous units, whose number does not
+    depend on nthreads. Each unit is copied into a private DataTree and
+    derived there, so that no data is shared between threads. The
+    derivatives are then copied back into the present tree, in the order of
+    their indices, so that the result does not depend on nthreads or on
+    thread scheduling. The units are processed in waves of nthreads units,
+    each wave being freed once copied back (one unit at a time with
+    nthreads=1).
+    \param exprs the expressions to derive, sorted by index
+    \param vars the derivation IDs w.r. to which derive the expressions
+    \param symmetric if true, only derive w.r. to derivation IDs lower or equal to the last one in the index
+    \param[out] derivs the non-null derivatives, sorted by index (the derivation ID being appended to the index) */
+  void computeDerivativesParallel(const indexed_exprs_t &exprs, const set<int> &vars, bool symmetric, indexed_exprs_t &derivs);
+  //! Calls f(block, thread) for each block (or other independent unit of work), using nthreads worker threads
+  /*! The workers take the blocks in turn, so the order in which the blocks
+    are processed is not specified: f must only modify data specific to its
+    block, or to the worker thread (numbered from 0 to nthreads-1). With
+    nthreads=1, the blocks are processed in order by the calling thread. */
+  void forEachBlock(unsigned int nb_blocks, const function<void(unsigned int, int)> &f) const;
+  //! Computes chain rule derivatives of the blocks using nthreads worker threads
+  /*! As in computeDerivativesParallel(), contiguous units of blocks are
+    derived in private DataTrees, and the derivatives are copied back into
+    the present tree in the order of the blocks.
+    \param recursive_variables the recursive variables of each block, indexed by derivation ID
+    \param[in,out] derivs for each block, the expressions to derive and the derivation IDs w.r. to which derive them; the expressions are replaced by their derivatives */
+  void computeChainRuleDerivativesParallel(const vector<map<int, expr_t>> &recursive_variables, vector<vector<pair<expr_t, int>>> &derivs);
   //! Computes derivatives of the Jacobian and Hessian w.r. to parameters
   void computeParamsDerivatives(int paramsDerivsOrder);
   //! Write derivative of an equation w.r. to a variable
   void writeDerivative(ostream &output, int eq, int symb_id, int lag, ExprNodeOutputType output_type, const temporary_terms_t &temporary_terms) const;
   //! Computes temporary terms (for all equations and derivatives)
   void computeTemporaryTerms(bool is_matlab);
+  //! Selects temporary terms for all equations and derivatives, using the "cse" engine
+  /*! Contrary to the default engine, which decides on the fly while
+    traversing the trees, reference counts are first computed over the
+    residuals and the derivatives of order 1 to 3 together. Nodes are then
+    examined by increasing index (i.e. children before their parents), and a
+    node referenced n≥2 times becomes a temporary term if computing it n-1
+    extra times costs more than storing it (see OperatorCosts::temporary_term).
+    Model local variables are not handled here. */
+  void computeTemporaryTermsCSE(bool is_matlab, map<NodeTreeReference, temporary_terms_t> &temp_terms_map) const;
+  //! Returns the cost of computing the residuals and the derivatives of order 1 to 3, given a set of temporary terms
+  long temporaryTermsCost(const map<NodeTreeReference, temporary_terms_t> &temp_terms_map, bool is_matlab) const;
   //! Computes temporary terms for the file containing parameters derivatives
   void computeParamsDerivativesTemporaryTerms();
+  //! Computes the reverse-mode sweep for the derivatives w.r. to parameters of some expressions
+  void computeParamsAdjointSweep(const vector<expr_t> &roots, adjoint_sweep_t &sweep);
+  //! Computes the reverse-mode sweeps (and their temporary terms) for the derivatives of the residuals and of the Jacobian w.r. to parameters
+  /*! Contrary to computeParamsDerivatives(), the cost of the generated
+    code does not grow with the number of parameters: it computes the
+    derivatives of a weighted sum of the residuals (or of the Jacobian) w.r.
+    to all parameters at once, in a small multiple of the cost of evaluating
+    the residuals (or the Jacobian) */
+  void computeParamsAdjoint(bool no_tmp_terms);
+  //! Writes the body of the MATLAB function computing the reverse-mode parameters derivatives
+  /*! The function computes rp_bar = r_bar'*rp and, if nargout >= 2, gp_bar
+    = sum of g1_bar.*gp, where rp and gp are the derivatives of the residuals
+    and of the Jacobian w.r. to parameters (as in the params_derivs file).
+    \param residuals_seeds expressions of the adjoints of the equations
+    \param jacobian_seeds expressions of the adjoints of the first derivatives */
+  void writeParamsAdjoint(ostream &output, ExprNodeOutputType output_type,
+                          const vector<pair<expr_t, string>> &residuals_seeds,
+                          const vector<pair<expr_t, string>> &jacobian_seeds) const;
+  //! Writes a reverse-mode sweep, accumulating the derivatives w.r. to parameters in the row vector result
+  void writeParamsAdjointSweep(ostream &output, ExprNodeOutputType output_type, const adjoint_sweep_t &sweep,
+                               const vector<pair<expr_t, string>> &seeds, const string &result,
+                               const temporary_terms_t &tt, deriv_node_temp_terms_t &tef_terms) const;
   //! Writes temporary terms
   void writeTemporaryTerms(const temporary_terms_t &tt, const temporary_terms_t &ttm1, const temporary_terms_idxs_t &tt_idxs, ostream &output, ExprNodeOutputType output_type, deriv_node_temp_terms_t &tef_terms) const;
   void writeJsonTemporaryTerms(const temporary_terms_t &tt, const temporary_terms_t &ttm1, ostream &output, deriv_node_temp_terms_t &tef_terms, string &concat) const;
@@ -196,8 +401,16 @@ protected:
   void compileTemporaryTerms(ostream &code_file, unsigned int &instruction_number, const temporary_terms_t &tt, map_idx_t map_idx, bool dynamic, bool steady_dynamic) const;
   //! Adds informations for simulation in a binary file
   void Write_Inf_To_Bin_File(const string &filename, int &u_count_int, bool &file_open, bool is_two_boundaries, int block_mfs) const;
+  //! Writes the flat bytecode version (<model_name>.fbc) of the bytecode file <model_name>.cod, and the register-based flat bytecode (<model_name>_register.fbc) of the residuals and Jacobian
+  /*! Nothing is written if the model calls external functions. See FlatBytecode.hh for the format */
+  void writeFlatBytecode(const string &basename, const string &model_name, bool dynamic, int max_lag, int max_lead) const;
   //! Fixes output when there are more than 32 nested parens, Issue #1201
   void fixNestedParenthesis(ostringstream &output, map<string, string> &tmp_paren_vars, bool &message_printed) const;
+  //! Same as above, for a section spooled to a file
+  /*! The section is processed statement by statement (i.e. line by line) so that it never needs to be held in memory */
+  void fixNestedParenthesis(OutputSection &output, map<string, string> &tmp_paren_vars, bool &message_printed) const;
+  //! Fixes the nested parens in a string, numbering the auxiliary variables from tmp_var_nbr
+  void fixNestedParenthesis(string &str, map<string, string> &tmp_paren_vars, int &tmp_var_nbr, bool &message_printed) const;
   //! Tests if string contains more than 32 nested parens, Issue #1201
   bool testNestedParenthesis(const string &str) const;
   void writeModelLocalVariableTemporaryTerms(const temporary_terms_t &tto, const map<expr_t, expr_t, ExprNodeLess> &tt,
@@ -236,31 +449,44 @@ protected:
   //! for each block contains pair< max_lag, max_lead>
   lag_lead_vector_t block_lag_lead;
 
-  //! Compute the matching between endogenous and variable using the jacobian contemporaneous_jacobian
+  //! Compute the matching between endogenous and variable using an incidence matrix
   /*!
-    \param contemporaneous_jacobian Jacobian used as an incidence matrix: all elements declared in the map (even if they are zero), are used as vertices of the incidence matrix
+    \param incidence all the elements of the matrix (even if they are zero) are used as edges of the bipartite graph
     \return True if a complete normalization has been achieved
   */
-  bool computeNormalization(const jacob_map_t &contemporaneous_jacobian, bool verbose);
+  bool computeNormalization(const IncidenceMatrix &incidence, bool verbose);
+  //! Completes a matching between equations and endogenous, and stores it in endo2eq
+  /*! \return True if a complete normalization has been achieved */
+  bool applyNormalization(BipartiteMatching &matching, bool verbose);
 
   //! Try to compute the matching between endogenous and variable using a decreasing cutoff
   /*!
-    Applied to the jacobian contemporaneous_jacobian and stop when a matching is found.
-    If no matching is found using a strictly positive cutoff, then a zero cutoff is applied (i.e. use a symbolic normalization); in that case, the method adds zeros in the jacobian matrices to reflect all the edges in the symbolic incidence matrix.
+    Applied to the contemporaneous elements of the incidence matrix, normalized by the maximum of each row: the highest cutoff for which a matching exists is found by bisection over the magnitudes of the elements.
+    If no matching is found using a strictly positive cutoff, then a zero cutoff is applied (i.e. use a symbolic normalization); in that case, the method adds zeros in the incidence matrix and in the dynamic jacobian to reflect all the edges in the symbolic incidence matrix.
     If no matching is found with a zero cutoff close to zero an error message is printout.
   */
-  void computeNonSingularNormalization(jacob_map_t &contemporaneous_jacobian, double cutoff, jacob_map_t &static_jacobian, dynamic_jacob_map_t &dynamic_jacobian);
+  void computeNonSingularNormalization(IncidenceMatrix &incidence, double cutoff, dynamic_jacob_map_t &dynamic_jacobian);
 
   //! Try to normalized each unnormalized equation (matched endogenous variable only on the LHS)
   void computeNormalizedEquations(multimap<int, int> &endo2eqs) const;
   //! Evaluate the jacobian and suppress all the elements below the cutoff
-  void evaluateAndReduceJacobian(const eval_context_t &eval_context, jacob_map_t &contemporaneous_jacobian, jacob_map_t &static_jacobian, dynamic_jacob_map_t &dynamic_jacobian, double cutoff, bool verbose);
+  /*! \param[out] incidence the incidence matrix of the endogenous in the equations, with the values of the static and contemporaneous jacobians */
+  void evaluateAndReduceJacobian(const eval_context_t &eval_context, IncidenceMatrix &incidence, dynamic_jacob_map_t &dynamic_jacobian, double cutoff, bool verbose);
+  //! Warns about the elements of the Jacobian below the cutoff at the given calibration, but not at random perturbations of the parameters
+  /*! \param below_cutoff the (equation, deriv_id) pairs discarded by evaluateAndReduceJacobian()
+    The Jacobian is evaluated at all the draws at once, with evaluateResidualsAndJacobian() */
+  void checkCutoffRobustness(const eval_context_t &eval_context, const set<pair<int, int>> &below_cutoff, double cutoff) const;
+  //! Computes the incidence matrix of the endogenous (at any lead or lag) in the equations, with zero values
+  IncidenceMatrix computeSymbolicIncidence() const;
   //! Search the equations and variables belonging to the prologue and the epilogue of the model
-  void computePrologueAndEpilogue(const jacob_map_t &static_jacobian, vector<int> &equation_reordered, vector<int> &variable_reordered);
+  void computePrologueAndEpilogue(const IncidenceMatrix &incidence, vector<int> &equation_reordered, vector<int> &variable_reordered);
   //! Determine the type of each equation of model and try to normalized the unnormalized equation using computeNormalizedEquations
   equation_type_and_normalized_equation_t equationTypeDetermination(const map<pair<int, pair<int, int>>, expr_t> &first_order_endo_derivatives, const vector<int> &Index_Var_IM, const vector<int> &Index_Equ_IM, int mfs) const;
+  //! Computes the digest of the inputs of computeBlockDecompositionAndFeedbackVariablesForEachBlock(), used as the key of the block cache
+  string computeBlockDecompositionDigest(const IncidenceMatrix &incidence, const dynamic_jacob_map_t &dynamic_jacobian, const vector<int> &equation_reordered, const vector<int> &variable_reordered, const equation_type_and_normalized_equation_t &Equation_Type, bool select_feedback_variable, int mfs) const;
   //! Compute the block decomposition and for a non-recusive block find the minimum feedback set
-  void computeBlockDecompositionAndFeedbackVariablesForEachBlock(const jacob_map_t &static_jacobian, const dynamic_jacob_map_t &dynamic_jacobian, vector<int> &equation_reordered, vector<int> &variable_reordered, vector<pair<int, int>> &blocks, const equation_type_and_normalized_equation_t &Equation_Type, bool verbose_, bool select_feedback_variable, int mfs, vector<int> &inv_equation_reordered, vector<int> &inv_variable_reordered, lag_lead_vector_t &equation_lag_lead, lag_lead_vector_t &variable_lag_lead_t, vector<unsigned int> &n_static, vector<unsigned int> &n_forward, vector<unsigned int> &n_backward, vector<unsigned int> &n_mixed) const;
+  /*! With a block cache (see block_cache), the decomposition is reused if its inputs did not change, and otherwise the feedback variables of the blocks that did not change are reused */
+  void computeBlockDecompositionAndFeedbackVariablesForEachBlock(const IncidenceMatrix &incidence, const dynamic_jacob_map_t &dynamic_jacobian, vector<int> &equation_reordered, vector<int> &variable_reordered, vector<pair<int, int>> &blocks, const equation_type_and_normalized_equation_t &Equation_Type, bool verbose_, bool select_feedback_variable, int mfs, vector<int> &inv_equation_reordered, vector<int> &inv_variable_reordered, lag_lead_vector_t &equation_lag_lead, lag_lead_vector_t &variable_lag_lead_t, vector<unsigned int> &n_static, vector<unsigned int> &n_forward, vector<unsigned int> &n_backward, vector<unsigned int> &n_mixed) const;
   //! Reduce the number of block merging the same type equation in the prologue and the epilogue and determine the type of each block
   block_type_firstequation_size_mfs_t reduceBlocksAndTypeDetermination(const dynamic_jacob_map_t &dynamic_jacobian, vector<pair<int, int>> &blocks, const equation_type_and_normalized_equation_t &Equation_Type, const vector<int> &variable_reordered, const vector<int> &equation_reordered, vector<unsigned int> &n_static, vector<unsigned int> &n_forward, vector<unsigned int> &n_backward, vector<unsigned int> &n_mixed, vector<pair< pair<int, int>, pair<int, int>>> &block_col_type);
   //! Determine the maximum number of lead and lag for the endogenous variable in a bloc
@@ -320,12 +546,55 @@ protected:
   virtual int getBlockInitialOtherEndogenousID(int block_number, int variable_number) const = 0;
   //! Initialize equation_reordered & variable_reordered
   void initializeVariablesAndEquations();
+  //! Feeds the block decomposition to a structural hash (see computeStructuralDigests())
+  /*! By default, only the reorderings of equations and variables are fed */
+  virtual void addBlockDecompositionToStructuralHash(StructuralHash &hash) const;
+  //! Helper for the above, feeding the block decomposition members shared by StaticModel and DynamicModel
+  void addBlocksToStructuralHash(StructuralHash &hash,
+                                 const equation_type_and_normalized_equation_t &equation_type_and_normalized_equation,
+                                 const block_type_firstequation_size_mfs_t &block_type_firstequation_size_mfs,
+                                 const vector<bool> &blocks_linear) const;
 public:
   ModelTree(SymbolTable &symbol_table_arg,
             NumericalConstants &num_constants_arg,
             ExternalFunctionsTable &external_functions_table_arg);
   //! Absolute value under which a number is considered to be zero
   double cutoff;
+  //! Number of threads used for computing derivatives of order 1 to 3, and for processing the blocks of the block decomposition (1 means no multi-threading)
+  int nthreads;
+  //! Directory where the block decompositions are kept for reuse by later runs (empty to disable the cache)
+  string block_cache;
+  //! Whether the bytecode output also includes the flat bytecode files (see writeFlatBytecode())
+  bool flat_bytecode;
+  //! Whether to use the "cse" engine for selecting temporary terms (see computeTemporaryTermsCSE())
+  bool cse_temporary_terms;
+  //! Whether to print the cost of the generated code under both temporary terms engines
+  bool temporary_terms_report;
+  //! Whether to compute the derivatives w.r. to parameters in reverse mode (see computeParamsAdjoint())
+  bool params_derivs_adjoint;
+  //! Restricts the computation of derivatives of order 2 and 3 to the equations with the given names (as given by their "name" tag)
+  /*! The derivatives of the other equations are treated as null, so that
+    the sparse layout of the output files is unchanged. A warning lists
+    these other equations, whose g2 and g3 entries are hence zero. The
+    auxiliary equations are always kept */
+  void restrictHigherOrderDerivatives(const vector<string> &eq_names, WarningConsolidation &warnings);
+  //! Evaluates the residuals and the Jacobian at all the points of a context at once
+  /*! Results are in structure-of-arrays layout: the value at point k of the
+    residual (lhs minus rhs) of equation eq is residuals[eq*npoints+k], and
+    that of its derivative w.r. to deriv_id is jacobian[{ eq, deriv_id }][k].
+    Values that cannot be computed (missing value in the context, external
+    function) are NaN. */
+  void evaluateResidualsAndJacobian(const DenseEvalContext &context, vector<double> &residuals,
+                                    map<pair<int, int>, vector<double>> &jacobian) const;
+  //! Computes the digests of the parts of the model from which its output files are generated
+  /*! The digests are computed on the DAG with StructuralHash, so that no
+    expression needs to be printed. The keys are "equations" (with their tags
+    and the auxiliary equations), "first_derivatives", "second_derivatives",
+    "third_derivatives", "params_derivatives", "temporary_terms", "blocks"
+    (the block decomposition, which also depends on numerical values through
+    the cutoff) and "lines" (the line numbers of the equations, which only
+    appear in JSON output) */
+  map<string, string> computeStructuralDigests() const;
   //! Compute the minimum feedback set
   /*!   0 : all endogenous variables are considered as feedback variables
     1 : the variables belonging to non normalized equation are considered as feedback variables
@@ -351,10 +620,57 @@ public:
   //! Helper for writing the Jacobian elements in MATLAB and C
   /*! Writes either (i+1,j+1) or [i+j*no_eq] */
   void jacobianHelper(ostream &output, int eq_nb, int col_nb, ExprNodeOutputType output_type) const;
+  //! Helper for writing the subscript of a residual
+  /*! Writes either (eq+1), [eq] or, in batched C output, [eq*n+i] */
+  void residualHelper(ostream &output, int eq_nb, ExprNodeOutputType output_type) const;
   //! Helper for writing the sparse Hessian or third derivatives in MATLAB and C
   /*! If order=2, writes either v2(i+1,j+1) or v2[i+j*NNZDerivatives[1]]
     If order=3, writes either v3(i+1,j+1) or v3[i+j*NNZDerivatives[2]] */
   void sparseHelper(int order, ostream &output, int row_nb, int col_nb, ExprNodeOutputType output_type) const;
+  //! Writes the sparsity pattern of the Hessian or third derivatives as a static table
+  /*! indices contains the (1-based) row and column of every line of v2 or v3.
+    In C, writes a file-scope array holding the first two columns of v2 or v3 (column-major),
+    which the caller copies with a single memcpy; in MATLAB, writes the assignment of these
+    two columns from a literal matrix */
+  void writeSparseIndexTable(ostream &output, int order, const vector<pair<int, int>> &indices, ExprNodeOutputType output_type) const;
+  //! Writes the filling of the values of the symmetric elements of v2 or v3
+  /*! copies contains (0-based) pairs of destination and source lines. In C, the table
+    is written to table_output (at file scope) and the copy loop to output; in MATLAB,
+    a single vectorized assignment is written to output */
+  void writeSparseSymmetricCopies(ostream &table_output, ostream &output, int order, const vector<pair<int, int>> &copies, ExprNodeOutputType output_type) const;
+  //! Writes a section of generated C code as separate translation units (see the split_c_files option)
+  /*! Each unit holds at most statements_per_file statements (i.e. lines) of
+    the section, and defines a function <name>_<k> with the given parameters;
+    the units are written to <basename>/model/src/<name>_<k>.c and include
+    <header>. A unit is never ended after a "lhs =" or "rhs =" line, since the
+    following lines use these local variables (declared in every unit if
+    residuals is true).
+    The prototypes of the functions are written to prototypes, the calls (in
+    order, with the given arguments and indentation) to calls, and the names
+    of the source files are appended to sources. */
+  void writeCSplitSection(const string &basename, const string &header, const string &name,
+                          const string &params, const string &args, bool residuals,
+                          OutputSection &code, int statements_per_file,
+                          ostream &prototypes, ostream &calls, const string &indent,
+                          vector<string> &sources) const;
+  //! Writes a makefile compiling the given sources in parallel into the MEX file <basename>/<name>
+  void writeCSplitMakefile(const string &basename, const string &name, const string &header,
+                           const vector<string> &sources) const;
+  //! Writes the declarations of the standalone C library (see language=c) for the static or dynamic model
+  /*! The names are prefixed with prefix. params is the list of parameters
+    common to all the per-order functions, and signature the (prefixed)
+    prototype of the function computing all orders */
+  void writeCLibraryDeclarations(ostream &output, const string &prefix, const string &model_name,
+                                 const string &params, const string &signature) const;
+  //! Writes the macros giving their prefixed names to the symbols defined by the C library source of a model
+  /*! The symbols are those declared by writeCLibraryDeclarations(), those of
+    other_symbols (e.g. Static), and the helper functions of the model */
+  void writeCLibraryRenames(ostream &output, const string &prefix, const string &model_name,
+                            const vector<string> &other_symbols) const;
+  //! Writes the definitions of the metadata of the standalone C library for the static or dynamic model
+  /*! g1_indices contains the (0-based) row and column of the nonzero elements of the Jacobian */
+  void writeCLibraryMetadata(ostream &output, const string &model_name, int g1_ncols,
+                             const vector<pair<int, int>> &g1_indices) const;
   inline static std::string
   c_Equation_Type(int type)
   {
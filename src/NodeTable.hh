@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _NODETABLE_HH
+#define _NODETABLE_HH
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+using namespace std;
+
+//! Hash table used by DataTree for sharing identical nodes
+/*! Entries are only ever added (or all removed at once), which allows a
+  simpler layout than std::unordered_map:
+  - the (key, node) pairs are stored contiguously, in insertion order, which
+    is also the iteration order (hence reproducible from one run to another);
+  - the index is an open addressing table with linear probing, whose slots
+    hold the position of an entry together with the hash of its key. A probe
+    therefore only compares keys when their hashes are equal, and growing the
+    index never recomputes a hash.
+
+  The hash can be computed once by the caller with hash(), and passed to both
+  find() and insert() when the lookup of a key is followed by its insertion. */
+template<typename Key, typename Node, typename Hash>
+class NodeTable
+{
+public:
+  using key_type = Key;
+  using value_type = pair<Key, Node *>;
+private:
+  struct Slot
+  {
+    size_t hash;
+    //! Position in entries, or -1 if the slot is empty
+    int entry;
+  };
+  vector<value_type> entries;
+  //! Its size is zero or a power of two, and at most half of the slots are used
+  vector<Slot> slots;
+  Hash hasher;
+
+  void
+  grow()
+  {
+    vector<Slot> old_slots(slots.empty() ? 16 : 2 * slots.size(), Slot{ 0, -1 });
+    swap(slots, old_slots);
+    size_t mask = slots.size() - 1;
+    for (const auto &slot : old_slots)
+      if (slot.entry >= 0)
+        {
+          size_t i = slot.hash & mask;
+          while (slots[i].entry >= 0)
+            i = (i + 1) & mask;
+          slots[i] = slot;
+        }
+  };
+public:
+  using const_iterator = typename vector<value_type>::const_iterator;
+
+  size_t
+  hash(const Key &key) const
+  {
+    return hasher(key);
+  };
+  //! Returns the node associated to a key whose hash is h, or nullptr
+  Node *
+  find(const Key &key, size_t h) const
+  {
+    if (slots.empty())
+      return nullptr;
+    size_t mask = slots.size() - 1;
+    for (size_t i = h & mask; slots[i].entry >= 0; i = (i + 1) & mask)
+      if (slots[i].hash == h && entries[slots[i].entry].first == key)
+        return entries[slots[i].entry].second;
+    return nullptr;
+  };
+  Node *
+  find(const Key &key) const
+  {
+    return find(key, hash(key));
+  };
+  //! Adds a key whose hash is h, which must not already be in the table
+  void
+  insert(Key key, Node *node, size_t h)
+  {
+    if (2 * (entries.size() + 1) > slots.size())
+      grow();
+    size_t mask = slots.size() - 1;
+    size_t i = h & mask;
+    while (slots[i].entry >= 0)
+      i = (i + 1) & mask;
+    slots[i] = { h, static_cast<int>(entries.size()) };
+    entries.emplace_back(move(key), node);
+  };
+  void
+  insert(Key key, Node *node)
+  {
+    size_t h = hash(key);
+    insert(move(key), node, h);
+  };
+  size_t
+  size() const
+  {
+    return entries.size();
+  };
+  void
+  clear()
+  {
+    entries.clear();
+    slots.clear();
+  };
+  const_iterator
+  begin() const
+  {
+    return entries.begin();
+  };
+  const_iterator
+  end() const
+  {
+    return entries.end();
+  };
+};
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file
+  Compares the tables that DataTree can use for sharing the binary operator
+  nodes: std::map, std::unordered_map and NodeTable (see NodeTable.hh).
+
+  Usage: node_table_benchmark [operations] [hit_ratio] [seed]
+
+  The workload mimics the construction of a model and of its derivatives by
+  the Add* methods of DataTree: each operation looks up the key of a binary
+  operator node (two existing nodes, an operator code and an order of power
+  derivative), and creates a new node when the key is not yet in the table.
+  A fraction hit_ratio of the operations look up a key that has already been
+  added. All the tables must give the same nodes. */
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <map>
+#include <unordered_map>
+#include <tuple>
+#include <cstdlib>
+
+#include <boost/functional/hash.hpp>
+
+#include "NodeTable.hh"
+
+//! Stands for ExprNode, which is only identified by its index in the tables
+struct Node
+{
+  int idx;
+};
+
+using Key = tuple<const Node *, const Node *, int, int>;
+
+//! Same hash as DataTree::NodeKeyHash on the key of a binary operator node
+struct KeyHash
+{
+  size_t
+  operator()(const Key &key) const
+  {
+    size_t seed = 0;
+    boost::hash_combine(seed, get<0>(key)->idx);
+    boost::hash_combine(seed, get<1>(key)->idx);
+    boost::hash_combine(seed, get<2>(key));
+    boost::hash_combine(seed, get<3>(key));
+    return seed;
+  }
+};
+
+int
+main(int argc, char **argv)
+{
+  if (argc > 4)
+    {
+      cerr << "Usage: " << argv[0] << " [operations] [hit_ratio] [seed]" << endl;
+      exit(EXIT_FAILURE);
+    }
+  int n = argc >= 2 ? atoi(argv[1]) : 1000000;
+  double hit_ratio = argc >= 3 ? atof(argv[2]) : 0.5;
+  unsigned int seed = argc >= 4 ? atoi(argv[3]) : 0;
+  if (n <= 0 || hit_ratio < 0 || hit_ratio >= 1)
+    {
+      cerr << "Error: the number of operations must be positive, and the hit ratio in [0,1)" << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  /* The nodes are allocated beforehand, so that the k-th node created by a
+     table is nodes[k] */
+  vector<Node> nodes(n);
+  for (int i = 0; i < n; i++)
+    nodes[i].idx = i;
+
+  // Draws the keys, the children of a new node being taken among the existing ones
+  mt19937 gen(seed);
+  uniform_real_distribution<double> unit_dist;
+  uniform_int_distribution<int> op_dist(0, 7);
+  vector<Key> keys;
+  keys.reserve(n);
+  int created = 0;
+  for (int i = 0; i < n; i++)
+    if (created > 0 && unit_dist(gen) < hit_ratio)
+      keys.push_back(keys[uniform_int_distribution<int>(0, keys.size() - 1)(gen)]);
+    else
+      {
+        const Node *arg1 = &nodes[created == 0 ? 0 : uniform_int_distribution<int>(0, created - 1)(gen)];
+        const Node *arg2 = &nodes[created == 0 ? 0 : uniform_int_distribution<int>(0, created - 1)(gen)];
+        keys.emplace_back(arg1, arg2, op_dist(gen), 0);
+        created++;
+      }
+
+  auto time = [](auto f)
+    {
+      auto start = chrono::steady_clock::now();
+      f();
+      chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+      return elapsed.count();
+    };
+
+  // For each table, the node obtained by each operation
+  vector<const Node *> map_result(n), unordered_result(n), node_table_result(n);
+  double map_time = time([&]()
+                         {
+                           map<Key, const Node *> table;
+                           for (int i = 0; i < n; i++)
+                             {
+                               auto it = table.find(keys[i]);
+                               if (it != table.end())
+                                 map_result[i] = it->second;
+                               else
+                                 table.emplace(keys[i], map_result[i] = &nodes[table.size()]);
+                             }
+                         });
+  double unordered_time = time([&]()
+                               {
+                                 unordered_map<Key, const Node *, KeyHash> table;
+                                 for (int i = 0; i < n; i++)
+                                   {
+                                     auto it = table.find(keys[i]);
+                                     if (it != table.end())
+                                       unordered_result[i] = it->second;
+                                     else
+                                       table.emplace(keys[i], unordered_result[i] = &nodes[table.size()]);
+                                   }
+                               });
+  double node_table_time = time([&]()
+                                {
+                                  NodeTable<Key, const Node, KeyHash> table;
+                                  for (int i = 0; i < n; i++)
+                                    {
+                                      size_t hash = table.hash(keys[i]);
+                                      if (auto p = table.find(keys[i], hash))
+                                        node_table_result[i] = p;
+                                      else
+                                        table.insert(keys[i], node_table_result[i] = &nodes[table.size()], hash);
+                                    }
+                                });
+
+  bool identical = map_result == unordered_result && map_result == node_table_result;
+  cout << "Operations: " << n << ", nodes created: " << created << endl
+       << "std::map: " << map_time << " s" << endl
+       << "std::unordered_map: " << unordered_time << " s" << endl
+       << "NodeTable: " << node_table_time << " s" << endl
+       << "Results: " << (identical ? "identical" : "DIFFERENT") << endl;
+  if (!identical)
+    exit(EXIT_FAILURE);
+}
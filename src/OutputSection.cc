@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdlib>
+
+#include <boost/filesystem.hpp>
+
+#include "OutputSection.hh"
+
+OutputSection::OutputSection()
+{
+  filename = (boost::filesystem::temp_directory_path()
+              / boost::filesystem::unique_path("dynare-%%%%-%%%%-%%%%-%%%%")).string();
+  open(filename, ios::in | ios::out | ios::trunc | ios::binary);
+  if (!is_open())
+    {
+      cerr << "Error: Can't open temporary file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+}
+
+OutputSection::~OutputSection()
+{
+  close();
+  boost::system::error_code ec;
+  boost::filesystem::remove(filename, ec);
+}
+
+bool
+OutputSection::empty()
+{
+  return tellp() == 0;
+}
+
+void
+OutputSection::rewind()
+{
+  flush();
+  clear();
+  seekg(0);
+}
+
+void
+OutputSection::copyTo(ostream &output)
+{
+  // Inserting an empty streambuf would set the failbit of output
+  if (empty())
+    return;
+  rewind();
+  output << rdbuf();
+  clear();
+  seekp(0, ios::end);
+}
+
+void
+OutputSection::swap(OutputSection &other)
+{
+  fstream::swap(other);
+  filename.swap(other.filename);
+}
+
+ostream &
+operator<<(ostream &output, OutputSection &section)
+{
+  section.copyTo(output);
+  return output;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _OUTPUTSECTION_HH
+#define _OUTPUTSECTION_HH
+
+#include <fstream>
+#include <string>
+
+using namespace std;
+
+//! A section of generated code, spooled to a temporary file
+/*! The model writers produce several sections (temporary terms, residuals,
+  derivatives...) which are only assembled into the final files once they are
+  all complete. Unlike an ostringstream, an OutputSection does not keep its
+  contents in memory, so that the memory needed for writing the output does
+  not grow with the size of the model. */
+class OutputSection : public fstream
+{
+private:
+  //! Path of the temporary file, removed on destruction
+  string filename;
+public:
+  OutputSection();
+  ~OutputSection() override;
+  OutputSection(const OutputSection &) = delete;
+  OutputSection &operator=(const OutputSection &) = delete;
+  //! Returns true if nothing has been written to the section
+  bool empty();
+  //! Positions the section for reading its contents from the beginning
+  void rewind();
+  //! Copies the contents of the section at the end of the given stream
+  /*! Afterwards, the section can be written to again */
+  void copyTo(ostream &output);
+  //! Exchanges the contents of two sections
+  void swap(OutputSection &other);
+};
+
+//! Copies the contents of the section at the end of the stream
+ostream &operator<<(ostream &output, OutputSection &section);
+
+#endif
@@ -3133,6 +3133,12 @@ ParsingDriver::add_parallel_local_file(string filename)
   mod_file->parallel_local_files.push_back(move(filename));
 }
 
+void
+ParsingDriver::add_higher_order_equation(string eq_name)
+{
+  mod_file->higher_order_equations.push_back(move(eq_name));
+}
+
 void
 ParsingDriver::add_moment_calibration_item(const string &endo1, const string &endo2, string lags, const pair<string, string> &range)
 {
@@ -814,6 +814,8 @@ public:
   void model_diagnostics();
   //! Processing the parallel_local_files option
   void add_parallel_local_file(string filename);
+  //! Processing the higher_order_equations option
+  void add_higher_order_equation(string eq_name);
   //! Add an item of a moment_calibration statement
   void add_moment_calibration_item(const string &endo1, const string &endo2, string lags, const pair<string, string> &range);
   //! End a moment_calibration statement
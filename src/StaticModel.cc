@@ -38,7 +38,7 @@ StaticModel::StaticModel(SymbolTable &symbol_table_arg,
 }
 
 void
-StaticModel::compileDerivative(ofstream &code_file, unsigned int &instruction_number, int eq, int symb_id, map_idx_t &map_idx, temporary_terms_t temporary_terms) const
+StaticModel::compileDerivative(ostream &code_file, unsigned int &instruction_number, int eq, int symb_id, map_idx_t &map_idx, temporary_terms_t temporary_terms) const
 {
   auto it = first_derivatives.find({ eq, getDerivID(symbol_table.getID(SymbolType::endogenous, symb_id), 0) });
   if (it != first_derivatives.end())
@@ -51,7 +51,7 @@ StaticModel::compileDerivative(ofstream &code_file, unsigned int &instruction_nu
 }
 
 void
-StaticModel::compileChainRuleDerivative(ofstream &code_file, unsigned int &instruction_number, int eqr, int varr, int lag, map_idx_t &map_idx, temporary_terms_t temporary_terms) const
+StaticModel::compileChainRuleDerivative(ostream &code_file, unsigned int &instruction_number, int eqr, int varr, int lag, map_idx_t &map_idx, temporary_terms_t temporary_terms) const
 {
   auto it = first_chain_rule_derivatives.find({ eqr, { varr, lag } });
   if (it != first_chain_rule_derivatives.end())
@@ -85,41 +85,38 @@ StaticModel::computeTemporaryTermsOrdered()
 
   temporary_terms.clear();
 
-  //local temporay terms
-  for (unsigned int block = 0; block < nb_blocks; block++)
-    {
-      map<expr_t, int> reference_count_local;
-      reference_count_local.clear();
-      map<expr_t, pair<int, int>> first_occurence_local;
-      first_occurence_local.clear();
-      temporary_terms_t temporary_terms_l;
-      temporary_terms_l.clear();
-
-      unsigned int block_size = getBlockSize(block);
-      unsigned int block_nb_mfs = getBlockMfs(block);
-      unsigned int block_nb_recursives = block_size - block_nb_mfs;
-      v_temporary_terms_local[block] = vector<temporary_terms_t>(block_size);
-
-      for (unsigned int i = 0; i < block_size; i++)
-        {
-          if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
-            getBlockEquationRenormalizedExpr(block, i)->computeTemporaryTerms(reference_count_local, temporary_terms_l, first_occurence_local, block, v_temporary_terms_local,  i);
-          else
-            {
-              eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-              eq_node->computeTemporaryTerms(reference_count_local, temporary_terms_l, first_occurence_local, block, v_temporary_terms_local,  i);
-            }
-        }
-      for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
-        {
-          expr_t id = it->second.second;
-          id->computeTemporaryTerms(reference_count_local, temporary_terms_l, first_occurence_local, block, v_temporary_terms_local,  block_size-1);
-        }
-      set<int> temporary_terms_in_use;
-      temporary_terms_in_use.clear();
-      v_temporary_terms_inuse[block] = temporary_terms_in_use;
-      computeTemporaryTermsMapping(temporary_terms_l, map_idx2[block]);
-    }
+  //local temporay terms, which only depend on the block
+  forEachBlock(nb_blocks, [&](unsigned int block, int thread)
+               {
+                 map<expr_t, int> reference_count_local;
+                 reference_count_local.clear();
+                 map<expr_t, pair<int, int>> first_occurence_local;
+                 first_occurence_local.clear();
+                 temporary_terms_t temporary_terms_l;
+                 temporary_terms_l.clear();
+
+                 unsigned int block_size = getBlockSize(block);
+                 unsigned int block_nb_mfs = getBlockMfs(block);
+                 unsigned int block_nb_recursives = block_size - block_nb_mfs;
+                 v_temporary_terms_local[block] = vector<temporary_terms_t>(block_size);
+
+                 for (unsigned int i = 0; i < block_size; i++)
+                   {
+                     if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
+                       getBlockEquationRenormalizedExpr(block, i)->computeTemporaryTerms(reference_count_local, temporary_terms_l, first_occurence_local, block, v_temporary_terms_local,  i);
+                     else
+                       getBlockEquationExpr(block, i)->computeTemporaryTerms(reference_count_local, temporary_terms_l, first_occurence_local, block, v_temporary_terms_local,  i);
+                   }
+                 for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
+                   {
+                     expr_t id = it->second.second;
+                     id->computeTemporaryTerms(reference_count_local, temporary_terms_l, first_occurence_local, block, v_temporary_terms_local,  block_size-1);
+                   }
+                 set<int> temporary_terms_in_use;
+                 temporary_terms_in_use.clear();
+                 v_temporary_terms_inuse[block] = temporary_terms_in_use;
+                 computeTemporaryTermsMapping(temporary_terms_l, map_idx2[block]);
+               });
 
   // global temporay terms
   for (unsigned int block = 0; block < nb_blocks; block++)
@@ -146,34 +143,32 @@ StaticModel::computeTemporaryTermsOrdered()
         }
     }
 
-  for (unsigned int block = 0; block < nb_blocks; block++)
-    {
-      // Collecte the temporary terms reordered
-      unsigned int block_size = getBlockSize(block);
-      unsigned int block_nb_mfs = getBlockMfs(block);
-      unsigned int block_nb_recursives = block_size - block_nb_mfs;
-      set<int> temporary_terms_in_use;
-      for (unsigned int i = 0; i < block_size; i++)
-        {
-          if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
-            getBlockEquationRenormalizedExpr(block, i)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-          else
-            {
-              eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-              eq_node->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-            }
-        }
-      for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
-        {
-          expr_t id = it->second.second;
-          id->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-        }
-      for (int i = 0; i < (int) getBlockSize(block); i++)
-        for (auto it = v_temporary_terms[block][i].begin();
-             it != v_temporary_terms[block][i].end(); it++)
-          (*it)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-      v_temporary_terms_inuse[block] = temporary_terms_in_use;
-    }
+  // The temporary terms used by each block only depend on the block
+  forEachBlock(nb_blocks, [&](unsigned int block, int thread)
+               {
+                 // Collecte the temporary terms reordered
+                 unsigned int block_size = getBlockSize(block);
+                 unsigned int block_nb_mfs = getBlockMfs(block);
+                 unsigned int block_nb_recursives = block_size - block_nb_mfs;
+                 set<int> temporary_terms_in_use;
+                 for (unsigned int i = 0; i < block_size; i++)
+                   {
+                     if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
+                       getBlockEquationRenormalizedExpr(block, i)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                     else
+                       getBlockEquationExpr(block, i)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                   }
+                 for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
+                   {
+                     expr_t id = it->second.second;
+                     id->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                   }
+                 for (int i = 0; i < (int) getBlockSize(block); i++)
+                   for (auto it = v_temporary_terms[block][i].begin();
+                        it != v_temporary_terms[block][i].end(); it++)
+                     (*it)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+                 v_temporary_terms_inuse[block] = temporary_terms_in_use;
+               });
   computeTemporaryTermsMapping(temporary_terms, map_idx);
 }
 
@@ -552,6 +547,9 @@ StaticModel::writeModelEquationsCode(const string &basename, map_idx_t map_idx)
   FEND_ fend;
   fend.write(code_file, instruction_number);
   code_file.close();
+
+  if (flat_bytecode)
+    writeFlatBytecode(basename, "static", false, 0, 0);
 }
 
 void
@@ -568,17 +566,8 @@ StaticModel::writeModelEquationsCode_Block(const string &basename, map_idx_t map
     Uff_l *Ufl, *Ufl_First;
   };
 
-  int i, v;
-  string tmp_s;
-  ostringstream tmp_output;
   ofstream code_file;
   unsigned int instruction_number = 0;
-  expr_t lhs = nullptr, rhs = nullptr;
-  BinaryOpNode *eq_node;
-  Uff Uf[symbol_table.endo_nbr()];
-  map<expr_t, int> reference_count;
-  vector<int> feedback_variables;
-  deriv_node_temp_terms_t tef_terms;
   bool file_open = false;
 
   boost::filesystem::create_directories(basename + "/model/bytecode");
@@ -595,27 +584,38 @@ StaticModel::writeModelEquationsCode_Block(const string &basename, map_idx_t map
   FDIMST_ fdimst(temporary_terms.size());
   fdimst.write(code_file, instruction_number);
 
+  // Write_Inf_To_Bin_File_Block() appends to a single file, so it is called for all the blocks beforehand
+  vector<int> blocks_u_count_int(getNbBlocks(), 0);
   for (unsigned int block = 0; block < getNbBlocks(); block++)
     {
-      feedback_variables.clear();
-      if (block > 0)
+      BlockSimulationType simulation_type = getBlockSimulationType(block);
+      if (simulation_type == SOLVE_TWO_BOUNDARIES_SIMPLE || simulation_type == SOLVE_TWO_BOUNDARIES_COMPLETE
+          || simulation_type == SOLVE_BACKWARD_COMPLETE || simulation_type == SOLVE_FORWARD_COMPLETE)
         {
-          FENDBLOCK_ fendblock;
-          fendblock.write(code_file, instruction_number);
+          Write_Inf_To_Bin_File_Block(basename, block, blocks_u_count_int[block], file_open);
+          file_open = true;
         }
+    }
+
+  /* The code of each block is written in its own buffer (the jumps being
+     relative to the current instruction), and the buffers are concatenated
+     in the order of the blocks */
+  vector<string> blocks_code(getNbBlocks());
+  auto writeBlock = [&](unsigned int block, Uff *Uf, deriv_node_temp_terms_t &tef_terms)
+    {
+      ostringstream code_file;
+      unsigned int instruction_number = 0;
+      int i, v;
+      expr_t lhs = nullptr, rhs = nullptr;
+      BinaryOpNode *eq_node;
+      vector<int> feedback_variables;
       int count_u;
-      int u_count_int = 0;
+      int u_count_int = blocks_u_count_int[block];
       BlockSimulationType simulation_type = getBlockSimulationType(block);
       unsigned int block_size = getBlockSize(block);
       unsigned int block_mfs = getBlockMfs(block);
       unsigned int block_recursive = block_size - block_mfs;
 
-      if (simulation_type == SOLVE_TWO_BOUNDARIES_SIMPLE || simulation_type == SOLVE_TWO_BOUNDARIES_COMPLETE
-          || simulation_type == SOLVE_BACKWARD_COMPLETE || simulation_type == SOLVE_FORWARD_COMPLETE)
-        {
-          Write_Inf_To_Bin_File_Block(basename, block, u_count_int, file_open);
-          file_open = true;
-        }
 
       FBEGINBLOCK_ fbeginblock(block_mfs,
                                simulation_type,
@@ -960,12 +960,46 @@ StaticModel::writeModelEquationsCode_Block(const string &basename, map_idx_t map
       FJMP_ fjmp1(instruction_number - prev_instruction_number);
       fjmp1.write(code_file, instruction_number);
       code_file.seekp(pos1);
+      blocks_code[block] = code_file.str();
+    };
+
+  /* External functions computed in a block are not computed again in the
+     following ones, so in their presence the blocks are written serially;
+     otherwise they are written using nthreads threads */
+  if (external_functions_table.get_total_number_of_unique_model_block_external_functions() > 0)
+    {
+      vector<Uff> Uf(symbol_table.endo_nbr());
+      deriv_node_temp_terms_t tef_terms;
+      for (unsigned int block = 0; block < getNbBlocks(); block++)
+        writeBlock(block, Uf.data(), tef_terms);
+    }
+  else
+    {
+      vector<vector<Uff>> Uf(max(nthreads, 1), vector<Uff>(symbol_table.endo_nbr()));
+      forEachBlock(getNbBlocks(), [&](unsigned int block, int thread)
+                   {
+                     deriv_node_temp_terms_t tef_terms;
+                     writeBlock(block, Uf[thread].data(), tef_terms);
+                   });
+    }
+
+  for (unsigned int block = 0; block < getNbBlocks(); block++)
+    {
+      if (block > 0)
+        {
+          FENDBLOCK_ fendblock;
+          fendblock.write(code_file, instruction_number);
+        }
+      code_file.write(blocks_code[block].data(), blocks_code[block].size());
     }
   FENDBLOCK_ fendblock;
   fendblock.write(code_file, instruction_number);
   FEND_ fend;
   fend.write(code_file, instruction_number);
   code_file.close();
+
+  if (flat_bytecode)
+    writeFlatBytecode(basename, "static", false, 0, 0);
 }
 
 void
@@ -1098,19 +1132,30 @@ StaticModel::computingPass(const eval_context_t &eval_context, bool no_tmp_terms
         computeParamsDerivativesTemporaryTerms();
     }
 
+  if (params_derivs_adjoint)
+    {
+      if (!nopreprocessoroutput)
+        cout << " - reverse-mode derivatives of residuals/Jacobian w.r. to parameters" << endl;
+      computeParamsAdjoint(no_tmp_terms);
+    }
+
   if (block)
     {
-      jacob_map_t contemporaneous_jacobian, static_jacobian;
+      IncidenceMatrix incidence;
       vector<unsigned int> n_static, n_forward, n_backward, n_mixed;
 
       // for each block contains pair<Size, Feddback_variable>
       vector<pair<int, int>> blocks;
 
-      evaluateAndReduceJacobian(eval_context, contemporaneous_jacobian, static_jacobian, dynamic_jacobian, cutoff, false);
+      evaluateAndReduceJacobian(eval_context, incidence, dynamic_jacobian, cutoff, false);
 
-      computeNonSingularNormalization(contemporaneous_jacobian, cutoff, static_jacobian, dynamic_jacobian);
+      computeNonSingularNormalization(incidence, cutoff, dynamic_jacobian);
 
-      computePrologueAndEpilogue(static_jacobian, equation_reordered, variable_reordered);
+      // With a zero cutoff, the model is reordered according to its symbolic incidence
+      if (cutoff == 0)
+        incidence = computeSymbolicIncidence();
+
+      computePrologueAndEpilogue(incidence, equation_reordered, variable_reordered);
 
       map<pair<int, pair<int, int>>, expr_t> first_order_endo_derivatives = collect_first_order_derivatives_endogenous();
 
@@ -1121,7 +1166,7 @@ StaticModel::computingPass(const eval_context_t &eval_context, bool no_tmp_terms
 
       lag_lead_vector_t equation_lag_lead, variable_lag_lead;
 
-      computeBlockDecompositionAndFeedbackVariablesForEachBlock(static_jacobian, dynamic_jacobian, equation_reordered, variable_reordered, blocks, equation_type_and_normalized_equation, false, false, mfs, inv_equation_reordered, inv_variable_reordered, equation_lag_lead, variable_lag_lead, n_static, n_forward, n_backward, n_mixed);
+      computeBlockDecompositionAndFeedbackVariablesForEachBlock(incidence, dynamic_jacobian, equation_reordered, variable_reordered, blocks, equation_type_and_normalized_equation, false, false, mfs, inv_equation_reordered, inv_variable_reordered, equation_lag_lead, variable_lag_lead, n_static, n_forward, n_backward, n_mixed);
 
       block_type_firstequation_size_mfs = reduceBlocksAndTypeDetermination(dynamic_jacobian, blocks, equation_type_and_normalized_equation, variable_reordered, equation_reordered, n_static, n_forward, n_backward, n_mixed, block_col_type);
 
@@ -1212,7 +1257,7 @@ StaticModel::writeStaticModelHelper(const string &basename,
                                     const string &name_tt, size_t ttlen,
                                     const string &previous_tt_name,
                                     const ostringstream &init_s, const ostringstream &end_s,
-                                    const ostringstream &s, const ostringstream &s_tt) const
+                                    OutputSection &s, OutputSection &s_tt) const
 {
   string filename = packageDir(basename) + "/" + name_tt + ".m";
   ofstream output;
@@ -1243,7 +1288,7 @@ StaticModel::writeStaticModelHelper(const string &basename,
   if (!previous_tt_name.empty())
     output << "T = " << basename << "." << previous_tt_name << "(T, y, x, params);" << endl << endl;
 
-  output << s_tt.str() << endl
+  output << s_tt << endl
          << "end" << endl;
   output.close();
 
@@ -1278,7 +1323,7 @@ StaticModel::writeStaticModelHelper(const string &basename,
            << "end" << endl;
 
   output << init_s.str() << endl
-         << s.str()
+         << s
          << end_s.str() << endl
          << "end" << endl;
   output.close();
@@ -1316,28 +1361,33 @@ StaticModel::writeStaticMatlabCompatLayer(const string &basename) const
 void
 StaticModel::writeStaticModel(ostream &StaticOutput, bool use_dll, bool julia) const
 {
-  writeStaticModel("", StaticOutput, use_dll, julia);
+  writeStaticModel("", StaticOutput, use_dll, julia, 0);
 }
 
 void
 StaticModel::writeStaticModel(const string &basename, bool use_dll, bool julia) const
 {
   ofstream StaticOutput;
-  writeStaticModel(basename, StaticOutput, use_dll, julia);
+  writeStaticModel(basename, StaticOutput, use_dll, julia, 0);
 }
 
 void
 StaticModel::writeStaticModel(const string &basename,
-                              ostream &StaticOutput, bool use_dll, bool julia) const
+                              ostream &StaticOutput, bool use_dll, bool julia, int split_c_files) const
 {
-  ostringstream model_tt_output;             // Used for storing model temp vars
-  ostringstream model_output;                // Used for storing model equations
-  ostringstream jacobian_tt_output;          // Used for storing jacobian temp vars
-  ostringstream jacobian_output;             // Used for storing jacobian equations
-  ostringstream hessian_tt_output;           // Used for storing Hessian temp vars
-  ostringstream hessian_output;              // Used for storing Hessian equations
-  ostringstream third_derivatives_tt_output; // Used for storing third order derivatives temp terms
-  ostringstream third_derivatives_output;    // Used for storing third order derivatives equations
+  OutputSection model_tt_output;             // Used for storing model temp vars
+  OutputSection model_output;                // Used for storing model equations
+  OutputSection jacobian_tt_output;          // Used for storing jacobian temp vars
+  OutputSection jacobian_output;             // Used for storing jacobian equations
+  OutputSection hessian_tt_output;           // Used for storing Hessian temp vars
+  OutputSection hessian_output;              // Used for storing Hessian equations
+  OutputSection third_derivatives_tt_output; // Used for storing third order derivatives temp terms
+  OutputSection third_derivatives_output;    // Used for storing third order derivatives equations
+  OutputSection hessian_copies_output;       // Used for storing the copies of symmetric elements of v2 (C only)
+  OutputSection third_derivatives_copies_output; // Used for storing the copies of symmetric elements of v3 (C only)
+  ostringstream sparse_idx_output;           // Used for storing the sparsity patterns of v2 and v3 (C only)
+  ostringstream hessian_idx_output;          // Used for storing the sparsity pattern of v2 (MATLAB only)
+  ostringstream third_derivatives_idx_output; // Used for storing the sparsity pattern of v3 (MATLAB only)
   ostringstream for_sym;
 
   ExprNodeOutputType output_type = (use_dll ? ExprNodeOutputType::CStaticModel :
@@ -1397,6 +1447,7 @@ StaticModel::writeStaticModel(const string &basename,
       temp_term_union.insert(temporary_terms_g2.begin(), temporary_terms_g2.end());
 
       int k = 0; // Keep the line of a 2nd derivative in v2
+      vector<pair<int, int>> hessian_indices, hessian_copies;
       for (const auto & second_derivative : second_derivatives)
         {
           int eq, var1, var2;
@@ -1421,12 +1472,7 @@ StaticModel::writeStaticModel(const string &basename,
             }
           else
             {
-              sparseHelper(2, hessian_output, k, 0, output_type);
-              hessian_output << "=" << eq + 1 << ";" << endl;
-
-              sparseHelper(2, hessian_output, k, 1, output_type);
-              hessian_output << "=" << col_nb + 1 << ";" << endl;
-
+              hessian_indices.emplace_back(eq + 1, col_nb + 1);
               sparseHelper(2, hessian_output, k, 2, output_type);
               hessian_output << "=";
               d2->writeOutput(hessian_output, output_type, temp_term_union, temporary_terms_idxs, tef_terms);
@@ -1442,20 +1488,16 @@ StaticModel::writeStaticModel(const string &basename,
                              << for_sym.str() << endl;
             else
               {
-                sparseHelper(2, hessian_output, k, 0, output_type);
-                hessian_output << "=" << eq + 1 << ";" << endl;
-
-                sparseHelper(2, hessian_output, k, 1, output_type);
-                hessian_output << "=" << col_nb_sym + 1 << ";" << endl;
-
-                sparseHelper(2, hessian_output, k, 2, output_type);
-                hessian_output << "=";
-                sparseHelper(2, hessian_output, k-1, 2, output_type);
-                hessian_output << ";" << endl;
-
+                hessian_indices.emplace_back(eq + 1, col_nb_sym + 1);
+                hessian_copies.emplace_back(k, k-1);
                 k++;
               }
         }
+
+      writeSparseIndexTable(isCOutput(output_type) ? sparse_idx_output : hessian_idx_output,
+                            2, hessian_indices, output_type);
+      writeSparseSymmetricCopies(sparse_idx_output, isCOutput(output_type) ? hessian_copies_output : hessian_output,
+                                 2, hessian_copies, output_type);
     }
 
   // Writing third derivatives
@@ -1468,6 +1510,7 @@ StaticModel::writeStaticModel(const string &basename,
       temp_term_union.insert(temporary_terms_g3.begin(), temporary_terms_g3.end());
 
       int k = 0; // Keep the line of a 3rd derivative in v3
+      vector<pair<int, int>> third_derivatives_indices, third_derivatives_copies;
       for (const auto & third_derivative : third_derivatives)
         {
           int eq, var1, var2, var3;
@@ -1490,12 +1533,7 @@ StaticModel::writeStaticModel(const string &basename,
             }
           else
             {
-              sparseHelper(3, third_derivatives_output, k, 0, output_type);
-              third_derivatives_output << "=" << eq + 1 << ";" << endl;
-
-              sparseHelper(3, third_derivatives_output, k, 1, output_type);
-              third_derivatives_output << "=" << ref_col + 1 << ";" << endl;
-
+              third_derivatives_indices.emplace_back(eq + 1, ref_col + 1);
               sparseHelper(3, third_derivatives_output, k, 2, output_type);
               third_derivatives_output << "=";
               d3->writeOutput(third_derivatives_output, output_type, temp_term_union, temporary_terms_idxs, tef_terms);
@@ -1519,21 +1557,17 @@ StaticModel::writeStaticModel(const string &basename,
                                          << for_sym.str() << endl;
               else
                 {
-                  sparseHelper(3, third_derivatives_output, k+k2, 0, output_type);
-                  third_derivatives_output << "=" << eq + 1 << ";" << endl;
-
-                  sparseHelper(3, third_derivatives_output, k+k2, 1, output_type);
-                  third_derivatives_output << "=" << col + 1 << ";" << endl;
-
-                  sparseHelper(3, third_derivatives_output, k+k2, 2, output_type);
-                  third_derivatives_output << "=";
-                  sparseHelper(3, third_derivatives_output, k, 2, output_type);
-                  third_derivatives_output << ";" << endl;
-
+                  third_derivatives_indices.emplace_back(eq + 1, col + 1);
+                  third_derivatives_copies.emplace_back(k+k2, k);
                   k2++;
                 }
           k += k2;
         }
+
+      writeSparseIndexTable(isCOutput(output_type) ? sparse_idx_output : third_derivatives_idx_output,
+                            3, third_derivatives_indices, output_type);
+      writeSparseSymmetricCopies(sparse_idx_output, isCOutput(output_type) ? third_derivatives_copies_output : third_derivatives_output,
+                                 3, third_derivatives_copies, output_type);
     }
 
   if (output_type == ExprNodeOutputType::matlabStaticModel)
@@ -1581,7 +1615,8 @@ StaticModel::writeStaticModel(const string &basename,
       end_output.clear();
       if (second_derivatives.size())
         {
-          init_output << "v2 = zeros(" << NNZDerivatives[1] << ",3);";
+          init_output << "v2 = zeros(" << NNZDerivatives[1] << ",3);" << endl
+                      << hessian_idx_output.str();
           end_output << "g2 = sparse(v2(:,1),v2(:,2),v2(:,3)," << equations.size() << "," << g2ncols << ");";
         }
       else
@@ -1601,7 +1636,8 @@ StaticModel::writeStaticModel(const string &basename,
       int ncols = hessianColsNbr * JacobianColsNbr;
       if (third_derivatives.size())
         {
-          init_output << "v3 = zeros(" << NNZDerivatives[2] << ",3);";
+          init_output << "v3 = zeros(" << NNZDerivatives[2] << ",3);" << endl
+                      << third_derivatives_idx_output.str();
           end_output << "g3 = sparse(v3(:,1),v3(:,2),v3(:,3)," << nrows << "," << ncols << ");";
         }
       else
@@ -1618,37 +1654,92 @@ StaticModel::writeStaticModel(const string &basename,
     }
   else if (output_type == ExprNodeOutputType::CStaticModel)
     {
-      StaticOutput << "void Static(double *y, double *x, int nb_row_x, double *params, double *residual, double *g1, double *v2)" << endl
+      /* As in the MATLAB output, each order has its own pair of functions:
+         static_<order>_tt() fills the T buffer with the temporary terms needed
+         up to that order, and static_<order>() computes the derivatives from
+         it. With split_c_files, the body of these functions is written to
+         separate translation units. */
+      int ntt = temporary_terms_mlv.size() + temporary_terms_res.size() + temporary_terms_g1.size()
+        + temporary_terms_g2.size() + temporary_terms_g3.size();
+      string params = "double *y, double *x, int nb_row_x, double *params, double *T";
+      string args = "y, x, nb_row_x, params, T";
+      vector<string> sources = { "static.c", "static_mex.c" };
+      ostringstream prototypes;
+      OutputSection functions;
+      auto writeFunction = [&](OutputSection &code, const string &name, const string &out,
+                               const string &previous_name, const string &init, OutputSection *end)
+        {
+          functions << "void " << name << "(" << (out.empty() ? params : params + ", double *" + out) << ")" << endl
+                    << "{" << endl;
+          if (!previous_name.empty())
+            functions << "  " << previous_name << "(" << args << ");" << endl;
+          functions << init;
+          if (split_c_files > 0)
+            writeCSplitSection(basename, "static.h", name,
+                               out.empty() ? params : params + ", double *" + out,
+                               out.empty() ? args : args + ", " + out,
+                               name == "static_resid", code, split_c_files, prototypes, functions, "  ", sources);
+          else
+            {
+              if (name == "static_resid")
+                functions << "  double lhs, rhs;" << endl;
+              functions << code;
+            }
+          if (end)
+            functions << *end;
+          functions << "}" << endl << endl;
+        };
+
+      writeFunction(model_tt_output, "static_resid_tt", "", "", "", nullptr);
+      writeFunction(model_output, "static_resid", "residual", "", "", nullptr);
+      writeFunction(jacobian_tt_output, "static_g1_tt", "", "static_resid_tt", "", nullptr);
+      writeFunction(jacobian_output, "static_g1", "g1", "", "", nullptr);
+      vector<pair<string, string>> orders = { { "resid", "residual" }, { "g1", "g1" } };
+      if (second_derivatives.size())
+        {
+          writeFunction(hessian_tt_output, "static_g2_tt", "", "static_g1_tt", "", nullptr);
+          writeFunction(hessian_output, "static_g2", "v2", "", "  memcpy(v2, v2_idx, sizeof(v2_idx));\n",
+                        &hessian_copies_output);
+          orders.emplace_back("g2", "v2");
+        }
+      // Static() has no argument for the third derivatives, which are only available through static_g3()
+      if (third_derivatives.size())
+        {
+          writeFunction(third_derivatives_tt_output, "static_g3_tt", "", "static_g2_tt", "", nullptr);
+          writeFunction(third_derivatives_output, "static_g3", "v3", "", "  memcpy(v3, v3_idx, sizeof(v3_idx));\n",
+                        &third_derivatives_copies_output);
+        }
+
+      StaticOutput << sparse_idx_output.str()
+                   << prototypes.str();
+      if (split_c_files > 0)
+        StaticOutput << endl;
+      StaticOutput << functions
+                   << "void Static(double *y, double *x, int nb_row_x, double *params, double *residual, double *g1, double *v2)" << endl
                    << "{" << endl
-                   << "  double lhs, rhs;" << endl
-                   << endl
-                   << "  /* Residual equations */" << endl
-                   << model_tt_output.str()
-                   << model_output.str()
-                   << "  /* Jacobian  */" << endl
-                   << "  if (g1 == NULL)" << endl
-                   << "    return;" << endl
-                   << endl
-                   << jacobian_tt_output.str()
-                   << jacobian_output.str()
+                   << "  double T[" << max(ntt, 1) << "];" << endl
                    << endl;
+      // Only compute the temporary terms of the highest order requested
+      for (size_t k = 0; k < orders.size(); k++)
+        {
+          StaticOutput << "  ";
+          if (k > 0)
+            StaticOutput << "else";
+          if (k > 0 && k < orders.size() - 1)
+            StaticOutput << " ";
+          if (k < orders.size() - 1)
+            StaticOutput << "if (" << orders[k+1].second << " == NULL)";
+          StaticOutput << endl
+                       << "    {" << endl
+                       << "      static_" << orders[k].first << "_tt(" << args << ");" << endl;
+          for (size_t l = 0; l <= k; l++)
+            StaticOutput << "      static_" << orders[l].first << "(" << args << ", " << orders[l].second << ");" << endl;
+          StaticOutput << "    }" << endl;
+        }
+      StaticOutput << "}" << endl << endl;
 
-      if (second_derivatives.size())
-        StaticOutput << "  /* Hessian for endogenous and exogenous variables */" << endl
-                     << "  if (v2 == NULL)" << endl
-                     << "    return;" << endl
-                     << endl
-                     << hessian_tt_output.str()
-                     << hessian_output.str()
-                     << endl;
-      if (third_derivatives.size())
-        StaticOutput << "  /* Third derivatives for endogenous and exogenous variables */" << endl
-                     << "  if (v3 == NULL)" << endl
-                     << "    return;" << endl
-                     << endl
-                     << third_derivatives_tt_output.str()
-                     << third_derivatives_output.str()
-                     << endl;
+      if (split_c_files > 0)
+        writeCSplitMakefile(basename, "static", "static.h", sources);
     }
   else
     {
@@ -1723,7 +1814,7 @@ StaticModel::writeStaticModel(const string &basename,
       output << "function staticResidTT!(T::Vector{Float64}," << endl
              << "                        y::Vector{Float64}, x::Vector{Float64}, params::Vector{Float64})" << endl
              << "    @assert length(T) >= " << temporary_terms_mlv.size() + temporary_terms_res.size()  << endl
-             << model_tt_output.str()
+             << model_tt_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -1737,7 +1828,7 @@ StaticModel::writeStaticModel(const string &basename,
              << "    if T0_flag" << endl
              << "        staticResidTT!(T, y, x, params)" << endl
              << "    end" << endl
-             << model_output.str()
+             << model_output
              << "    if ~isreal(residual)" << endl
              << "        residual = real(residual)+imag(residual).^2;" << endl
              << "    end" << endl
@@ -1750,7 +1841,7 @@ StaticModel::writeStaticModel(const string &basename,
              << "    if T0_flag" << endl
              << "        staticResidTT!(T, y, x, params)" << endl
              << "    end" << endl
-             << jacobian_tt_output.str()
+             << jacobian_tt_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -1767,7 +1858,7 @@ StaticModel::writeStaticModel(const string &basename,
              << "        staticG1TT!(T, y, x, params, T0_flag)" << endl
              << "    end" << endl
              << "    fill!(g1, 0.0)" << endl
-             << jacobian_output.str()
+             << jacobian_output
              << "    if ~isreal(g1)" << endl
              << "        g1 = real(g1)+2*imag(g1);" << endl
              << "    end" << endl
@@ -1780,7 +1871,7 @@ StaticModel::writeStaticModel(const string &basename,
              << "    if T1_flag" << endl
              << "        staticG1TT!(T, y, x, params, TO_flag)" << endl
              << "    end" << endl
-             << hessian_tt_output.str()
+             << hessian_tt_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -1797,7 +1888,7 @@ StaticModel::writeStaticModel(const string &basename,
              << "        staticG2TT!(T, y, x, params, T1_flag, T0_flag)" << endl
              << "    end" << endl
              << "    fill!(g2, 0.0)" << endl
-             << hessian_output.str()
+             << hessian_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -1807,7 +1898,7 @@ StaticModel::writeStaticModel(const string &basename,
              << "    if T2_flag" << endl
              << "        staticG2TT!(T, y, x, params, T1_flag, T0_flag)" << endl
              << "    end" << endl
-             << third_derivatives_tt_output.str()
+             << third_derivatives_tt_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -1825,7 +1916,7 @@ StaticModel::writeStaticModel(const string &basename,
              << "        staticG3TT!(T, y, x, params, T2_flag, T1_flag, T0_flag)" << endl
              << "    end" << endl
              << "    fill!(g3, 0.0)" << endl
-             << third_derivatives_output.str()
+             << third_derivatives_output
              << "    return nothing" << endl
              << "end" << endl << endl;
 
@@ -1862,13 +1953,25 @@ StaticModel::writeStaticModel(const string &basename,
 }
 
 void
-StaticModel::writeStaticCFile(const string &basename) const
+StaticModel::writeStaticCFile(const string &basename, int split_c_files, const string &library_prefix) const
 {
+  bool library = !library_prefix.empty();
   // Writing comments and function definition command
   boost::filesystem::create_directories(basename + "/model/src");
   string filename = basename + "/model/src/static.c";
   string filename_mex = basename + "/model/src/static_mex.c";
 
+  if (split_c_files > 0 && external_functions_table.get_total_number_of_unique_model_block_external_functions())
+    {
+      cerr << "ERROR: the split_c_files option cannot be used with external functions in the model block" << endl;
+      exit(EXIT_FAILURE);
+    }
+  if (library && external_functions_table.get_total_number_of_unique_model_block_external_functions())
+    {
+      cerr << "ERROR: the C library output (language=c) cannot be used with external functions in the model block" << endl;
+      exit(EXIT_FAILURE);
+    }
+
   ofstream output;
   output.open(filename, ios::out | ios::binary);
   if (!output.is_open())
@@ -1882,35 +1985,83 @@ StaticModel::writeStaticCFile(const string &basename) const
          << " *" << endl
          << " * Warning : this file is generated automatically by Dynare" << endl
          << " *           from model file (.mod)" << endl << endl
-         << " */" << endl
+         << " */" << endl;
+
+  ostringstream prologue;
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
-         << "#ifdef _MSC_VER" << endl
-         << "#define _USE_MATH_DEFINES" << endl
-         << "#endif" << endl
+  prologue << "#ifdef _MSC_VER" << endl
+           << "#define _USE_MATH_DEFINES" << endl
+           << "#endif" << endl;
 #endif
-         << "#include <math.h>" << endl;
+  prologue << "#include <math.h>" << endl
+           << "#include <string.h>" << endl
+           << "#include <stdlib.h>" << endl;
 
   if (external_functions_table.get_total_number_of_unique_model_block_external_functions())
     // External Matlab function, implies Static function will call mex
-    output << "#include \"mex.h\"" << endl;
-  else
-    output << "#include <stdlib.h>" << endl;
+    prologue << "#include \"mex.h\"" << endl;
+
+  prologue << "#define max(a, b) (((a) > (b)) ? (a) : (b))" << endl
+           << "#define min(a, b) (((a) > (b)) ? (b) : (a))" << endl;
 
-  output << "#define max(a, b) (((a) > (b)) ? (a) : (b))" << endl
-         << "#define min(a, b) (((a) > (b)) ? (b) : (a))" << endl;
+  if (library)
+    writeCLibraryRenames(prologue, library_prefix, "static", { "Static" });
 
   // Write function definition if BinaryOpcode::powerDeriv is used
-  writePowerDerivCHeader(output);
-  writeNormcdfCHeader(output);
+  writePowerDerivCHeader(prologue);
+  writeNormcdfCHeader(prologue);
+
+  if (split_c_files > 0)
+    {
+      // The prologue is shared with the other translation units
+      string filename_h = basename + "/model/src/static.h";
+      ofstream header;
+      header.open(filename_h, ios::out | ios::binary);
+      if (!header.is_open())
+        {
+          cerr << "ERROR: Can't open file " << filename_h << " for writing" << endl;
+          exit(EXIT_FAILURE);
+        }
+      header << "/*" << endl
+             << " * " << filename_h << " : Declarations shared by the translation units of the static model" << endl
+             << " *" << endl
+             << " * Warning : this file is generated automatically by Dynare" << endl
+             << " *           from model file (.mod)" << endl
+             << " */" << endl
+             << "#ifndef _STATIC_H" << endl
+             << "#define _STATIC_H" << endl
+             << prologue.str()
+             << "#endif" << endl;
+      header.close();
+      output << "#include \"static.h\"" << endl;
+    }
+  else
+    output << prologue.str();
+
+  // Checks that the definitions match the interface of the library
+  if (library)
+    output << "#include \"model.h\"" << endl;
 
   // Writing the function body
-  writeStaticModel(output, true, false);
-  output << "}" << endl << endl;
+  writeStaticModel(basename, output, true, false, split_c_files);
+
+  if (library)
+    {
+      vector<pair<int, int>> g1_indices;
+      for (const auto &first_derivative : first_derivatives)
+        g1_indices.emplace_back(first_derivative.first.first,
+                                symbol_table.getTypeSpecificID(getSymbIDByDerivID(first_derivative.first.second)));
+      writeCLibraryMetadata(output, "static", symbol_table.endo_nbr(), g1_indices);
+    }
 
   writePowerDeriv(output);
   writeNormcdf(output);
   output.close();
 
+  // The library has no MEX gateway
+  if (library)
+    return;
+
   output.open(filename_mex, ios::out | ios::binary);
   if (!output.is_open())
     {
@@ -1986,7 +2137,24 @@ StaticModel::writeStaticJuliaFile(const string &basename) const
 }
 
 void
-StaticModel::writeStaticFile(const string &basename, bool block, bool bytecode, bool use_dll, bool julia) const
+StaticModel::writeStaticCLibraryFile(const string &basename, const string &prefix, ostream &header) const
+{
+  writeStaticCFile(basename, 0, prefix);
+
+  writeCLibraryDeclarations(header, prefix, "static",
+                            "double *y, double *x, int nb_row_x, double *params, double *T",
+                            "void " + prefix + "Static(double *y, double *x, int nb_row_x, double *params, double *residual, double *g1, double *v2)");
+}
+
+void
+StaticModel::addBlockDecompositionToStructuralHash(StructuralHash &hash) const
+{
+  addBlocksToStructuralHash(hash, equation_type_and_normalized_equation, block_type_firstequation_size_mfs,
+                            blocks_linear);
+}
+
+void
+StaticModel::writeStaticFile(const string &basename, bool block, bool bytecode, bool use_dll, bool julia, int split_c_files) const
 {
   if (block && bytecode)
     writeModelEquationsCode_Block(basename, map_idx, map_idx2);
@@ -1998,7 +2166,7 @@ StaticModel::writeStaticFile(const string &basename, bool block, bool bytecode,
       writeStaticBlockMFSFile(basename);
     }
   else if (use_dll)
-    writeStaticCFile(basename);
+    writeStaticCFile(basename, split_c_files, "");
   else if (julia)
     writeStaticJuliaFile(basename);
   else
@@ -2228,77 +2396,101 @@ StaticModel::get_Derivatives(int block)
 void
 StaticModel::computeChainRuleJacobian(blocks_derivatives_t &blocks_derivatives)
 {
-  map<int, expr_t> recursive_variables;
   unsigned int nb_blocks = getNbBlocks();
   blocks_derivatives = blocks_derivatives_t(nb_blocks);
+  /* The derivatives to be computed by the chain rule are first listed for
+     all the blocks, since they are independent from one block to another,
+     and computed using nthreads threads */
+  vector<map<int, expr_t>> recursive_variables(nb_blocks);
+  vector<map<pair<pair<int, pair<int, int>>, pair<int, int>>, int>> blocks_Derivatives(nb_blocks);
+  vector<vector<pair<expr_t, int>>> chain_rule_derivatives(nb_blocks);
   for (unsigned int block = 0; block < nb_blocks; block++)
     {
-      block_derivatives_equation_variable_laglead_nodeid_t tmp_derivatives;
-      recursive_variables.clear();
       BlockSimulationType simulation_type = getBlockSimulationType(block);
       int block_size = getBlockSize(block);
       int block_nb_mfs = getBlockMfs(block);
       int block_nb_recursives = block_size - block_nb_mfs;
+      for (int i = 0; i < block_nb_recursives; i++)
+        {
+          if (getBlockEquationType(block, i) == E_EVALUATE_S)
+            recursive_variables[block][getDerivID(symbol_table.getID(SymbolType::endogenous, getBlockVariableID(block, i)), 0)] = getBlockEquationRenormalizedExpr(block, i);
+          else
+            recursive_variables[block][getDerivID(symbol_table.getID(SymbolType::endogenous, getBlockVariableID(block, i)), 0)] = getBlockEquationExpr(block, i);
+        }
       if (simulation_type == SOLVE_TWO_BOUNDARIES_COMPLETE || simulation_type == SOLVE_TWO_BOUNDARIES_SIMPLE)
         {
-          blocks_derivatives.push_back(block_derivatives_equation_variable_laglead_nodeid_t(0));
-          for (int i = 0; i < block_nb_recursives; i++)
+          blocks_Derivatives[block] = get_Derivatives(block);
+          for (const auto &it : blocks_Derivatives[block])
             {
-              if (getBlockEquationType(block, i) == E_EVALUATE_S)
-                recursive_variables[getDerivID(symbol_table.getID(SymbolType::endogenous, getBlockVariableID(block, i)), 0)] = getBlockEquationRenormalizedExpr(block, i);
-              else
-                recursive_variables[getDerivID(symbol_table.getID(SymbolType::endogenous, getBlockVariableID(block, i)), 0)] = getBlockEquationExpr(block, i);
-            }
-          map<pair<pair<int, pair<int, int>>, pair<int, int>>, int> Derivatives = get_Derivatives(block);
-          map<pair<pair<int, pair<int, int>>, pair<int, int>>, int>::const_iterator it = Derivatives.begin();
-          for (int i = 0; i < (int) Derivatives.size(); i++)
-            {
-              int Deriv_type = it->second;
-              pair<pair<int, pair<int, int>>, pair<int, int>> it_l(it->first);
-              it++;
-              int lag = it_l.first.first;
-              int eq = it_l.first.second.first;
-              int var = it_l.first.second.second;
-              int eqr = it_l.second.first;
-              int varr = it_l.second.second;
-              if (Deriv_type == 0)
-                first_chain_rule_derivatives[{ eqr, { varr, lag } }] = first_derivatives[{ eqr, getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag) }];
-              else if (Deriv_type == 1)
-                first_chain_rule_derivatives[{ eqr, { varr, lag } }] = (equation_type_and_normalized_equation[eqr].second)->getChainRuleDerivative(getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag), recursive_variables);
+              int Deriv_type = it.second;
+              int lag = it.first.first.first;
+              int eq = it.first.first.second.first;
+              int eqr = it.first.second.first;
+              int varr = it.first.second.second;
+              int deriv_id = getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag);
+              if (Deriv_type == 1)
+                chain_rule_derivatives[block].emplace_back(equation_type_and_normalized_equation[eqr].second, deriv_id);
               else if (Deriv_type == 2)
                 {
                   if (getBlockEquationType(block, eq) == E_EVALUATE_S && eq < block_nb_recursives)
-                    first_chain_rule_derivatives[{ eqr, { varr, lag } }] = (equation_type_and_normalized_equation[eqr].second)->getChainRuleDerivative(getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag), recursive_variables);
+                    chain_rule_derivatives[block].emplace_back(equation_type_and_normalized_equation[eqr].second, deriv_id);
                   else
-                    first_chain_rule_derivatives[{ eqr, { varr, lag } }] = equations[eqr]->getChainRuleDerivative(getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag), recursive_variables);
+                    chain_rule_derivatives[block].emplace_back(equations[eqr], deriv_id);
                 }
-              tmp_derivatives.emplace_back(make_pair(eq, var), make_pair(lag, first_chain_rule_derivatives[make_pair(eqr, make_pair(varr, lag))]));
             }
         }
       else
-        {
-          blocks_derivatives.push_back(block_derivatives_equation_variable_laglead_nodeid_t(0));
-          for (int i = 0; i < block_nb_recursives; i++)
-            {
-              if (getBlockEquationType(block, i) == E_EVALUATE_S)
-                recursive_variables[getDerivID(symbol_table.getID(SymbolType::endogenous, getBlockVariableID(block, i)), 0)] = getBlockEquationRenormalizedExpr(block, i);
-              else
-                recursive_variables[getDerivID(symbol_table.getID(SymbolType::endogenous, getBlockVariableID(block, i)), 0)] = getBlockEquationExpr(block, i);
-            }
-          for (int eq = block_nb_recursives; eq < block_size; eq++)
-            {
-              int eqr = getBlockEquationID(block, eq);
-              for (int var = block_nb_recursives; var < block_size; var++)
-                {
-                  int varr = getBlockVariableID(block, var);
-                  expr_t d1 = equations[eqr]->getChainRuleDerivative(getDerivID(symbol_table.getID(SymbolType::endogenous, varr), 0), recursive_variables);
-                  if (d1 == Zero)
-                    continue;
-                  first_chain_rule_derivatives[{ eqr, { varr, 0 } }] = d1;
-                  tmp_derivatives.emplace_back(make_pair(eq, var), make_pair(0, first_chain_rule_derivatives[make_pair(eqr, make_pair(varr, 0))]));
-                }
-            }
-        }
+        for (int eq = block_nb_recursives; eq < block_size; eq++)
+          {
+            int eqr = getBlockEquationID(block, eq);
+            for (int var = block_nb_recursives; var < block_size; var++)
+              {
+                int varr = getBlockVariableID(block, var);
+                chain_rule_derivatives[block].emplace_back(equations[eqr], getDerivID(symbol_table.getID(SymbolType::endogenous, varr), 0));
+              }
+          }
+    }
+
+  computeChainRuleDerivativesParallel(recursive_variables, chain_rule_derivatives);
+
+  for (unsigned int block = 0; block < nb_blocks; block++)
+    {
+      block_derivatives_equation_variable_laglead_nodeid_t tmp_derivatives;
+      BlockSimulationType simulation_type = getBlockSimulationType(block);
+      int block_size = getBlockSize(block);
+      int block_nb_mfs = getBlockMfs(block);
+      int block_nb_recursives = block_size - block_nb_mfs;
+      blocks_derivatives.push_back(block_derivatives_equation_variable_laglead_nodeid_t(0));
+      auto it_chr = chain_rule_derivatives[block].begin();
+      if (simulation_type == SOLVE_TWO_BOUNDARIES_COMPLETE || simulation_type == SOLVE_TWO_BOUNDARIES_SIMPLE)
+        for (const auto &it : blocks_Derivatives[block])
+          {
+            int Deriv_type = it.second;
+            int lag = it.first.first.first;
+            int eq = it.first.first.second.first;
+            int var = it.first.first.second.second;
+            int eqr = it.first.second.first;
+            int varr = it.first.second.second;
+            if (Deriv_type == 0)
+              first_chain_rule_derivatives[{ eqr, { varr, lag } }] = first_derivatives[{ eqr, getDerivID(symbol_table.getID(SymbolType::endogenous, varr), lag) }];
+            else if (Deriv_type == 1 || Deriv_type == 2)
+              first_chain_rule_derivatives[{ eqr, { varr, lag } }] = (it_chr++)->first;
+            tmp_derivatives.emplace_back(make_pair(eq, var), make_pair(lag, first_chain_rule_derivatives[make_pair(eqr, make_pair(varr, lag))]));
+          }
+      else
+        for (int eq = block_nb_recursives; eq < block_size; eq++)
+          {
+            int eqr = getBlockEquationID(block, eq);
+            for (int var = block_nb_recursives; var < block_size; var++)
+              {
+                int varr = getBlockVariableID(block, var);
+                expr_t d1 = (it_chr++)->first;
+                if (d1 == Zero)
+                  continue;
+                first_chain_rule_derivatives[{ eqr, { varr, 0 } }] = d1;
+                tmp_derivatives.emplace_back(make_pair(eq, var), make_pair(0, first_chain_rule_derivatives[make_pair(eqr, make_pair(varr, 0))]));
+              }
+          }
       blocks_derivatives[block] = tmp_derivatives;
     }
 }
@@ -2694,6 +2886,67 @@ StaticModel::writeParamsDerivativesFile(const string &basename, bool julia) cons
   paramsDerivsFile.close();
 }
 
+void
+StaticModel::writeParamsAdjointFile(const string &basename) const
+{
+  if (!params_derivs_adjoint)
+    return;
+
+  vector<pair<expr_t, string>> residuals_seeds, jacobian_seeds;
+  for (int eq = 0; eq < (int) equations.size(); eq++)
+    residuals_seeds.emplace_back(equations[eq], "r_bar(" + to_string(eq+1) + ")");
+  for (const auto &first_derivative : first_derivatives)
+    {
+      int eq, var;
+      tie(eq, var) = first_derivative.first;
+      int var_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(var)) + 1;
+      jacobian_seeds.emplace_back(first_derivative.second, "g1_bar(" + to_string(eq+1) + ", "
+                                  + to_string(var_col) + ")");
+    }
+
+  ostringstream body_output;
+  writeParamsAdjoint(body_output, ExprNodeOutputType::matlabStaticModel, residuals_seeds, jacobian_seeds);
+
+  // Check that we don't have more than 32 nested parenthesis because Matlab does not suppor this. See Issue #1201
+  map<string, string> tmp_paren_vars;
+  bool message_printed = false;
+  fixNestedParenthesis(body_output, tmp_paren_vars, message_printed);
+
+  string filename = packageDir(basename) + "/static_params_adjoint.m";
+  ofstream paramsAdjointFile;
+  paramsAdjointFile.open(filename, ios::out | ios::binary);
+  if (!paramsAdjointFile.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  paramsAdjointFile << "function [rp_bar, gp_bar] = static_params_adjoint(y, x, params, r_bar, g1_bar)" << endl
+                    << "%" << endl
+                    << "% Status : Computes in reverse mode the derivatives of weighted sums of the static model residuals" << endl
+                    << "%          and Jacobian with respect to the parameters" << endl
+                    << "%" << endl
+                    << "% Inputs : " << endl
+                    << "%   y         [M_.endo_nbr by 1] double    vector of endogenous variables in declaration order" << endl
+                    << "%   x         [M_.exo_nbr by 1] double     vector of exogenous variables in declaration order" << endl
+                    << "%   params    [M_.param_nbr by 1] double   vector of parameter values in declaration order" << endl
+                    << "%   r_bar     [M_.eq_nbr by 1] double      weights of the residuals" << endl
+                    << "%   g1_bar    [M_.eq_nbr by M_.endo_nbr] double   weights of the Jacobian entries" << endl
+                    << "%" << endl
+                    << "% Outputs:" << endl
+                    << "%   rp_bar    [1 by #params] double   r_bar'*rp, where rp is the Jacobian matrix of static model equations" << endl
+                    << "%                                     with respect to parameters (see static_params_derivs.m)" << endl
+                    << "%   gp_bar    [1 by #params] double   sum of g1_bar.*gp over equations and variables, where gp is the derivative" << endl
+                    << "%                                     of the Jacobian matrix with respect to the parameters (see static_params_derivs.m)" << endl
+                    << "%" << endl
+                    << "%" << endl
+                    << "% Warning : this file is generated automatically by Dynare" << endl
+                    << "%           from model file (.mod)" << endl << endl
+                    << body_output.str()
+                    << "end" << endl;
+  paramsAdjointFile.close();
+}
+
 void
 StaticModel::writeJsonOutput(ostream &output) const
 {
@@ -2703,11 +2956,11 @@ StaticModel::writeJsonOutput(ostream &output) const
 void
 StaticModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) const
 {
-  ostringstream model_local_vars_output;   // Used for storing model local vars
-  ostringstream model_output;              // Used for storing model
-  ostringstream jacobian_output;           // Used for storing jacobian equations
-  ostringstream hessian_output;            // Used for storing Hessian equations
-  ostringstream third_derivatives_output;  // Used for storing third order derivatives equations
+  OutputSection model_local_vars_output;   // Used for storing model local vars
+  OutputSection model_output;              // Used for storing model
+  OutputSection jacobian_output;           // Used for storing jacobian equations
+  OutputSection hessian_output;            // Used for storing Hessian equations
+  OutputSection third_derivatives_output;  // Used for storing third order derivatives equations
 
   deriv_node_temp_terms_t tef_terms;
   temporary_terms_t temp_term_union = temporary_terms_res;
@@ -2869,11 +3122,11 @@ StaticModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) co
     output << "\"static_model\": {";
   else
     output << "\"static_model_simple\": {";
-  output << model_local_vars_output.str()
-         << ", " << model_output.str()
-         << ", " << jacobian_output.str()
-         << ", " << hessian_output.str()
-         << ", " << third_derivatives_output.str()
+  output << model_local_vars_output
+         << ", " << model_output
+         << ", " << jacobian_output
+         << ", " << hessian_output
+         << ", " << third_derivatives_output
          << "}";
 }
 
@@ -2887,13 +3140,13 @@ StaticModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       && !hessian_params_derivatives.size())
     return;
 
-  ostringstream model_local_vars_output;   // Used for storing model local vars
-  ostringstream model_output;              // Used for storing model temp vars and equations
-  ostringstream jacobian_output;           // Used for storing jacobian equations
-  ostringstream hessian_output;            // Used for storing Hessian equations
-  ostringstream hessian1_output;           // Used for storing Hessian equations
-  ostringstream third_derivs_output;       // Used for storing third order derivatives equations
-  ostringstream third_derivs1_output;      // Used for storing third order derivatives equations
+  OutputSection model_local_vars_output;   // Used for storing model local vars
+  OutputSection model_output;              // Used for storing model temp vars and equations
+  OutputSection jacobian_output;           // Used for storing jacobian equations
+  OutputSection hessian_output;            // Used for storing Hessian equations
+  OutputSection hessian1_output;           // Used for storing Hessian equations
+  OutputSection third_derivs_output;       // Used for storing third order derivatives equations
+  OutputSection third_derivs1_output;      // Used for storing third order derivatives equations
 
   deriv_node_temp_terms_t tef_terms;
   writeJsonModelLocalVariables(model_local_vars_output, tef_terms);
@@ -3085,12 +3338,12 @@ StaticModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
     output << "\"static_model_params_derivative\": {";
   else
     output << "\"static_model_params_derivatives_simple\": {";
-  output << model_local_vars_output.str()
-         << ", " << model_output.str()
-         << ", " << jacobian_output.str()
-         << ", " << hessian_output.str()
-         << ", " << hessian1_output.str()
-         << ", " << third_derivs_output.str()
-         << ", " << third_derivs1_output.str()
+  output << model_local_vars_output
+         << ", " << model_output
+         << ", " << jacobian_output
+         << ", " << hessian_output
+         << ", " << hessian1_output
+         << ", " << third_derivs_output
+         << ", " << third_derivs1_output
          << "}";
 }
@@ -45,13 +45,15 @@ private:
   void writeStaticMFile(const string &basename) const;
 
   //! Writes static model file (C version)
-  void writeStaticCFile(const string &basename) const;
+  /*! If library_prefix is not empty, writes the standalone C library version
+    (without MEX gateway), whose symbols are prefixed with library_prefix */
+  void writeStaticCFile(const string &basename, int split_c_files, const string &library_prefix) const;
 
   //! Writes static model file (Julia version)
   void writeStaticJuliaFile(const string &basename) const;
 
   //! Writes the static model equations and its derivatives
-  void writeStaticModel(const string &basename, ostream &StaticOutput, bool use_dll, bool julia) const;
+  void writeStaticModel(const string &basename, ostream &StaticOutput, bool use_dll, bool julia, int split_c_files) const;
 
   //! Writes the static function calling the block to solve (Matlab version)
   void writeStaticBlockMFSFile(const string &basename) const;
@@ -82,9 +84,9 @@ private:
   void computeTemporaryTermsMapping(temporary_terms_t &temporary_terms, map_idx_t &map_idx);
 
   //! Write derivative code of an equation w.r. to a variable
-  void compileDerivative(ofstream &code_file, unsigned int &instruction_number, int eq, int symb_id, map_idx_t &map_idx, temporary_terms_t temporary_terms) const;
+  void compileDerivative(ostream &code_file, unsigned int &instruction_number, int eq, int symb_id, map_idx_t &map_idx, temporary_terms_t temporary_terms) const;
   //! Write chain rule derivative code of an equation w.r. to a variable
-  void compileChainRuleDerivative(ofstream &code_file, unsigned int &instruction_number, int eq, int var, int lag, map_idx_t &map_idx, temporary_terms_t temporary_terms) const;
+  void compileChainRuleDerivative(ostream &code_file, unsigned int &instruction_number, int eq, int var, int lag, map_idx_t &map_idx, temporary_terms_t temporary_terms) const;
 
   //! Get the type corresponding to a derivation ID
   SymbolType getTypeByDerivID(int deriv_id) const noexcept(false) override;
@@ -123,6 +125,8 @@ protected:
   //! Vector indicating if the block is linear in endogenous variable (true) or not (false)
   vector<bool> blocks_linear;
 
+  void addBlockDecompositionToStructuralHash(StructuralHash &hash) const override;
+
   //! Map the derivatives for a block pair<lag, make_pair(make_pair(eq, var)), expr_t>
   using derivative_t = map<pair< int, pair<int, int>>, expr_t>;
   //! Vector of derivative for each blocks
@@ -151,7 +155,7 @@ protected:
                               const string &name_tt, size_t ttlen,
                               const string &previous_tt_name,
                               const ostringstream &init_s, const ostringstream &end_s,
-                              const ostringstream &s, const ostringstream &s_tt) const;
+                              OutputSection &s, OutputSection &s_tt) const;
   void writeWrapperFunctions(const string &basename, const string &ending) const;
 
   //! Create a legacy *_static.m file for Matlab/Octave not yet using the temporary terms array interface
@@ -181,7 +185,11 @@ public:
                                    int &u_count_int, bool &file_open) const;
 
   //! Writes static model file
-  void writeStaticFile(const string &basename, bool block, bool bytecode, bool use_dll, bool julia) const;
+  void writeStaticFile(const string &basename, bool block, bool bytecode, bool use_dll, bool julia, int split_c_files) const;
+
+  //! Writes the static model of the standalone C library (see language=c), and its declarations to the header of the library
+  /*! The symbols of the library are prefixed with prefix */
+  void writeStaticCLibraryFile(const string &basename, const string &prefix, ostream &header) const;
 
   //! Write JSON Output (used by PlannerObjectiveStatement)
   void writeJsonOutput(ostream &output) const;
@@ -195,6 +203,9 @@ public:
   //! Writes file containing static parameters derivatives
   void writeParamsDerivativesFile(const string &basename, bool julia) const;
 
+  //! Writes file containing the reverse-mode static parameters derivatives (MATLAB only)
+  void writeParamsAdjointFile(const string &basename) const;
+
   //! Writes LaTeX file with the equations of the static model
   void writeLatexFile(const string &basename, const bool write_equation_tags) const;
 
@@ -543,6 +543,38 @@ SymbolTable::writeCOutput(ostream &output) const noexcept(false)
     }
 }
 
+void
+SymbolTable::writeCLibraryOutput(ostream &header, ostream &source, const string &prefix) const noexcept(false)
+{
+  if (!frozen)
+    throw NotYetFrozenException();
+
+  header << "/* Symbols, in declaration order. The arrays of names are terminated by NULL. */" << endl;
+
+  auto writeSymbols = [&](const string &type, const vector<int> &ids)
+    {
+      header << "extern const int " << prefix << type << "_nbr;" << endl
+             << "extern const char *const " << prefix << type << "_names[];" << endl;
+      source << endl
+             << "const int " << prefix << type << "_nbr = " << ids.size() << ";" << endl
+             << "const char *const " << prefix << type << "_names[] = {";
+      for (int id : ids)
+        source << endl << "  \"" << getName(id) << "\",";
+      source << endl << "  NULL" << endl
+             << "};" << endl;
+    };
+  writeSymbols("endo", endo_ids);
+  writeSymbols("exo", exo_ids);
+  writeSymbols("exo_det", exo_det_ids);
+  writeSymbols("param", param_ids);
+
+  // The auxiliary variables are the last endogenous
+  header << "extern const int " << prefix << "orig_endo_nbr;" << endl
+         << endl;
+  source << endl
+         << "const int " << prefix << "orig_endo_nbr = " << orig_endo_nbr() << ";" << endl;
+}
+
 void
 SymbolTable::writeCCOutput(ostream &output) const noexcept(false)
 {
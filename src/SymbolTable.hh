@@ -353,7 +353,7 @@ public:
   //! Get number of parameters
   inline int param_nbr() const noexcept(false);
   //! Returns the greatest symbol ID (the smallest is zero)
-  inline int maxID();
+  inline int maxID() const;
   //! Get number of user-declared endogenous variables (without the auxiliary variables)
   inline int orig_endo_nbr() const noexcept(false);
   //! Write output of this class
@@ -366,6 +366,10 @@ public:
   void writeCOutput(ostream &output) const noexcept(false);
   //! Write CC output of this class
   void writeCCOutput(ostream &output) const noexcept(false);
+  //! Write the symbol metadata of the standalone C library (see language=c)
+  /*! The declarations go to the header, the definitions to the source file;
+    the names are prefixed with prefix */
+  void writeCLibraryOutput(ostream &header, ostream &source, const string &prefix) const noexcept(false);
   //! Mark a symbol as predetermined variable
   void markPredetermined(int symb_id) noexcept(false);
   //! Test if a given symbol is a predetermined variable
@@ -515,7 +519,7 @@ SymbolTable::param_nbr() const noexcept(false)
 }
 
 inline int
-SymbolTable::maxID()
+SymbolTable::maxID() const
 {
   return symbol_table.size() - 1;
 }